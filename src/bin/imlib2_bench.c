@@ -0,0 +1,782 @@
+/*
+ * Benchmark the core imlib2 kernels on synthetic images
+ */
+#include "config.h"
+#ifndef X_DISPLAY_MISSING
+#define X_DISPLAY_MISSING
+#endif
+#include <Imlib2.h>
+
+#include <math.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "prog_util.h"
+
+#define PROG_NAME "imlib2_bench"
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof(a[0]))
+
+#define HELP \
+   "Usage:\n" \
+   "  imlib2_bench [OPTIONS] [KERNEL...]\n" \
+   "    KERNEL selects benchmarks by name prefix (default: all).\n" \
+   "\n" \
+   "OPTIONS:\n" \
+   "  -c CPU   : Pin to CPU number CPU, running single threaded\n" \
+   "             (IMLIB2_THREADS=1, other thread counts are rejected)\n" \
+   "  -d DIR   : Directory for load/save temporary files (default /tmp)\n" \
+   "  -f FONT  : Font for text benchmarks (default notepad/15)\n" \
+   "  -g WxH   : Synthetic image size (default 1024x768)\n" \
+   "  -h       : Show help\n" \
+   "  -k KIND  : Kernel selection, 'c', 'asm' (default, best available),\n" \
+   "             or an instruction set cap: 'sse2', 'ssse3', 'avx2', 'avx512'\n" \
+   "  -l       : List benchmarks and exit\n" \
+   "  -n N     : Iterations per benchmark (default 10)\n" \
+   "  -o FILE  : Write JSON results to FILE (default stdout)\n" \
+   "  -s SEED  : Seed for synthetic image contents\n"
+
+typedef struct {
+    const char     *name;
+    void            (*func)(int arg);
+    int             arg;
+} bench_t;
+
+static int      opt_w = 1024;
+static int      opt_h = 768;
+static int      opt_iter = 10;
+static unsigned int opt_seed = 1;
+static const char *opt_dir = "/tmp";
+static const char *opt_font = "notepad/15";
+
+static Imlib_Image im_src;      /* Source with alpha */
+static Imlib_Image im_dst;      /* Destination without alpha */
+static Imlib_Color_Modifier cmod;
+static Imlib_Font font;
+
+/* Pixels processed by the latest benchmark iteration */
+static double   npix;
+
+static const char *const op_names[] = { "copy", "add", "subtract", "reshade" };
+
+static const char *const save_formats[] = {
+    "argb", "bmp", "ff", "jpg", "jxl", "png", "pnm", "qoi", "tga", "tiff",
+    "webp",
+};
+
+static void
+usage(void)
+{
+    printf(HELP);
+}
+
+static unsigned int
+rnd(void)
+{
+    opt_seed = opt_seed * 1103515245 + 12345;
+    return opt_seed >> 8;
+}
+
+static Imlib_Image
+image_create_synthetic(int w, int h, bool alpha)
+{
+    Imlib_Image     im;
+    uint32_t       *data;
+    int             x, y;
+    unsigned int    r, g, b, a;
+
+    im = imlib_create_image(w, h);
+    if (!im)
+        return NULL;
+
+    imlib_context_set_image(im);
+    imlib_image_set_has_alpha(alpha);
+    data = imlib_image_get_data();
+
+    /* Gradients with a bit of noise - something like a photo */
+    for (y = 0; y < h; y++)
+    {
+        for (x = 0; x < w; x++)
+        {
+            r = (x * 255 / w + (rnd() & 0x0f)) & 0xff;
+            g = (y * 255 / h + (rnd() & 0x0f)) & 0xff;
+            b = ((x + y) * 255 / (w + h)) & 0xff;
+            a = alpha ? ((x ^ y) & 0xff) : 0xff;
+            *data++ = (a << 24) | (r << 16) | (g << 8) | b;
+        }
+    }
+
+    imlib_image_put_back_data(imlib_image_get_data());
+
+    return im;
+}
+
+static void
+bench_scale(int arg)
+{
+    Imlib_Image     im;
+    int             w, h;
+
+    /* arg: bit 0 = anti-alias, bit 1 = up-scale */
+    w = (arg & 2) ? opt_w * 2 : opt_w / 2;
+    h = (arg & 2) ? opt_h * 2 : opt_h / 2;
+
+    imlib_context_set_anti_alias(arg & 1);
+    imlib_context_set_image(im_src);
+    im = imlib_create_cropped_scaled_image(0, 0, opt_w, opt_h, w, h);
+    if (!im)
+        return;
+    imlib_context_set_image(im);
+    imlib_free_image_and_decache();
+
+    npix = (double)w * h;
+}
+
+static void
+bench_blend(int arg)
+{
+    /* arg: bits 0-1 = operation, bit 2 = color modifier */
+    imlib_context_set_operation(arg & 3);
+    imlib_context_set_color_modifier((arg & 4) ? cmod : NULL);
+    imlib_context_set_blend(1);
+    imlib_context_set_image(im_dst);
+    imlib_blend_image_onto_image(im_src, 0, 0, 0, opt_w, opt_h,
+                                 0, 0, opt_w, opt_h);
+    imlib_context_set_color_modifier(NULL);
+    imlib_context_set_operation(IMLIB_OP_COPY);
+
+    npix = (double)opt_w * opt_h;
+}
+
+static void
+bench_blend_scaled(int arg)
+{
+    /* arg: bit 0 = anti-alias, bit 1 = color modifier */
+    imlib_context_set_anti_alias(arg & 1);
+    imlib_context_set_color_modifier((arg & 2) ? cmod : NULL);
+    imlib_context_set_blend(1);
+    imlib_context_set_image(im_dst);
+    imlib_blend_image_onto_image(im_src, 0, 0, 0, opt_w / 2, opt_h / 2,
+                                 0, 0, opt_w, opt_h);
+    imlib_context_set_color_modifier(NULL);
+
+    npix = (double)opt_w * opt_h;
+}
+
+static void
+bench_color_adjust(int arg)
+{
+    imlib_context_set_image(im_dst);
+    switch (arg)
+    {
+    case 0:
+        imlib_image_adjust_hsv(30, 1.2, 0.9);
+        break;
+    case 1:
+        imlib_image_adjust_hls(30, 0.9, 1.2);
+        break;
+    case 2:
+        imlib_image_grayscale();
+        break;
+    }
+
+    npix = (double)opt_w * opt_h;
+}
+
+static void
+bench_cmod_apply(int arg)
+{
+    imlib_context_set_color_modifier(cmod);
+    imlib_context_set_image(im_dst);
+    imlib_apply_color_modifier();
+    imlib_context_set_color_modifier(NULL);
+
+    npix = (double)opt_w * opt_h;
+}
+
+static void
+bench_rotate(int arg)
+{
+    Imlib_Image     im;
+
+    imlib_context_set_anti_alias(arg);
+    imlib_context_set_image(im_src);
+    im = imlib_create_rotated_image(0.3);
+    if (!im)
+        return;
+    imlib_context_set_image(im);
+    npix = (double)imlib_image_get_width() * imlib_image_get_height();
+    imlib_free_image_and_decache();
+}
+
+static void
+bench_orientate(int arg)
+{
+    static Imlib_Image im;
+
+    /* Orientate a private copy in place, the size may flip-flop */
+    if (!im)
+    {
+        imlib_context_set_image(im_src);
+        im = imlib_clone_image();
+        if (!im)
+            return;
+    }
+    imlib_context_set_image(im);
+    imlib_image_orientate(arg);
+
+    npix = (double)opt_w * opt_h;
+}
+
+static void
+bench_skew(int arg)
+{
+    imlib_context_set_anti_alias(arg);
+    imlib_context_set_blend(1);
+    imlib_context_set_image(im_dst);
+    imlib_blend_image_onto_image_skewed(im_src, 0, 0, 0, opt_w, opt_h,
+                                        opt_w / 8, 0, opt_w * 3 / 4, opt_h / 8,
+                                        -opt_w / 8, opt_h * 3 / 4);
+
+    npix = (double)opt_w * opt_h * 3 / 4;
+}
+
+static void
+bench_filter(int arg)
+{
+    imlib_context_set_image(im_dst);
+    if (arg)
+        imlib_image_sharpen(3);
+    else
+        imlib_image_blur(3);
+
+    npix = (double)opt_w * opt_h;
+}
+
+static void
+bench_fill_polygon(int arg)
+{
+    ImlibPolygon    poly;
+    int             i, n;
+    double          r, t;
+
+    /* A star with arg spikes covering most of the image */
+    n = 2 * arg;
+    poly = imlib_polygon_new();
+    for (i = 0; i < n; i++)
+    {
+        r = (i & 1) ? 0.25 : 0.5;
+        t = 2 * M_PI * i / n;
+        imlib_polygon_add_point(poly,
+                                opt_w / 2 + (int)(r * opt_w * cos(t)),
+                                opt_h / 2 +
+                                (int)(r * opt_h * sin(t)));
+    }
+
+    imlib_context_set_anti_alias(1);
+    imlib_context_set_blend(1);
+    imlib_context_set_color(200, 100, 50, 128);
+    imlib_context_set_image(im_dst);
+    imlib_image_fill_polygon(poly);
+    imlib_polygon_free(poly);
+
+    npix = (double)opt_w * opt_h / 2;
+}
+
+static void
+bench_fill_ellipse(int arg)
+{
+    imlib_context_set_anti_alias(arg);
+    imlib_context_set_blend(1);
+    imlib_context_set_color(50, 100, 200, 128);
+    imlib_context_set_image(im_dst);
+    imlib_image_fill_ellipse(opt_w / 2, opt_h / 2, opt_w / 2 - 1,
+                             opt_h / 2 - 1);
+
+    npix = M_PI * (opt_w / 2) * (opt_h / 2);
+}
+
+static void
+bench_fill_rectangle(int arg)
+{
+    imlib_context_set_blend(arg);
+    imlib_context_set_color(50, 200, 100, 128);
+    imlib_context_set_image(im_dst);
+    imlib_image_fill_rectangle(0, 0, opt_w, opt_h);
+
+    npix = (double)opt_w * opt_h;
+}
+
+static void
+bench_draw_lines(int arg)
+{
+    Imlib_Draw_List dl;
+    int            *xy;
+    int             i, n, dx, dy;
+
+    /* A chart line with many short segments */
+    n = 16 * opt_w;
+    xy = malloc(2 * (n + 1) * sizeof(int));
+    if (!xy)
+        return;
+    npix = 0;
+    for (i = 0; i <= n; i++)
+    {
+        xy[2 * i] = (long)i * (opt_w - 1) / n;
+        xy[2 * i + 1] = opt_h / 2 + (int)(opt_h / 3 * sin(i * 8. / n)) +
+            (int)(rnd() % 32) - 16;
+        if (i == 0)
+            continue;
+        dx = abs(xy[2 * i] - xy[2 * i - 2]);
+        dy = abs(xy[2 * i + 1] - xy[2 * i - 1]);
+        npix += (dx > dy ? dx : dy) + 1;
+    }
+
+    imlib_context_set_anti_alias(arg & 1);
+    imlib_context_set_blend(1);
+    imlib_context_set_color(30, 100, 200, 200);
+    imlib_context_set_line_width(arg & 4 ? 8 : 0);
+    imlib_context_set_line_cap(IMLIB_LINE_CAP_ROUND);
+    imlib_context_set_image(im_dst);
+    if (arg & 2)
+    {
+        dl = imlib_draw_list_new();
+        imlib_draw_list_draw_polyline(dl, xy, n + 1, 0);
+        imlib_image_draw_list(dl);
+        imlib_draw_list_free(dl);
+    }
+    else
+    {
+        for (i = 0; i < n; i++)
+            imlib_image_draw_line(xy[2 * i], xy[2 * i + 1],
+                                  xy[2 * i + 2], xy[2 * i + 3], 0);
+    }
+
+    free(xy);
+    imlib_context_set_line_width(0);
+    if (arg & 4)
+        npix *= 8;
+}
+
+static void
+bench_draw_ellipse(int arg)
+{
+    imlib_context_set_anti_alias(1);
+    imlib_context_set_blend(1);
+    imlib_context_set_color(50, 100, 200, 128);
+    imlib_context_set_line_width(arg);
+    imlib_context_set_image(im_dst);
+    imlib_image_draw_ellipse(opt_w / 2, opt_h / 2, opt_w / 2 - 1 - arg,
+                             opt_h / 2 - 1 - arg);
+    imlib_context_set_line_width(0);
+
+    npix = M_PI * (opt_w + opt_h) / 2 * (arg ? arg : 1);
+}
+
+static void
+bench_fill_gradient(int arg)
+{
+    Imlib_Color_Range range;
+
+    range = imlib_create_color_range();
+    imlib_context_set_color_range(range);
+    imlib_context_set_color(255, 0, 0, 255);
+    imlib_add_color_to_color_range(0);
+    imlib_context_set_color(0, 255, 64, 160);
+    imlib_add_color_to_color_range(10);
+    imlib_context_set_color(0, 32, 255, 255);
+    imlib_add_color_to_color_range(10);
+
+    imlib_context_set_image(im_dst);
+    if (arg)
+        imlib_image_fill_hsva_color_range_rectangle(0, 0, opt_w, opt_h, 30.);
+    else
+        imlib_image_fill_color_range_rectangle(0, 0, opt_w, opt_h, 30.);
+    imlib_free_color_range();
+
+    npix = (double)opt_w * opt_h;
+}
+
+static void
+bench_text(int arg)
+{
+    static const char text[] = "The quick brown fox jumps over the lazy dog";
+    int             y, tw, th;
+
+    if (!font)
+        return;
+
+    imlib_context_set_font(font);
+    imlib_context_set_direction(arg);
+    imlib_context_set_angle(0.2);
+    imlib_context_set_blend(1);
+    imlib_context_set_color(255, 255, 255, 255);
+    imlib_context_set_image(im_dst);
+    imlib_get_text_size(text, &tw, &th);
+    if (th <= 0)
+        return;
+
+    npix = 0;
+    for (y = 0; y + th <= opt_h; y += th)
+    {
+        imlib_text_draw(0, y, text);
+        npix += (double)tw * th;
+    }
+    imlib_context_set_direction(IMLIB_TEXT_TO_RIGHT);
+}
+
+static void
+bench_save(int arg)
+{
+    char            buf[4096];
+
+    snprintf(buf, sizeof(buf), "%s/%s-%d.%s", opt_dir, PROG_NAME, getpid(),
+             save_formats[arg]);
+
+    imlib_context_set_image(im_src);
+    imlib_image_set_format(save_formats[arg]);
+    imlib_save_image(buf);
+    if (imlib_get_error())
+        return;
+
+    npix = (double)opt_w * opt_h;
+}
+
+static void
+bench_load(int arg)
+{
+    char            buf[4096];
+    Imlib_Image     im;
+
+    snprintf(buf, sizeof(buf), "%s/%s-%d.%s", opt_dir, PROG_NAME, getpid(),
+             save_formats[arg]);
+
+    im = imlib_load_image_immediately(buf);
+    if (!im)
+        return;
+    imlib_context_set_image(im);
+    imlib_free_image_and_decache();
+
+    npix = (double)opt_w * opt_h;
+}
+
+static void
+bench_cleanup_files(void)
+{
+    char            buf[4096];
+    unsigned int    i;
+
+    for (i = 0; i < ARRAY_SIZE(save_formats); i++)
+    {
+        snprintf(buf, sizeof(buf), "%s/%s-%d.%s", opt_dir, PROG_NAME,
+                 getpid(), save_formats[i]);
+        unlink(buf);
+    }
+}
+
+static bench_t *benches;
+static int      n_benches;
+
+static void
+bench_add(const char *name, void (*func)(int arg), int arg)
+{
+    benches = realloc(benches, (n_benches + 1) * sizeof(bench_t));
+    if (!benches)
+        exit(1);
+    benches[n_benches].name = strdup(name);
+    benches[n_benches].func = func;
+    benches[n_benches].arg = arg;
+    n_benches++;
+}
+
+static void
+bench_setup(void)
+{
+    char            buf[64];
+    unsigned int    i;
+    int             op;
+
+    bench_add("scale_sample_down", bench_scale, 0);
+    bench_add("scale_aa_down", bench_scale, 1);
+    bench_add("scale_sample_up", bench_scale, 2);
+    bench_add("scale_aa_up", bench_scale, 3);
+
+    for (op = 0; op < 4; op++)
+    {
+        snprintf(buf, sizeof(buf), "blend_%s", op_names[op]);
+        bench_add(buf, bench_blend, op);
+        snprintf(buf, sizeof(buf), "blend_%s_cmod", op_names[op]);
+        bench_add(buf, bench_blend, op | 4);
+    }
+    bench_add("blend_scaled_sample", bench_blend_scaled, 0);
+    bench_add("blend_scaled_aa", bench_blend_scaled, 1);
+    bench_add("blend_scaled_aa_cmod", bench_blend_scaled, 3);
+    bench_add("cmod_apply", bench_cmod_apply, 0);
+    bench_add("adjust_hsv", bench_color_adjust, 0);
+    bench_add("adjust_hls", bench_color_adjust, 1);
+    bench_add("grayscale", bench_color_adjust, 2);
+
+    bench_add("rotate_sample", bench_rotate, 0);
+    bench_add("rotate_aa", bench_rotate, 1);
+    bench_add("rotate_90", bench_orientate, 1);
+    bench_add("rotate_180", bench_orientate, 2);
+    bench_add("flip_horizontal", bench_orientate, 4);
+    bench_add("flip_vertical", bench_orientate, 6);
+    bench_add("flip_transpose", bench_orientate, 7);
+    bench_add("skew_sample", bench_skew, 0);
+    bench_add("skew_aa", bench_skew, 1);
+
+    bench_add("filter_blur", bench_filter, 0);
+    bench_add("filter_sharpen", bench_filter, 1);
+
+    bench_add("fill_rectangle_copy", bench_fill_rectangle, 0);
+    bench_add("fill_rectangle_blend", bench_fill_rectangle, 1);
+    bench_add("fill_gradient", bench_fill_gradient, 0);
+    bench_add("fill_gradient_hsva", bench_fill_gradient, 1);
+    bench_add("fill_polygon_16", bench_fill_polygon, 8);
+    bench_add("fill_polygon_4096", bench_fill_polygon, 2048);
+    bench_add("fill_ellipse", bench_fill_ellipse, 0);
+    bench_add("fill_ellipse_aa", bench_fill_ellipse, 1);
+    bench_add("draw_lines", bench_draw_lines, 0);
+    bench_add("draw_lines_aa", bench_draw_lines, 1);
+    bench_add("draw_list_lines", bench_draw_lines, 2);
+    bench_add("draw_list_lines_aa", bench_draw_lines, 3);
+    bench_add("draw_lines_wide_aa", bench_draw_lines, 5);
+    bench_add("draw_ellipse_aa", bench_draw_ellipse, 0);
+    bench_add("draw_ellipse_wide_aa", bench_draw_ellipse, 32);
+
+    bench_add("text_horizontal", bench_text, IMLIB_TEXT_TO_RIGHT);
+    bench_add("text_angle", bench_text, IMLIB_TEXT_TO_ANGLE);
+
+    /* Save must run before load */
+    for (i = 0; i < ARRAY_SIZE(save_formats); i++)
+    {
+        snprintf(buf, sizeof(buf), "save_%s", save_formats[i]);
+        bench_add(buf, bench_save, i);
+    }
+    for (i = 0; i < ARRAY_SIZE(save_formats); i++)
+    {
+        snprintf(buf, sizeof(buf), "load_%s", save_formats[i]);
+        bench_add(buf, bench_load, i);
+    }
+}
+
+static bool
+bench_selected(const bench_t *b, int argc, char **argv)
+{
+    int             i;
+
+    if (argc <= 0)
+        return true;
+
+    for (i = 0; i < argc; i++)
+        if (strncmp(b->name, argv[i], strlen(argv[i])) == 0)
+            return true;
+
+    return false;
+}
+
+static void
+bench_run(FILE *fout, const bench_t *b, bool first)
+{
+    unsigned int    t0, dt;
+    double          pix;
+    int             i;
+
+    /* Warm up - also checks that the kernel is available */
+    npix = 0;
+    b->func(b->arg);
+    if (npix <= 0)
+    {
+        fprintf(stderr, "%s: Skipping %s (not available)\n",
+                PROG_NAME, b->name);
+        return;
+    }
+
+    pix = 0;
+    t0 = time_us();
+    for (i = 0; i < opt_iter; i++)
+    {
+        b->func(b->arg);
+        pix += npix;
+    }
+    dt = time_us() - t0;
+    if (dt == 0)
+        dt = 1;
+
+    fprintf(fout, "%s    {\"name\": \"%s\", \"iterations\": %d, "
+            "\"pixels\": %.0f, \"time_us\": %u, "
+            "\"mpix_per_s\": %.3f, \"ns_per_pixel\": %.4f}",
+            first ? "" : ",\n", b->name, opt_iter, pix, dt,
+            pix / dt, 1e3 * dt / pix);
+}
+
+int
+main(int argc, char **argv)
+{
+    int             opt, i, cpu;
+    bool            list, first;
+    const char     *kind, *fout_name, *threads;
+    FILE           *fout;
+    cpu_set_t       cpus;
+
+    cpu = -1;
+    list = false;
+    kind = NULL;
+    fout_name = NULL;
+
+    while ((opt = getopt(argc, argv, "c:d:f:g:hk:ln:o:s:")) != -1)
+    {
+        switch (opt)
+        {
+        default:
+        case 'h':
+            usage();
+            return 1;
+        case 'c':
+            cpu = atoi(optarg);
+            break;
+        case 'd':
+            opt_dir = optarg;
+            break;
+        case 'f':
+            opt_font = optarg;
+            break;
+        case 'g':
+            sscanf(optarg, "%dx%d", &opt_w, &opt_h);
+            break;
+        case 'k':
+            kind = optarg;
+            break;
+        case 'l':
+            list = true;
+            break;
+        case 'n':
+            opt_iter = atoi(optarg);
+            break;
+        case 'o':
+            fout_name = optarg;
+            break;
+        case 's':
+            opt_seed = strtoul(optarg, NULL, 0);
+            break;
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    bench_setup();
+
+    if (list)
+    {
+        for (i = 0; i < n_benches; i++)
+            printf("%s\n", benches[i].name);
+        return 0;
+    }
+
+    if (opt_w < 2 || opt_h < 2 || opt_iter <= 0)
+    {
+        usage();
+        return 1;
+    }
+
+    /* Must be set before the first imlib2 call, the selection is latched */
+    if (kind && strcmp(kind, "c") == 0)
+        setenv("IMLIB2_ASM_OFF", "1", 1);
+    else if (kind && strcmp(kind, "asm") == 0)
+        unsetenv("IMLIB2_ASM_OFF");
+    else if (kind && (strcmp(kind, "sse2") == 0 ||
+                      strcmp(kind, "ssse3") == 0 ||
+                      strcmp(kind, "avx2") == 0 ||
+                      strcmp(kind, "avx512") == 0))
+    {
+        unsetenv("IMLIB2_ASM_OFF");
+        setenv("IMLIB2_ISA", kind, 1);
+    }
+    else if (kind)
+    {
+        usage();
+        return 1;
+    }
+
+    if (cpu >= 0)
+    {
+        /* Threads created later inherit the affinity mask, so a pool
+         * would share the one CPU. Run without one. */
+        threads = getenv("IMLIB2_THREADS");
+        if (threads && strtol(threads, NULL, 0) != 1)
+        {
+            fprintf(stderr, "%s: -c needs IMLIB2_THREADS=1\n", PROG_NAME);
+            return 1;
+        }
+        setenv("IMLIB2_THREADS", "1", 1);
+
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        if (sched_setaffinity(0, sizeof(cpus), &cpus))
+        {
+            fprintf(stderr, "%s: Cannot pin to cpu %d\n", PROG_NAME, cpu);
+            return 1;
+        }
+    }
+
+    fout = stdout;
+    if (fout_name)
+    {
+        fout = fopen(fout_name, "w");
+        if (!fout)
+        {
+            fprintf(stderr, "%s: Cannot open '%s'\n", PROG_NAME, fout_name);
+            return 1;
+        }
+    }
+
+    im_src = image_create_synthetic(opt_w, opt_h, true);
+    im_dst = image_create_synthetic(opt_w, opt_h, false);
+    if (!im_src || !im_dst)
+    {
+        fprintf(stderr, "%s: Cannot create %dx%d images\n", PROG_NAME,
+                opt_w, opt_h);
+        return 1;
+    }
+
+    cmod = imlib_create_color_modifier();
+    imlib_context_set_color_modifier(cmod);
+    imlib_modify_color_modifier_gamma(0.8);
+    imlib_modify_color_modifier_brightness(0.1);
+    imlib_modify_color_modifier_contrast(1.2);
+    imlib_context_set_color_modifier(NULL);
+
+    imlib_add_path_to_font_path(PACKAGE_DATA_DIR "/data/fonts");
+    font = imlib_load_font(opt_font);
+
+    fprintf(fout, "{\n  \"program\": \"%s\",\n  \"version\": %d,\n"
+            "  \"width\": %d,\n  \"height\": %d,\n  \"iterations\": %d,\n"
+            "  \"kernels\": \"%s\",\n  \"cpu\": %d,\n  \"results\": [\n",
+            PROG_NAME, imlib_version(), opt_w, opt_h, opt_iter,
+            getenv("IMLIB2_ASM_OFF") ? "c" : kind ? kind : "asm", cpu);
+
+    first = true;
+    for (i = 0; i < n_benches; i++)
+    {
+        if (!bench_selected(&benches[i], argc, argv))
+            continue;
+        bench_run(fout, &benches[i], first);
+        if (npix > 0)
+            first = false;
+    }
+
+    fprintf(fout, "\n  ]\n}\n");
+
+    bench_cleanup_files();
+
+    if (fout != stdout)
+        fclose(fout);
+
+    return 0;
+}
@@ -54,6 +54,8 @@ typedef void   *Imlib_Font;
 typedef void   *Imlib_Color_Range;
 typedef void   *Imlib_Filter;
 typedef void   *ImlibPolygon;
+typedef void   *Imlib_Draw_List;
+typedef void   *Imlib_Text_Run;
 
 /* blending operations */
 typedef enum {
@@ -71,6 +73,17 @@ typedef enum {
     IMLIB_TEXT_TO_ANGLE = 4
 } Imlib_Text_Direction;
 
+typedef enum {
+    IMLIB_FILL_EVEN_ODD,
+    IMLIB_FILL_NON_ZERO
+} Imlib_Fill_Rule;
+
+typedef enum {
+    IMLIB_LINE_CAP_BUTT,
+    IMLIB_LINE_CAP_ROUND,
+    IMLIB_LINE_CAP_SQUARE
+} Imlib_Line_Cap;
+
 #define IMLIB_ERR_INTERNAL      -1      /* Internal error (should not happen) */
 #define IMLIB_ERR_NO_LOADER     -2      /* No loader for file format */
 #define IMLIB_ERR_NO_SAVER      -3      /* No saver for file format */
@@ -85,6 +98,15 @@ typedef struct {
     int             alpha, red, green, blue;
 } Imlib_Color;
 
+/* A string for imlib_text_draw_items() */
+typedef struct {
+    Imlib_Font      font;
+    uint32_t        color;      /* ARGB */
+    int             x, y;       /* Top left corner */
+    const char     *text;
+    Imlib_Text_Direction direction;
+} Imlib_Text_Item;
+
 /* Progressive loading callback */
 typedef int     (*Imlib_Progress_Function)(Imlib_Image im, char percent,
                                            int update_x, int update_y,
@@ -266,6 +288,31 @@ EAPI void       imlib_context_set_mask_alpha_threshold(int
  */
 EAPI int        imlib_context_get_mask_alpha_threshold(void);
 
+/**
+ * Set X RENDER mode
+ *
+ * If on (1), images are rendered to drawables by uploading them once to
+ * the server and letting the X RENDER extension scale, skew and blend
+ * them there, instead of grabbing the drawable and doing it client side.
+ * This is much faster over a network or for repeated renders of the same
+ * image. The result is close to, but not exactly, that of the client side
+ * rendering (scaling down is not area averaged, and the colors are not
+ * dithered), so it is off (0) by default.
+ * Rendering falls back to the client side when the server or visual
+ * can't do it, with a mask, a color modifier, an operation other than
+ * IMLIB_OP_COPY, or an image with alpha and blending off.
+ *
+ * @param xrender       The X RENDER flag
+ */
+EAPI void       imlib_context_set_xrender(char xrender);
+
+/**
+ * Return the current X RENDER mode
+ *
+ * @return The current X RENDER flag
+ */
+EAPI char       imlib_context_get_xrender(void);
+
 #endif                          /* X_DISPLAY_MISSING */
 
 /**
@@ -380,6 +427,43 @@ EAPI void       imlib_context_set_operation(Imlib_Operation operation);
  */
 EAPI Imlib_Operation imlib_context_get_operation(void);
 
+/**
+ * Set line width
+ *
+ * With a line width > 0 lines, ellipses and arcs are drawn as strokes
+ * of that width, centered on the outline, with area coverage when
+ * anti-aliased. The default, 0, keeps the one pixel wide lines.
+ *
+ * @param width         The line width in pixels
+ */
+EAPI void       imlib_context_set_line_width(double width);
+
+/**
+ * Return the current line width
+ *
+ * @return The current line width
+ */
+EAPI double     imlib_context_get_line_width(void);
+
+/**
+ * Set line cap style
+ *
+ * Sets how the ends of wide lines and arcs are drawn.
+ * IMLIB_LINE_CAP_BUTT (the default) ends the stroke at the end point,
+ * IMLIB_LINE_CAP_ROUND adds a half circle and IMLIB_LINE_CAP_SQUARE a half
+ * square around the end point.
+ *
+ * @param cap           The line cap style
+ */
+EAPI void       imlib_context_set_line_cap(Imlib_Line_Cap cap);
+
+/**
+ * Return the current line cap style
+ *
+ * @return The current line cap style
+ */
+EAPI Imlib_Line_Cap imlib_context_get_line_cap(void);
+
 /**
  * Set the font to use when rendering text
  *
@@ -1731,6 +1815,41 @@ EAPI void       imlib_image_tile_vertical(void);
  */
 EAPI void       imlib_image_tile(void);
 
+/**
+ * Adjust the colors of the current image in HSV space
+ *
+ * Rotates the hue of all pixels by @p hue degrees and multiplies their
+ * saturation and value by @p saturation and @p value (results are limited
+ * to the valid range). Alpha is unchanged.
+ * imlib_image_adjust_hsv(0, 1, 1) leaves the image unchanged.
+ *
+ * @param hue           The hue rotation (degrees)
+ * @param saturation    The saturation factor (0 - 255)
+ * @param value         The value factor (0 - 255)
+ */
+EAPI void       imlib_image_adjust_hsv(float hue, float saturation,
+                                       float value);
+
+/**
+ * Adjust the colors of the current image in HLS space
+ *
+ * Like imlib_image_adjust_hsv() but scales lightness instead of value.
+ *
+ * @param hue           The hue rotation (degrees)
+ * @param lightness     The lightness factor (0 - 255)
+ * @param saturation    The saturation factor (0 - 255)
+ */
+EAPI void       imlib_image_adjust_hls(float hue, float lightness,
+                                       float saturation);
+
+/**
+ * Convert the current image to grayscale
+ *
+ * Sets the red, green and blue of all pixels to their luma (ITU-R BT.601
+ * weights, as the Y of JPEG YCbCr). Alpha is unchanged.
+ */
+EAPI void       imlib_image_grayscale(void);
+
 /**
  * Copy image alpha
  *
@@ -1941,11 +2060,114 @@ EAPI void       imlib_get_text_advance(const char *text,
  */
 EAPI int        imlib_get_text_inset(const char *text);
 
+/**
+ * Create a text run
+ *
+ * Lays out @p text with the current font (and its fallback chain) once,
+ * so it can be measured and drawn many times without walking the string
+ * and looking up its characters again.
+ * The run keeps using the font it was made with, which must not be freed
+ * before the run. If the fallback chain changes the run is laid out again
+ * when next used.
+ *
+ * The plain text functions share a cache of recently used runs, so this
+ * is mostly for strings drawn over and over, like labels.
+ *
+ * @param text          A null-byte terminated string
+ *
+ * @return The text run, NULL on failure
+ */
+EAPI Imlib_Text_Run imlib_text_run_new(const char *text);
+
+/**
+ * Free a text run
+ *
+ * @param run           The text run
+ */
+EAPI void       imlib_text_run_free(Imlib_Text_Run run);
+
+/**
+ * Draw a text run
+ *
+ * Works just like imlib_text_draw() with the run's text and font.
+ *
+ * @param run           The text run
+ * @param x             The x coordinate of the top left corner
+ * @param y             The y coordinate of the top left corner
+ */
+EAPI void       imlib_text_run_draw(Imlib_Text_Run run, int x, int y);
+
+/**
+ * Draw a text run and return metrics
+ *
+ * Works just like imlib_text_draw_with_return_metrics() with the run's
+ * text and font.
+ *
+ * @param run           The text run
+ * @param x             The x coordinate of the top left corner
+ * @param y             The y coordinate of the top left corner
+ * @param width_return  The width of the string
+ * @param height_return The height of the string
+ * @param horizontal_advance_return  Horizontal offset
+ * @param vertical_advance_return    Vertical offset
+ */
+EAPI void       imlib_text_run_draw_with_return_metrics(Imlib_Text_Run run,
+                                                        int x, int y,
+                                                        int *width_return,
+                                                        int *height_return,
+                                                        int *horizontal_advance_return,
+                                                        int *vertical_advance_return);
+
+/**
+ * Get text run size
+ *
+ * Works just like imlib_get_text_size() with the run's text and font.
+ *
+ * @param run           The text run
+ * @param width_return  The width of the text
+ * @param height_return The height of the text
+ */
+EAPI void       imlib_text_run_get_size(Imlib_Text_Run run,
+                                        int *width_return,
+                                        int *height_return);
+
+/**
+ * Get text run advances
+ *
+ * Works just like imlib_get_text_advance() with the run's text and font.
+ *
+ * @param run           The text run
+ * @param horizontal_advance_return Horizontal offset
+ * @param vertical_advance_return Vertical offset
+ */
+EAPI void       imlib_text_run_get_advance(Imlib_Text_Run run,
+                                           int *horizontal_advance_return,
+                                           int *vertical_advance_return);
+
+/**
+ * Draw many strings
+ *
+ * Draws the @p n strings of @p items on the current image, each with its
+ * own font, color (as ARGB, like the image data), position and direction,
+ * like imlib_text_draw() would, in order. The current operation, cliprect
+ * and angle (for IMLIB_TEXT_TO_ANGLE) apply to all of them.
+ *
+ * Left to right strings are laid out and their glyphs fetched first, and
+ * then composited band by band of the image in parallel. This is much
+ * faster than drawing labels one by one.
+ *
+ * @param items         The strings (items with no font or text are skipped)
+ * @param n             Number of items
+ */
+EAPI void       imlib_text_draw_items(const Imlib_Text_Item * items, int n);
+
 /**
  * Add font path
  *
  * Adds the directory @p path to the end of the current list of
  * directories to scan for fonts.
+ * The system is asked to read the font files in it ahead, in the
+ * background.
  *
  * @param path          A directory path
  */
@@ -2055,6 +2277,10 @@ EAPI int        imlib_get_font_cache_size(void);
  * cache size.
  * Setting the size to 0 effectively frees all speculatively cached fonts.
  *
+ * The size is also the budget for the rendered glyphs of all fonts (but
+ * never less than 4 MiB). The least recently used glyphs are dropped when
+ * it is exceeded.
+ *
  * @param bytes         The font cache size in bytes
  */
 EAPI void       imlib_set_font_cache_size(int bytes);
@@ -2241,6 +2467,8 @@ EAPI Imlib_Updates imlib_image_draw_pixel(int x, int y, char make_updates);
  *
  * Draws a line using the current color on the current image from
  * coordinates (@p x1, @p y1) to (@p x2, @p y2).
+ * With a line width set (imlib_context_set_line_width()) the line is
+ * stroked with that width and the current line cap style.
  * If @p make_updates is 1 it will also return an update you can use for an
  * updates list, otherwise it returns NULL.
  *
@@ -2315,6 +2543,19 @@ EAPI void       imlib_polygon_free(ImlibPolygon poly);
  */
 EAPI void       imlib_polygon_add_point(ImlibPolygon poly, int x, int y);
 
+/**
+ * Set polygon fill rule
+ *
+ * Selects which areas imlib_image_fill_polygon() fills where the polygon
+ * overlaps itself. IMLIB_FILL_EVEN_ODD (the default) fills areas enclosed
+ * an odd number of times, IMLIB_FILL_NON_ZERO fills all enclosed areas.
+ *
+ * @param poly          A polygon
+ * @param rule          The fill rule
+ */
+EAPI void       imlib_polygon_set_fill_rule(ImlibPolygon poly,
+                                            Imlib_Fill_Rule rule);
+
 /**
  * Draw a polygon (no fill)
  *
@@ -2371,6 +2612,25 @@ EAPI void       imlib_polygon_get_bounds(ImlibPolygon poly,
 EAPI unsigned char imlib_polygon_contains_point(ImlibPolygon poly,
                                                 int x, int y);
 
+/**
+ * Check if polygon contains points
+ *
+ * Tests @p n points at once, as imlib_polygon_contains_point().
+ * Large polygons are indexed on the first query (and again after points
+ * are added), after which each test only looks at the edges near the
+ * point.
+ *
+ * @param poly          A polygon
+ * @param xy            The point coordinates, x and y interleaved
+ * @param n             The number of points
+ * @param inside        Per point result, non-zero if inside polygon
+ *
+ * @return the number of points inside polygon
+ */
+EAPI int        imlib_polygon_contains_points(ImlibPolygon poly,
+                                              const int *xy, int n,
+                                              unsigned char *inside);
+
 /*--------------------------------
  * Ellipses
  */
@@ -2383,6 +2643,8 @@ EAPI unsigned char imlib_polygon_contains_point(ImlibPolygon poly,
  * point (@p xc, @p yc) marks the center of the ellipse, @p a defines the
  * horizontal amplitude of the ellipse, and @p b defines the vertical
  * amplitude.
+ * With a line width set (imlib_context_set_line_width()) the ellipse is
+ * stroked with that width.
  *
  * @param xc            X coordinate of the center of the ellipse
  * @param yc            Y coordinate of the center of the ellipse
@@ -2391,6 +2653,27 @@ EAPI unsigned char imlib_polygon_contains_point(ImlibPolygon poly,
  */
 EAPI void       imlib_image_draw_ellipse(int xc, int yc, int a, int b);
 
+/**
+ * Draw an elliptical arc
+ *
+ * Draws the part of the ellipse given as in imlib_image_draw_ellipse()
+ * from @p angle1 to @p angle2, stroked with the current line width (1 if
+ * not set) and line cap style.
+ * Angles are in degrees, clockwise from the positive x axis. The arc goes
+ * clockwise from @p angle1, if @p angle2 is less than @p angle1 it is
+ * increased by multiples of 360. Arcs of 360 degrees or more are drawn as
+ * full ellipses.
+ *
+ * @param xc            X coordinate of the center of the ellipse
+ * @param yc            Y coordinate of the center of the ellipse
+ * @param a             The horizontal amplitude of the ellipse
+ * @param b             The vertical amplitude of the ellipse
+ * @param angle1        Start angle
+ * @param angle2        End angle
+ */
+EAPI void       imlib_image_draw_arc(int xc, int yc, int a, int b,
+                                     double angle1, double angle2);
+
 /**
  * Draw an ellipse (filled)
  *
@@ -2408,6 +2691,179 @@ EAPI void       imlib_image_draw_ellipse(int xc, int yc, int a, int b);
  */
 EAPI void       imlib_image_fill_ellipse(int xc, int yc, int a, int b);
 
+/*--------------------------------
+ * Display lists
+ */
+
+/**
+ * Create empty display list
+ *
+ * A display list records drawing operations, which are then drawn onto
+ * an image in one go with imlib_image_draw_list(). The result is the
+ * same as drawing the primitives one by one with the imlib_image_draw_*()
+ * and imlib_image_fill_*() functions, but the per call overhead is gone,
+ * the image is drawn band by band, and the bands are drawn in parallel.
+ *
+ * The current color, operation, blend and anti-alias settings are
+ * recorded with each primitive. The image and the clip rectangle are
+ * those current when the list is drawn.
+ *
+ * @return a new display list
+ */
+EAPI Imlib_Draw_List imlib_draw_list_new(void);
+
+/**
+ * Free a display list
+ *
+ * @param dl            A display list
+ */
+EAPI void       imlib_draw_list_free(Imlib_Draw_List dl);
+
+/**
+ * Remove all primitives from a display list
+ *
+ * @param dl            A display list
+ */
+EAPI void       imlib_draw_list_clear(Imlib_Draw_List dl);
+
+/**
+ * Add pixel to display list
+ *
+ * As imlib_image_draw_pixel().
+ *
+ * @param dl            A display list
+ * @param x             The x coordinate of the pixel
+ * @param y             The y coordinate of the pixel
+ */
+EAPI void       imlib_draw_list_draw_pixel(Imlib_Draw_List dl, int x, int y);
+
+/**
+ * Add line to display list
+ *
+ * As imlib_image_draw_line().
+ *
+ * @param dl            A display list
+ * @param x1            The x coordinate of the first point
+ * @param y1            The y coordinate of the first point
+ * @param x2            The x coordinate of the second point
+ * @param y2            The y coordinate of the second point
+ */
+EAPI void       imlib_draw_list_draw_line(Imlib_Draw_List dl,
+                                          int x1, int y1, int x2, int y2);
+
+/**
+ * Add connected lines to display list
+ *
+ * Adds lines joining the @p n points in @p xy, as imlib_image_draw_line()
+ * for each pair of consecutive points. The last point is joined with the
+ * first if @p closed is non-zero.
+ * With a line width set every segment is stroked on its own, with caps at
+ * both ends.
+ *
+ * @param dl            A display list
+ * @param xy            The point coordinates, x and y interleaved
+ * @param n             The number of points
+ * @param closed        Closed polyline flag
+ */
+EAPI void       imlib_draw_list_draw_polyline(Imlib_Draw_List dl,
+                                              const int *xy, int n,
+                                              unsigned char closed);
+
+/**
+ * Add rectangle outline to display list
+ *
+ * As imlib_image_draw_rectangle().
+ *
+ * @param dl            A display list
+ * @param x             The top left x coordinate of the rectangle
+ * @param y             The top left y coordinate of the rectangle
+ * @param width         The width of the rectangle
+ * @param height        The height of the rectangle
+ */
+EAPI void       imlib_draw_list_draw_rectangle(Imlib_Draw_List dl,
+                                               int x, int y,
+                                               int width, int height);
+
+/**
+ * Add filled rectangle to display list
+ *
+ * As imlib_image_fill_rectangle().
+ *
+ * @param dl            A display list
+ * @param x             The top left x coordinate of the rectangle
+ * @param y             The top left y coordinate of the rectangle
+ * @param width         The width of the rectangle
+ * @param height        The height of the rectangle
+ */
+EAPI void       imlib_draw_list_fill_rectangle(Imlib_Draw_List dl,
+                                               int x, int y,
+                                               int width, int height);
+
+/**
+ * Add ellipse outline to display list
+ *
+ * As imlib_image_draw_ellipse().
+ *
+ * @param dl            A display list
+ * @param xc            X coordinate of the center of the ellipse
+ * @param yc            Y coordinate of the center of the ellipse
+ * @param a             The horizontal amplitude of the ellipse
+ * @param b             The vertical amplitude of the ellipse
+ */
+EAPI void       imlib_draw_list_draw_ellipse(Imlib_Draw_List dl,
+                                             int xc, int yc, int a, int b);
+
+/**
+ * Add filled ellipse to display list
+ *
+ * As imlib_image_fill_ellipse().
+ *
+ * @param dl            A display list
+ * @param xc            X coordinate of the center of the ellipse
+ * @param yc            Y coordinate of the center of the ellipse
+ * @param a             The horizontal amplitude of the ellipse
+ * @param b             The vertical amplitude of the ellipse
+ */
+EAPI void       imlib_draw_list_fill_ellipse(Imlib_Draw_List dl,
+                                             int xc, int yc, int a, int b);
+
+/**
+ * Add polygon outline to display list
+ *
+ * As imlib_image_draw_polygon(). The polygon is copied, it may be changed
+ * or freed afterwards.
+ *
+ * @param dl            A display list
+ * @param poly          A polygon
+ * @param closed        Closed polygon flag
+ */
+EAPI void       imlib_draw_list_draw_polygon(Imlib_Draw_List dl,
+                                             ImlibPolygon poly,
+                                             unsigned char closed);
+
+/**
+ * Add filled polygon to display list
+ *
+ * As imlib_image_fill_polygon(). The polygon is copied, it may be changed
+ * or freed afterwards.
+ *
+ * @param dl            A display list
+ * @param poly          A polygon
+ */
+EAPI void       imlib_draw_list_fill_polygon(Imlib_Draw_List dl,
+                                             ImlibPolygon poly);
+
+/**
+ * Draw display list
+ *
+ * Draws the primitives in the display list @p dl onto the current image,
+ * in the order they were added, clipped to the current clip rectangle.
+ * The list is kept, and can be drawn again.
+ *
+ * @param dl            A display list
+ */
+EAPI void       imlib_image_draw_list(Imlib_Draw_List dl);
+
 /*--------------------------------
  * Color ranges
  */
@@ -2902,6 +3358,69 @@ EAPI void       imlib_image_get_frame_info(Imlib_Frame_Info * info);
  */
 EAPI const char *imlib_strerror(int err);
 
+/*--------------------------------
+ * Statistics and tracing
+ */
+
+/** Operation types reported to the trace function */
+typedef enum {
+    IMLIB_TRACE_LOAD,
+    IMLIB_TRACE_SAVE,
+    IMLIB_TRACE_SCALE,
+    IMLIB_TRACE_RENDER
+} Imlib_Trace_Type;
+
+typedef struct {
+    Imlib_Trace_Type type;      /* Operation type */
+    const char     *name;       /* Loader/saver name (may be NULL) */
+    const char     *file;       /* File name (may be NULL) */
+    int             w, h;       /* Image/output size (0 if not yet known) */
+    int             error;      /* Error code (end of span only) */
+    unsigned int    time_us;    /* Elapsed time (end of span only) */
+} Imlib_Trace_Span;
+
+/* Trace callback, called at the beginning (end = 0) and end (end = 1) of spans */
+typedef void    (*Imlib_Trace_Function)(const Imlib_Trace_Span * span,
+                                        int end, void *data);
+
+/* Statistics callback, called once for each counter */
+typedef void    (*Imlib_Stats_Function)(const char *name, uint64_t value,
+                                        void *data);
+
+/**
+ * Set trace function
+ *
+ * The trace function is called at the beginning and at the end of image
+ * loads, saves, scales and renders. Spans are properly nested, so a
+ * begin/end pair can be matched with a stack.
+ * Pass NULL to disable tracing.
+ *
+ * @param func          The trace function
+ * @param data          User data passed to the trace function
+ */
+EAPI void       imlib_set_trace_function(Imlib_Trace_Function func,
+                                         void *data);
+
+/**
+ * Enumerate statistics counters
+ *
+ * Calls @p func for each statistics counter with its current value.
+ * Counter names are dot separated, e.g.
+ * "load.png.count", "load.png.bytes_in", "load.png.latency_us.1024",
+ * "cache.image.hit", "scale.aa.bytes", "blend.copy.bytes".
+ * Latency histogram counters are named by their upper limit in
+ * microseconds ("inf" for the last one) and are not cumulative.
+ *
+ * @param func          The function called for each counter
+ * @param data          User data passed to @p func
+ */
+EAPI void       imlib_stats_foreach(Imlib_Stats_Function func, void *data);
+
+/**
+ * Reset all statistics counters to zero
+ */
+EAPI void       imlib_stats_reset(void);
+
 /*--------------------------------
  * Deprecated functionality
  */
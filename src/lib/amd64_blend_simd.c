@@ -0,0 +1,106 @@
+#include "common.h"
+
+#include <immintrin.h>
+#include <string.h>
+
+#include "blend.h"
+#include "color_helpers.h"
+#include "colormod.h"
+#include "grad.h"
+#include "rotate.h"
+#include "span.h"
+#ifdef BUILD_X11
+#include "x11_grab.h"
+#include "x11_rgba.h"
+#endif
+
+/* AVX2, 8 pixels per iteration */
+#define VW 8
+#define ISA "avx2"
+#define SFX(x) x##_avx2
+#define GATHER(tab, x) \
+    _mm256_i32gather_epi32((const int *)(tab), (__m256i)(x), 1)
+#define MASK_N(n) \
+    _mm256_cmpgt_epi32(_mm256_set1_epi32(n), \
+                       _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7))
+#define LOAD_N(p, n) _mm256_maskload_epi32((const int *)(p), MASK_N(n))
+#define STORE_N(p, v, n) \
+    _mm256_maskstore_epi32((int *)(p), MASK_N(n), (__m256i)(v))
+#include "amd64_blend_simd.h"
+#undef VW
+#undef ISA
+#undef SFX
+#undef GATHER
+#undef MASK_N
+#undef LOAD_N
+#undef STORE_N
+
+/* AVX-512, 16 pixels per iteration */
+#define VW 16
+#define ISA "avx512f,avx512bw"
+#define SFX(x) x##_avx512
+#define GATHER(tab, x) \
+    _mm512_i32gather_epi32((__m512i)(x), (const void *)(tab), 1)
+#define LOAD_N(p, n) _mm512_maskz_loadu_epi32((1U << (n)) - 1, p)
+#define STORE_N(p, v, n) \
+    _mm512_mask_storeu_epi32(p, (1U << (n)) - 1, (__m512i)(v))
+#define LOAD_N_U8(p, n) \
+    _mm512_castsi512_si128(_mm512_maskz_loadu_epi8((1ULL << (n)) - 1, p))
+#include "amd64_blend_simd.h"
+#undef VW
+#undef ISA
+#undef SFX
+#undef GATHER
+#undef LOAD_N
+#undef STORE_N
+#undef LOAD_N_U8
+
+/* AVX-512 VBMI colour modifier spans.
+ * Each 256 entry table is looked up for all bytes with two 128 entry byte
+ * permutes, and the result kept for the bytes of its channel. */
+#define VBMI "avx512f,avx512bw,avx512vbmi"
+
+static inline   __attribute__((always_inline, target(VBMI))) __m512i
+_cmod_lookup_vbmi(__m512i r, __m512i s, __mmask64 hi, __mmask64 chan,
+                  const uint8_t *tab)
+{
+    __m512i         lo, up;
+
+    lo = _mm512_permutex2var_epi8(_mm512_loadu_si512(tab), s,
+                                  _mm512_loadu_si512(tab + 64));
+    up = _mm512_permutex2var_epi8(_mm512_loadu_si512(tab + 128), s,
+                                  _mm512_loadu_si512(tab + 192));
+
+    return _mm512_mask_mov_epi8(r, chan, _mm512_mask_mov_epi8(lo, hi, up));
+}
+
+void            __attribute__((target(VBMI)))
+__imlib_cmod_span_vbmi(uint32_t *p, int len, const ImlibColorModifier *cm,
+                       int map)
+{
+    __m512i         s, r;
+    __mmask64       hi;
+    __mmask16       k;
+    int             x;
+
+    for (x = 0; x < len; x += 16)
+    {
+        k = len - x >= 16 ? 0xffff : (1 << (len - x)) - 1;
+        s = _mm512_maskz_loadu_epi32(k, p + x);
+        hi = _mm512_movepi8_mask(s);
+        r = s;
+        if (map & CMOD_MAP_RGB)
+        {
+            r = _cmod_lookup_vbmi(r, s, hi, 0x1111111111111111ULL,
+                                  cm->blue_mapping);
+            r = _cmod_lookup_vbmi(r, s, hi, 0x2222222222222222ULL,
+                                  cm->green_mapping);
+            r = _cmod_lookup_vbmi(r, s, hi, 0x4444444444444444ULL,
+                                  cm->red_mapping);
+        }
+        if (map & CMOD_MAP_A)
+            r = _cmod_lookup_vbmi(r, s, hi, 0x8888888888888888ULL,
+                                  cm->alpha_mapping);
+        _mm512_mask_storeu_epi32(p + x, k, r);
+    }
+}
@@ -0,0 +1,1256 @@
+/*
+ * Vector blend, colour modifier and adjustment, span, gradient, rotation,
+ * grabbed and rendered row kernels, included by amd64_blend_simd.c once per
+ * instruction set with
+ *   VW       - Vector width (pixels)
+ *   ISA      - Target instruction set (function attribute)
+ *   GATHER(tab, x) - 32 bit gather from tab at byte offsets x
+ *   LOAD_N(p, n), STORE_N(p, v, n) - Load/store the first n < VW pixels
+ *   LOAD_N_U8(p, n) - Load the first n < VW bytes (optional)
+ *   SFX(x)   - Name suffixer
+ *
+ * All channel arithmetic is done in 32 bit lanes, mirroring the scalar
+ * macros in blend.h step by step, so the results are bit-exact with the
+ * C implementations in blend.c.
+ *
+ * There is no SSE2 instance, GATHER and LOAD_N/STORE_N have no SSE2
+ * equivalent worth having. CPUs without AVX2 get the C functions (and the
+ * SSE2 assembly where there is some), see asm_c.h.
+ */
+
+typedef uint32_t SFX(vu) __attribute__((vector_size(VW * 4)));
+typedef int32_t SFX(vi) __attribute__((vector_size(VW * 4)));
+typedef float   SFX(vf) __attribute__((vector_size(VW * 4)));
+typedef uint8_t SFX(vb) __attribute__((vector_size(VW)));
+
+#define vu SFX(vu)
+#define vi SFX(vi)
+#define vf SFX(vf)
+#define vb SFX(vb)
+
+#define SIMD_INLINE static inline __attribute__((always_inline, target(ISA)))
+
+/* Select a where mask m is set, b otherwise */
+#define VSEL(m, a, b) (((a) & (vu)(m)) | ((b) & ~(vu)(m)))
+
+/* Partial vectors, the lanes from n on load as 0 and are not stored */
+SIMD_INLINE vu
+SFX(load_n) (const uint32_t * p, int n)
+{
+    return (vu) LOAD_N(p, n);
+}
+
+SIMD_INLINE void
+SFX(store_n) (uint32_t * p, vu v, int n)
+{
+    STORE_N(p, v, n);
+}
+
+SIMD_INLINE vb
+SFX(load_n_u8) (const uint8_t * p, int n)
+{
+#ifdef LOAD_N_U8
+    return (vb) LOAD_N_U8(p, n);
+#else
+    vb              v = { };
+    int             k;
+
+    for (k = 0; k < n; k++)
+        v[k] = p[k];
+    return v;
+#endif
+}
+
+/* Byte table lookup.
+ * Gathers 32 bits, so may read up to 3 bytes past the end of a cmod table,
+ * which is still inside ImlibColorModifier. */
+SIMD_INLINE vu
+SFX(lookup) (vu x, const uint8_t * tab)
+{
+    return (vu) GATHER(tab, x) & 0xff;
+}
+
+/* pow_lut[aa][da] (see __imlib_build_pow_lut()).
+ * Both quotients are < 256 with numerators < 2^24, so the single precision
+ * divisions truncate to the exact integer results. */
+SIMD_INLINE vu
+SFX(pow_lut) (vu aa, vu da)
+{
+    vu              div, nz;
+    vf              q;
+
+    q = __builtin_convertvector(da * (255 - aa), vf) / 255.f;
+    div = aa + __builtin_convertvector(q, vu);
+    nz = (vu)(div != 0);
+    q = __builtin_convertvector(aa * 255, vf) /
+        __builtin_convertvector(div | (~nz & 1), vf);
+
+    return __builtin_convertvector(q, vu) & nz;
+}
+
+/* BLEND_COLOR(a, nc, c, cc) */
+SIMD_INLINE vu
+SFX(blend_color) (vu a, vu c, vu cc)
+{
+    vu              tmp;
+
+    tmp = (c - cc) * a;
+    return (cc + ((tmp + (tmp >> 8) + 0x80) >> 8)) & 0xff;
+}
+
+/* Apply operation at full alpha ({ADD,SUB,RESHADE}_COLOR) */
+SIMD_INLINE vu
+SFX(op_copy) (int op, vu c, vu cc)
+{
+    vu              tmp;
+
+    switch (op)
+    {
+    default:
+        return c;
+    case OP_ADD:
+        tmp = cc + c;
+        return (tmp | -(tmp >> 8)) & 0xff;
+    case OP_SUBTRACT:
+        tmp = cc - c;
+        return tmp & ~(tmp >> 8) & 0xff;
+    case OP_RESHADE:
+        tmp = (vu)((vi) cc + ((vi) c - 127) * 2);
+        return (tmp | -(tmp >> 8)) & ~(tmp >> 9) & 0xff;
+    }
+}
+
+/* Apply operation with alpha (BLEND_COLOR, {ADD,SUB,RESHADE}_COLOR_WITH_ALPHA) */
+SIMD_INLINE vu
+SFX(op_alpha) (int op, vu a, vu c, vu cc)
+{
+    vu              tmp;
+
+    switch (op)
+    {
+    default:
+        return SFX(blend_color) (a, c, cc);
+    case OP_ADD:
+        tmp = c * a;
+        tmp = cc + ((tmp + (tmp >> 8) + 0x80) >> 8);
+        return (tmp | -(tmp >> 8)) & 0xff;
+    case OP_SUBTRACT:
+        tmp = c * a;
+        tmp = cc - ((tmp + (tmp >> 8) + 0x80) >> 8);
+        return tmp & ~(tmp >> 8) & 0xff;
+    case OP_RESHADE:
+        tmp = (vu)((vi) cc + ((((vi) c - 127) * (vi) a) >> 7));
+        return (tmp | -(tmp >> 8)) & ~(tmp >> 9) & 0xff;
+    }
+}
+
+SIMD_INLINE vu
+SFX(blend_px) (vu s, vu d, const ImlibColorModifier * cm,
+               int op, int merge_alpha, int rgb_src, int blend)
+{
+    vu              sa, sr, sg, sb, da, dr, dg, db;
+    vu              na, nr, ng, nb, fa, fr, fg, fb, a;
+    vu              full, zero;
+
+    sr = (s >> 16) & 0xff;
+    sg = (s >> 8) & 0xff;
+    sb = s & 0xff;
+    if (rgb_src)
+        sa = (vu) { } + (cm ? cm->alpha_mapping[255] : 255);
+    else
+        sa = s >> 24;
+    if (cm)
+    {
+        sr = SFX(lookup) (sr, cm->red_mapping);
+        sg = SFX(lookup) (sg, cm->green_mapping);
+        sb = SFX(lookup) (sb, cm->blue_mapping);
+        if (!rgb_src)
+            sa = SFX(lookup) (sa, cm->alpha_mapping);
+    }
+
+    da = d >> 24;
+    dr = (d >> 16) & 0xff;
+    dg = (d >> 8) & 0xff;
+    db = d & 0xff;
+
+    /* Full alpha (or no blending) */
+    fr = SFX(op_copy) (op, sr, dr);
+    fg = SFX(op_copy) (op, sg, dg);
+    fb = SFX(op_copy) (op, sb, db);
+    if (!blend)
+    {
+        na = merge_alpha ? sa : da;
+        return (na << 24) | (fr << 16) | (fg << 8) | fb;
+    }
+    fa = merge_alpha ? (vu) { } + 255 : da;
+
+    /* Partial alpha */
+    if (merge_alpha)
+    {
+        a = SFX(pow_lut) (sa, da);
+        na = SFX(blend_color) (sa, (vu) { } + 255, da);
+    }
+    else
+    {
+        a = sa;
+        na = da;
+    }
+    nr = SFX(op_alpha) (op, a, sr, dr);
+    ng = SFX(op_alpha) (op, a, sg, dg);
+    nb = SFX(op_alpha) (op, a, sb, db);
+
+    full = (vu)(sa == 255);
+    zero = (vu)(sa == 0);
+    na = VSEL(full, fa, na);
+    nr = VSEL(full, fr, nr);
+    ng = VSEL(full, fg, ng);
+    nb = VSEL(full, fb, nb);
+
+    return VSEL(zero, d, (na << 24) | (nr << 16) | (ng << 8) | nb);
+}
+
+SIMD_INLINE void
+SFX(blend) (uint32_t * src, int srcw, uint32_t * dst, int dstw,
+            int w, int h, const ImlibColorModifier * cm,
+            int op, int merge_alpha, int rgb_src, int blend)
+{
+    vu              s, d;
+    int             x, n;
+
+    for (; h > 0; h--, src += srcw, dst += dstw)
+    {
+        for (x = 0; x < w; x += VW)
+        {
+            n = w - x;
+            if (n >= VW)
+            {
+                memcpy(&s, src + x, sizeof(s));
+                memcpy(&d, dst + x, sizeof(d));
+                d = SFX(blend_px) (s, d, cm, op, merge_alpha, rgb_src, blend);
+                memcpy(dst + x, &d, sizeof(d));
+            }
+            else
+            {
+                s = SFX(load_n) (src + x, n);
+                d = SFX(load_n) (dst + x, n);
+                d = SFX(blend_px) (s, d, cm, op, merge_alpha, rgb_src, blend);
+                SFX(store_n) (dst + x, d, n);
+            }
+        }
+    }
+}
+
+/* Instantiate all [ operation ][ cmod ][ merge_alpha ][ rgb_src ][ blend ] */
+#define BLEND_FN(o, c, m, r, b) \
+static void __attribute__((target(ISA))) \
+SFX(blend_##o##_##c##m##r##b) (uint32_t * src, int srcw, uint32_t * dst, \
+                               int dstw, int w, int h, \
+                               ImlibColorModifier * cm) \
+{ \
+    SFX(blend) (src, srcw, dst, dstw, w, h, c ? cm : NULL, o, m, r, b); \
+}
+
+#define BLEND_FN_OP(o) \
+BLEND_FN(o, 0, 0, 0, 0) BLEND_FN(o, 0, 0, 0, 1) \
+BLEND_FN(o, 0, 0, 1, 0) BLEND_FN(o, 0, 0, 1, 1) \
+BLEND_FN(o, 0, 1, 0, 0) BLEND_FN(o, 0, 1, 0, 1) \
+BLEND_FN(o, 0, 1, 1, 0) BLEND_FN(o, 0, 1, 1, 1) \
+BLEND_FN(o, 1, 0, 0, 0) BLEND_FN(o, 1, 0, 0, 1) \
+BLEND_FN(o, 1, 0, 1, 0) BLEND_FN(o, 1, 0, 1, 1) \
+BLEND_FN(o, 1, 1, 0, 0) BLEND_FN(o, 1, 1, 0, 1) \
+BLEND_FN(o, 1, 1, 1, 0) BLEND_FN(o, 1, 1, 1, 1)
+
+BLEND_FN_OP(0)
+BLEND_FN_OP(1)
+BLEND_FN_OP(2)
+BLEND_FN_OP(3)
+
+#define BLEND_FP(o, c, m, r, b) SFX(blend_##o##_##c##m##r##b)
+
+/* Copying an RGB source without cmod sets alpha also when not merging
+ * (blend.c: __imlib_CopyRGBToRGB -> __imlib_CopyRGBToRGBA) */
+#define BLEND_TAB_OP(o) \
+    { { { { BLEND_FP(o, 0, 0, 0, 0), BLEND_FP(o, 0, 0, 0, 1) }, \
+          { o == OP_COPY ? BLEND_FP(o, 0, 1, 1, 0) : BLEND_FP(o, 0, 0, 1, 0), \
+            o == OP_COPY ? BLEND_FP(o, 0, 1, 1, 0) : BLEND_FP(o, 0, 0, 1, 1) } }, \
+        { { BLEND_FP(o, 0, 1, 0, 0), BLEND_FP(o, 0, 1, 0, 1) }, \
+          { BLEND_FP(o, 0, 1, 1, 0), BLEND_FP(o, 0, 1, 1, 1) } } }, \
+      { { { BLEND_FP(o, 1, 0, 0, 0), BLEND_FP(o, 1, 0, 0, 1) }, \
+          { BLEND_FP(o, 1, 0, 1, 0), BLEND_FP(o, 1, 0, 1, 1) } }, \
+        { { BLEND_FP(o, 1, 1, 0, 0), BLEND_FP(o, 1, 1, 0, 1) }, \
+          { BLEND_FP(o, 1, 1, 1, 0), BLEND_FP(o, 1, 1, 1, 1) } } } }
+
+const ImlibBlendFunction SFX(__imlib_blend_funcs)[4][2][2][2][2] = {
+    BLEND_TAB_OP(0),
+    BLEND_TAB_OP(1),
+    BLEND_TAB_OP(2),
+    BLEND_TAB_OP(3),
+};
+
+/* Colour modifier spans (colormod.c) */
+SIMD_INLINE vu
+SFX(cmod_px) (vu s, const ImlibColorModifier * cm, int map)
+{
+    vu              a, r, g, b;
+
+    a = s >> 24;
+    r = (s >> 16) & 0xff;
+    g = (s >> 8) & 0xff;
+    b = s & 0xff;
+    if (map & CMOD_MAP_RGB)
+    {
+        r = SFX(lookup) (r, cm->red_mapping);
+        g = SFX(lookup) (g, cm->green_mapping);
+        b = SFX(lookup) (b, cm->blue_mapping);
+    }
+    if (map & CMOD_MAP_A)
+        a = SFX(lookup) (a, cm->alpha_mapping);
+
+    return (a << 24) | (r << 16) | (g << 8) | b;
+}
+
+SIMD_INLINE void
+SFX(cmod_span_map) (uint32_t * p, int len, const ImlibColorModifier * cm,
+                    int map)
+{
+    vu              s;
+    int             x;
+
+    for (x = 0; x + VW <= len; x += VW)
+    {
+        memcpy(&s, p + x, sizeof(s));
+        s = SFX(cmod_px) (s, cm, map);
+        memcpy(p + x, &s, sizeof(s));
+    }
+    if (x < len)
+    {
+        s = (vu) { };
+        memcpy(&s, p + x, (len - x) * sizeof(uint32_t));
+        s = SFX(cmod_px) (s, cm, map);
+        memcpy(p + x, &s, (len - x) * sizeof(uint32_t));
+    }
+}
+
+void            __attribute__((target(ISA)))
+SFX(__imlib_cmod_span) (uint32_t * p, int len, const ImlibColorModifier * cm,
+                        int map)
+{
+    switch (map)
+    {
+    case CMOD_MAP_RGB:
+        SFX(cmod_span_map) (p, len, cm, CMOD_MAP_RGB);
+        break;
+    case CMOD_MAP_A:
+        SFX(cmod_span_map) (p, len, cm, CMOD_MAP_A);
+        break;
+    case CMOD_MAP_ALL:
+        SFX(cmod_span_map) (p, len, cm, CMOD_MAP_ALL);
+        break;
+    default:
+        break;
+    }
+}
+
+/* Colour adjustment spans (color_helpers.c), all in 32 bit signed lanes */
+#define VSELI(m, a, b) ((vi)VSEL(m, (vu)(a), (vu)(b)))
+#define VMAXI(a, b) VSELI((a) > (b), a, b)
+#define VMINI(a, b) VSELI((a) < (b), a, b)
+
+/* a / b, a < 2^24, 0 < b < 2^24 */
+SIMD_INLINE vi
+SFX(idiv) (vi a, vi b)
+{
+    return __builtin_convertvector(__builtin_convertvector(a, vf) /
+                                   __builtin_convertvector(b, vf), vi);
+}
+
+SIMD_INLINE vi
+SFX(adj_hue) (vi r, vi g, vi b, vi mx, vi d, const ImlibColorAdjust * ca)
+{
+    vi              h, mr, mg, num, base;
+
+    mr = r == mx;
+    mg = ~mr & (g == mx);
+    num = VSELI(mr, g - b, VSELI(mg, b - r, r - g));
+    base = VSELI(mr, (vi) { }, VSELI(mg, (vi) { } + 2 * ADJ_HUE_ONE,
+                                     (vi) { } + 4 * ADJ_HUE_ONE));
+    h = base + SFX(idiv) (num * ADJ_HUE_ONE, VMAXI(d, (vi) { } + 1));
+    h += (h < 0) & (6 * ADJ_HUE_ONE);
+
+    h += ca->hue;
+    h -= (h >= 6 * ADJ_HUE_ONE) & (6 * ADJ_HUE_ONE);
+
+    return h;
+}
+
+SIMD_INLINE vu
+SFX(adj_hsv) (vi r, vi g, vi b, const ImlibColorAdjust * ca)
+{
+    vi              mx, mn, d, h, s, v, i, f, c, x, p, q, t;
+
+    mx = VMAXI(r, VMAXI(g, b));
+    mn = VMINI(r, VMINI(g, b));
+    d = mx - mn;
+
+    h = SFX(adj_hue) (r, g, b, mx, d, ca);
+    s = SFX(idiv) (d * ADJ_SAT_ONE + mx / 2, VMAXI(mx, (vi) { } + 1));
+    s = VMINI((s * ca->sat) >> ADJ_FAC_BITS, (vi) { } + ADJ_SAT_ONE);
+    v = VMINI((mx * ca->lum) >> ADJ_FAC_BITS, (vi) { } + 255);
+
+    i = h >> ADJ_HUE_BITS;
+    f = h & (ADJ_HUE_ONE - 1);
+    c = v * s;
+    x = v * ADJ_SAT_ONE;
+    p = x - c;
+    q = x - ((c * f) >> ADJ_HUE_BITS);
+    t = x - ((c * (ADJ_HUE_ONE - f)) >> ADJ_HUE_BITS);
+
+    r = VSELI((i == 0) | (i == 5), x,
+              VSELI(i == 1, q, VSELI(i == 4, t, p)));
+    g = VSELI((i == 1) | (i == 2), x,
+              VSELI(i == 0, t, VSELI(i == 3, q, p)));
+    b = VSELI((i == 3) | (i == 4), x,
+              VSELI(i == 2, t, VSELI(i == 5, q, p)));
+
+    return ((vu)((r + ADJ_SAT_ONE / 2) >> ADJ_SAT_BITS) << 16) |
+        ((vu)((g + ADJ_SAT_ONE / 2) >> ADJ_SAT_BITS) << 8) |
+        (vu)((b + ADJ_SAT_ONE / 2) >> ADJ_SAT_BITS);
+}
+
+SIMD_INLINE vi
+SFX(adj_hls_channel) (vi h, vi m1, vi m2, vi c)
+{
+    vi              i, f;
+
+    h += (h < 0) & (6 * ADJ_HUE_ONE);
+    h -= (h >= 6 * ADJ_HUE_ONE) & (6 * ADJ_HUE_ONE);
+    i = h >> ADJ_HUE_BITS;
+    f = h & (ADJ_HUE_ONE - 1);
+
+    return VSELI(i == 0, m1 + ((c * f) >> (ADJ_HUE_BITS - 1)),
+                 VSELI(i == 3,
+                       m1 + ((c * (ADJ_HUE_ONE - f)) >> (ADJ_HUE_BITS - 1)),
+                       VSELI(i < 3, m2, m1)));
+}
+
+SIMD_INLINE vu
+SFX(adj_hls) (vi r, vi g, vi b, const ImlibColorAdjust * ca)
+{
+    vi              mx, mn, d, h, l, s, k, c, m1, m2;
+
+    mx = VMAXI(r, VMAXI(g, b));
+    mn = VMINI(r, VMINI(g, b));
+    d = mx - mn;
+
+    h = SFX(adj_hue) (r, g, b, mx, d, ca);
+    l = mx + mn;
+    k = VSELI(l < 255, l, 510 - l);
+    s = SFX(idiv) (d * ADJ_SAT_ONE + k / 2, VMAXI(k, (vi) { } + 1));
+    s = VMINI((s * ca->sat) >> ADJ_FAC_BITS, (vi) { } + ADJ_SAT_ONE);
+    l = VMINI((l * ca->lum) >> ADJ_FAC_BITS, (vi) { } + 510);
+
+    k = 255 - VMAXI(l - 255, 255 - l);
+    c = k * s;
+    m1 = l * ADJ_SAT_ONE - c;
+    m2 = l * ADJ_SAT_ONE + c;
+    r = SFX(adj_hls_channel) (h + 2 * ADJ_HUE_ONE, m1, m2, c);
+    g = SFX(adj_hls_channel) (h, m1, m2, c);
+    b = SFX(adj_hls_channel) (h - 2 * ADJ_HUE_ONE, m1, m2, c);
+
+    return ((vu)((r + ADJ_SAT_ONE) >> (ADJ_SAT_BITS + 1)) << 16) |
+        ((vu)((g + ADJ_SAT_ONE) >> (ADJ_SAT_BITS + 1)) << 8) |
+        (vu)((b + ADJ_SAT_ONE) >> (ADJ_SAT_BITS + 1));
+}
+
+SIMD_INLINE vu
+SFX(adj_px) (vu s, const ImlibColorAdjust * ca, int mode)
+{
+    vi              r, g, b;
+    vu              y;
+
+    r = (vi)((s >> 16) & 0xff);
+    g = (vi)((s >> 8) & 0xff);
+    b = (vi)(s & 0xff);
+    switch (mode)
+    {
+    default:
+    case COLOR_ADJUST_HSV:
+        return (s & 0xff000000) | SFX(adj_hsv) (r, g, b, ca);
+    case COLOR_ADJUST_HLS:
+        return (s & 0xff000000) | SFX(adj_hls) (r, g, b, ca);
+    case COLOR_ADJUST_GRAY:
+        y = (vu)((77 * r + 150 * g + 29 * b + 128) >> 8);
+        return (s & 0xff000000) | (y << 16) | (y << 8) | y;
+    }
+}
+
+SIMD_INLINE void
+SFX(color_adjust_mode) (uint32_t * p, int len, const ImlibColorAdjust * ca,
+                        int mode)
+{
+    vu              s;
+    int             x;
+
+    for (x = 0; x + VW <= len; x += VW)
+    {
+        memcpy(&s, p + x, sizeof(s));
+        s = SFX(adj_px) (s, ca, mode);
+        memcpy(p + x, &s, sizeof(s));
+    }
+    if (x < len)
+    {
+        s = (vu) { };
+        memcpy(&s, p + x, (len - x) * sizeof(uint32_t));
+        s = SFX(adj_px) (s, ca, mode);
+        memcpy(p + x, &s, (len - x) * sizeof(uint32_t));
+    }
+}
+
+void            __attribute__((target(ISA)))
+SFX(__imlib_color_adjust_span) (uint32_t * p, int len,
+                                const ImlibColorAdjust * ca)
+{
+    switch (ca->mode)
+    {
+    case COLOR_ADJUST_HSV:
+        SFX(color_adjust_mode) (p, len, ca, COLOR_ADJUST_HSV);
+        break;
+    case COLOR_ADJUST_HLS:
+        SFX(color_adjust_mode) (p, len, ca, COLOR_ADJUST_HLS);
+        break;
+    case COLOR_ADJUST_GRAY:
+        SFX(color_adjust_mode) (p, len, ca, COLOR_ADJUST_GRAY);
+        break;
+    }
+}
+
+#undef VSELI
+#undef VMAXI
+#undef VMINI
+
+/* Solid colour spans (span.c).
+ * aa is the colour alpha, for shaped spans scaled by the shape.
+ * Shaped blends treat full alpha as a copy like the C code does, plain
+ * blended spans always take the alpha path. */
+SIMD_INLINE vu
+SFX(span_px) (vu d, vu aa, vu cr, vu cg, vu cb,
+              int op, int dst_alpha, int blend, int shaped)
+{
+    vu              da, dr, dg, db, na, nr, ng, nb, a, full;
+
+    da = d >> 24;
+    dr = (d >> 16) & 0xff;
+    dg = (d >> 8) & 0xff;
+    db = d & 0xff;
+
+    if (!blend)
+    {
+        na = dst_alpha ? aa : da;
+        nr = SFX(op_copy) (op, cr, dr);
+        ng = SFX(op_copy) (op, cg, dg);
+        nb = SFX(op_copy) (op, cb, db);
+        return (na << 24) | (nr << 16) | (ng << 8) | nb;
+    }
+
+    if (dst_alpha)
+    {
+        a = SFX(pow_lut) (aa, da);
+        na = SFX(blend_color) (aa, (vu) { } + 255, da);
+    }
+    else
+    {
+        a = aa;
+        na = da;
+    }
+    nr = SFX(op_alpha) (op, a, cr, dr);
+    ng = SFX(op_alpha) (op, a, cg, dg);
+    nb = SFX(op_alpha) (op, a, cb, db);
+
+    if (shaped)
+    {
+        full = (vu)(aa == 255);
+        na = VSEL(full, dst_alpha ? (vu) { } + 255 : da, na);
+        nr = VSEL(full, SFX(op_copy) (op, cr, dr), nr);
+        ng = VSEL(full, SFX(op_copy) (op, cg, dg), ng);
+        nb = VSEL(full, SFX(op_copy) (op, cb, db), nb);
+    }
+
+    return (na << 24) | (nr << 16) | (ng << 8) | nb;
+}
+
+SIMD_INLINE void
+SFX(span) (uint32_t color, uint32_t * dst, int len,
+           int op, int dst_alpha, int blend)
+{
+    vu              d, ca, cr, cg, cb;
+    int             x, n;
+
+    ca = (vu) { } + (color >> 24);
+    cr = (vu) { } + ((color >> 16) & 0xff);
+    cg = (vu) { } + ((color >> 8) & 0xff);
+    cb = (vu) { } + (color & 0xff);
+
+    if (op == OP_COPY && dst_alpha && !blend)
+    {
+        d = (vu) { } + color;
+        for (x = 0; x + VW <= len; x += VW)
+            memcpy(dst + x, &d, sizeof(d));
+        for (; x < len; x++)
+            dst[x] = color;
+        return;
+    }
+
+    for (x = 0; x + VW <= len; x += VW)
+    {
+        memcpy(&d, dst + x, sizeof(d));
+        d = SFX(span_px) (d, ca, cr, cg, cb, op, dst_alpha, blend, 0);
+        memcpy(dst + x, &d, sizeof(d));
+    }
+    n = len - x;
+    if (n > 0)
+    {
+        d = SFX(load_n) (dst + x, n);
+        d = SFX(span_px) (d, ca, cr, cg, cb, op, dst_alpha, blend, 0);
+        SFX(store_n) (dst + x, d, n);
+    }
+}
+
+SIMD_INLINE void
+SFX(shaped_span) (uint8_t * src, uint32_t color, uint32_t * dst, int len,
+                  int op, int dst_alpha, int blend)
+{
+    vb              sb;
+    vu              s, d, aa, cr, cg, cb, tmp;
+    int             x, n, k, any;
+
+    cr = (vu) { } + ((color >> 16) & 0xff);
+    cg = (vu) { } + ((color >> 8) & 0xff);
+    cb = (vu) { } + (color & 0xff);
+
+    for (x = 0; x < len; x += VW)
+    {
+        n = len - x;
+        if (n >= VW)
+        {
+            n = VW;
+            memcpy(&sb, src + x, sizeof(sb));
+        }
+        else
+        {
+            sb = SFX(load_n_u8) (src + x, n);
+        }
+        any = 0;
+        for (k = 0; k < VW; k++)
+            any |= sb[k];
+        if (!any)
+            continue;
+        s = __builtin_convertvector(sb, vu);
+
+        /* MULT(aa, s, color alpha) */
+        tmp = s * (color >> 24) + 0x80;
+        aa = (tmp + (tmp >> 8)) >> 8;
+
+        if (n == VW)
+            memcpy(&d, dst + x, sizeof(d));
+        else
+            d = SFX(load_n) (dst + x, n);
+        d = VSEL(s == 0, d,
+                 SFX(span_px) (d, aa, cr, cg, cb, op, dst_alpha, blend, 1));
+        if (n == VW)
+            memcpy(dst + x, &d, sizeof(d));
+        else
+            SFX(store_n) (dst + x, d, n);
+    }
+}
+
+/* Shorter shaped spans, like the rows of glyphs and the edges of shapes,
+ * are mostly sparse and done faster by the C code */
+#define SHAPED_SPAN_MIN (2 * VW)
+
+/* Instantiate all [ operation ][ dst_alpha ][ blend ] */
+#define SPAN_FN(o, d, b) \
+static void __attribute__((target(ISA))) \
+SFX(span_##o##d##b) (uint32_t color, uint32_t * dst, int len) \
+{ \
+    SFX(span) (color, dst, len, o, d, b); \
+} \
+static void __attribute__((target(ISA))) \
+SFX(shaped_span_##o##d##b) (uint8_t * src, uint32_t color, uint32_t * dst, \
+                            int len) \
+{ \
+    if (len < SHAPED_SPAN_MIN) \
+        __imlib_shaped_span_funcs_c[o][d][b] (src, color, dst, len); \
+    else \
+        SFX(shaped_span) (src, color, dst, len, o, d, b); \
+}
+
+#define SPAN_FN_OP(o) \
+SPAN_FN(o, 0, 0) SPAN_FN(o, 0, 1) SPAN_FN(o, 1, 0) SPAN_FN(o, 1, 1)
+
+SPAN_FN_OP(0)
+SPAN_FN_OP(1)
+SPAN_FN_OP(2)
+SPAN_FN_OP(3)
+
+#define SPAN_TAB_OP(f, o) \
+    { { SFX(f##_##o##00), SFX(f##_##o##01) }, \
+      { SFX(f##_##o##10), SFX(f##_##o##11) } }
+
+const ImlibSpanDrawFunction SFX(__imlib_span_funcs)[4][2][2] = {
+    SPAN_TAB_OP(span, 0),
+    SPAN_TAB_OP(span, 1),
+    SPAN_TAB_OP(span, 2),
+    SPAN_TAB_OP(span, 3),
+};
+
+const ImlibShapedSpanDrawFunction SFX(__imlib_shaped_span_funcs)[4][2][2] = {
+    SPAN_TAB_OP(shaped_span, 0),
+    SPAN_TAB_OP(shaped_span, 1),
+    SPAN_TAB_OP(shaped_span, 2),
+    SPAN_TAB_OP(shaped_span, 3),
+};
+
+/* Gradient span (grad.c): Fetch map[clamp(pos[x] + pos_add)] and blend */
+SIMD_INLINE void
+SFX(grad_span_op) (uint32_t * dst, const int *pos, int pos_add,
+                   const uint32_t * map, int len, int w, int op)
+{
+    vu              i, c, d, ca, cr, cg, cb, da, dr, dg, db, a;
+    int             x, n;
+
+    for (x = 0; x < w; x += VW)
+    {
+        n = w - x;
+        if (n > VW)
+            n = VW;
+        i = d = (vu) { };
+        memcpy(&i, pos + x, n * sizeof(int));
+        memcpy(&d, dst + x, n * sizeof(uint32_t));
+
+        i += pos_add;
+        i = VSEL((vi) i < 0, (vu) { }, i);
+        i = VSEL((vi) i >= len, (vu) { } + (len - 1), i);
+        c = (vu) GATHER(map, i * 4);
+
+        ca = c >> 24;
+        cr = (c >> 16) & 0xff;
+        cg = (c >> 8) & 0xff;
+        cb = c & 0xff;
+        da = d >> 24;
+        dr = (d >> 16) & 0xff;
+        dg = (d >> 8) & 0xff;
+        db = d & 0xff;
+
+        switch (op)
+        {
+        default:
+        case GRAD_OP_BLEND:    /* BLEND */
+            dr = SFX(blend_color) (ca, cr, dr);
+            dg = SFX(blend_color) (ca, cg, dg);
+            db = SFX(blend_color) (ca, cb, db);
+            break;
+        case GRAD_OP_BLEND_DST_ALPHA:  /* BLEND_DST_ALPHA */
+            a = SFX(pow_lut) (ca, da);
+            da = SFX(blend_color) (ca, (vu) { } + 255, da);
+            dr = SFX(blend_color) (a, cr, dr);
+            dg = SFX(blend_color) (a, cg, dg);
+            db = SFX(blend_color) (a, cb, db);
+            break;
+        case GRAD_OP_SUBTRACT: /* BLEND_SUB */
+            dr = SFX(op_alpha) (OP_SUBTRACT, ca, cr, dr);
+            dg = SFX(op_alpha) (OP_SUBTRACT, ca, cg, dg);
+            db = SFX(op_alpha) (OP_SUBTRACT, ca, cb, db);
+            break;
+        case GRAD_OP_RESHADE:  /* BLEND_RE */
+            dr = SFX(op_alpha) (OP_RESHADE, ca, cr, dr);
+            dg = SFX(op_alpha) (OP_RESHADE, ca, cg, dg);
+            db = SFX(op_alpha) (OP_RESHADE, ca, cb, db);
+            break;
+        }
+
+        d = (da << 24) | (dr << 16) | (dg << 8) | db;
+        memcpy(dst + x, &d, n * sizeof(uint32_t));
+    }
+}
+
+void            __attribute__((target(ISA)))
+SFX(__imlib_grad_span) (uint32_t * dst, const int *pos, int pos_add,
+                        const uint32_t * map, int len, int w, int op)
+{
+    switch (op)
+    {
+    default:
+    case GRAD_OP_BLEND:
+        SFX(grad_span_op) (dst, pos, pos_add, map, len, w, GRAD_OP_BLEND);
+        break;
+    case GRAD_OP_BLEND_DST_ALPHA:
+        SFX(grad_span_op) (dst, pos, pos_add, map, len, w,
+                           GRAD_OP_BLEND_DST_ALPHA);
+        break;
+    case GRAD_OP_SUBTRACT:
+        SFX(grad_span_op) (dst, pos, pos_add, map, len, w, GRAD_OP_SUBTRACT);
+        break;
+    case GRAD_OP_RESHADE:
+        SFX(grad_span_op) (dst, pos, pos_add, map, len, w, GRAD_OP_RESHADE);
+        break;
+    }
+}
+
+/* Rotation spans (rotate.c): n pixels stepping (dxh, dyh) from (x, y) in
+ * _ROTATE_PREC fixed point. All taps must be inside the source. */
+SIMD_INLINE void
+SFX(rotate_coords) (int x, int y, int dxh, int dyh, vi * vx, vi * vy)
+{
+    int             k;
+
+    for (k = 0; k < VW; k++)
+    {
+        (*vx)[k] = x + k * dxh;
+        (*vy)[k] = y + k * dyh;
+    }
+}
+
+/* Byte offsets of the pixels at (vx, vy), lanes >= n point at pixel 0 */
+SIMD_INLINE vu
+SFX(rotate_offs) (vi vx, vi vy, int sow, int n)
+{
+    vu              i;
+    int             k;
+
+    i = (vu) ((vx >> _ROTATE_PREC) + (vy >> _ROTATE_PREC) * sow) * 4;
+
+    for (k = n; k < VW; k++)
+        i[k] = 0;
+
+    return i;
+}
+
+void            __attribute__((target(ISA)))
+SFX(__imlib_rotate_sample_span) (const uint32_t * src, int sow,
+                                 uint32_t * dst, int n, int x, int y,
+                                 int dxh, int dyh)
+{
+    vi              vx, vy;
+    vu              i, c;
+
+    SFX(rotate_coords) (x, y, dxh, dyh, &vx, &vy);
+    for (; n > 0; n -= VW, dst += VW)
+    {
+        i = SFX(rotate_offs) (vx, vy, sow, n);
+        c = (vu) GATHER(src, i);
+        memcpy(dst, &c, MIN(n, VW) * sizeof(uint32_t));
+        vx += dxh * VW;
+        vy += dyh * VW;
+    }
+}
+
+/* Bilinear interpolation as INTERP_VAL2 in rotate.c.
+ * The final sum may exceed INT_MAX, the scalar code wraps the same way
+ * and keeps only the low 8 bits of the shifted result. */
+SIMD_INLINE vu
+SFX(interp2) (vu ul, vu ur, vu ll, vu lr, vu fx, vu fy, int sh)
+{
+    vu              a, b, c, d;
+
+    a = (ul >> sh) & 0xff;
+    b = (ur >> sh) & 0xff;
+    c = (ll >> sh) & 0xff;
+    d = (lr >> sh) & 0xff;
+    a = (a << _ROTATE_PREC) + (b - a) * fx;
+    c = (c << _ROTATE_PREC) + (d - c) * fx;
+    a = (a << _ROTATE_PREC) + (c - a) * fy;
+
+    return (a >> (2 * _ROTATE_PREC)) << sh;
+}
+
+void            __attribute__((target(ISA)))
+SFX(__imlib_rotate_aa_span) (const uint32_t * src, int sow,
+                             uint32_t * dst, int n, int x, int y,
+                             int dxh, int dyh)
+{
+    vi              vx, vy;
+    vu              i, ul, ur, ll, lr, fx, fy, c;
+
+    SFX(rotate_coords) (x, y, dxh, dyh, &vx, &vy);
+    for (; n > 0; n -= VW, dst += VW)
+    {
+        i = SFX(rotate_offs) (vx, vy, sow, n);
+        ul = (vu) GATHER(src, i);
+        ur = (vu) GATHER(src + 1, i);
+        ll = (vu) GATHER(src + sow, i);
+        lr = (vu) GATHER(src + sow + 1, i);
+        fx = (vu) vx & _ROTATE_PREC_BITS;
+        fy = (vu) vy & _ROTATE_PREC_BITS;
+
+        c = SFX(interp2) (ul, ur, ll, lr, fx, fy, 24) |
+            SFX(interp2) (ul, ur, ll, lr, fx, fy, 16) |
+            SFX(interp2) (ul, ur, ll, lr, fx, fy, 8) |
+            SFX(interp2) (ul, ur, ll, lr, fx, fy, 0);
+        memcpy(dst, &c, MIN(n, VW) * sizeof(uint32_t));
+        vx += dxh * VW;
+        vy += dyh * VW;
+    }
+}
+
+#ifdef BUILD_X11
+/* Grabbed XImage rows (x11_grab.c).
+ * For 5 and 6 bit v, (v * 1053) >> 7 == 255 * v / 31 and
+ * (v * 4145) >> 10 == 255 * v / 63. */
+typedef uint16_t SFX(vh) __attribute__((vector_size(VW * 2)));
+
+#define RGB5V(v) ((((v) & 0x1f) * 1053) >> 7)
+#define RGB6V(v) ((((v) & 0x3f) * 4145) >> 10)
+
+SIMD_INLINE vu
+SFX(grab_px) (vu p, int fmt)
+{
+    switch (fmt)
+    {
+    case GRAB_ROW_RGB555:
+        return 0xff000000 | (RGB5V(p >> 10) << 16) | (RGB5V(p >> 5) << 8) |
+            RGB5V(p);
+    case GRAB_ROW_RGB565:
+        return 0xff000000 | (RGB5V(p >> 11) << 16) | (RGB6V(p >> 5) << 8) |
+            RGB5V(p);
+    case GRAB_ROW_XRGB32:
+        return 0xff000000 | p;
+    case GRAB_ROW_XBGR32:
+        return 0xff000000 | ((p << 16) & 0xff0000) | (p & 0x00ff00) |
+            ((p >> 16) & 0x0000ff);
+    default:
+    case GRAB_ROW_BSWAP32:
+        return (p << 24) | ((p << 8) & 0xff0000) | ((p >> 8) & 0x00ff00) |
+            (p >> 24);
+    }
+}
+
+SIMD_INLINE void
+SFX(grab_row_fmt) (uint32_t * dst, const uint8_t * src, int w, int fmt)
+{
+    SFX(vh)         h;
+    vu              p;
+    int             x, bpp;
+
+    bpp = (fmt == GRAB_ROW_RGB555 || fmt == GRAB_ROW_RGB565) ? 2 : 4;
+
+    for (x = 0; x <= w - VW; x += VW)
+    {
+        if (bpp == 2)
+        {
+            memcpy(&h, src + 2 * x, sizeof(h));
+            p = __builtin_convertvector(h, vu);
+        }
+        else
+        {
+            memcpy(&p, src + 4 * x, sizeof(p));
+        }
+        p = SFX(grab_px) (p, fmt);
+        memcpy(dst + x, &p, sizeof(p));
+    }
+
+    if (x < w)
+    {
+        h = (SFX(vh)) { };
+        p = (vu) { };
+        if (bpp == 2)
+        {
+            memcpy(&h, src + 2 * x, (w - x) * 2);
+            p = __builtin_convertvector(h, vu);
+        }
+        else
+        {
+            memcpy(&p, src + 4 * x, (w - x) * 4);
+        }
+        p = SFX(grab_px) (p, fmt);
+        memcpy(dst + x, &p, (w - x) * sizeof(uint32_t));
+    }
+}
+
+void            __attribute__((target(ISA)))
+SFX(__imlib_grab_row) (uint32_t * dst, const uint8_t * src, int w, int fmt)
+{
+    switch (fmt)
+    {
+    case GRAB_ROW_RGB555:
+        SFX(grab_row_fmt) (dst, src, w, GRAB_ROW_RGB555);
+        break;
+    case GRAB_ROW_RGB565:
+        SFX(grab_row_fmt) (dst, src, w, GRAB_ROW_RGB565);
+        break;
+    case GRAB_ROW_XRGB32:
+        SFX(grab_row_fmt) (dst, src, w, GRAB_ROW_XRGB32);
+        break;
+    case GRAB_ROW_XBGR32:
+        SFX(grab_row_fmt) (dst, src, w, GRAB_ROW_XBGR32);
+        break;
+    case GRAB_ROW_ARGB32:
+        memcpy(dst, src, w * sizeof(uint32_t));
+        break;
+    case GRAB_ROW_BSWAP32:
+        SFX(grab_row_fmt) (dst, src, w, GRAB_ROW_BSWAP32);
+        break;
+    }
+}
+
+/* Clear the alpha of pixels whose bit is 0, LSB first. Rows of VW pixels
+ * start on byte boundaries. */
+void            __attribute__((target(ISA)))
+SFX(__imlib_grab_mask_row) (uint32_t * dst, const uint8_t * bits, int w)
+{
+    vu              lane, keep, d;
+    uint32_t        b, all;
+    int             x, n, k;
+
+    for (k = 0; k < VW; k++)
+        lane[k] = k;
+
+    for (x = 0; x < w; x += VW)
+    {
+        n = MIN(w - x, VW);
+        b = 0;
+        memcpy(&b, bits + x / 8, (n + 7) / 8);
+        all = (1U << n) - 1;
+        if ((b & all) == all)
+            continue;           /* All inside */
+
+        keep = (vu) { } + b;
+        keep = (0 - ((keep >> lane) & 1)) | 0x00ffffff;
+        if (n == VW)
+        {
+            memcpy(&d, dst + x, sizeof(d));
+            d &= keep;
+            memcpy(dst + x, &d, sizeof(d));
+        }
+        else
+        {
+            d = SFX(load_n) (dst + x, n);
+            SFX(store_n) (dst + x, d & keep, n);
+        }
+    }
+}
+
+/* Rendered rows (x11_rgba.c).
+ * The 15/16 bpp dither adds one to the truncated channel where the 4x4
+ * matrix is below the dropped bits, unless that would overflow, which is
+ * what the lookup tables built by __imlib_RGBA_init() hold. */
+SIMD_INLINE vu
+SFX(rgba_px16) (vu p, vu d, int fmt, int dither)
+{
+    vu              hi, g, lo;
+    int             g6;
+
+    g6 = fmt == RGBA_ROW_RGB565 || fmt == RGBA_ROW_BGR565;
+    if (fmt == RGBA_ROW_BGR565 || fmt == RGBA_ROW_BGR555)
+    {
+        hi = p & 0xff;
+        lo = (p >> 16) & 0xff;
+    }
+    else
+    {
+        hi = (p >> 16) & 0xff;
+        lo = p & 0xff;
+    }
+    g = (p >> 8) & 0xff;
+
+    if (dither)
+    {
+        hi = (hi >> 3) + ((vu)((d < (hi & 7)) & (hi < 248)) & 1);
+        lo = (lo >> 3) + ((vu)((d < (lo & 7)) & (lo < 248)) & 1);
+        if (g6)
+            g = (g >> 2) + ((vu)((d < ((g & 3) << 1)) & (g < 252)) & 1);
+        else
+            g = (g >> 3) + ((vu)((d < (g & 7)) & (g < 248)) & 1);
+    }
+    else
+    {
+        hi >>= 3;
+        lo >>= 3;
+        g >>= g6 ? 2 : 3;
+    }
+
+    return (hi << (g6 ? 11 : 10)) | (g << 5) | lo;
+}
+
+SIMD_INLINE void
+SFX(rgba_rows16) (const uint32_t * src, int src_jump, uint8_t * dst, int dow,
+                  int w, int h, int dx, int dy, int fmt, int dither)
+{
+    SFX(vh)         o;
+    vu              p, d = { };
+    int             x, y, k;
+
+    for (y = 0; y < h; y++, src += w + src_jump, dst += dow)
+    {
+        if (dither)
+        {
+            for (k = 0; k < VW; k++)
+                d[k] = __imlib_dither_44[(dx + k) & 3][(dy + y) & 3];
+        }
+
+        for (x = 0; x <= w - VW; x += VW)
+        {
+            memcpy(&p, src + x, sizeof(p));
+            p = SFX(rgba_px16) (p, d, fmt, dither);
+            o = __builtin_convertvector(p, SFX(vh));
+            memcpy(dst + 2 * x, &o, sizeof(o));
+        }
+
+        if (x < w)
+        {
+            p = SFX(load_n) (src + x, w - x);
+            p = SFX(rgba_px16) (p, d, fmt, dither);
+            o = __builtin_convertvector(p, SFX(vh));
+            memcpy(dst + 2 * x, &o, (w - x) * 2);
+        }
+    }
+}
+
+SIMD_INLINE void
+SFX(rgba_rows32) (const uint32_t * src, int src_jump, uint8_t * dst, int dow,
+                  int w, int h)
+{
+    vu              p;
+    int             x, y;
+
+    for (y = 0; y < h; y++, src += w + src_jump, dst += dow)
+    {
+        for (x = 0; x <= w - VW; x += VW)
+        {
+            memcpy(&p, src + x, sizeof(p));
+            p = ((p >> 16) & 0xff) | (p & 0xff00) | ((p << 16) & 0xff0000);
+            memcpy(dst + 4 * x, &p, sizeof(p));
+        }
+
+        if (x < w)
+        {
+            p = SFX(load_n) (src + x, w - x);
+            p = ((p >> 16) & 0xff) | (p & 0xff00) | ((p << 16) & 0xff0000);
+            memcpy(dst + 4 * x, &p, (w - x) * 4);
+        }
+    }
+}
+
+/* 24 bpp, packing each 16 byte lane of 4 pixels to 12 bytes, then the
+ * lanes together. The whole vector is stored, the bytes past the packed
+ * pixels are written again by the next ones. */
+typedef uint8_t SFX(vq) __attribute__((vector_size(VW * 4)));
+
+#define PACK24_LANE(a, b, c, o) \
+    (a) + (o), (b) + (o), (c) + (o), (a) + (o) + 4, (b) + (o) + 4, \
+    (c) + (o) + 4, (a) + (o) + 8, (b) + (o) + 8, (c) + (o) + 8, \
+    (a) + (o) + 12, (b) + (o) + 12, (c) + (o) + 12, \
+    (o) + 3, (o) + 7, (o) + 11, (o) + 15
+#if VW == 16
+#define PACK24(a, b, c) \
+    { PACK24_LANE(a, b, c, 0), PACK24_LANE(a, b, c, 16), \
+      PACK24_LANE(a, b, c, 32), PACK24_LANE(a, b, c, 48) }
+#define PACK24_LANES \
+    { 0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, 3, 7, 11, 15 }
+#else
+#define PACK24(a, b, c) \
+    { PACK24_LANE(a, b, c, 0), PACK24_LANE(a, b, c, 16) }
+#define PACK24_LANES { 0, 1, 2, 4, 5, 6, 3, 7 }
+#endif
+
+SIMD_INLINE void
+SFX(rgba_rows24) (const uint32_t * src, int src_jump, uint8_t * dst, int dow,
+                  int w, int h, int bgr)
+{
+    static const SFX(vq) rgb = PACK24(0, 1, 2);
+    static const SFX(vq) bgr_ = PACK24(2, 1, 0);
+    static const vu lanes = PACK24_LANES;
+    SFX(vq)         p;
+    const uint32_t *s;
+    uint8_t        *d;
+    int             x, y;
+
+    for (y = 0; y < h; y++, src += w + src_jump, dst += dow)
+    {
+        for (x = 0; 3 * x + 4 * VW <= 3 * w; x += VW)
+        {
+            memcpy(&p, src + x, sizeof(p));
+            p = __builtin_shuffle(p, bgr ? bgr_ : rgb);
+            p = (SFX(vq)) __builtin_shuffle((vu) p, lanes);
+            memcpy(dst + 3 * x, &p, sizeof(p));
+        }
+
+        for (s = src + x, d = dst + 3 * x; x < w; x++, s++, d += 3)
+        {
+            d[0] = *s >> (bgr ? 16 : 0);
+            d[1] = *s >> 8;
+            d[2] = *s >> (bgr ? 0 : 16);
+        }
+    }
+}
+
+#undef PACK24_LANE
+#undef PACK24
+#undef PACK24_LANES
+
+SIMD_INLINE void
+SFX(rgba_rows) (const uint32_t * src, int src_jump, uint8_t * dst, int dow,
+                int w, int h, int dx, int dy, int fmt, int dither)
+{
+    switch (fmt)
+    {
+    default:
+        SFX(rgba_rows16) (src, src_jump, dst, dow, w, h, dx, dy, fmt, dither);
+        break;
+    case RGBA_ROW_BGR8888:
+        SFX(rgba_rows32) (src, src_jump, dst, dow, w, h);
+        break;
+    case RGBA_ROW_RGB888:
+        SFX(rgba_rows24) (src, src_jump, dst, dow, w, h, 0);
+        break;
+    case RGBA_ROW_BGR888:
+        SFX(rgba_rows24) (src, src_jump, dst, dow, w, h, 1);
+        break;
+    }
+}
+
+#define RGBA_FN(f, d) \
+static void __attribute__((target(ISA))) \
+SFX(rgba_##f##_##d) (const uint32_t * src, int src_jump, uint8_t * dst, \
+                     int dow, int w, int h, int dx, int dy) \
+{ \
+    SFX(rgba_rows) (src, src_jump, dst, dow, w, h, dx, dy, \
+                    RGBA_ROW_##f, d); \
+}
+
+RGBA_FN(RGB565, 0) RGBA_FN(RGB565, 1)
+RGBA_FN(BGR565, 0) RGBA_FN(BGR565, 1)
+RGBA_FN(RGB555, 0) RGBA_FN(RGB555, 1)
+RGBA_FN(BGR555, 0) RGBA_FN(BGR555, 1)
+RGBA_FN(BGR8888, 0)
+RGBA_FN(RGB888, 0)
+RGBA_FN(BGR888, 0)
+
+/* Nothing to dither at 24 bits */
+const ImlibRGBAFunction SFX(__imlib_rgba_funcs)[RGBA_ROW_NUM][2] = {
+    [RGBA_ROW_RGB565] = { SFX(rgba_RGB565_0), SFX(rgba_RGB565_1) },
+    [RGBA_ROW_BGR565] = { SFX(rgba_BGR565_0), SFX(rgba_BGR565_1) },
+    [RGBA_ROW_RGB555] = { SFX(rgba_RGB555_0), SFX(rgba_RGB555_1) },
+    [RGBA_ROW_BGR555] = { SFX(rgba_BGR555_0), SFX(rgba_BGR555_1) },
+    [RGBA_ROW_BGR8888] = { SFX(rgba_BGR8888_0), SFX(rgba_BGR8888_0) },
+    [RGBA_ROW_RGB888] = { SFX(rgba_RGB888_0), SFX(rgba_RGB888_0) },
+    [RGBA_ROW_BGR888] = { SFX(rgba_BGR888_0), SFX(rgba_BGR888_0) },
+};
+
+#undef RGBA_FN
+#undef RGB5V
+#undef RGB6V
+#endif                          /* BUILD_X11 */
+
+#undef BLEND_FN
+#undef BLEND_FN_OP
+#undef BLEND_FP
+#undef BLEND_TAB_OP
+#undef SPAN_FN
+#undef SPAN_FN_OP
+#undef SPAN_TAB_OP
+#undef VSEL
+#undef SIMD_INLINE
+#undef vu
+#undef vi
+#undef vf
+#undef vb
@@ -19,6 +19,7 @@
 #include "rotate.h"
 #include "scale.h"
 #include "script.h"
+#include "stats.h"
 #include "updates.h"
 #ifdef BUILD_X11
 #include "x11_pixmap.h"
@@ -312,6 +313,30 @@ imlib_context_get_operation(void)
     return (Imlib_Operation) ctx->operation;
 }
 
+EAPI void
+imlib_context_set_line_width(double width)
+{
+    ctx->line_width = width;
+}
+
+EAPI double
+imlib_context_get_line_width(void)
+{
+    return ctx->line_width;
+}
+
+EAPI void
+imlib_context_set_line_cap(Imlib_Line_Cap cap)
+{
+    ctx->line_cap = cap;
+}
+
+EAPI            Imlib_Line_Cap
+imlib_context_get_line_cap(void)
+{
+    return ctx->line_cap;
+}
+
 EAPI void
 imlib_context_set_color(int red, int green, int blue, int alpha)
 {
@@ -725,7 +750,7 @@ imlib_free_image_and_decache(void)
 
     CHECK_PARAM_POINTER("image", ctx->image);
     CAST_IMAGE(im, ctx->image);
-    IM_FLAG_SET(im, F_INVALID);
+    __imlib_DirtyImage(im);
     __imlib_FreeImage(im);
     ctx->image = NULL;
 }
@@ -1108,7 +1133,7 @@ imlib_updates_merge(Imlib_Updates updates, int w, int h)
     ImlibUpdate    *u;
 
     u = (ImlibUpdate *) updates;
-    return __imlib_MergeUpdate(u, w, h, 0);
+    return __imlib_MergeUpdate(u, w, h, UPDATE_COST_MERGE);
 }
 
 EAPI            Imlib_Updates
@@ -1117,7 +1142,7 @@ imlib_updates_merge_for_rendering(Imlib_Updates updates, int w, int h)
     ImlibUpdate    *u;
 
     u = (ImlibUpdate *) updates;
-    return __imlib_MergeUpdate(u, w, h, 3);
+    return __imlib_MergeUpdate(u, w, h, UPDATE_COST_RENDER);
 }
 
 EAPI void
@@ -1354,6 +1379,40 @@ imlib_image_tile(void)
     __imlib_TileImageVert(im);
 }
 
+static void
+_imlib_image_color_adjust(int mode, float hue, float sat, float lum)
+{
+    ImlibImage     *im;
+    ImlibColorAdjust ca;
+
+    CHECK_PARAM_POINTER("image", ctx->image);
+    CAST_IMAGE(im, ctx->image);
+    ctx->error = __imlib_LoadImageData(im);
+    if (ctx->error)
+        return;
+    __imlib_DirtyImage(im);
+    __imlib_ColorAdjustSetup(&ca, mode, hue, sat, lum);
+    __imlib_DataColorAdjust(im->data, im->w, im->h, 0, &ca);
+}
+
+EAPI void
+imlib_image_adjust_hsv(float hue, float saturation, float value)
+{
+    _imlib_image_color_adjust(COLOR_ADJUST_HSV, hue, saturation, value);
+}
+
+EAPI void
+imlib_image_adjust_hls(float hue, float lightness, float saturation)
+{
+    _imlib_image_color_adjust(COLOR_ADJUST_HLS, hue, saturation, lightness);
+}
+
+EAPI void
+imlib_image_grayscale(void)
+{
+    _imlib_image_color_adjust(COLOR_ADJUST_GRAY, 0, 1, 1);
+}
+
 EAPI            Imlib_Color_Modifier
 imlib_create_color_modifier(void)
 {
@@ -1502,6 +1561,13 @@ imlib_image_draw_line(int x1, int y1, int x2, int y2, char make_updates)
     if (ctx->error)
         return NULL;
     __imlib_DirtyImage(im);
+    if (ctx->line_width > 0)
+        return __imlib_Line_StrokeToImage(x1, y1, x2, y2, ctx->line_width,
+                                          ctx->line_cap, ctx->pixel, im,
+                                          ctx->cliprect.x, ctx->cliprect.y,
+                                          ctx->cliprect.w, ctx->cliprect.h,
+                                          ctx->operation, ctx->blend,
+                                          ctx->anti_alias, make_updates);
     return __imlib_Line_DrawToImage(x1, y1, x2, y2, ctx->pixel,
                                     im, ctx->cliprect.x,
                                     ctx->cliprect.y,
@@ -2119,6 +2185,14 @@ imlib_polygon_add_point(ImlibPolygon poly, int x, int y)
     __imlib_polygon_add_point((ImlibPoly *) poly, x, y);
 }
 
+EAPI void
+imlib_polygon_set_fill_rule(ImlibPolygon poly, Imlib_Fill_Rule rule)
+{
+    CHECK_PARAM_POINTER("polygon", poly);
+    ((ImlibPoly *) poly)->fill_rule = rule == IMLIB_FILL_NON_ZERO ?
+        POLY_FILL_NON_ZERO : POLY_FILL_EVEN_ODD;
+}
+
 EAPI void
 imlib_polygon_free(ImlibPolygon poly)
 {
@@ -2179,10 +2253,39 @@ imlib_image_draw_ellipse(int xc, int yc, int a, int b)
     if (ctx->error)
         return;
     __imlib_DirtyImage(im);
-    __imlib_Ellipse_DrawToImage(xc, yc, a, b, ctx->pixel,
-                                im, ctx->cliprect.x, ctx->cliprect.y,
-                                ctx->cliprect.w, ctx->cliprect.h,
-                                ctx->operation, ctx->blend, ctx->anti_alias);
+    if (ctx->line_width > 0)
+        __imlib_Arc_StrokeToImage(xc, yc, a, b, 0, 360, ctx->line_width,
+                                  ctx->line_cap, ctx->pixel, im,
+                                  ctx->cliprect.x, ctx->cliprect.y,
+                                  ctx->cliprect.w, ctx->cliprect.h,
+                                  ctx->operation, ctx->blend,
+                                  ctx->anti_alias);
+    else
+        __imlib_Ellipse_DrawToImage(xc, yc, a, b, ctx->pixel,
+                                    im, ctx->cliprect.x, ctx->cliprect.y,
+                                    ctx->cliprect.w, ctx->cliprect.h,
+                                    ctx->operation, ctx->blend,
+                                    ctx->anti_alias);
+}
+
+EAPI void
+imlib_image_draw_arc(int xc, int yc, int a, int b, double angle1,
+                     double angle2)
+{
+    ImlibImage     *im;
+
+    CHECK_PARAM_POINTER("image", ctx->image);
+    CAST_IMAGE(im, ctx->image);
+    ctx->error = __imlib_LoadImageData(im);
+    if (ctx->error)
+        return;
+    __imlib_DirtyImage(im);
+    __imlib_Arc_StrokeToImage(xc, yc, a, b, angle1, angle2,
+                              ctx->line_width > 0 ? ctx->line_width : 1,
+                              ctx->line_cap, ctx->pixel, im,
+                              ctx->cliprect.x, ctx->cliprect.y,
+                              ctx->cliprect.w, ctx->cliprect.h,
+                              ctx->operation, ctx->blend, ctx->anti_alias);
 }
 
 EAPI void
@@ -2209,6 +2312,158 @@ imlib_polygon_contains_point(ImlibPolygon poly, int x, int y)
     return __imlib_polygon_contains_point((ImlibPoly *) poly, x, y);
 }
 
+EAPI int
+imlib_polygon_contains_points(ImlibPolygon poly, const int *xy, int n,
+                              unsigned char *inside)
+{
+    CHECK_PARAM_POINTER_RETURN("polygon", poly, 0);
+    CHECK_PARAM_POINTER_RETURN("xy", xy, 0);
+    CHECK_PARAM_POINTER_RETURN("inside", inside, 0);
+    if (n <= 0)
+        return 0;
+    return __imlib_polygon_contains_points((ImlibPoly *) poly, xy, n, inside);
+}
+
+EAPI            Imlib_Draw_List
+imlib_draw_list_new(void)
+{
+    return __imlib_DrawListNew();
+}
+
+EAPI void
+imlib_draw_list_free(Imlib_Draw_List dl)
+{
+    CHECK_PARAM_POINTER("draw_list", dl);
+    __imlib_DrawListFree((ImlibDrawList *) dl);
+}
+
+EAPI void
+imlib_draw_list_clear(Imlib_Draw_List dl)
+{
+    CHECK_PARAM_POINTER("draw_list", dl);
+    __imlib_DrawListClear((ImlibDrawList *) dl);
+}
+
+EAPI void
+imlib_draw_list_draw_pixel(Imlib_Draw_List dl, int x, int y)
+{
+    CHECK_PARAM_POINTER("draw_list", dl);
+    __imlib_DrawListAddPoint((ImlibDrawList *) dl, x, y, ctx->pixel,
+                             ctx->operation, ctx->blend);
+}
+
+EAPI void
+imlib_draw_list_draw_line(Imlib_Draw_List dl, int x1, int y1, int x2, int y2)
+{
+    CHECK_PARAM_POINTER("draw_list", dl);
+    __imlib_DrawListAddLine((ImlibDrawList *) dl, x1, y1, x2, y2,
+                            ctx->line_width, ctx->line_cap, ctx->pixel,
+                            ctx->operation, ctx->blend, ctx->anti_alias);
+}
+
+EAPI void
+imlib_draw_list_draw_polyline(Imlib_Draw_List dl, const int *xy, int n,
+                              unsigned char closed)
+{
+    int             i;
+
+    CHECK_PARAM_POINTER("draw_list", dl);
+    CHECK_PARAM_POINTER("xy", xy);
+    if (n == 1 && ctx->line_width > 0)
+        __imlib_DrawListAddLine((ImlibDrawList *) dl, xy[0], xy[1],
+                                xy[0], xy[1], ctx->line_width, ctx->line_cap,
+                                ctx->pixel, ctx->operation, ctx->blend,
+                                ctx->anti_alias);
+    else if (n == 1)
+        __imlib_DrawListAddPoint((ImlibDrawList *) dl, xy[0], xy[1],
+                                 ctx->pixel, ctx->operation, ctx->blend);
+    for (i = 1; i < n; i++)
+        __imlib_DrawListAddLine((ImlibDrawList *) dl,
+                                xy[2 * i - 2], xy[2 * i - 1],
+                                xy[2 * i], xy[2 * i + 1], ctx->line_width,
+                                ctx->line_cap, ctx->pixel, ctx->operation,
+                                ctx->blend, ctx->anti_alias);
+    if (closed && n > 2)
+        __imlib_DrawListAddLine((ImlibDrawList *) dl,
+                                xy[2 * n - 2], xy[2 * n - 1], xy[0], xy[1],
+                                ctx->line_width, ctx->line_cap, ctx->pixel,
+                                ctx->operation, ctx->blend, ctx->anti_alias);
+}
+
+EAPI void
+imlib_draw_list_draw_rectangle(Imlib_Draw_List dl, int x, int y,
+                               int width, int height)
+{
+    CHECK_PARAM_POINTER("draw_list", dl);
+    __imlib_DrawListAddRectangle((ImlibDrawList *) dl, x, y, width, height,
+                                 0, ctx->pixel, ctx->operation, ctx->blend);
+}
+
+EAPI void
+imlib_draw_list_fill_rectangle(Imlib_Draw_List dl, int x, int y,
+                               int width, int height)
+{
+    CHECK_PARAM_POINTER("draw_list", dl);
+    __imlib_DrawListAddRectangle((ImlibDrawList *) dl, x, y, width, height,
+                                 1, ctx->pixel, ctx->operation, ctx->blend);
+}
+
+EAPI void
+imlib_draw_list_draw_ellipse(Imlib_Draw_List dl, int xc, int yc, int a, int b)
+{
+    CHECK_PARAM_POINTER("draw_list", dl);
+    __imlib_DrawListAddEllipse((ImlibDrawList *) dl, xc, yc, a, b, 0,
+                               ctx->line_width, ctx->pixel, ctx->operation,
+                               ctx->blend, ctx->anti_alias);
+}
+
+EAPI void
+imlib_draw_list_fill_ellipse(Imlib_Draw_List dl, int xc, int yc, int a, int b)
+{
+    CHECK_PARAM_POINTER("draw_list", dl);
+    __imlib_DrawListAddEllipse((ImlibDrawList *) dl, xc, yc, a, b, 1, 0,
+                               ctx->pixel, ctx->operation, ctx->blend,
+                               ctx->anti_alias);
+}
+
+EAPI void
+imlib_draw_list_draw_polygon(Imlib_Draw_List dl, ImlibPolygon poly,
+                             unsigned char closed)
+{
+    CHECK_PARAM_POINTER("draw_list", dl);
+    CHECK_PARAM_POINTER("polygon", poly);
+    __imlib_DrawListAddPolygon((ImlibDrawList *) dl, (ImlibPoly *) poly,
+                               closed, 0, ctx->pixel, ctx->operation,
+                               ctx->blend, ctx->anti_alias);
+}
+
+EAPI void
+imlib_draw_list_fill_polygon(Imlib_Draw_List dl, ImlibPolygon poly)
+{
+    CHECK_PARAM_POINTER("draw_list", dl);
+    CHECK_PARAM_POINTER("polygon", poly);
+    __imlib_DrawListAddPolygon((ImlibDrawList *) dl, (ImlibPoly *) poly,
+                               0, 1, ctx->pixel, ctx->operation,
+                               ctx->blend, ctx->anti_alias);
+}
+
+EAPI void
+imlib_image_draw_list(Imlib_Draw_List dl)
+{
+    ImlibImage     *im;
+
+    CHECK_PARAM_POINTER("image", ctx->image);
+    CHECK_PARAM_POINTER("draw_list", dl);
+    CAST_IMAGE(im, ctx->image);
+    ctx->error = __imlib_LoadImageData(im);
+    if (ctx->error)
+        return;
+    __imlib_DirtyImage(im);
+    __imlib_DrawList_DrawToImage((ImlibDrawList *) dl, im,
+                                 ctx->cliprect.x, ctx->cliprect.y,
+                                 ctx->cliprect.w, ctx->cliprect.h);
+}
+
 EAPI void
 imlib_image_clear(void)
 {
@@ -2278,3 +2533,45 @@ imlib_strerror(int err)
 
     return str;
 }
+
+static Imlib_Trace_Function trace_func = NULL;
+static void    *trace_data = NULL;
+
+static void
+_trace_func(const ImlibSpan * sp, int end, int err, unsigned int dt,
+            void *data)
+{
+    Imlib_Trace_Span span;
+
+    span.type = (Imlib_Trace_Type) sp->type;
+    span.name = sp->name;
+    span.file = sp->file;
+    span.w = sp->w;
+    span.h = sp->h;
+    span.error = err;
+    span.time_us = dt;
+
+    trace_func(&span, end, trace_data);
+}
+
+EAPI void
+imlib_set_trace_function(Imlib_Trace_Function func, void *data)
+{
+    trace_func = func;
+    trace_data = data;
+    __imlib_SetTraceFunction(func ? _trace_func : NULL, NULL);
+}
+
+EAPI void
+imlib_stats_foreach(Imlib_Stats_Function func, void *data)
+{
+    CHECK_PARAM_POINTER("func", func);
+
+    __imlib_StatsForeach(func, data);
+}
+
+EAPI void
+imlib_stats_reset(void)
+{
+    __imlib_StatsReset();
+}
@@ -57,6 +57,8 @@ typedef struct {
     char            dither_mask;
     int             mask_alpha_threshold;
     Imlib_Rectangle cliprect;
+    double          line_width;
+    Imlib_Line_Cap  line_cap;
     int             references;
     char            dirty;
 #if ENABLE_FILTERS
@@ -3,6 +3,7 @@
 #include "common.h"
 
 #include <math.h>
+#include <stdlib.h>
 
 #include "api.h"
 #include "file.h"
@@ -88,37 +89,25 @@ imlib_get_next_font_in_fallback_chain(Imlib_Font fn)
     return ((ImlibFont *) fn)->fallback_next;
 }
 
-EAPI void
-imlib_text_draw(int x, int y, const char *text)
-{
-    imlib_text_draw_with_return_metrics(x, y, text, NULL, NULL, NULL, NULL);
-}
-
-EAPI void
-imlib_text_draw_with_return_metrics(int x, int y, const char *text,
-                                    int *width_return, int *height_return,
-                                    int *horizontal_advance_return,
-                                    int *vertical_advance_return)
+static void
+__text_draw(ImlibTextRun *run, int x, int y, int *width_return,
+            int *height_return, int *horizontal_advance_return,
+            int *vertical_advance_return)
 {
     ImlibImage     *im;
-    ImlibFont      *fn;
     int             dir;
 
-    CHECK_PARAM_POINTER("font", ctx->font);
-    CHECK_PARAM_POINTER("image", ctx->image);
-    CHECK_PARAM_POINTER("text", text);
     CAST_IMAGE(im, ctx->image);
     ctx->error = __imlib_LoadImageData(im);
     if (ctx->error)
         return;
-    fn = (ImlibFont *) ctx->font;
     __imlib_DirtyImage(im);
 
     dir = ctx->direction;
     if (ctx->direction == IMLIB_TEXT_TO_ANGLE && ctx->angle == 0.0)
         dir = IMLIB_TEXT_TO_RIGHT;
 
-    __imlib_render_str(im, fn, x, y, text, ctx->pixel, dir,
+    __imlib_render_str(im, run, x, y, ctx->pixel, dir,
                        ctx->angle, width_return, height_return, 0,
                        horizontal_advance_return, vertical_advance_return,
                        ctx->operation,
@@ -126,22 +115,17 @@ imlib_text_draw_with_return_metrics(int x, int y, const char *text,
                        ctx->cliprect.w, ctx->cliprect.h);
 }
 
-EAPI void
-imlib_get_text_size(const char *text, int *width_return, int *height_return)
+static void
+__text_size(ImlibTextRun *run, int *width_return, int *height_return)
 {
-    ImlibFont      *fn;
     int             w, h;
     int             dir;
 
-    CHECK_PARAM_POINTER("font", ctx->font);
-    CHECK_PARAM_POINTER("text", text);
-    fn = (ImlibFont *) ctx->font;
-
     dir = ctx->direction;
     if (ctx->direction == IMLIB_TEXT_TO_ANGLE && ctx->angle == 0.0)
         dir = IMLIB_TEXT_TO_RIGHT;
 
-    __imlib_font_query_size(fn, text, &w, &h);
+    __imlib_font_query_size(run, &w, &h);
 
     switch (dir)
     {
@@ -218,17 +202,56 @@ imlib_get_text_size(const char *text, int *width_return, int *height_return)
     }
 }
 
+EAPI void
+imlib_text_draw(int x, int y, const char *text)
+{
+    imlib_text_draw_with_return_metrics(x, y, text, NULL, NULL, NULL, NULL);
+}
+
+EAPI void
+imlib_text_draw_with_return_metrics(int x, int y, const char *text,
+                                    int *width_return, int *height_return,
+                                    int *horizontal_advance_return,
+                                    int *vertical_advance_return)
+{
+    ImlibTextRun   *run;
+
+    CHECK_PARAM_POINTER("font", ctx->font);
+    CHECK_PARAM_POINTER("image", ctx->image);
+    CHECK_PARAM_POINTER("text", text);
+    run = __imlib_font_run_get((ImlibFont *) ctx->font, text);
+    if (!run)
+        return;
+    __text_draw(run, x, y, width_return, height_return,
+                horizontal_advance_return, vertical_advance_return);
+}
+
+EAPI void
+imlib_get_text_size(const char *text, int *width_return, int *height_return)
+{
+    ImlibTextRun   *run;
+
+    CHECK_PARAM_POINTER("font", ctx->font);
+    CHECK_PARAM_POINTER("text", text);
+    run = __imlib_font_run_get((ImlibFont *) ctx->font, text);
+    if (!run)
+        return;
+    __text_size(run, width_return, height_return);
+}
+
 EAPI void
 imlib_get_text_advance(const char *text, int *horizontal_advance_return,
                        int *vertical_advance_return)
 {
-    ImlibFont      *fn;
+    ImlibTextRun   *run;
     int             w, h;
 
     CHECK_PARAM_POINTER("font", ctx->font);
     CHECK_PARAM_POINTER("text", text);
-    fn = (ImlibFont *) ctx->font;
-    __imlib_font_query_advance(fn, text, &w, &h);
+    run = __imlib_font_run_get((ImlibFont *) ctx->font, text);
+    if (!run)
+        return;
+    __imlib_font_query_advance(run, &w, &h);
     if (horizontal_advance_return)
         *horizontal_advance_return = w;
     if (vertical_advance_return)
@@ -238,12 +261,113 @@ imlib_get_text_advance(const char *text, int *horizontal_advance_return,
 EAPI int
 imlib_get_text_inset(const char *text)
 {
-    ImlibFont      *fn;
+    ImlibTextRun   *run;
 
     CHECK_PARAM_POINTER_RETURN("font", ctx->font, 0);
     CHECK_PARAM_POINTER_RETURN("text", text, 0);
-    fn = (ImlibFont *) ctx->font;
-    return __imlib_font_query_inset(fn, text);
+    run = __imlib_font_run_get((ImlibFont *) ctx->font, text);
+    if (!run)
+        return 0;
+    return __imlib_font_query_inset(run);
+}
+
+EAPI            Imlib_Text_Run
+imlib_text_run_new(const char *text)
+{
+    CHECK_PARAM_POINTER_RETURN("font", ctx->font, NULL);
+    CHECK_PARAM_POINTER_RETURN("text", text, NULL);
+    return __imlib_font_run_new((ImlibFont *) ctx->font, text);
+}
+
+EAPI void
+imlib_text_run_free(Imlib_Text_Run run)
+{
+    CHECK_PARAM_POINTER("run", run);
+    __imlib_font_run_free((ImlibTextRun *) run);
+}
+
+EAPI void
+imlib_text_run_draw(Imlib_Text_Run run, int x, int y)
+{
+    imlib_text_run_draw_with_return_metrics(run, x, y, NULL, NULL, NULL, NULL);
+}
+
+EAPI void
+imlib_text_run_draw_with_return_metrics(Imlib_Text_Run run, int x, int y,
+                                        int *width_return,
+                                        int *height_return,
+                                        int *horizontal_advance_return,
+                                        int *vertical_advance_return)
+{
+    CHECK_PARAM_POINTER("run", run);
+    CHECK_PARAM_POINTER("image", ctx->image);
+    if (__imlib_font_run_check((ImlibTextRun *) run))
+        return;
+    __text_draw((ImlibTextRun *) run, x, y, width_return, height_return,
+                horizontal_advance_return, vertical_advance_return);
+}
+
+EAPI void
+imlib_text_run_get_size(Imlib_Text_Run run, int *width_return,
+                        int *height_return)
+{
+    CHECK_PARAM_POINTER("run", run);
+    if (__imlib_font_run_check((ImlibTextRun *) run))
+        return;
+    __text_size((ImlibTextRun *) run, width_return, height_return);
+}
+
+EAPI void
+imlib_text_run_get_advance(Imlib_Text_Run run,
+                           int *horizontal_advance_return,
+                           int *vertical_advance_return)
+{
+    int             w, h;
+
+    CHECK_PARAM_POINTER("run", run);
+    if (__imlib_font_run_check((ImlibTextRun *) run))
+        return;
+    __imlib_font_query_advance((ImlibTextRun *) run, &w, &h);
+    if (horizontal_advance_return)
+        *horizontal_advance_return = w;
+    if (vertical_advance_return)
+        *vertical_advance_return = h;
+}
+
+EAPI void
+imlib_text_draw_items(const Imlib_Text_Item *items, int n)
+{
+    ImlibImage     *im;
+    ImlibTextItem  *ti;
+    int             i, m;
+
+    CHECK_PARAM_POINTER("image", ctx->image);
+    CHECK_PARAM_POINTER("items", items);
+    if (n <= 0)
+        return;
+    CAST_IMAGE(im, ctx->image);
+    ctx->error = __imlib_LoadImageData(im);
+    if (ctx->error)
+        return;
+
+    ti = malloc(n * sizeof(ImlibTextItem));
+    if (!ti)
+        return;
+    for (i = m = 0; i < n; i++)
+    {
+        if (!items[i].font || !items[i].text)
+            continue;
+        ti[m++] = (ImlibTextItem) {
+            (ImlibFont *) items[i].font, items[i].color, items[i].x,
+            items[i].y, items[i].text, items[i].direction
+        };
+    }
+    __imlib_DirtyImage(im);
+
+    __imlib_render_str_items(im, ti, m, ctx->angle, ctx->operation,
+                             ctx->cliprect.x, ctx->cliprect.y,
+                             ctx->cliprect.w, ctx->cliprect.h);
+    free(ti);
 }
 
 EAPI void
@@ -274,19 +398,21 @@ imlib_text_get_index_and_location(const char *text, int x, int y,
                                   int *char_width_return,
                                   int *char_height_return)
 {
-    ImlibFont      *fn;
+    ImlibTextRun   *run;
     int             w, h, cx, cy, cw, ch, cp, xx, yy;
     int             dir;
 
     CHECK_PARAM_POINTER_RETURN("font", ctx->font, -1);
     CHECK_PARAM_POINTER_RETURN("text", text, -1);
-    fn = (ImlibFont *) ctx->font;
+    run = __imlib_font_run_get((ImlibFont *) ctx->font, text);
+    if (!run)
+        return -1;
 
     dir = ctx->direction;
     if (ctx->direction == IMLIB_TEXT_TO_ANGLE && ctx->angle == 0.0)
         dir = IMLIB_TEXT_TO_RIGHT;
 
-    imlib_get_text_size(text, &w, &h);
+    __text_size(run, &w, &h);
 
     switch (dir)
     {
@@ -310,7 +436,7 @@ imlib_text_get_index_and_location(const char *text, int x, int y,
         return -1;
     }
 
-    cp = __imlib_font_query_text_at_pos(fn, text, xx, yy, &cx, &cy, &cw, &ch);
+    cp = __imlib_font_query_text_at_pos(run, xx, yy, &cx, &cy, &cw, &ch);
 
     switch (dir)
     {
@@ -373,17 +499,19 @@ imlib_text_get_location_at_index(const char *text, int index,
                                  int *char_width_return,
                                  int *char_height_return)
 {
-    ImlibFont      *fn;
+    ImlibTextRun   *run;
     int             cx, cy, cw, ch, w, h;
 
     CHECK_PARAM_POINTER("font", ctx->font);
     CHECK_PARAM_POINTER("text", text);
-    fn = (ImlibFont *) ctx->font;
+    run = __imlib_font_run_get((ImlibFont *) ctx->font, text);
+    if (!run)
+        return;
 
-    __imlib_font_query_char_coords(fn, text, index, &cx, &cy, &cw, &ch);
+    __imlib_font_query_char_coords(run, index, &cx, &cy, &cw, &ch);
 
     w = h = 0;
-    imlib_get_text_size(text, &w, &h);
+    __text_size(run, &w, &h);
 
     switch (ctx->direction)
     {
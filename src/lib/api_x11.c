@@ -109,6 +109,18 @@ imlib_context_get_mask_alpha_threshold(void)
     return ctx->mask_alpha_threshold;
 }
 
+EAPI void
+imlib_context_set_xrender(char xrender)
+{
+    ctx->x11.xrender = xrender;
+}
+
+EAPI char
+imlib_context_get_xrender(void)
+{
+    return ctx->x11.xrender;
+}
+
 EAPI int
 imlib_get_ximage_cache_count_used(void)
 {
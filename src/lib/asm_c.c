@@ -1,6 +1,7 @@
 #include "common.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "asm_c.h"
 
@@ -11,6 +12,87 @@
 int             __imlib_get_cpuid(void);
 #endif
 
+#if DO_AMD64_ASM
+static const char *const isa_names[] = {
+    "c", "sse2", "ssse3", "avx2", "avx512",
+};
+
+static int
+_cpu_isa_detect(void)
+{
+    int             isa;
+
+    isa = ISA_SSE2;             // instruction set is always present
+#if defined(__GNUC__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3"))
+    {
+        isa = ISA_SSSE3;
+        if (__builtin_cpu_supports("avx2"))
+        {
+            isa = ISA_AVX2;
+            if (__builtin_cpu_supports("avx512f") &&
+                __builtin_cpu_supports("avx512bw"))
+                isa = ISA_AVX512;
+        }
+    }
+#endif
+
+    return isa;
+}
+
+int
+__imlib_cpu_isa(void)
+{
+    static signed char _cpu_isa = -1;
+    const char     *s;
+    int             i;
+
+    if (_cpu_isa < 0)
+    {
+        _cpu_isa = _cpu_isa_detect();
+
+        /* IMLIB2_ISA caps the instruction set tier, e.g. "sse2" */
+        s = getenv("IMLIB2_ISA");
+        if (s)
+        {
+            for (i = 0; i < (int)(sizeof(isa_names) / sizeof(isa_names[0]));
+                 i++)
+            {
+                if (strcmp(s, isa_names[i]) == 0)
+                {
+                    if (i < _cpu_isa)
+                        _cpu_isa = i;
+                    break;
+                }
+            }
+        }
+
+        if (getenv("IMLIB2_ASM_OFF"))
+            _cpu_isa = ISA_C;
+    }
+
+    return _cpu_isa;
+}
+
+int
+__imlib_cpu_vbmi(void)
+{
+    static signed char _cpu_vbmi = -1;
+
+    if (_cpu_vbmi < 0)
+    {
+        _cpu_vbmi = 0;
+#if defined(__GNUC__)
+        if (__imlib_cpu_isa() >= ISA_AVX512)
+            _cpu_vbmi = !!__builtin_cpu_supports("avx512vbmi");
+#endif
+    }
+
+    return _cpu_vbmi;
+}
+#endif
+
 int
 __imlib_do_asm(void)
 {
@@ -18,13 +100,13 @@ __imlib_do_asm(void)
 
     if (_cpu_can_asm < 0)
     {
+#if DO_MMX_ASM
         if (getenv("IMLIB2_ASM_OFF"))
             _cpu_can_asm = 0;
         else
-#if DO_MMX_ASM
             _cpu_can_asm = !!(__imlib_get_cpuid() & CPUID_MMX);
 #elif DO_AMD64_ASM
-            _cpu_can_asm = 1;   // instruction set is always present
+        _cpu_can_asm = __imlib_cpu_isa() >= ISA_SSE2;
 #endif
     }
 
@@ -5,4 +5,23 @@
 int             __imlib_do_asm(void);
 #endif
 
+#if DO_AMD64_ASM
+/* Instruction set tiers, ordered.
+ * The vector kernels of amd64_blend_simd.c are built for AVX2 and AVX-512
+ * only, they need gathers and masked loads. Below AVX2 blending uses the
+ * SSE2 assembly (amd64_blend*.S), everything else the C code. */
+enum {
+    ISA_C,
+    ISA_SSE2,
+    ISA_SSSE3,
+    ISA_AVX2,
+    ISA_AVX512,                 /* AVX-512F + AVX-512BW */
+};
+
+int             __imlib_cpu_isa(void);
+
+/* AVX-512 VBMI (byte permutes) is available, within ISA_AVX512 */
+int             __imlib_cpu_vbmi(void);
+#endif
+
 #endif                          /* ASM_C_H */
@@ -7,6 +7,7 @@
 #include "colormod.h"
 #include "image.h"
 #include "scale.h"
+#include "stats.h"
 
 #define ADD_COPY(r, g, b, dest) \
                 ADD_COLOR(R_VAL(dest), r, R_VAL(dest)); \
@@ -1735,11 +1736,27 @@ __imlib_GetBlendFunction(ImlibOp op, char blend, char merge_alpha, char rgb_src,
     do_mmx = __imlib_do_asm();
 #endif
 
+    /* Skip the table lookups when they don't change anything */
+    cm = CMOD_ACTIVE(cm);
     if (cm && rgb_src && (A_CMOD(cm, 0xff) == 0xff))
         blend = 0;
     if (blend && cm && rgb_src && (A_CMOD(cm, 0xff) == 0))
         return NULL;
 
+#ifdef DO_AMD64_ASM
+    switch (__imlib_cpu_isa())
+    {
+    case ISA_AVX512:
+        return __imlib_blend_funcs_avx512[op][!!cm][!!merge_alpha][!!rgb_src]
+            [!!blend];
+    case ISA_AVX2:
+        return __imlib_blend_funcs_avx2[op][!!cm][!!merge_alpha][!!rgb_src]
+            [!!blend];
+    default:                   /* SSSE3 uses the SSE2 functions */
+        break;
+    }
+#endif
+
     bfun = ibfuncs[!!do_mmx][op][!!cm][!!merge_alpha][!!rgb_src][!!blend];
 
     return bfun;
@@ -1793,10 +1810,13 @@ __imlib_BlendRGBAToData(const uint32_t *src, int src_w, int src_h,
 
     __imlib_build_pow_lut();
     blender = __imlib_GetBlendFunction(op, blend, merge_alpha, rgb_src, cm);
-    if (blender)
-        blender((uint32_t *) src + (sy * src_w) + sx, src_w,
-                dst + (dy * dst_w) + dx, dst_w, w, h,
-                (ImlibColorModifier *) cm);
+    if (!blender)
+        return;
+
+    blender((uint32_t *) src + (sy * src_w) + sx, src_w,
+            dst + (dy * dst_w) + dx, dst_w, w, h, (ImlibColorModifier *) cm);
+
+    STATS_ADD(blend_bytes[op], (uint64_t) w * h * sizeof(uint32_t));
 }
 
 #define LINESIZE 16
@@ -1851,6 +1871,7 @@ __imlib_BlendImageToImage(const ImlibImage *im_src, ImlibImage *im_dst,
     else
     {
         ImlibScaleInfo *scaleinfo;
+        ImlibSpan       span;
         uint32_t       *buf;
         int             dwabs, dhabs, dxx, dyy, y2, x2, sw_org, sh_org;
         int             psx, psy, psw, psh;
@@ -1938,6 +1959,8 @@ __imlib_BlendImageToImage(const ImlibImage *im_src, ImlibImage *im_dst,
                 blend = 1;
         }
 
+        __imlib_SpanBegin(&span, SPAN_SCALE, NULL, NULL, dwabs, dhabs);
+
         /* scale in LINESIZE Y chunks and convert to depth */
         for (y = 0; y < dhabs; y += LINESIZE, h -= LINESIZE)
         {
@@ -1955,6 +1978,9 @@ __imlib_BlendImageToImage(const ImlibImage *im_src, ImlibImage *im_dst,
                                     0, 0, dx, dy + y, dwabs, dhabs,
                                     blend, merge_alpha, cm, op, rgb_src);
         }
+        __imlib_SpanEnd(&span, 0);
+        STATS_ADD(scale_bytes[!!aa], (uint64_t) dwabs * dhabs * sizeof(uint32_t));
+
         /* free up our buffers and point tables */
         free(buf);
         __imlib_FreeScaleInfo(scaleinfo);
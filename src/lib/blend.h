@@ -524,6 +524,10 @@ void    __imlib_amd64_reshade_copy_rgba_to_rgba_cmod(uint32_t * src, int sw, uin
                                                      int w, int h, ImlibColorModifier * cm);
 void    __imlib_amd64_reshade_copy_rgb_to_rgba_cmod(uint32_t * src, int sw, uint32_t * dst, int dw,
                                                     int w, int h, ImlibColorModifier * cm);
+
+/* [ operation ][ cmod ][ merge_alpha ][ rgb_src ][ blend ] */
+extern const ImlibBlendFunction __imlib_blend_funcs_avx2[4][2][2][2][2];
+extern const ImlibBlendFunction __imlib_blend_funcs_avx512[4][2][2][2][2];
 #endif
 /* *INDENT-ON* */
 #endif
@@ -1,12 +1,18 @@
 /*
  * Color space conversion helper routines
  * Convert between rgb and hsv and between rgb and hls
+ * and adjust whole rows in those spaces
  */
 #include "common.h"
 
 #include <math.h>
+#include <stdlib.h>
 
+#include "asm_c.h"
 #include "color_helpers.h"
+#include "threads.h"
+
+#define ADJ_ROWS_MIN(w) (1 + 16384 / (w))
 
 void
 __imlib_rgb_to_hsv(int r, int g, int b, float *h, float *s, float *v)
@@ -210,3 +216,243 @@ __imlib_hls_to_rgb(float hue, float lightness, float saturation, int *r, int *g,
             *b = (int)(255.0 * m1);
     }
 }
+
+/*
+ * Row adjustments.
+ * Each step is mirrored by the vector kernels (amd64_blend_simd.h).
+ * All divisions have numerators below 2^24, so the vector kernels can do
+ * them in single precision.
+ */
+
+/* Hue of r, g, b with maximum mx and range d, [0, 6 * ADJ_HUE_ONE) */
+static int
+__adj_hue(int r, int g, int b, int mx, int d)
+{
+    int             h;
+
+    if (r == mx)
+        h = (g - b) * ADJ_HUE_ONE / MAX(d, 1);
+    else if (g == mx)
+        h = 2 * ADJ_HUE_ONE + (b - r) * ADJ_HUE_ONE / MAX(d, 1);
+    else
+        h = 4 * ADJ_HUE_ONE + (r - g) * ADJ_HUE_ONE / MAX(d, 1);
+    if (h < 0)
+        h += 6 * ADJ_HUE_ONE;
+
+    return h;
+}
+
+static int
+__adj_rotate(int h, const ImlibColorAdjust *ca)
+{
+    h += ca->hue;
+    if (h >= 6 * ADJ_HUE_ONE)
+        h -= 6 * ADJ_HUE_ONE;
+
+    return h;
+}
+
+static uint32_t
+__adj_hsv(uint32_t px, const ImlibColorAdjust *ca)
+{
+    int             r, g, b, mx, mn, d, h, s, v, i, f, c, x, p, q, t;
+
+    r = PIXEL_R(px);
+    g = PIXEL_G(px);
+    b = PIXEL_B(px);
+    mx = MAX(r, MAX(g, b));
+    mn = MIN(r, MIN(g, b));
+    d = mx - mn;
+
+    h = __adj_rotate(__adj_hue(r, g, b, mx, d), ca);
+    s = (d * ADJ_SAT_ONE + mx / 2) / MAX(mx, 1);
+    s = MIN((s * ca->sat) >> ADJ_FAC_BITS, ADJ_SAT_ONE);
+    v = MIN((mx * ca->lum) >> ADJ_FAC_BITS, 255);
+
+    /* Back to rgb, in units of 1 / ADJ_SAT_ONE */
+    i = h >> ADJ_HUE_BITS;
+    f = h & (ADJ_HUE_ONE - 1);
+    c = v * s;
+    x = v * ADJ_SAT_ONE;
+    p = x - c;
+    q = x - ((c * f) >> ADJ_HUE_BITS);
+    t = x - ((c * (ADJ_HUE_ONE - f)) >> ADJ_HUE_BITS);
+
+    r = (i == 0 || i == 5) ? x : (i == 1) ? q : (i == 4) ? t : p;
+    g = (i == 1 || i == 2) ? x : (i == 0) ? t : (i == 3) ? q : p;
+    b = (i == 3 || i == 4) ? x : (i == 2) ? t : (i == 5) ? q : p;
+
+    return (px & 0xff000000) |
+        (((r + ADJ_SAT_ONE / 2) >> ADJ_SAT_BITS) << 16) |
+        (((g + ADJ_SAT_ONE / 2) >> ADJ_SAT_BITS) << 8) |
+        ((b + ADJ_SAT_ONE / 2) >> ADJ_SAT_BITS);
+}
+
+/* HLS channel at hue h, in units of 1 / (2 * ADJ_SAT_ONE) */
+static int
+__adj_hls_channel(int h, int m1, int m2, int c)
+{
+    int             i, f;
+
+    if (h < 0)
+        h += 6 * ADJ_HUE_ONE;
+    else if (h >= 6 * ADJ_HUE_ONE)
+        h -= 6 * ADJ_HUE_ONE;
+    i = h >> ADJ_HUE_BITS;
+    f = h & (ADJ_HUE_ONE - 1);
+
+    if (i == 0)
+        return m1 + ((c * f) >> (ADJ_HUE_BITS - 1));
+    if (i == 3)
+        return m1 + ((c * (ADJ_HUE_ONE - f)) >> (ADJ_HUE_BITS - 1));
+    return (i < 3) ? m2 : m1;
+}
+
+static uint32_t
+__adj_hls(uint32_t px, const ImlibColorAdjust *ca)
+{
+    int             r, g, b, mx, mn, d, h, l, s, k, c, m1, m2;
+
+    r = PIXEL_R(px);
+    g = PIXEL_G(px);
+    b = PIXEL_B(px);
+    mx = MAX(r, MAX(g, b));
+    mn = MIN(r, MIN(g, b));
+    d = mx - mn;
+
+    /* Lightness in [0, 510] */
+    h = __adj_rotate(__adj_hue(r, g, b, mx, d), ca);
+    l = mx + mn;
+    k = (l < 255) ? l : 510 - l;
+    s = (d * ADJ_SAT_ONE + k / 2) / MAX(k, 1);
+    s = MIN((s * ca->sat) >> ADJ_FAC_BITS, ADJ_SAT_ONE);
+    l = MIN((l * ca->lum) >> ADJ_FAC_BITS, 510);
+
+    /* Back to rgb, in units of 1 / (2 * ADJ_SAT_ONE) */
+    k = 255 - abs(l - 255);
+    c = k * s;
+    m1 = l * ADJ_SAT_ONE - c;
+    m2 = l * ADJ_SAT_ONE + c;
+    r = __adj_hls_channel(h + 2 * ADJ_HUE_ONE, m1, m2, c);
+    g = __adj_hls_channel(h, m1, m2, c);
+    b = __adj_hls_channel(h - 2 * ADJ_HUE_ONE, m1, m2, c);
+
+    return (px & 0xff000000) |
+        (((r + ADJ_SAT_ONE) >> (ADJ_SAT_BITS + 1)) << 16) |
+        (((g + ADJ_SAT_ONE) >> (ADJ_SAT_BITS + 1)) << 8) |
+        ((b + ADJ_SAT_ONE) >> (ADJ_SAT_BITS + 1));
+}
+
+/* ITU-R BT.601 luma (the Y of JPEG YCbCr) */
+static uint32_t
+__adj_gray(uint32_t px)
+{
+    int             y;
+
+    y = (77 * PIXEL_R(px) + 150 * PIXEL_G(px) + 29 * PIXEL_B(px) + 128) >> 8;
+
+    return (px & 0xff000000) | (y << 16) | (y << 8) | y;
+}
+
+static void
+__color_adjust_span(uint32_t *p, int len, const ImlibColorAdjust *ca)
+{
+    uint32_t       *end;
+
+    end = p + len;
+    switch (ca->mode)
+    {
+    case COLOR_ADJUST_HSV:
+        for (; p < end; p++)
+            *p = __adj_hsv(*p, ca);
+        break;
+    case COLOR_ADJUST_HLS:
+        for (; p < end; p++)
+            *p = __adj_hls(*p, ca);
+        break;
+    case COLOR_ADJUST_GRAY:
+        for (; p < end; p++)
+            *p = __adj_gray(*p);
+        break;
+    }
+}
+
+static ImlibColorAdjustFunction
+__color_adjust_span_function(void)
+{
+#ifdef DO_AMD64_ASM
+    switch (__imlib_cpu_isa())
+    {
+    case ISA_AVX512:
+        return __imlib_color_adjust_span_avx512;
+    case ISA_AVX2:
+        return __imlib_color_adjust_span_avx2;
+    default:
+        break;
+    }
+#endif
+    return __color_adjust_span;
+}
+
+static int
+__adj_factor(float v)
+{
+    if (!(v > 0))
+        return 0;
+    if (v > 255)
+        v = 255;
+
+    return (int)(v * ADJ_FAC_ONE + .5f);
+}
+
+void
+__imlib_ColorAdjustSetup(ImlibColorAdjust *ca, int mode,
+                         float hue, float sat, float lum)
+{
+    double          h;
+
+    ca->mode = mode;
+    h = isfinite(hue) ? fmod(hue, 360) : 0;
+    ca->hue = (int)lround(h * ADJ_HUE_ONE / 60);
+    if (ca->hue < 0)
+        ca->hue += 6 * ADJ_HUE_ONE;
+    if (ca->hue >= 6 * ADJ_HUE_ONE)
+        ca->hue -= 6 * ADJ_HUE_ONE;
+    ca->sat = __adj_factor(sat);
+    ca->lum = __adj_factor(lum);
+}
+
+typedef struct {
+    uint32_t       *data;
+    int             w, stride;
+    const ImlibColorAdjust *ca;
+    ImlibColorAdjustFunction span;
+} ImlibColorAdjustJob;
+
+static void
+__color_adjust_rows(void *data, int y0, int y1)
+{
+    ImlibColorAdjustJob *aj = data;
+    int             y;
+
+    for (y = y0; y < y1; y++)
+        aj->span(aj->data + (size_t)y * aj->stride, aj->w, aj->ca);
+}
+
+void
+__imlib_DataColorAdjust(uint32_t *data, int w, int h, int jump,
+                        const ImlibColorAdjust *ca)
+{
+    ImlibColorAdjustJob aj;
+
+    if (w <= 0 || h <= 0)
+        return;
+
+    aj.data = data;
+    aj.w = w;
+    aj.stride = w + jump;
+    aj.ca = ca;
+    aj.span = __color_adjust_span_function();
+
+    __imlib_ParallelFor(h, ADJ_ROWS_MIN(w), __color_adjust_rows, &aj);
+}
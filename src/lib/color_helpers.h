@@ -1,6 +1,8 @@
 #ifndef __COLOR_HELPERS
 #define __COLOR_HELPERS 1
 
+#include "types.h"
+
 void            __imlib_rgb_to_hsv(int r, int g, int b, float *hue,
                                    float *saturation, float *value);
 void            __imlib_hsv_to_rgb(float hue, float saturation, float value,
@@ -10,4 +12,46 @@ void            __imlib_rgb_to_hls(int r, int g, int b, float *hue,
 void            __imlib_hls_to_rgb(float hue, float lightness,
                                    float saturation, int *r, int *g, int *b);
 
+/*
+ * Whole row colour adjustments
+ *
+ * Done in fixed point, hues in sixths of the colour circle (60 degrees),
+ * so the C and vector kernels give the same results.
+ */
+#define ADJ_HUE_ONE     1024    /* Hue sector (60 degrees) */
+#define ADJ_HUE_BITS    10
+#define ADJ_SAT_ONE     4096    /* Saturation 1 */
+#define ADJ_SAT_BITS    12
+#define ADJ_FAC_ONE     256     /* Factor 1 */
+#define ADJ_FAC_BITS    8
+
+enum {
+    COLOR_ADJUST_HSV,
+    COLOR_ADJUST_HLS,
+    COLOR_ADJUST_GRAY,
+};
+
+typedef struct {
+    int             mode;       /* COLOR_ADJUST_* */
+    int             hue;        /* Hue rotation, [0, 6 * ADJ_HUE_ONE) */
+    int             sat;        /* Saturation factor, ADJ_FAC_ONE = 1 */
+    int             lum;        /* Value or lightness factor */
+} ImlibColorAdjust;
+
+/* Adjust len pixels at p */
+typedef void    (*ImlibColorAdjustFunction)(uint32_t * p, int len,
+                                            const ImlibColorAdjust * ca);
+
+void            __imlib_ColorAdjustSetup(ImlibColorAdjust * ca, int mode,
+                                         float hue, float sat, float lum);
+void            __imlib_DataColorAdjust(uint32_t * data, int w, int h,
+                                        int jump, const ImlibColorAdjust * ca);
+
+#if DO_AMD64_ASM
+void            __imlib_color_adjust_span_avx2(uint32_t * p, int len,
+                                               const ImlibColorAdjust * ca);
+void            __imlib_color_adjust_span_avx512(uint32_t * p, int len,
+                                                 const ImlibColorAdjust * ca);
+#endif
+
 #endif
@@ -4,11 +4,26 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "asm_c.h"
 #include "colormod.h"
 #include "image.h"
+#include "threads.h"
+
+#define CMOD_ROWS_MIN(w) (1 + 65536 / (w))
 
 static uint64_t mod_count = 0;
 
+static bool
+__cmod_is_identity(const uint8_t *map)
+{
+    int             i;
+
+    for (i = 0; i < 256; i++)
+        if (map[i] != i)
+            return false;
+    return true;
+}
+
 ImlibColorModifier *
 __imlib_CreateCmod(void)
 {
@@ -26,6 +41,7 @@ __imlib_CreateCmod(void)
         cm->blue_mapping[i] = (uint8_t) i;
         cm->alpha_mapping[i] = (uint8_t) i;
     }
+    cm->identity = CMOD_MAP_ALL;
     return cm;
 }
 
@@ -40,6 +56,14 @@ __imlib_CmodChanged(ImlibColorModifier *cm)
 {
     mod_count++;
     cm->modification_count = mod_count;
+
+    cm->identity = 0;
+    if (__cmod_is_identity(cm->red_mapping) &&
+        __cmod_is_identity(cm->green_mapping) &&
+        __cmod_is_identity(cm->blue_mapping))
+        cm->identity |= CMOD_MAP_RGB;
+    if (__cmod_is_identity(cm->alpha_mapping))
+        cm->identity |= CMOD_MAP_A;
 }
 
 void
@@ -77,46 +101,98 @@ __imlib_CmodReset(ImlibColorModifier *cm)
     __imlib_CmodChanged(cm);
 }
 
-void
-__imlib_DataCmodApply(uint32_t *data, int w, int h, int jump,
-                      bool has_alpha, ImlibColorModifier *cm)
+static void
+__cmod_span(uint32_t *p, int len, const ImlibColorModifier *cm, int map)
 {
-    int             x, y;
-    uint32_t       *p;
+    uint32_t       *end;
 
-    /* We might be adding alpha */
-    if (!has_alpha)
+    end = p + len;
+    switch (map)
     {
-        p = data;
-        for (y = 0; y < h; y++)
+    case CMOD_MAP_RGB:
+        for (; p < end; p++)
         {
-            for (x = 0; x < w; x++)
-            {
-                R_VAL(p) = R_CMOD(cm, R_VAL(p));
-                G_VAL(p) = G_CMOD(cm, G_VAL(p));
-                B_VAL(p) = B_CMOD(cm, B_VAL(p));
-                p++;
-            }
-            p += jump;
+            R_VAL(p) = R_CMOD(cm, R_VAL(p));
+            G_VAL(p) = G_CMOD(cm, G_VAL(p));
+            B_VAL(p) = B_CMOD(cm, B_VAL(p));
         }
-        return;
-    }
-
-    p = data;
-    for (y = 0; y < h; y++)
-    {
-        for (x = 0; x < w; x++)
+        break;
+    case CMOD_MAP_A:
+        for (; p < end; p++)
+            A_VAL(p) = A_CMOD(cm, A_VAL(p));
+        break;
+    case CMOD_MAP_ALL:
+        for (; p < end; p++)
         {
             R_VAL(p) = R_CMOD(cm, R_VAL(p));
             G_VAL(p) = G_CMOD(cm, G_VAL(p));
             B_VAL(p) = B_CMOD(cm, B_VAL(p));
             A_VAL(p) = A_CMOD(cm, A_VAL(p));
-            p++;
         }
-        p += jump;
+        break;
+    default:
+        break;
     }
 }
 
+static ImlibCmodSpanFunction
+__cmod_span_function(void)
+{
+#ifdef DO_AMD64_ASM
+    switch (__imlib_cpu_isa())
+    {
+    case ISA_AVX512:
+        if (__imlib_cpu_vbmi())
+            return __imlib_cmod_span_vbmi;
+        return __imlib_cmod_span_avx512;
+    case ISA_AVX2:
+        return __imlib_cmod_span_avx2;
+    default:
+        break;
+    }
+#endif
+    return __cmod_span;
+}
+
+typedef struct {
+    uint32_t       *data;
+    int             w, stride;
+    int             map;
+    const ImlibColorModifier *cm;
+    ImlibCmodSpanFunction span;
+} ImlibCmodJob;
+
+static void
+__cmod_rows(void *data, int y0, int y1)
+{
+    ImlibCmodJob   *cj = data;
+    int             y;
+
+    for (y = y0; y < y1; y++)
+        cj->span(cj->data + (size_t)y * cj->stride, cj->w, cj->cm, cj->map);
+}
+
+void
+__imlib_DataCmodApply(uint32_t *data, int w, int h, int jump,
+                      bool has_alpha, ImlibColorModifier *cm)
+{
+    ImlibCmodJob    cj;
+
+    /* Only map the channels that change.
+     * We might be adding alpha, so leave it alone without. */
+    cj.map = (has_alpha ? CMOD_MAP_ALL : CMOD_MAP_RGB) & ~cm->identity;
+    if (!cj.map || w <= 0 || h <= 0)
+        return;
+
+    cj.data = data;
+    cj.w = w;
+    cj.stride = w + jump;
+    cj.cm = cm;
+    cj.span = __cmod_span_function();
+
+    __imlib_ParallelFor(h, CMOD_ROWS_MIN(w), __cmod_rows, &cj);
+}
+
 void
 __imlib_CmodGetTables(ImlibColorModifier *cm, uint8_t *r, uint8_t *g,
                       uint8_t *b, uint8_t *a)
@@ -167,6 +243,7 @@ __imlib_CmodModBrightness(ImlibColorModifier *cm, double v)
             val2 = 255;
         cm->alpha_mapping[i] = (uint8_t) val2;
     }
+    __imlib_CmodChanged(cm);
 }
 
 void
@@ -204,6 +281,7 @@ __imlib_CmodModContrast(ImlibColorModifier *cm, double v)
             val2 = 255;
         cm->alpha_mapping[i] = (uint8_t) val2;
     }
+    __imlib_CmodChanged(cm);
 }
 
 void
@@ -243,6 +321,7 @@ __imlib_CmodModGamma(ImlibColorModifier *cm, double v)
             val2 = 255;
         cm->alpha_mapping[i] = (uint8_t) val2;
     }
+    __imlib_CmodChanged(cm);
 }
 
 #if 0
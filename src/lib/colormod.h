@@ -9,8 +9,18 @@ struct _ImlibColorModifier {
     uint8_t         blue_mapping[256];
     uint8_t         alpha_mapping[256];
     uint64_t        modification_count;
+    uint8_t         identity;   /* CMOD_MAP_* of the identity tables */
 };
 
+/* Channel sets, for identity flags and for what to map */
+#define CMOD_MAP_RGB 1
+#define CMOD_MAP_A   2
+#define CMOD_MAP_ALL (CMOD_MAP_RGB | CMOD_MAP_A)
+
+/* The colour modifier, or NULL when it does not change anything */
+#define CMOD_ACTIVE(cm) \
+((cm) && (cm)->identity != CMOD_MAP_ALL ? (cm) : NULL)
+
 #define CMOD_APPLY_RGB(cm, r, g, b) \
 (r) = (cm)->red_mapping[(int)(r)]; \
 (g) = (cm)->green_mapping[(int)(g)]; \
@@ -55,4 +65,20 @@ void            __imlib_CmodGetTables(ImlibColorModifier * cm, uint8_t * r,
 void            __imlib_CmodModBrightness(ImlibColorModifier * cm, double v);
 void            __imlib_CmodModContrast(ImlibColorModifier * cm, double v);
 void            __imlib_CmodModGamma(ImlibColorModifier * cm, double v);
+
+/* Map the channels in map of len pixels at p */
+typedef void    (*ImlibCmodSpanFunction)(uint32_t * p, int len,
+                                         const ImlibColorModifier * cm,
+                                         int map);
+
+#if DO_AMD64_ASM
+void            __imlib_cmod_span_avx2(uint32_t * p, int len,
+                                       const ImlibColorModifier * cm, int map);
+void            __imlib_cmod_span_avx512(uint32_t * p, int len,
+                                         const ImlibColorModifier * cm,
+                                         int map);
+void            __imlib_cmod_span_vbmi(uint32_t * p, int len,
+                                       const ImlibColorModifier * cm, int map);
+#endif
+
 #endif
@@ -32,6 +32,26 @@ _debug_init(void)
     opt_fout = (p2) ? stderr : stdout;
 }
 
+__EXPORT__ void
+__imlib_printf(const char *pfx, const char *fmt, ...)
+{
+    char            fmtx[1024];
+    va_list         args;
+
+    va_start(args, fmt);
+
+    if (pfx)
+    {
+        snprintf(fmtx, sizeof(fmtx), "%-4s: %s", pfx, fmt);
+        fmt = fmtx;
+    }
+    vfprintf(opt_fout, fmt, args);
+
+    va_end(args);
+}
+
+#endif                          /* IMLIB2_DEBUG */
+
 #if USE_MONOTONIC_CLOCK
 #include <time.h>
 #else
@@ -56,26 +76,6 @@ __imlib_time_us(void)
 #endif
 }
 
-__EXPORT__ void
-__imlib_printf(const char *pfx, const char *fmt, ...)
-{
-    char            fmtx[1024];
-    va_list         args;
-
-    va_start(args, fmt);
-
-    if (pfx)
-    {
-        snprintf(fmtx, sizeof(fmtx), "%-4s: %s", pfx, fmt);
-        fmt = fmtx;
-    }
-    vfprintf(opt_fout, fmt, args);
-
-    va_end(args);
-}
-
-#endif                          /* IMLIB2_DEBUG */
-
 __EXPORT__ void
 __imlib_perror(const char *pfx, const char *fmt, ...)
 {
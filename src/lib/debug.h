@@ -21,8 +21,6 @@ extern unsigned int __imlib_debug;
 
 __PRINTF_2__ void __imlib_printf(const char *pfx, const char *fmt, ...);
 
-unsigned int    __imlib_time_us(void);
-
 #else
 
 #define D(fmt...)
@@ -35,4 +33,6 @@ unsigned int    __imlib_time_us(void);
 
 __PRINTF_2__ void __imlib_perror(const char *pfx, const char *fmt, ...);
 
+unsigned int    __imlib_time_us(void);
+
 #endif                          /* IMLIB2_DEDUG_H */
@@ -242,6 +242,60 @@ __imlib_SimpleLine_DrawToData(int x0, int y0, int x1, int y1, uint32_t color,
     return 1;
 }
 
+/* Minor coordinate offset at walk position v (16.16), as the walks compute it */
+static inline int
+__line_minor(int v, int a_a)
+{
+    int             m;
+
+    m = v >> 16;
+    if (!a_a)
+        m += (v - (m << 16)) >> 15;
+
+    return m;
+}
+
+/*
+ * First step k in [k0 .. k1] at which the minor coordinate of a line walk,
+ * m0 + __line_minor(k * dmm), is inside [lo .. hi], -1 if there is none.
+ * The minor coordinate is monotonic along the walk, so the first visible
+ * pixel is found exactly and clipping never shifts the line.
+ */
+static int
+__line_first_step(int k0, int k1, int m0, int dmm, int lo, int hi, int a_a)
+{
+    int             m, k, kmax;
+
+    if (k0 > k1)
+        return -1;
+    kmax = k1;
+
+    m = m0 + __line_minor(k0 * dmm, a_a);
+    if (m >= lo && m <= hi)
+        return k0;
+    if ((dmm >= 0 && m > hi) || (dmm <= 0 && m < lo))
+        return -1;
+
+    /* Invariant: k0 is before the clip range */
+    while (k0 < k1)
+    {
+        k = k0 + (k1 - k0 + 1) / 2;
+        m = m0 + __line_minor(k * dmm, a_a);
+        if ((dmm > 0 && m < lo) || (dmm < 0 && m > hi))
+            k0 = k;
+        else
+            k1 = k - 1;
+    }
+    k = k0 + 1;
+    if (k > kmax)
+        return -1;
+    m = m0 + __line_minor(k * dmm, a_a);
+    if (m < lo || m > hi)
+        return -1;
+
+    return k;
+}
+
 #define SETUP_LINE_SHALLOW() \
 do { \
     if (x0 > x1)                                    \
@@ -251,10 +305,6 @@ do { \
         dy = -dy;                                   \
     }                                               \
                                                     \
-    px = x0;                                        \
-    py = y0;                                        \
-                                                    \
-    p0_in = (IN_RANGE(x0 ,y0 , clw, clh) ? 1 : 0);  \
     p1_in = (IN_RANGE(x1 ,y1 , clw, clh) ? 1 : 0);  \
                                                     \
     dely = 1;                                       \
@@ -267,53 +317,18 @@ do { \
                                                     \
     dyy = (dy << 16) / dx;                          \
                                                     \
-    if (!p0_in)                                     \
-    {                                               \
-        dxx = (dx << 16) / dy;                      \
-        if (px < 0)                                 \
-        {                                           \
-            x = -px;  px = 0;                       \
-            yy = x * dyy;                           \
-            y = yy >> 16;                           \
-                if (!a_a)                           \
-                    y += (yy - (y << 16)) >> 15;    \
-            py += y;                                \
-            if ((dely > 0) && (py >= clh))          \
-                return 0;                           \
-            else if ((dely < 0) && (py < -1))       \
-                return 0;                           \
-        }                                           \
-                                                    \
-        y = 0;                                      \
-        if ((dely > 0) && (py < -1))                \
-            y = (-1 - py);                          \
-        else if ((dely < 0) && (py >= clh))         \
-            y = (clh - 1 - py);                     \
+    x = __line_first_step(MAX(0, -x0), MIN(x1, clw - 1) - x0, \
+                          y0, dyy, -a_a, clh - 1, a_a);       \
+    if (x < 0)                                      \
+        return 0;                                   \
                                                     \
-        xx = y * dxx;                               \
-        x = xx >> 16;                               \
-        if (!a_a)                                   \
-            x += (xx - (x << 16)) >> 15;            \
-        px += x;                                    \
-        if (px >= clw) return 0;                    \
-                                                    \
-        yy = x * dyy;                               \
-        y = yy >> 16;                               \
-        if (!a_a)                                   \
-            y += (yy - (y << 16)) >> 15;            \
-        py += y;                                    \
-        if ((dely > 0) && (py >= clh))              \
-            return 0;                               \
-        else if ((dely < 0) && (py < -1))           \
-            return 0;                               \
-    }                                               \
+    yy = x * dyy;                                   \
+    prev_y = __line_minor(yy, a_a);                 \
+    px = x0 + x;                                    \
+    py = y0 + prev_y;                               \
                                                     \
     p = dst + (dstw * py) + px;                     \
                                                     \
-    x = px - x0;                                    \
-    yy = x * dyy;                                   \
-    prev_y = (yy >> 16);                            \
-                                                    \
     rx = MIN(x1 + 1, clw);                          \
     by = clh - 1;                                   \
 } while (0)
@@ -322,71 +337,31 @@ do { \
 do { \
     if (y0 > y1)                                    \
     {                                               \
-    EXCHANGE_POINTS(x0, y0, x1, y1);                \
-    dx = -dx;                                       \
-    dy = -dy;                                       \
+        EXCHANGE_POINTS(x0, y0, x1, y1);            \
+        dx = -dx;                                   \
+        dy = -dy;                                   \
     }                                               \
                                                     \
-    px = x0;                                        \
-    py = y0;                                        \
-                                                    \
-    p0_in = (IN_RANGE(x0 ,y0 , clw, clh) ? 1 : 0);  \
     p1_in = (IN_RANGE(x1 ,y1 , clw, clh) ? 1 : 0);  \
                                                     \
     delx = 1;                                       \
     if (dx < 0)                                     \
-    delx = -1;                                      \
+        delx = -1;                                  \
                                                     \
     dxx = (dx << 16) / dy;                          \
                                                     \
-    if (!p0_in)                                     \
-    {                                               \
-        dyy = (dy << 16) / dx;                      \
-                                                    \
-        if (py < 0)                                 \
-        {                                           \
-            y = -py;  py = 0;                       \
-            xx = y * dxx;                           \
-            x = xx >> 16;                           \
-            if (!a_a)                               \
-                x += (xx - (x << 16)) >> 15;        \
-            px += x;                                \
-            if ((delx > 0) && (px >= clw))          \
-                return 0;                           \
-            else if ((delx < 0) && (px < -1))       \
-                return 0;                           \
-      }                                             \
-                                                    \
-    x = 0;                                          \
-    if ((delx > 0) && (px < -1))                    \
-        x = (-1 - px);                              \
-    else if ((delx < 0) && (px >= clw))             \
-        x = (clw - 1 - px);                         \
-                                                    \
-    yy = x * dyy;                                   \
-    y = yy >> 16;                                   \
-    if (!a_a)                                       \
-        y += (yy - (y << 16)) >> 15;                \
-    py += y;                                        \
-    if (py >= clh) return 0;                        \
+    y = __line_first_step(MAX(0, -y0), MIN(y1, clh - 1) - y0, \
+                          x0, dxx, -a_a, clw - 1, a_a);       \
+    if (y < 0)                                      \
+        return 0;                                   \
                                                     \
     xx = y * dxx;                                   \
-    x = xx >> 16;                                   \
-        if (!a_a)                                   \
-            x += (xx - (x << 16)) >> 15;            \
-    px += x;                                        \
-    if ((delx > 0) && (px >= clw))                  \
-       return 0;                                    \
-    else if ((delx < 0) && (px < -1))               \
-       return 0;                                    \
-    }                                               \
+    prev_x = __line_minor(xx, a_a);                 \
+    px = x0 + prev_x;                               \
+    py = y0 + y;                                    \
                                                     \
     p = dst + (dstw * py) + px;                     \
                                                     \
-    y = py - y0;                                    \
-    xx = y * dxx;                                   \
-    prev_x = (xx >> 16);                            \
-                                                    \
     by = MIN(y1 + 1, clh);                          \
     rx = clw - 1;                                   \
 } while (0)
@@ -399,7 +374,7 @@ __imlib_Line_DrawToData(int x0, int y0, int x1, int y1, uint32_t color,
 {
     ImlibPointDrawFunction pfunc;
     int             px, py, x, y, prev_x, prev_y;
-    int             dx, dy, rx, by, p0_in, p1_in, dh, a_a = 0;
+    int             dx, dy, rx, by, p1_in, dh, a_a = 0;
     int             delx, dely, xx, yy, dxx, dyy;
     uint32_t       *p;
 
@@ -514,7 +489,7 @@ __imlib_Line_DrawToData_AA(int x0, int y0, int x1, int y1, uint32_t color,
 {
     ImlibPointDrawFunction pfunc;
     int             px, py, x, y, prev_x, prev_y;
-    int             dx, dy, rx, by, p0_in, p1_in, dh, a_a = 1;
+    int             dx, dy, rx, by, p1_in, dh, a_a = 1;
     int             delx, dely, xx, yy, dxx, dyy;
     uint32_t       *p;
     uint8_t         ca = A_VAL(&color);
@@ -686,11 +661,12 @@ __imlib_Line_DrawToImage(int x0, int y0, int x1, int y1, uint32_t color,
     if (clw <= 0 || clh <= 0)
         return NULL;
 
-    if ((x0 < clx) && (x1 < clx))
+    /* Anti-aliased lines also cover the pixels right of/below the walk */
+    if ((x0 < clx - anti_alias) && (x1 < clx - anti_alias))
         return NULL;
     if ((x0 >= (clx + clw)) && (x1 >= (clx + clw)))
         return NULL;
-    if ((y0 < cly) && (y1 < cly))
+    if ((y0 < cly - anti_alias) && (y1 < cly - anti_alias))
         return NULL;
     if ((y0 >= (cly + clh)) && (y1 >= (cly + clh)))
         return NULL;
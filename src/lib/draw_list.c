@@ -0,0 +1,635 @@
+#include "common.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "blend.h"
+#include "image.h"
+#include "rgbadraw.h"
+#include "span.h"
+#include "threads.h"
+
+/*
+ * Display lists
+ *
+ * Primitives are recorded with their color and drawing mode, and drawn in
+ * one go. The clip area is split into bands of rows, each primitive is
+ * listed in the bands it touches (in recording order), and the bands are
+ * drawn in parallel. Every pixel belongs to one band, so it sees the same
+ * operations in the same order as when drawing the primitives one by one.
+ *
+ * This requires the rasterizers to produce the same pixels whatever the
+ * clip rectangle is. All do, except the anti-aliased polygon outline,
+ * which is drawn on its own (in order) when it spans more than one band.
+ */
+
+#define DL_BAND_ROWS_MIN    16  /* Minimum band height */
+
+enum {
+    DL_POINT,
+    DL_LINE,
+    DL_RECT_DRAW,
+    DL_RECT_FILL,
+    DL_ELLIPSE_DRAW,
+    DL_ELLIPSE_FILL,
+    DL_POLY_DRAW,
+    DL_POLY_FILL,
+};
+
+typedef struct {
+    uint8_t         type;
+    uint8_t         op;
+    uint8_t         blend;
+    uint8_t         anti_alias;
+    uint8_t         cap;
+    uint32_t        color;
+    int             v[4];       /* Coordinates, sizes, closed flag */
+    double          width;      /* Line width, 0 for thin lines */
+    ImlibPoly      *poly;
+    int             x0, y0, x1, y1;     /* Touched area, inclusive */
+} DrawListCmd;
+
+struct _ImlibDrawList {
+    DrawListCmd    *cmds;
+    int             num, alloc;
+};
+
+/* Span functions, resolved when op or blending changes */
+typedef struct {
+    int             key;
+    ImlibPointDrawFunction pfunc;
+    ImlibSpanDrawFunction sfunc;
+} DrawListFuncs;
+
+typedef struct {
+    const ImlibDrawList *dl;
+    ImlibImage     *im;
+    int             clx, cly, clw, clh;
+    int             band_h;
+    const int      *first;      /* Per band index into cmd, nbands + 1 */
+    const int      *cmd;        /* Command indices, grouped by band */
+} DrawListJob;
+
+ImlibDrawList  *
+__imlib_DrawListNew(void)
+{
+    return calloc(1, sizeof(ImlibDrawList));
+}
+
+void
+__imlib_DrawListClear(ImlibDrawList *dl)
+{
+    int             i;
+
+    for (i = 0; i < dl->num; i++)
+    {
+        if (dl->cmds[i].poly)
+            __imlib_polygon_free(dl->cmds[i].poly);
+    }
+    dl->num = 0;
+}
+
+void
+__imlib_DrawListFree(ImlibDrawList *dl)
+{
+    __imlib_DrawListClear(dl);
+    free(dl->cmds);
+    free(dl);
+}
+
+static DrawListCmd *
+__dl_add(ImlibDrawList *dl, int type, uint32_t color, ImlibOp op,
+         char blend, char anti_alias)
+{
+    DrawListCmd    *cmd;
+    int             n;
+
+    if (dl->num >= dl->alloc)
+    {
+        n = dl->alloc ? 2 * dl->alloc : 64;
+        cmd = realloc(dl->cmds, n * sizeof(DrawListCmd));
+        if (!cmd)
+            return NULL;
+        dl->cmds = cmd;
+        dl->alloc = n;
+    }
+
+    cmd = &dl->cmds[dl->num++];
+    cmd->type = type;
+    cmd->op = op;
+    cmd->blend = blend;
+    cmd->anti_alias = anti_alias;
+    cmd->color = color;
+    cmd->poly = NULL;
+    cmd->width = 0;
+    cmd->cap = 0;
+
+    return cmd;
+}
+
+void
+__imlib_DrawListAddPoint(ImlibDrawList *dl, int x, int y, uint32_t color,
+                         ImlibOp op, char blend)
+{
+    DrawListCmd    *cmd;
+
+    cmd = __dl_add(dl, DL_POINT, color, op, blend, 0);
+    if (!cmd)
+        return;
+
+    cmd->v[0] = cmd->x0 = cmd->x1 = x;
+    cmd->v[1] = cmd->y0 = cmd->y1 = y;
+}
+
+void
+__imlib_DrawListAddLine(ImlibDrawList *dl, int x0, int y0, int x1, int y1,
+                        double width, int cap, uint32_t color, ImlibOp op,
+                        char blend, char anti_alias)
+{
+    DrawListCmd    *cmd;
+    int             e;
+
+    cmd = __dl_add(dl, DL_LINE, color, op, blend, anti_alias);
+    if (!cmd)
+        return;
+
+    cmd->v[0] = x0;
+    cmd->v[1] = y0;
+    cmd->v[2] = x1;
+    cmd->v[3] = y1;
+    /* Anti-aliased lines also cover the pixels right of/below the walk,
+     * wide lines reach out up to width / sqrt(2) with square caps */
+    e = 0;
+    if (width > 0)
+    {
+        cmd->width = MIN(width, 65536);
+        cmd->cap = cap;
+        e = ceil(cmd->width * M_SQRT1_2) + 1;
+    }
+    cmd->x0 = MIN(x0, x1) - e;
+    cmd->y0 = MIN(y0, y1) - e;
+    cmd->x1 = MAX(x0, x1) + 1 + e;
+    cmd->y1 = MAX(y0, y1) + 1 + e;
+}
+
+void
+__imlib_DrawListAddRectangle(ImlibDrawList *dl, int x, int y, int w, int h,
+                             char fill, uint32_t color, ImlibOp op,
+                             char blend)
+{
+    DrawListCmd    *cmd;
+
+    cmd = __dl_add(dl, fill ? DL_RECT_FILL : DL_RECT_DRAW, color, op, blend,
+                   0);
+    if (!cmd)
+        return;
+
+    cmd->v[0] = x;
+    cmd->v[1] = y;
+    cmd->v[2] = w;
+    cmd->v[3] = h;
+    /* Degenerate rectangles are drawn as lines from (x, y) */
+    cmd->x0 = MIN(x, x + w - 1);
+    cmd->y0 = MIN(y, y + h - 1);
+    cmd->x1 = MAX(x, x + w - 1);
+    cmd->y1 = MAX(y, y + h - 1);
+}
+
+void
+__imlib_DrawListAddEllipse(ImlibDrawList *dl, int xc, int yc, int a, int b,
+                           char fill, double width, uint32_t color,
+                           ImlibOp op, char blend, char anti_alias)
+{
+    DrawListCmd    *cmd;
+    int             e;
+
+    cmd = __dl_add(dl, fill ? DL_ELLIPSE_FILL : DL_ELLIPSE_DRAW, color, op,
+                   blend, anti_alias);
+    if (!cmd)
+        return;
+
+    cmd->v[0] = xc;
+    cmd->v[1] = yc;
+    cmd->v[2] = a;
+    cmd->v[3] = b;
+    a = abs(a);
+    b = abs(b);
+    if (a > 65535)
+        a = 65535;
+    if (b > 65535)
+        b = 65535;
+    e = 2;
+    if (!fill && width > 0)
+    {
+        cmd->width = MIN(width, 65536);
+        e += ceil(cmd->width / 2);
+    }
+    cmd->x0 = xc - a - e;
+    cmd->y0 = yc - b - e;
+    cmd->x1 = xc + a + e;
+    cmd->y1 = yc + b + e;
+}
+
+void
+__imlib_DrawListAddPolygon(ImlibDrawList *dl, const ImlibPoly *poly,
+                           char closed, char fill, uint32_t color,
+                           ImlibOp op, char blend, char anti_alias)
+{
+    DrawListCmd    *cmd;
+    ImlibPoly      *copy;
+
+    if (poly->pointcount < 1)
+        return;
+
+    copy = __imlib_polygon_copy(poly);
+    if (!copy)
+        return;
+
+    cmd = __dl_add(dl, fill ? DL_POLY_FILL : DL_POLY_DRAW, color, op,
+                   blend, anti_alias);
+    if (!cmd)
+    {
+        __imlib_polygon_free(copy);
+        return;
+    }
+
+    cmd->poly = copy;
+    cmd->v[0] = closed;
+    cmd->x0 = copy->lx - 1;
+    cmd->y0 = copy->ty - 1;
+    cmd->x1 = copy->rx + 1;
+    cmd->y1 = copy->by + 1;
+}
+
+/* Whether drawing with a band clip gives the same pixels in the band */
+static int
+__dl_band_invariant(const DrawListCmd *cmd)
+{
+    return !(cmd->type == DL_POLY_DRAW && cmd->anti_alias);
+}
+
+static void
+__dl_funcs(DrawListFuncs *df, const DrawListCmd *cmd, char dst_alpha)
+{
+    int             blend, key;
+
+    blend = cmd->blend && A_VAL(&cmd->color) != 0xff;
+    key = (cmd->op << 1) | blend;
+    if (key == df->key)
+        return;
+
+    df->key = key;
+    df->pfunc = __imlib_GetPointDrawFunction(cmd->op, dst_alpha, blend);
+    df->sfunc = __imlib_GetSpanDrawFunction(cmd->op, dst_alpha, blend);
+}
+
+static void
+__dl_draw(const DrawListCmd *cmd, DrawListFuncs *df, ImlibImage *im,
+          int clx, int cly, int clw, int clh)
+{
+    uint32_t        color = cmd->color;
+    uint32_t       *p;
+    int             x, y, x1, y1;
+
+    if (cmd->blend && !A_VAL(&color))
+        return;
+
+    switch (cmd->type)
+    {
+    case DL_LINE:
+        if (cmd->width > 0)
+        {
+            (void)__imlib_Line_StrokeToImage(cmd->v[0], cmd->v[1],
+                                             cmd->v[2], cmd->v[3],
+                                             cmd->width, cmd->cap, color, im,
+                                             clx, cly, clw, clh, cmd->op,
+                                             cmd->blend, cmd->anti_alias, 0);
+            break;
+        }
+        x = cmd->v[0];
+        y = cmd->v[1];
+        x1 = cmd->v[2];
+        y1 = cmd->v[3];
+        if (y == y1)
+        {
+            /* Horizontal (and single point) */
+            if (x > x1)
+            {
+                x = x1;
+                x1 = cmd->v[0];
+            }
+            if (x < clx)
+                x = clx;
+            if (x1 > clx + clw - 1)
+                x1 = clx + clw - 1;
+            if (x > x1 || !IN_SEGMENT(y, cly, clh))
+                break;
+            __dl_funcs(df, cmd, im->has_alpha);
+            if (df->sfunc)
+                df->sfunc(color, im->data + im->w * y + x, x1 - x + 1);
+            break;
+        }
+        if (x == x1)
+        {
+            /* Vertical */
+            if (y > y1)
+            {
+                y = y1;
+                y1 = cmd->v[1];
+            }
+            if (y < cly)
+                y = cly;
+            if (y1 > cly + clh - 1)
+                y1 = cly + clh - 1;
+            if (y > y1 || !IN_SEGMENT(x, clx, clw))
+                break;
+            __dl_funcs(df, cmd, im->has_alpha);
+            if (!df->pfunc)
+                break;
+            for (p = im->data + im->w * y + x; y <= y1; y++, p += im->w)
+                df->pfunc(color, p);
+            break;
+        }
+        (void)__imlib_Line_DrawToImage(x, y, x1, y1, color, im,
+                                       clx, cly, clw, clh, cmd->op,
+                                       cmd->blend, cmd->anti_alias, 0);
+        break;
+
+    case DL_POINT:
+        x = cmd->v[0];
+        y = cmd->v[1];
+        if (!IN_RECT(x, y, clx, cly, clw, clh))
+            break;
+        __dl_funcs(df, cmd, im->has_alpha);
+        if (df->pfunc)
+            df->pfunc(color, im->data + im->w * y + x);
+        break;
+
+    case DL_RECT_FILL:
+        if (cmd->v[2] == 1 || cmd->v[3] == 1)
+        {
+            __imlib_Rectangle_FillToImage(cmd->v[0], cmd->v[1],
+                                          cmd->v[2], cmd->v[3], color, im,
+                                          clx, cly, clw, clh, cmd->op,
+                                          cmd->blend);
+            break;
+        }
+        x = cmd->v[0];
+        y = cmd->v[1];
+        x1 = cmd->v[2];
+        y1 = cmd->v[3];
+        CLIP(x, y, x1, y1, clx, cly, clw, clh);
+        if (x1 <= 0 || y1 <= 0)
+            break;
+        __dl_funcs(df, cmd, im->has_alpha);
+        if (!df->sfunc)
+            break;
+        for (p = im->data + im->w * y + x; y1--; p += im->w)
+            df->sfunc(color, p, x1);
+        break;
+
+    case DL_RECT_DRAW:
+        __imlib_Rectangle_DrawToImage(cmd->v[0], cmd->v[1],
+                                      cmd->v[2], cmd->v[3], color, im,
+                                      clx, cly, clw, clh, cmd->op, cmd->blend);
+        break;
+
+    case DL_ELLIPSE_DRAW:
+        if (cmd->width > 0)
+        {
+            __imlib_Arc_StrokeToImage(cmd->v[0], cmd->v[1],
+                                      cmd->v[2], cmd->v[3], 0, 360,
+                                      cmd->width, 0, color, im,
+                                      clx, cly, clw, clh, cmd->op,
+                                      cmd->blend, cmd->anti_alias);
+            break;
+        }
+        __imlib_Ellipse_DrawToImage(cmd->v[0], cmd->v[1],
+                                    cmd->v[2], cmd->v[3], color, im,
+                                    clx, cly, clw, clh, cmd->op, cmd->blend,
+                                    cmd->anti_alias);
+        break;
+
+    case DL_ELLIPSE_FILL:
+        __imlib_Ellipse_FillToImage(cmd->v[0], cmd->v[1],
+                                    cmd->v[2], cmd->v[3], color, im,
+                                    clx, cly, clw, clh, cmd->op, cmd->blend,
+                                    cmd->anti_alias);
+        break;
+
+    case DL_POLY_DRAW:
+        __imlib_Polygon_DrawToImage(cmd->poly, cmd->v[0], color, im,
+                                    clx, cly, clw, clh, cmd->op, cmd->blend,
+                                    cmd->anti_alias);
+        break;
+
+    case DL_POLY_FILL:
+        __imlib_Polygon_FillToImage(cmd->poly, color, im,
+                                    clx, cly, clw, clh, cmd->op, cmd->blend,
+                                    cmd->anti_alias);
+        break;
+    }
+}
+
+static void
+__dl_bands(void *data, int i0, int i1)
+{
+    const DrawListJob *job = data;
+    const DrawListCmd *cmd;
+    DrawListFuncs   df;
+    int             i, k, y0, y1;
+
+    df.key = -1;
+
+    for (i = i0; i < i1; i++)
+    {
+        y0 = job->cly + i * job->band_h;
+        y1 = MIN(y0 + job->band_h, job->cly + job->clh);
+
+        for (k = job->first[i]; k < job->first[i + 1]; k++)
+        {
+            cmd = &job->dl->cmds[job->cmd[k]];
+            /* Commands listed in a single band get the full clip */
+            if (__dl_band_invariant(cmd))
+                __dl_draw(cmd, &df, job->im, job->clx, y0, job->clw, y1 - y0);
+            else
+                __dl_draw(cmd, &df, job->im,
+                          job->clx, job->cly, job->clw, job->clh);
+        }
+    }
+}
+
+/* Get the bands [*b0 .. *b1] touched by cmd, 0 if none */
+static int
+__dl_cmd_bands(const DrawListJob *job, const DrawListCmd *cmd,
+               int *b0, int *b1)
+{
+    if (cmd->x1 < job->clx || cmd->x0 >= job->clx + job->clw ||
+        cmd->y1 < job->cly || cmd->y0 >= job->cly + job->clh)
+        return 0;
+
+    *b0 = (MAX(cmd->y0, job->cly) - job->cly) / job->band_h;
+    *b1 = (MIN(cmd->y1, job->cly + job->clh - 1) - job->cly) / job->band_h;
+
+    return 1;
+}
+
+/* Draw commands [i0 .. i1), all band invariant or within one band */
+static int
+__dl_draw_banded(DrawListJob *job, int nbands, int i0, int i1,
+                 int **pbuf, int *pbuf_size)
+{
+    int            *first, *pos, *buf;
+    int             i, b, b0, b1, n;
+
+    n = 0;
+    for (i = i0; i < i1; i++)
+    {
+        if (__dl_cmd_bands(job, &job->dl->cmds[i], &b0, &b1))
+            n += b1 - b0 + 1;
+    }
+    if (n == 0)
+        return 0;
+
+    /* Band starts, fill positions, command indices */
+    n += 2 * nbands + 1;
+    if (n > *pbuf_size)
+    {
+        buf = realloc(*pbuf, n * sizeof(int));
+        if (!buf)
+            return -1;
+        *pbuf = buf;
+        *pbuf_size = n;
+    }
+    first = *pbuf;
+    pos = first + nbands + 1;
+    buf = pos + nbands;
+
+    /* Count, then place command indices per band, keeping the order */
+    for (b = 0; b <= nbands; b++)
+        first[b] = 0;
+    for (i = i0; i < i1; i++)
+    {
+        if (!__dl_cmd_bands(job, &job->dl->cmds[i], &b0, &b1))
+            continue;
+        for (b = b0; b <= b1; b++)
+            first[b + 1]++;
+    }
+    for (b = 0; b < nbands; b++)
+    {
+        first[b + 1] += first[b];
+        pos[b] = first[b];
+    }
+    for (i = i0; i < i1; i++)
+    {
+        if (!__dl_cmd_bands(job, &job->dl->cmds[i], &b0, &b1))
+            continue;
+        for (b = b0; b <= b1; b++)
+            buf[pos[b]++] = i;
+    }
+
+    job->first = first;
+    job->cmd = buf;
+    __imlib_ParallelFor(nbands, 1, __dl_bands, job);
+
+    return 0;
+}
+
+void
+__imlib_DrawList_DrawToImage(const ImlibDrawList *dl, ImlibImage *im,
+                             int clx, int cly, int clw, int clh)
+{
+    const DrawListCmd *cmd;
+    DrawListJob     job;
+    DrawListFuncs   df;
+    int             i, i0, b0, b1, nbands, nthreads, buf_size;
+    int            *buf;
+
+    if (dl->num <= 0)
+        return;
+
+    if (clw == 0)
+    {
+        clx = cly = 0;
+        clw = im->w;
+        clh = im->h;
+    }
+    else
+    {
+        CLIP(clx, cly, clw, clh, 0, 0, im->w, im->h);
+    }
+    if (clw <= 0 || clh <= 0)
+        return;
+
+    /* Build shared tables before going parallel */
+    if (im->has_alpha)
+    {
+        for (i = 0; i < dl->num; i++)
+        {
+            if (dl->cmds[i].blend)
+            {
+                __imlib_build_pow_lut();
+                break;
+            }
+        }
+    }
+
+    nthreads = __imlib_ThreadCount();
+    nbands = nthreads > 1 ? 4 * nthreads : 1;
+    if (nbands > clh / DL_BAND_ROWS_MIN)
+        nbands = clh / DL_BAND_ROWS_MIN;
+    if (nbands < 1)
+        nbands = 1;
+
+    job.dl = dl;
+    job.im = im;
+    job.clx = clx;
+    job.cly = cly;
+    job.clw = clw;
+    job.clh = clh;
+    job.band_h = (clh + nbands - 1) / nbands;
+    nbands = (clh + job.band_h - 1) / job.band_h;
+
+    if (nbands == 1)
+    {
+        df.key = -1;
+        for (i = 0; i < dl->num; i++)
+        {
+            cmd = &dl->cmds[i];
+            if (__dl_cmd_bands(&job, cmd, &b0, &b1))
+                __dl_draw(cmd, &df, im, clx, cly, clw, clh);
+        }
+        return;
+    }
+
+    /*
+     * Runs of commands that can be banded are drawn in parallel, the
+     * others are drawn on their own in between.
+     */
+    buf = NULL;
+    buf_size = 0;
+    df.key = -1;
+    for (i = 0; i < dl->num;)
+    {
+        for (i0 = i; i < dl->num; i++)
+        {
+            cmd = &dl->cmds[i];
+            if (__dl_band_invariant(cmd) ||
+                !__dl_cmd_bands(&job, cmd, &b0, &b1) || b0 == b1)
+                continue;
+            break;
+        }
+
+        if (i > i0 && __dl_draw_banded(&job, nbands, i0, i, &buf, &buf_size))
+        {
+            /* Out of memory - draw the run one by one */
+            for (; i0 < i; i0++)
+                __dl_draw(&dl->cmds[i0], &df, im, clx, cly, clw, clh);
+        }
+
+        if (i < dl->num)
+            __dl_draw(&dl->cmds[i++], &df, im, clx, cly, clw, clh);
+    }
+
+    free(buf);
+}
@@ -1,5 +1,6 @@
 #include "common.h"
 
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -20,32 +21,30 @@ __imlib_polygon_new(void)
     return poly;
 }
 
+static void     __poly_index_free(ImlibPolyIndex * pi);
+
 void
 __imlib_polygon_add_point(ImlibPoly *poly, int x, int y)
 {
-    if (!poly->points)
+    ImlibPoint     *points;
+    int             n = poly->pointcount;
+
+    /* The point array grows by doubling, it is full at powers of two */
+    if ((n & (n - 1)) == 0)
     {
-        poly->points = (ImlibPoint *) malloc(sizeof(ImlibPoint));
-        if (!poly->points)
+        points = realloc(poly->points, (n ? 2 * n : 1) * sizeof(ImlibPoint));
+        if (!points)
             return;
+        poly->points = points;
+    }
 
-        poly->pointcount++;
+    if (n == 0)
+    {
         poly->lx = poly->rx = x;
         poly->ty = poly->by = y;
     }
     else
     {
-        poly->pointcount++;
-        poly->points =
-            (ImlibPoint *) realloc(poly->points,
-                                   (poly->pointcount * sizeof(ImlibPoint)));
-
-        if (!poly->points)
-        {
-            poly->pointcount = 0;
-            return;
-        }
-
         if (x < poly->lx)
             poly->lx = x;
         if (poly->rx < x)
@@ -56,28 +55,43 @@ __imlib_polygon_add_point(ImlibPoly *poly, int x, int y)
             poly->by = y;
     }
 
-    poly->points[poly->pointcount - 1].x = x;
-    poly->points[poly->pointcount - 1].y = y;
+    poly->points[n].x = x;
+    poly->points[n].y = y;
+    poly->pointcount++;
+
+    __poly_index_free(poly->index);
+    poly->index = NULL;
 }
 
 void
 __imlib_polygon_free(ImlibPoly *poly)
 {
+    __poly_index_free(poly->index);
     free(poly->points);
     free(poly);
 }
 
-#define TRUE 1
-#define FALSE 0
+ImlibPoly      *
+__imlib_polygon_copy(const ImlibPoly *poly)
+{
+    ImlibPoly      *copy;
+    int             i;
+
+    copy = __imlib_polygon_new();
+    if (!copy)
+        return NULL;
 
-/* Check if p lies on segment [ s1, s2 ] given that
-      it lies on the line defined by s1 and s2. */
-#define __imlib_point_inside_segment(p_x, p_y, s1_x, s1_y, s2_x,s2_y) \
-    (s1_y != s2_y) ? (p_y <= MAX(s1_y, s2_y) && p_y >= MIN(s1_y, s2_y)) : \
-                     (p_x <= MAX(s1_x, s2_x) && p_x >= MIN(s1_x, s2_x))
+    for (i = 0; i < poly->pointcount; i++)
+        __imlib_polygon_add_point(copy, poly->points[i].x, poly->points[i].y);
+    if (copy->pointcount != poly->pointcount)
+    {
+        __imlib_polygon_free(copy);
+        return NULL;
+    }
+    copy->fill_rule = poly->fill_rule;
 
-#define __imlib_point_on_segment(p_x, p_y, s1_x, s1_y, s2_x, s2_y) \
-    __imlib_segments_intersect(p_x, p_y, p_x, p_y, s1_x, s1_y, s2_x, s2_y)
+    return copy;
+}
 
 void
 __imlib_polygon_get_bounds(ImlibPoly *poly, int *px1, int *py1, int *px2,
@@ -96,118 +110,227 @@ __imlib_polygon_get_bounds(ImlibPoly *poly, int *px1, int *py1, int *px2,
         *py2 = poly->by;
 }
 
-static double
-__imlib_point_delta_from_line(int p_x, int p_y, int s1_x, int s1_y, int s2_x,
-                              int s2_y)
+/* Edge bands for point queries.
+ * The y range of the polygon is split in bands, each listing the edges
+ * overlapping it, so a query only looks at the edges near its scanline. */
+#define POLY_INDEX_MIN  32      /* Points needed to bother */
+#define POLY_INDEX_SPAN 8       /* Max. band entries per edge, on average */
+#define POLY_INDEX_MAX  (1 << 24)       /* Max. band entries, else no index */
+
+typedef struct {
+    ImlibPoint      a, b;
+} PolyIndexEdge;
+
+struct _ImlibPolyIndex {
+    int             nbands;
+    int            *band;       /* First edge of each band, nbands + 1 */
+    PolyIndexEdge  *edges;
+};
+
+static int
+__poly_band(const ImlibPoly *poly, int nbands, int y)
 {
-    if (s2_x - s1_x == 0.0)
-        return p_x - s1_x;
-    else
+    return (int64_t)(y - poly->ty) * nbands / (poly->by - poly->ty + 1);
+}
+
+static int64_t
+__poly_index_entries(const ImlibPoly *poly, int nbands)
+{
+    const ImlibPoint *a, *b;
+    int64_t         n;
+    int             i;
+
+    for (i = n = 0; i < poly->pointcount; i++)
+    {
+        a = poly->points + i;
+        b = poly->points + (i + 1) % poly->pointcount;
+        n += __poly_band(poly, nbands, MAX(a->y, b->y)) -
+            __poly_band(poly, nbands, MIN(a->y, b->y)) + 1;
+    }
+
+    return n;
+}
+
+static ImlibPolyIndex *
+__poly_index_build(const ImlibPoly *poly)
+{
+    ImlibPolyIndex *pi;
+    const ImlibPoint *a, *b;
+    int64_t         nentries;
+    int             nbands, i, j, j0, j1;
+
+    /* About 4 edges per band, fewer bands if edges span too many.
+     * Edges spanning many bands can make up to about pointcount^2 / 4
+     * entries. */
+    nbands = MIN(poly->pointcount / 4, poly->by - poly->ty + 1);
+    for (;;)
+    {
+        nentries = __poly_index_entries(poly, nbands);
+        if (nbands == 1 ||
+            nentries <= (int64_t)POLY_INDEX_SPAN * poly->pointcount)
+            break;
+        nbands /= 2;
+    }
+    /* Too big, scan all edges */
+    if (nentries > POLY_INDEX_MAX)
+        return NULL;
+
+    pi = malloc(sizeof(ImlibPolyIndex));
+    if (!pi)
+        return NULL;
+    pi->nbands = nbands;
+    pi->band = calloc(nbands + 1, sizeof(int));
+    pi->edges = malloc(nentries * sizeof(PolyIndexEdge));
+    if (!pi->band || !pi->edges)
     {
-        double          m = (double)(s2_y - s1_y) / (double)(s2_x - s1_x);
+        __poly_index_free(pi);
+        return NULL;
+    }
 
-        return (p_y - s1_y - (double)(p_x - s1_x) * m);
+    /* Count per band, then place (band[j] ends up at the start of j) */
+    for (i = 0; i < poly->pointcount; i++)
+    {
+        a = poly->points + i;
+        b = poly->points + (i + 1) % poly->pointcount;
+        j1 = __poly_band(poly, nbands, MAX(a->y, b->y));
+        for (j = __poly_band(poly, nbands, MIN(a->y, b->y)); j <= j1; j++)
+            pi->band[j + 1]++;
+    }
+    for (j = 0; j < nbands; j++)
+        pi->band[j + 1] += pi->band[j];
+    for (i = 0; i < poly->pointcount; i++)
+    {
+        a = poly->points + i;
+        b = poly->points + (i + 1) % poly->pointcount;
+        j0 = __poly_band(poly, nbands, MIN(a->y, b->y));
+        j1 = __poly_band(poly, nbands, MAX(a->y, b->y));
+        for (j = j0; j <= j1; j++)
+        {
+            pi->edges[pi->band[j]].a = *a;
+            pi->edges[pi->band[j]].b = *b;
+            pi->band[j]++;
+        }
     }
+    for (j = nbands; j > 0; j--)
+        pi->band[j] = pi->band[j - 1];
+    pi->band[0] = 0;
+
+    return pi;
+}
+
+static void
+__poly_index_free(ImlibPolyIndex *pi)
+{
+    if (!pi)
+        return;
+    free(pi->band);
+    free(pi->edges);
+    free(pi);
+}
+
+/* Point (x, y) vs. edge a-b.
+ * Returns -1 if the point is on the edge, 1 if a ray from the point
+ * towards +x crosses the edge, 0 otherwise.
+ * Vertices on the ray count as above it, so the ray crosses a chain of
+ * edges through a vertex once, or not at all if it only touches it. */
+static int
+__poly_edge_test(const ImlibPoint *a, const ImlibPoint *b, int x, int y)
+{
+    int64_t         d;
+
+    if (x >= MIN(a->x, b->x) && x <= MAX(a->x, b->x) &&
+        y >= MIN(a->y, b->y) && y <= MAX(a->y, b->y) &&
+        (int64_t)(b->x - a->x) * (y - a->y) ==
+        (int64_t)(b->y - a->y) * (x - a->x))
+        return -1;
+
+    if ((a->y > y) == (b->y > y))
+        return 0;
+
+    /* Sign of (crossing x - x) * (b->y - a->y) */
+    d = (int64_t)(a->x - x) * (b->y - a->y) +
+        (int64_t)(y - a->y) * (b->x - a->x);
+
+    return (b->y > a->y) ? d > 0 : d < 0;
 }
 
 static unsigned char
-__imlib_segments_intersect(int r1_x, int r1_y, int r2_x, int r2_y, int s1_x,
-                           int s1_y, int s2_x, int s2_y)
+__poly_contains(ImlibPoly *poly, int x, int y)
 {
-    double          testS1R =
-        __imlib_point_delta_from_line(s1_x, s1_y, r1_x, r1_y, r2_x, r2_y);
-    double          testS2R =
-        __imlib_point_delta_from_line(s2_x, s2_y, r1_x, r1_y, r2_x, r2_y);
-    double          testR1S =
-        __imlib_point_delta_from_line(r1_x, r1_y, s1_x, s1_y, s2_x, s2_y);
-    double          testR2S =
-        __imlib_point_delta_from_line(r2_x, r2_y, s1_x, s1_y, s2_x, s2_y);
-
-    /* check if segments are collinear */
-    if (testS1R == 0.0 && testS2R == 0.0)
+    const PolyIndexEdge *e, *ee;
+    int             i, j, r, count;
+
+    if (x < poly->lx || x > poly->rx || y < poly->ty || y > poly->by)
+        return 0;
+
+    count = 0;
+    if (poly->index)
     {
-        if (__imlib_point_inside_segment(s1_x, s1_y, r1_x, r1_y, r2_x, r2_y) ||
-            __imlib_point_inside_segment(s2_x, s2_y, r1_x, r1_y, r2_x, r2_y) ||
-            __imlib_point_inside_segment(r1_x, r1_y, s1_x, s1_y, s2_x, s2_y) ||
-            __imlib_point_inside_segment(r2_x, r2_y, s1_x, s1_y, s2_x, s2_y))
-            return TRUE;
-        else
-            return FALSE;
+        j = __poly_band(poly, poly->index->nbands, y);
+        e = poly->index->edges + poly->index->band[j];
+        ee = poly->index->edges + poly->index->band[j + 1];
+        for (; e < ee; e++)
+        {
+            r = __poly_edge_test(&e->a, &e->b, x, y);
+            if (r < 0)
+                return 1;
+            count ^= r;
+        }
     }
-
-    if (testS1R * testS2R <= 0.0 && testR1S * testR2S <= 0.0)
-        return TRUE;
     else
-        return FALSE;
+    {
+        for (i = 0; i < poly->pointcount; i++)
+        {
+            j = (i < poly->pointcount - 1) ? i + 1 : 0;
+            r = __poly_edge_test(poly->points + i, poly->points + j, x, y);
+            if (r < 0)
+                return 1;
+            count ^= r;
+        }
+    }
+
+    return count;
+}
+
+static void
+__poly_prepare(ImlibPoly *poly)
+{
+    if (!poly->index && poly->pointcount >= POLY_INDEX_MIN)
+        poly->index = __poly_index_build(poly);
 }
 
 unsigned char
 __imlib_polygon_contains_point(ImlibPoly *poly, int x, int y)
 {
-    int             count = 0;
-    int             start = 0;
-    int             ysave = 0;  /* initial value arbitrary */
-    int             cx, nx, out_x, out_y, i, n;
-    int             curr_x, curr_y, next_x, next_y;
-
-    /* find a vertex of poly that does not lie on the test line */
-    while (start < poly->pointcount && poly->points[start].y == y)
-        start++;
-    /* if one doesn't exist we will use point on segment test
-     * and can start with vertex 0 anyway */
-    cx = start % poly->pointcount;
-
-    out_x = poly->points[0].x;
-    out_y = y;
-
-    for (i = 1; i < poly->pointcount; i++)
-    {
-        out_x = MAX(out_x, poly->points[i].x);
-    }
-    out_x++;                    /* out now guaranteed to be outside poly */
+    if (poly->pointcount < 1)
+        return 0;
 
-    for (n = 0; n < poly->pointcount; n++)
-    {
-        nx = (cx + 1) % poly->pointcount;
+    __poly_prepare(poly);
+
+    return __poly_contains(poly, x, y);
+}
 
-        curr_x = poly->points[cx].x;
-        curr_y = poly->points[cx].y;
-        next_x = poly->points[nx].x;
-        next_y = poly->points[nx].y;
+int
+__imlib_polygon_contains_points(ImlibPoly *poly, const int *xy, int n,
+                                unsigned char *inside)
+{
+    int             i, hits;
 
-        if (__imlib_point_on_segment(x, y, curr_x, curr_y, next_x, next_y))
-            return TRUE;
+    if (poly->pointcount < 1)
+    {
+        memset(inside, 0, n);
+        return 0;
+    }
 
-        /* ignore horizontal segments from this point on */
-        if (poly->points[cx].y != poly->points[nx].y)
-        {
-            if (__imlib_segments_intersect
-                (curr_x, curr_y, next_x, next_y, x, y, out_x, out_y))
-            {
-                count++;
+    __poly_prepare(poly);
 
-                if (__imlib_point_on_segment
-                    (next_x, next_y, x, y, out_x, out_y))
-                {
-                    /* current seg intersects test seg @ 2nd vtx
-                     * reset ysave */
-                    ysave = curr_y;
-                }
-                if (__imlib_point_on_segment(curr_x, curr_y, x, y,
-                                             out_x, out_y) &&
-                    ((ysave < y) != (next_y < y)))
-                {
-                    /* current seg xsects test seg @ 1st vtx and
-                     * ysave on opposite side of test line from
-                     * curr seg 2nd vtx;
-                     * decrement hits (2-1) for odd parity */
-                    count--;
-                }
-            }
-        }
-        cx = nx;
+    for (i = hits = 0; i < n; i++, xy += 2)
+    {
+        inside[i] = __poly_contains(poly, xy[0], xy[1]);
+        hits += inside[i];
     }
-    return (count % 2 == 1);
+
+    return hits;
 }
 
 /** Polygon Drawing and Filling **/
@@ -241,53 +364,74 @@ poly_value_sorter(const void *a, const void *b)
     return 1;
 }
 
+#define POLY_EDGE_LESS(p, q) \
+    (((p)->xx < (q)->xx) || (((p)->xx == (q)->xx) && ((p)->dxx < (q)->dxx)))
+
+/* Sort the active edges by x, then slope.
+ * The active edge table only changes a little from one scanline to the
+ * next, so this is close to linear. */
+static void
+poly_sort_edges(PolyEdge *edge, int nedges)
+{
+    PolyEdge        e;
+    int             i, j;
+
+    for (i = 1; i < nedges; i++)
+    {
+        if (!POLY_EDGE_LESS(edge + i, edge + i - 1))
+            continue;
+        e = edge[i];
+        for (j = i; (j > 0) && POLY_EDGE_LESS(&e, edge + j - 1); j--)
+            edge[j] = edge[j - 1];
+        edge[j] = e;
+    }
+}
+
+/* Drop the edges marked by DEL_EDGE(), keeping the order.
+ * Returns the number of edges left. */
 static int
-poly_edge_sorter(const void *a, const void *b)
+poly_purge_edges(PolyEdge *edge, int nedges, uint8_t *eactive, int *nhorz)
 {
-    PolyEdge       *p, *q;
+    int             i, n;
 
-    p = (PolyEdge *) a;
-    q = (PolyEdge *) b;
-    if (p->xx < q->xx)
-        return -1;
-    if (p->xx > q->xx)
-        return 1;
-    if (p->dxx <= q->dxx)
-        return -1;
-    return 1;
+    for (i = n = 0; i < nedges; i++)
+    {
+        if (eactive[edge[i].index] == 2)
+        {
+            eactive[edge[i].index] = 0;
+            if (edge[i].type == HORZ_EDGE)
+                (*nhorz)--;
+            continue;
+        }
+        if (n != i)
+            edge[n] = edge[i];
+        n++;
+    }
+
+    return n;
 }
 
 /* general macros */
 
+/* Edges are marked for deletion as vertices are passed, and dropped from
+ * the active edge table in one sweep per scanline, poly_purge_edges(). */
 #define DEL_EDGE(j) \
 do {                                                                    \
-    int m;                                                              \
-    for (m = 0; (m < nactive_edges) && (edge[m].index != (j)); m++);    \
-                                                                        \
-    if (m < nactive_edges)                                              \
-    {                                                                   \
-        if (edge[m].type == HORZ_EDGE) nactive_horz_edges--;            \
-        nactive_edges--;                                                \
-        memmove(edge + m, edge + m + 1,                                 \
-                (nactive_edges - m) * sizeof(PolyEdge));                \
-    }                                                                   \
+    if (eactive[j] == 1) eactive[j] = 2;                                \
 } while (0)
 
 #define DEL_HORZ_EDGES() \
 do {                                                                    \
-    int m = 0;                                                          \
+    int m, n;                                                           \
                                                                         \
-    while (m < nactive_edges)                                           \
+    for (m = n = 0; m < nactive_edges; m++)                             \
     {                                                                   \
         if (edge[m].type == HORZ_EDGE)                                  \
-        {                                                               \
-            nactive_edges--;                                            \
-            memmove(edge + m, edge + m + 1,                             \
-                    (nactive_edges - m) * sizeof(PolyEdge));            \
-            m--;                                                        \
-        }                                                               \
-        m++;                                                            \
+            eactive[edge[m].index] = 0;                                 \
+        else                                                            \
+            edge[n++] = edge[m];                                        \
     }                                                                   \
+    nactive_edges = n;                                                  \
     nactive_horz_edges = 0;                                             \
 } while (0)
 
@@ -295,10 +439,7 @@ do {                                                                    \
 do {                                                                    \
     int m;                                                              \
                                                                         \
-    for (m = 0; (m < nactive_edges) && (edge[m].index != i); m++);      \
-                                                                        \
-    if ((m == nactive_edges) && (i < nvertices) &&                      \
-        (nactive_edges < nvertices))                                    \
+    if ((i < nvertices) && !eactive[i] && (nactive_edges < nvertices))  \
     {                                                                   \
         ImlibPoint *v0, *v1, *w;                                        \
         PolyEdge *ne;                                                   \
@@ -346,6 +487,7 @@ do {                                                                    \
         }                                                               \
         ne->v0 = v0;                                                    \
         ne->v1 = v1;                                                    \
+        eactive[i] = 1;                                                 \
         nactive_edges++;                                                \
     }                                                                   \
 } while (0)
@@ -417,11 +559,14 @@ do { \
     ysort = (IndexedValue *)malloc(nvertices * sizeof(IndexedValue));   \
     if (!ysort) { free(edge); return; }                                 \
                                                                         \
+    eactive = (uint8_t *)calloc(nvertices, sizeof(uint8_t));            \
+    if (!eactive) { free(edge); free(ysort); return; }                  \
+                                                                        \
     s0 = (uint8_t *)malloc(clw * sizeof(uint8_t));                      \
-    if (!s0) { free(edge); free(ysort); return; }                       \
+    if (!s0) { free(edge); free(ysort); free(eactive); return; }        \
                                                                         \
     s1 = (uint8_t *)malloc(clw * sizeof(uint8_t));                      \
-    if (!s1) { free(edge); free(ysort); free(s0); return; }             \
+    if (!s1) { free(edge); free(ysort); free(eactive); free(s0); return; } \
                                                                         \
     memset(s0,0,clw);                                                   \
                                                                         \
@@ -461,6 +606,7 @@ do { \
 do { \
     free(edge);     \
     free(ysort);    \
+    free(eactive);  \
     s0 += clx;      \
     free(s0);       \
     s1 += clx;      \
@@ -481,6 +627,7 @@ __imlib_Polygon_DrawToData(ImlibPoly *poly, char close, uint32_t color,
     ImlibShapedSpanDrawFunction sfunc;
     IndexedValue   *ysort;
     PolyEdge       *edge;
+    uint8_t        *eactive;
     int             k, a_a = 0;
     int             nactive_edges, nactive_horz_edges, nvertices;
     int             clrx, clby, ty, by, y;
@@ -525,8 +672,10 @@ __imlib_Polygon_DrawToData(ImlibPoly *poly, char close, uint32_t color,
             k++;
         }
 
+        nactive_edges = poly_purge_edges(edge, nactive_edges, eactive,
+                                         &nactive_horz_edges);
         /* not really needed, but... */
-        qsort(edge, nactive_edges, sizeof(PolyEdge), poly_edge_sorter);
+        poly_sort_edges(edge, nactive_edges);
 
         /* clear alpha buffer */
         if (x0 <= x1)
@@ -720,6 +869,7 @@ __imlib_Polygon_DrawToData_AA(ImlibPoly *poly, char close, uint32_t color,
     ImlibShapedSpanDrawFunction sfunc;
     IndexedValue   *ysort;
     PolyEdge       *edge;
+    uint8_t        *eactive;
     int             k, a_a = 1;
     int             nactive_edges, nactive_horz_edges, nvertices;
     int             clrx, clby, ty, by, y, yy, prev_y, prev_yy;
@@ -768,8 +918,10 @@ __imlib_Polygon_DrawToData_AA(ImlibPoly *poly, char close, uint32_t color,
             k++;
         }
 
+        nactive_edges = poly_purge_edges(edge, nactive_edges, eactive,
+                                         &nactive_horz_edges);
         /* not really needed, but... */
-        qsort(edge, nactive_edges, sizeof(PolyEdge), poly_edge_sorter);
+        poly_sort_edges(edge, nactive_edges);
 
         /* clear alpha buffer */
         if (x0 <= x1)
@@ -1105,10 +1257,11 @@ __imlib_Polygon_FillToData(ImlibPoly *poly, uint32_t color,
     ImlibShapedSpanDrawFunction sfunc;
     IndexedValue   *ysort;
     PolyEdge       *edge;
+    uint8_t        *eactive;
     int             k, a_a = 0;
     int             nactive_edges, nactive_horz_edges, nvertices;
     int             clrx, clby, ty, by, y;
-    int             x0, x1, nx0, nx1;
+    int             x0, x1, nx0, nx1, hx0, hx1;
     uint32_t       *p;
     uint8_t        *s0, *s1, *ps;
 
@@ -1145,7 +1298,9 @@ __imlib_Polygon_FillToData(ImlibPoly *poly, uint32_t color,
             k++;
         }
 
-        qsort(edge, nactive_edges, sizeof(PolyEdge), poly_edge_sorter);
+        nactive_edges = poly_purge_edges(edge, nactive_edges, eactive,
+                                         &nactive_horz_edges);
+        poly_sort_edges(edge, nactive_edges);
 
         /* clear alpha buffer */
         if (x0 <= x1)
@@ -1155,6 +1310,8 @@ __imlib_Polygon_FillToData(ImlibPoly *poly, uint32_t color,
         x1 = nx1;
         nx0 = clrx + 1;
         nx1 = clx - 1;
+        hx0 = clrx + 1;
+        hx1 = clx - 1;
 
         /* draw to alpha buffer */
         j = 0;
@@ -1273,6 +1430,10 @@ __imlib_Polygon_FillToData(ImlibPoly *poly, uint32_t color,
                         memset(s0 + lx, 255, rx - lx + 1);
                         if (lx < x0)
                             x0 = lx;
+                        if (lx < hx0)
+                            hx0 = lx;
+                        if (rx > hx1)
+                            hx1 = rx;
                     }
                     le_rx++;
                     break;
@@ -1367,6 +1528,10 @@ __imlib_Polygon_FillToData(ImlibPoly *poly, uint32_t color,
                         memset(s0 + lx, 255, rx - lx + 1);
                         if (rx > x1)
                             x1 = rx;
+                        if (lx < hx0)
+                            hx0 = lx;
+                        if (rx > hx1)
+                            hx1 = rx;
                     }
                     re_lx--;
                     break;
@@ -1398,6 +1563,13 @@ __imlib_Polygon_FillToData(ImlibPoly *poly, uint32_t color,
         if ((x0 <= x1) && (y >= cly))
             sfunc(s0 + x0, color, p + x0, x1 - x0 + 1);
 
+        /* horizontal edges may have set pixels outside of the drawn span,
+         * include them in the range cleared before the buffer is reused */
+        if (hx0 < x0)
+            x0 = hx0;
+        if (hx1 > x1)
+            x1 = hx1;
+
         /* exchange alpha buffers */
         ps = s0;
         s0 = s1;
@@ -1410,387 +1582,423 @@ __imlib_Polygon_FillToData(ImlibPoly *poly, uint32_t color,
     DE_INIT_POLY();
 }
 
-/* anti-aliased filling */
+/* coverage filling */
+
+/* Polygon edge for the coverage filler, in pixel space where the vertices
+ * are at the pixel centers */
+typedef struct {
+    float           x0, y0;     /* Top */
+    float           y1;         /* Bottom */
+    float           dxdy;
+    float           dir;        /* 1: downwards, -1: upwards */
+} CovEdge;
+
+static int
+cov_edge_sorter(const void *a, const void *b)
+{
+    const CovEdge  *p = a, *q = b;
+
+    return (p->y0 > q->y0) - (p->y0 < q->y0);
+}
 
+/* Accumulate the signed area to the right of the segment from x0 to x1,
+ * spanning d of a scanline (negative when going up), into acc.
+ * The running sum over acc is the winding number weighted coverage of
+ * each pixel. x0 and x1 must be >= 0. */
 static void
-__imlib_Polygon_FillToData_AA(ImlibPoly *poly, uint32_t color,
-                              uint32_t *dst, int dstw,
-                              int clx, int cly, int clw, int clh,
-                              ImlibOp op, char dst_alpha, char blend)
+__cov_accumulate(float *acc, float x0, float x1, float d)
 {
-    ImlibShapedSpanDrawFunction sfunc;
-    IndexedValue   *ysort;
-    PolyEdge       *edge;
-    int             k, a_a = 1;
-    int             nactive_edges, nactive_horz_edges, nvertices;
-    int             clrx, clby, ty, by, y, yy, prev_y, prev_yy;
-    int             x0, x1, nx0, nx1;
-    uint32_t       *p;
-    uint8_t        *s0, *s1, *ps;
+    float           xl, xr, xm, s, f0, f1, a0, a1, am;
+    int             i0, i1, i;
 
-    INIT_POLY();
+    if (x0 < x1)
+    {
+        xl = x0;
+        xr = x1;
+    }
+    else
+    {
+        xl = x1;
+        xr = x0;
+    }
+    i0 = xl;
+    i1 = ceilf(xr);
 
-    yy = y << 16;
-    prev_y = y - 1;
-    prev_yy = prev_y << 16;
+    if (i1 <= i0 + 1)
+    {
+        /* Within one pixel */
+        xm = 0.5f * (x0 + x1) - i0;
+        acc[i0] += d - d * xm;
+        acc[i0 + 1] += d * xm;
+        return;
+    }
 
-    while (y <= by)
+    s = 1.0f / (xr - xl);
+    f0 = xl - i0;
+    a0 = 0.5f * s * (1.0f - f0) * (1.0f - f0);
+    f1 = xr - i1 + 1;
+    am = 0.5f * s * f1 * f1;
+
+    acc[i0] += d * a0;
+    if (i1 == i0 + 2)
     {
-        int             j;
+        acc[i0 + 1] += d * (1.0f - a0 - am);
+    }
+    else
+    {
+        a1 = s * (1.5f - f0);
+        acc[i0 + 1] += d * (a1 - a0);
+        for (i = i0 + 2; i < i1 - 1; i++)
+            acc[i] += d * s;
+        acc[i1 - 1] += d * (1.0f - a1 - (i1 - i0 - 3) * s - am);
+    }
+    acc[i1] += d * am;
+}
 
-        while ((k < nvertices) && (poly->points[ysort[k].index].y <= y))
-        {
-            int             i = ysort[k].index;
+/* Coverage for the accumulated signed area */
+static inline int
+__cov_alpha(float sum, int fill_rule, char anti_alias)
+{
+    float           c;
+    int             a;
 
-            if (i > 0)
-                j = i - 1;
-            else
-                j = nvertices - 1;
+    c = fabsf(sum);
+    if (fill_rule == POLY_FILL_EVEN_ODD)
+    {
+        c -= 2.0f * floorf(0.5f * c);
+        if (c > 1.0f)
+            c = 2.0f - c;
+    }
+    else if (c > 1.0f)
+    {
+        c = 1.0f;
+    }
+    a = c * 255.0f + 0.5f;
+    if (!anti_alias)
+        a = (a >= 128) ? 255 : 0;
 
-            if (poly->points[j].y < y)
-                DEL_EDGE(j);
-            else
-                ADD_EDGE(j);
+    return a;
+}
 
-            if (i < (nvertices - 1))
-                j = i + 1;
-            else
-                j = 0;
+/* Length of the run of v at cov, at most len, 8 bytes at a time */
+static inline int
+__cov_run(const uint8_t *cov, int len, uint8_t v)
+{
+    uint64_t        w, vv;
+    int             j;
 
-            if (poly->points[j].y < y)
-                DEL_EDGE(i);
-            else
-                ADD_EDGE(i);
+    vv = 0x0101010101010101ULL * v;
+    for (j = 0; j + 8 <= len; j += 8)
+    {
+        memcpy(&w, cov + j, 8);
+        if (w != vv)
+            break;
+    }
+    while ((j < len) && (cov[j] == v))
+        j++;
 
-            k++;
+    return j;
+}
+
+/* Draw a row of coverage values, full coverage runs as solid spans */
+static void
+__cov_draw(const uint8_t *cov, uint32_t color, uint32_t *dst, int len,
+           ImlibSpanDrawFunction func, ImlibShapedSpanDrawFunction sfunc)
+{
+    int             i, j;
+
+    for (i = 0; i < len; i = j)
+    {
+        j = i + 1;
+        if (cov[i] == 0)
+        {
+            j = i + __cov_run(cov + i, len - i, 0);
+            continue;
+        }
+        if (cov[i] == 255)
+        {
+            j = i + __cov_run(cov + i, len - i, 255);
+            func(color, dst + i, j - i);
+        }
+        else
+        {
+            while ((j < len) && (cov[j] != 255) && (cov[j] != 0))
+                j++;
+            sfunc((uint8_t *) cov + i, color, dst + i, j - i);
         }
+    }
+}
 
-        qsort(edge, nactive_edges, sizeof(PolyEdge), poly_edge_sorter);
+/* Accumulator blocks, log2 of pixels */
+#define COV_BLOCK_SHIFT 4
+
+/* Fill by area coverage.
+ * Each scanline accumulates the signed area of the active edges into a row
+ * of running sums, which gives the coverage for the fill rule. This is
+ * exact for pixels crossed by one edge, or by edges that don't overlap in
+ * them. Where edges cross or overlap within a pixel the fill rule is
+ * applied to their summed area, an approximation. Only blocks
+ * touched by edges are summed pixel by pixel, the coverage is constant in
+ * between. Without anti-aliasing pixels are set when at least half
+ * covered.
+ * lx, rx, ty and by are the pixel bounds of the edges. */
+static void
+__cov_fill(CovEdge *edges, int nedges, int fill_rule,
+           int lx, int rx, int ty, int by, uint32_t color,
+           uint32_t *dst, int dstw, int clx, int cly, int clw, int clh,
+           ImlibOp op, char dst_alpha, char blend, char anti_alias)
+{
+    ImlibSpanDrawFunction func;
+    ImlibShapedSpanDrawFunction sfunc;
+    CovEdge        *e, **aet;
+    float          *acc;
+    uint8_t        *cov, *touched;
+    int             nactive, i, j, k, b;
+    int             clrx, clby, y, ix0, ix1, i0, i1;
+    float           fy, ya, yb, xa, xb, sum;
+
+    func = __imlib_GetSpanDrawFunction(op, dst_alpha, blend);
+    sfunc = __imlib_GetShapedSpanDrawFunction(op, dst_alpha, blend);
+    if (!func || !sfunc)
+        return;
 
-        /* clear alpha buffer */
-        if (x0 <= x1)
-            memset(s1 + x0, 0, x1 - x0 + 1);
+    clrx = clx + clw - 1;
+    clby = cly + clh - 1;
+    CLIP_SPAN(clx, clrx, lx, rx);
+    CLIP_SPAN(cly, clby, ty, by);
+    if ((clrx < clx) || (clby < cly))
+        return;
+    clw = clrx - clx + 1;
 
-        x0 = nx0;
-        x1 = nx1;
-        nx0 = clrx + 1;
-        nx1 = clx - 1;
-        /* draw to alpha buffer */
-        j = 0;
-        while (j < nactive_edges)
+    aet = malloc((nedges + 1) * sizeof(CovEdge *));
+    acc = calloc(clw + 2, sizeof(float));
+    cov = malloc(clw);
+    touched = calloc(((clw + 1) >> COV_BLOCK_SHIFT) + 1, 1);
+    if (!aet || !acc || !cov || !touched)
+        goto quit;
+
+    for (i = 0; i < nedges; i++)
+        edges[i].x0 -= clx;
+    qsort(edges, nedges, sizeof(CovEdge), cov_edge_sorter);
+
+    dst += dstw * cly + clx;
+    nactive = 0;
+    k = 0;
+
+    for (y = cly; y <= clby; y++, dst += dstw)
+    {
+        fy = y;
+
+        /* Update the active edge table */
+        while ((k < nedges) && (edges[k].y0 < fy + 1.0f))
+            aet[nactive++] = edges + k++;
+
+        /* Finished edges are dropped keeping the order, so the sums are
+         * added up in the same order whatever the first row is */
+        ix0 = clw + 1;
+        ix1 = -1;
+        for (i = j = 0; i < nactive; i++)
         {
-            int             lx, rx;
-            int             le_lx, le_rx;
-            int             re_lx, re_rx;
-            PolyEdge       *le, *re;
+            e = aet[i];
+            if (e->y1 <= fy)
+                continue;
+            aet[j++] = e;
+
+            ya = MAX(e->y0, fy);
+            yb = MIN(e->y1, fy + 1.0f);
+            if (yb <= ya)
+                continue;
+
+            /* Clamping to the clip box keeps the winding to the right */
+            xa = e->x0 + (ya - e->y0) * e->dxdy;
+            xb = e->x0 + (yb - e->y0) * e->dxdy;
+            xa = MAX(0.0f, MIN(xa, clw));
+            xb = MAX(0.0f, MIN(xb, clw));
+
+            __cov_accumulate(acc, xa, xb, e->dir * (yb - ya));
+
+            i0 = MIN(xa, xb);
+            i1 = (int)ceilf(MAX(xa, xb)) + 1;
+            for (b = i0 >> COV_BLOCK_SHIFT; b <= i1 >> COV_BLOCK_SHIFT; b++)
+                touched[b] = 1;
+            ix0 = MIN(ix0, i0);
+            ix1 = MAX(ix1, i1);
+        }
+        nactive = j;
+        if (ix1 < 0)
+            continue;
 
-            if (j < (nactive_edges - 1))
-            {
-                le = edge + j;
-                re = le + 1;
-            }
-            else if (j > 0)
+        /* Running sum to coverage, clearing the accumulator */
+        sum = 0.0f;
+        for (b = ix0 >> COV_BLOCK_SHIFT; b <= ix1 >> COV_BLOCK_SHIFT; b++)
+        {
+            i0 = MAX(ix0, b << COV_BLOCK_SHIFT);
+            i1 = MIN(ix1, ((b + 1) << COV_BLOCK_SHIFT) - 1);
+            if (!touched[b])
             {
-                le = edge + (j - 1);
-                le->xx -= le->dxx;
-                re = le + 1;
+                i1 = MIN(i1, clw - 1);
+                if (i0 <= i1)
+                    memset(cov + i0, __cov_alpha(sum, fill_rule,
+                                                 anti_alias), i1 - i0 + 1);
+                continue;
             }
-            else
+            touched[b] = 0;
+            for (i = i0; i <= i1; i++)
             {
-                re = le = edge;
+                sum += acc[i];
+                acc[i] = 0.0f;
+                if (i < clw)
+                    cov[i] = __cov_alpha(sum, fill_rule, anti_alias);
             }
+        }
 
-            GET_EDGE_RANGE(le, le_lx, le_rx);
-            if ((le_lx < le->v0->x) && (le->dxx > 0))
-                le_lx = le->v0->x;
-            GET_EDGE_RANGE(re, re_lx, re_rx);
-            if ((re_rx > re->v0->x) && (re->dxx < 0))
-                re_rx = re->v0->x;
+        ix1 = MIN(ix1, clw - 1);
+        __cov_draw(cov + ix0, color, dst + ix0, ix1 - ix0 + 1, func, sfunc);
+    }
 
-            /* draw left aa edge */
-            switch (le->type)
-            {
-            case STEEP_EDGE:
-                {
-                    uint32_t        tmp;
-                    uint8_t         aa;
+  quit:
+    free(aet);
+    free(acc);
+    free(cov);
+    free(touched);
+}
 
-                    if (le_lx < x0)
-                        x0 = le_lx;
-                    le_rx = le_lx + 1;
-
-                    if (IN_SEGMENT(le_lx, clx, clw))
-                    {
-                        aa = 255 - ((le->xx - (le_lx << 16)) >> 8);
-                        ps = s0 + le_lx;
-                        BLEND_ALPHA(ps, aa, tmp);
-                    }
-
-                    if ((le->v1->y == (y + 1)) && (y < clby))
-                    {
-                        lx = (le->xx + le->dxx) >> 16;
-                        if (IN_SEGMENT(lx, clx, clw))
-                        {
-                            aa = 255 - ((le->xx + le->dxx - (lx << 16)) >> 8);
-                            ps = s1 + lx;
-                            BLEND_ALPHA(ps, aa, tmp);
-                            if (lx < nx0)
-                                nx0 = lx;
-                        }
-                    }
-                    break;
-                }
-            case SHALLOW_EDGE:
-                {
-                    int             x, ey, eyy;
-
-                    if (le_lx < x0)
-                        x0 = le_lx;
-                    x = le_lx;
-                    eyy = ((le->v0->y) << 16) + (x - (le->v0->x)) * (le->dyy);
-                    ey = eyy >> 16;
-
-                    if (le->dyy > 0)
-                    {
-                        while (ey < y)
-                        {
-                            uint32_t        tmp;
-                            uint8_t         aa;
-
-                            if ((ey == prev_y) && IN_SEGMENT(x, clx, clw))
-                            {
-                                aa = ((eyy - prev_yy) >> 8);
-                                ps = s0 + x;
-                                BLEND_ALPHA(ps, aa, tmp);
-                            }
-                            eyy += le->dyy;
-                            ey = eyy >> 16;
-                            x++;
-                        }
-                        le_rx = x;
-
-                        if (((y + 1) == le->v1->y) && (y < clby))
-                        {
-                            if (x < nx0)
-                                nx0 = x;
-                            rx = le->v1->x;
-                            while ((ey == y) && (x <= rx))
-                            {
-                                uint32_t        tmp;
-                                uint8_t         aa;
-
-                                if (IN_SEGMENT(x, clx, clw))
-                                {
-                                    aa = ((eyy - yy) >> 8);
-                                    ps = s1 + x;
-                                    BLEND_ALPHA(ps, aa, tmp);
-                                }
-                                eyy += le->dyy;
-                                ey = eyy >> 16;
-                                x++;
-                            }
-                        }
-                        break;
-                    }
-
-                    while (ey >= y)
-                    {
-                        uint32_t        tmp;
-                        uint8_t         aa;
-
-                        if ((ey == y) && IN_SEGMENT(x, clx, clw))
-                        {
-                            aa = 255 - ((eyy - yy) >> 8);
-                            ps = s0 + x;
-                            BLEND_ALPHA(ps, aa, tmp);
-                        }
-                        eyy += le->dyy;
-                        ey = eyy >> 16;
-                        x++;
-                    }
-                    le_rx = x;
-                    break;
-                }
-            case HORZ_EDGE:
-                {
-                    lx = le_lx;
-                    rx = le_rx;
-                    CLIP_SPAN(lx, rx, clx, clrx);
-                    if (lx <= rx)
-                    {
-                        memset(s0 + lx, 255, rx - lx + 1);
-                        if (lx < x0)
-                            x0 = lx;
-                    }
-                    le_rx++;
-                    break;
-                }
+static void
+__imlib_Polygon_FillToData_Cov(ImlibPoly *poly, uint32_t color,
+                               uint32_t *dst, int dstw,
+                               int clx, int cly, int clw, int clh,
+                               ImlibOp op, char dst_alpha, char blend,
+                               char anti_alias)
+{
+    CovEdge        *edges, *e;
+    int             nvertices, nedges, i;
+    const ImlibPoint *v0, *v1;
 
-            default:
-                break;
-            }
+    nvertices = poly->pointcount;
+    if (nvertices < 1)
+        return;
 
-            /* draw right aa edge */
-            switch (re->type)
-            {
-            case STEEP_EDGE:
-                {
-                    uint32_t        tmp;
-                    uint8_t         aa;
+    edges = malloc(nvertices * sizeof(CovEdge));
+    if (!edges)
+        return;
 
-                    rx = re_lx + 1;
-                    if (rx > x1)
-                        x1 = rx;
+    /* Edge table, horizontal edges don't contribute */
+    for (i = nedges = 0; i < nvertices; i++)
+    {
+        v0 = poly->points + i;
+        v1 = poly->points + ((i < nvertices - 1) ? i + 1 : 0);
+        if (v0->y == v1->y)
+            continue;
+        e = edges + nedges++;
+        e->dir = 1.0f;
+        if (v1->y < v0->y)
+        {
+            const ImlibPoint *w = v0;
 
-                    if (IN_SEGMENT(rx, clx, clw))
-                    {
-                        aa = (re->xx - (re_lx << 16)) >> 8;
-                        ps = s0 + rx;
-                        BLEND_ALPHA(ps, aa, tmp);
-                    }
+            v0 = v1;
+            v1 = w;
+            e->dir = -1.0f;
+        }
+        e->x0 = v0->x + 0.5f;
+        e->y0 = v0->y + 0.5f;
+        e->y1 = v1->y + 0.5f;
+        e->dxdy = (float)(v1->x - v0->x) / (v1->y - v0->y);
+    }
 
-                    if ((re->v1->y == (y + 1)) && (y < clby))
-                    {
-                        lx = (re->xx + re->dxx) >> 16;
-                        rx = lx + 1;
-                        if (IN_SEGMENT(rx, clx, clw))
-                        {
-                            aa = ((re->xx + re->dxx - (lx << 16)) >> 8);
-                            ps = s1 + rx;
-                            BLEND_ALPHA(ps, aa, tmp);
-                            if (rx > nx1)
-                                nx1 = rx;
-                        }
-                    }
-                    break;
-                }
-            case SHALLOW_EDGE:
-                {
-                    int             x, ey, eyy;
+    __cov_fill(edges, nedges, poly->fill_rule,
+               poly->lx, poly->rx, poly->ty, poly->by, color,
+               dst, dstw, clx, cly, clw, clh, op, dst_alpha, blend,
+               anti_alias);
 
-                    if (re_rx > x1)
-                        x1 = re_rx;
-                    x = re_rx;
-                    eyy = ((re->v0->y) << 16) + (x - (re->v0->x)) * (re->dyy);
-                    ey = eyy >> 16;
-
-                    if (re->dyy > 0)
-                    {
-                        while (ey >= y)
-                        {
-                            uint32_t        tmp;
-                            uint8_t         aa;
+    free(edges);
+}
 
-                            if ((ey == y) && IN_SEGMENT(x, clx, clw))
-                            {
-                                aa = 255 - ((eyy - yy) >> 8);
-                                ps = s0 + x;
-                                BLEND_ALPHA(ps, aa, tmp);
-                            }
-                            eyy -= re->dyy;
-                            ey = eyy >> 16;
-                            x--;
-                        }
-                        re_lx = x;
-                        break;
-                    }
+void
+__imlib_Path_FillToImage(const float *xy, const int *npoints, int ncontours,
+                         int fill_rule, uint32_t color, ImlibImage *im,
+                         int clx, int cly, int clw, int clh,
+                         ImlibOp op, char blend, char anti_alias)
+{
+    CovEdge        *edges, *e;
+    int             nvertices, nedges, i, j, n;
+    float           lx, rx, ty, by;
+    const float    *v0, *v1, *w;
 
-                    while (ey < y)
-                    {
-                        uint32_t        tmp;
-                        uint8_t         aa;
+    if (clw < 0)
+        return;
+    if (blend && (!A_VAL(&color)))
+        return;
 
-                        if ((ey == prev_y) && IN_SEGMENT(x, clx, clw))
-                        {
-                            aa = ((eyy - prev_yy) >> 8);
-                            ps = s0 + x;
-                            BLEND_ALPHA(ps, aa, tmp);
-                        }
-                        eyy -= re->dyy;
-                        ey = eyy >> 16;
-                        x--;
-                    }
-                    re_lx = x;
+    if (clw == 0)
+    {
+        clx = cly = 0;
+        clw = im->w;
+        clh = im->h;
+    }
+    else
+    {
+        CLIP(clx, cly, clw, clh, 0, 0, im->w, im->h);
+    }
+    if (clw <= 0 || clh <= 0)
+        return;
 
-                    if (((y + 1) == re->v1->y) && (y < clby))
-                    {
-                        if (x > nx1)
-                            nx1 = x;
-                        lx = re->v1->x;
-                        while ((ey == y) && (x >= lx))
-                        {
-                            uint32_t        tmp;
-                            uint8_t         aa;
+    for (i = nvertices = 0; i < ncontours; i++)
+        nvertices += npoints[i];
+    if (nvertices < 1)
+        return;
 
-                            if (IN_SEGMENT(x, clx, clw))
-                            {
-                                aa = ((eyy - yy) >> 8);
-                                ps = s1 + x;
-                                BLEND_ALPHA(ps, aa, tmp);
-                            }
-                            eyy -= re->dyy;
-                            ey = eyy >> 16;
-                            x--;
-                        }
-                    }
-                    break;
-                }
-            case HORZ_EDGE:
-                {
-                    lx = re_lx;
-                    rx = re_rx;
-                    CLIP_SPAN(lx, rx, clx, clrx);
-                    if (lx <= rx)
-                    {
-                        memset(s0 + lx, 255, rx - lx + 1);
-                        if (rx > x1)
-                            x1 = rx;
-                    }
-                    re_lx--;
-                    break;
-                }
+    edges = malloc(nvertices * sizeof(CovEdge));
+    if (!edges)
+        return;
 
-            default:
-                break;
+    lx = ty = 1e9f;
+    rx = by = -1e9f;
+    for (i = nedges = 0; i < ncontours; xy += 2 * npoints[i++])
+    {
+        n = npoints[i];
+        for (j = 0; j < n; j++)
+        {
+            v0 = xy + 2 * j;
+            v1 = xy + 2 * (j < n - 1 ? j + 1 : 0);
+            lx = MIN(lx, v0[0]);
+            rx = MAX(rx, v0[0]);
+            ty = MIN(ty, v0[1]);
+            by = MAX(by, v0[1]);
+            if (v0[1] == v1[1])
+                continue;
+            e = edges + nedges++;
+            e->dir = 1.0f;
+            if (v1[1] < v0[1])
+            {
+                w = v0;
+                v0 = v1;
+                v1 = w;
+                e->dir = -1.0f;
             }
-
-            /* draw span between edges */
-            lx = le_rx;
-            rx = re_lx;
-            CLIP_SPAN(lx, rx, clx, clrx);
-            if ((lx <= rx) && (y >= cly))
-                memset(s0 + lx, 255, rx - lx + 1);
-
-            le->xx += le->dxx;
-            if (le != re)
-                re->xx += re->dxx;
-
-            j += 2;
+            e->x0 = v0[0] + 0.5f;
+            e->y0 = v0[1] + 0.5f;
+            e->y1 = v1[1] + 0.5f;
+            e->dxdy = (v1[0] - v0[0]) / (v1[1] - v0[1]);
         }
+    }
 
-        if (nactive_horz_edges > 0)
-            DEL_HORZ_EDGES();
-
-        /* draw alpha buffer to dst */
-        CLIP_SPAN(x0, x1, clx, clrx);
-        if ((x0 <= x1) && (y >= cly))
-            sfunc(s0 + x0, color, p + x0, x1 - x0 + 1);
-
-        /* exchange alpha buffers */
-        ps = s0;
-        s0 = s1;
-        s1 = ps;
-
-        prev_yy = yy;
-        prev_y = y;
+    /* Keep the bounds in int range, the clip box does the rest */
+    lx = MAX(lx, -1e8f);
+    ty = MAX(ty, -1e8f);
+    rx = MIN(rx, 1e8f);
+    by = MIN(by, 1e8f);
 
-        y++;
-        yy = y << 16;
+    if (blend && im->has_alpha)
+        __imlib_build_pow_lut();
 
-        p += dstw;
-    }
+    if (nedges > 0 && lx <= rx)
+        __cov_fill(edges, nedges, fill_rule,
+                   floorf(lx + 0.5f), floorf(rx + 0.5f),
+                   floorf(ty + 0.5f), floorf(by + 0.5f), color,
+                   im->data, im->w, clx, cly, clw, clh,
+                   op, im->has_alpha, blend, anti_alias);
 
-    DE_INIT_POLY();
+    free(edges);
 }
 
 void
@@ -1834,11 +2042,11 @@ __imlib_Polygon_FillToImage(ImlibPoly *poly, uint32_t color,
     if (blend && im->has_alpha)
         __imlib_build_pow_lut();
 
-    if (anti_alias)
-        __imlib_Polygon_FillToData_AA(poly, color,
-                                      im->data, im->w,
-                                      clx, cly, clw, clh,
-                                      op, im->has_alpha, blend);
+    if (anti_alias || poly->fill_rule != POLY_FILL_EVEN_ODD)
+        __imlib_Polygon_FillToData_Cov(poly, color,
+                                       im->data, im->w,
+                                       clx, cly, clw, clh,
+                                       op, im->has_alpha, blend, anti_alias);
     else
         __imlib_Polygon_FillToData(poly, color,
                                    im->data, im->w,
@@ -0,0 +1,371 @@
+#include "common.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "image.h"
+#include "rgbadraw.h"
+#include "updates.h"
+
+/*
+ * Wide lines, ellipses and arcs
+ *
+ * The outline of the stroke is built as a polygon with float vertices and
+ * filled by the coverage filler, so the edges get exact area coverage and
+ * the inside is drawn with solid spans.
+ * Curves are flattened so the polygon stays within STROKE_TOLERANCE pixels
+ * of the true outline.
+ */
+
+#define STROKE_TOLERANCE    0.05
+#define STROKE_SEGS_MAX     65536
+
+typedef struct {
+    float          *xy;
+    int             num, alloc;
+    int             npoints[2];
+    int             ncontours;
+    int             error;
+} StrokePath;
+
+static void
+__path_add(StrokePath *path, double x, double y)
+{
+    float          *xy;
+    int             n;
+
+    if (path->num >= path->alloc)
+    {
+        n = path->alloc ? 2 * path->alloc : 256;
+        xy = realloc(path->xy, 2 * n * sizeof(float));
+        if (!xy)
+        {
+            path->error = 1;
+            return;
+        }
+        path->xy = xy;
+        path->alloc = n;
+    }
+    path->xy[2 * path->num] = x;
+    path->xy[2 * path->num + 1] = y;
+    path->num++;
+    path->npoints[path->ncontours]++;
+}
+
+/* Start the next contour */
+static void
+__path_close(StrokePath *path)
+{
+    if (path->npoints[path->ncontours] > 0)
+        path->ncontours++;
+}
+
+/* Number of segments for an arc of radius r spanning the angle sweep */
+static int
+__circle_segs(double r, double sweep)
+{
+    double          da;
+    int             n;
+
+    if (r <= STROKE_TOLERANCE)
+        return 2;
+    da = 2 * acos(1 - STROKE_TOLERANCE / r);
+    n = ceil(fabs(sweep) / da);
+
+    return MAX(2, MIN(n, STROKE_SEGS_MAX));
+}
+
+/* Circular arc around (x, y), both end points included.
+ * The points are stepped by rotation, which drifts far less than the
+ * tolerance over STROKE_SEGS_MAX steps. */
+static void
+__path_circle(StrokePath *path, double x, double y, double r,
+              double a0, double sweep)
+{
+    int             i, n;
+    double          c, s, dc, ds, t;
+
+    n = __circle_segs(r, sweep);
+    c = r * cos(a0);
+    s = r * sin(a0);
+    dc = cos(sweep / n);
+    ds = sin(sweep / n);
+    for (i = 0; i <= n; i++)
+    {
+        __path_add(path, x + c, y + s);
+        t = c * dc - s * ds;
+        s = c * ds + s * dc;
+        c = t;
+    }
+}
+
+/* End cap at (x, y) for the stroke going in direction (ux, uy), from the
+ * left side (x, y) + h * (uy, -ux) to the right side */
+static void
+__path_cap(StrokePath *path, double x, double y, double ux, double uy,
+           double h, int cap)
+{
+    switch (cap)
+    {
+    default:
+    case LINE_CAP_BUTT:
+        break;
+    case LINE_CAP_ROUND:
+        __path_circle(path, x, y, h, atan2(-ux, uy), M_PI);
+        break;
+    case LINE_CAP_SQUARE:
+        __path_add(path, x + h * (uy + ux), y + h * (uy - ux));
+        __path_add(path, x + h * (ux - uy), y + h * (ux + uy));
+        break;
+    }
+}
+
+static void
+__path_fill(StrokePath *path, uint32_t color, ImlibImage *im,
+            int clx, int cly, int clw, int clh, ImlibOp op, char blend,
+            char anti_alias)
+{
+    __path_close(path);
+    if (!path->error && path->ncontours > 0)
+        __imlib_Path_FillToImage(path->xy, path->npoints, path->ncontours,
+                                 POLY_FILL_NON_ZERO, color, im,
+                                 clx, cly, clw, clh, op, blend, anti_alias);
+    free(path->xy);
+}
+
+/* Line from (x0, y0) to (x1, y1) with cap0 at the start and cap1 at the
+ * end, of which cap1 is used for a dot */
+static void
+__stroke_line(StrokePath *path, double x0, double y0, double x1, double y1,
+              double h, int cap0, int cap1)
+{
+    double          ux, uy, len;
+
+    len = hypot(x1 - x0, y1 - y0);
+    if (len == 0)
+    {
+        /* No direction, caps only */
+        switch (cap1)
+        {
+        default:
+        case LINE_CAP_BUTT:
+            break;
+        case LINE_CAP_ROUND:
+            __path_circle(path, x0, y0, h, 0, 2 * M_PI);
+            break;
+        case LINE_CAP_SQUARE:
+            __path_add(path, x0 - h, y0 - h);
+            __path_add(path, x0 + h, y0 - h);
+            __path_add(path, x0 + h, y0 + h);
+            __path_add(path, x0 - h, y0 + h);
+            break;
+        }
+        return;
+    }
+
+    ux = (x1 - x0) / len;
+    uy = (y1 - y0) / len;
+    __path_add(path, x0 + h * uy, y0 - h * ux);
+    __path_add(path, x1 + h * uy, y1 - h * ux);
+    __path_cap(path, x1, y1, ux, uy, h, cap1);
+    __path_add(path, x1 - h * uy, y1 + h * ux);
+    __path_add(path, x0 - h * uy, y0 + h * ux);
+    __path_cap(path, x0, y0, -ux, -uy, h, cap0);
+}
+
+ImlibUpdate    *
+__imlib_Line_StrokeToImage(int x0, int y0, int x1, int y1, double width,
+                           int cap, uint32_t color, ImlibImage *im,
+                           int clx, int cly, int clw, int clh, ImlibOp op,
+                           char blend, char anti_alias, char make_updates)
+{
+    StrokePath      path = { };
+    double          h;
+    int             e, x, y, w, ht;
+
+    if (!(width > 0))
+        return NULL;
+    h = MIN(width, 65536) / 2;
+
+    __stroke_line(&path, x0, y0, x1, y1, h, cap, cap);
+    __path_fill(&path, color, im, clx, cly, clw, clh, op, blend, anti_alias);
+
+    if (!make_updates)
+        return NULL;
+
+    /* Square caps reach out h * sqrt(2) */
+    e = ceil(h * M_SQRT2) + 1;
+    x = MIN(x0, x1) - e;
+    y = MIN(y0, y1) - e;
+    w = abs(x1 - x0) + 2 * e + 1;
+    ht = abs(y1 - y0) + 2 * e + 1;
+    if (clw == 0)
+    {
+        clx = cly = 0;
+        clw = im->w;
+        clh = im->h;
+    }
+    CLIP(x, y, w, ht, clx, cly, clw, clh);
+    CLIP(x, y, w, ht, 0, 0, im->w, im->h);
+    if (w <= 0 || ht <= 0)
+        return NULL;
+
+    return __imlib_AddUpdate(NULL, x, y, w, ht);
+}
+
+/* Ellipse point and outwards normal for the parameter with cosine c and
+ * sine s */
+static void
+__ellipse_point(double a, double b, double c, double s, double *px,
+                double *py, double *nx, double *ny)
+{
+    double          l;
+
+    *px = a * c;
+    *py = b * s;
+    l = sqrt(b * c * b * c + a * s * a * s);
+    *nx = b * c / l;
+    *ny = a * s / l;
+}
+
+/* Ellipse offset curve by h from t0 to t0 + sweep, end points included,
+ * stepping the parameter by rotation as in __path_circle() */
+static void
+__path_ellipse(StrokePath *path, double xc, double yc, double a, double b,
+               double h, double t0, double sweep, int n)
+{
+    double          px, py, nx, ny, c, s, dc, ds, t;
+    int             i;
+
+    c = cos(t0);
+    s = sin(t0);
+    dc = cos(sweep / n);
+    ds = sin(sweep / n);
+    for (i = 0; i <= n; i++)
+    {
+        __ellipse_point(a, b, c, s, &px, &py, &nx, &ny);
+        __path_add(path, xc + px + h * nx, yc + py + h * ny);
+        t = c * dc - s * ds;
+        s = c * ds + s * dc;
+        c = t;
+    }
+}
+
+/* Whether cos(t) is 1 somewhere strictly between t0 and t1 */
+static int
+__cos_peak(double t0, double t1)
+{
+    return (floor(t0 / (2 * M_PI)) + 1) * 2 * M_PI < t1;
+}
+
+/* Parameter of the ellipse point at polar angle phi */
+static double
+__ellipse_param(double a, double b, double phi)
+{
+    return atan2(a * sin(phi), b * cos(phi));
+}
+
+void
+__imlib_Arc_StrokeToImage(int xc, int yc, int a, int b,
+                          double angle1, double angle2, double width,
+                          int cap, uint32_t color, ImlibImage *im,
+                          int clx, int cly, int clw, int clh, ImlibOp op,
+                          char blend, char anti_alias)
+{
+    StrokePath      path = { };
+    double          h, ra, rb, rmax, rmin, t0, t1, dt, px, py, nx, ny;
+    double          lo, hi;
+    int             n, full, cap0, cap1;
+
+    if (!(width > 0))
+        return;
+    h = MIN(width, 65536) / 2;
+    ra = MIN(abs(a), 65535);
+    rb = MIN(abs(b), 65535);
+
+    if (!(angle2 >= angle1))
+        angle2 += ceil((angle1 - angle2) / 360) * 360;
+    if (!(angle2 - angle1 <= 360))
+        angle2 = angle1 + 360;
+
+    if (ra == 0 || rb == 0)
+    {
+        /* Flat, stroke the part of the axis the arc covers, at cos(t) of
+         * it. Where the arc turns back the stroke ends round, as it does
+         * around the ends of a thin ellipse, else with the cap. */
+        full = angle2 - angle1 >= 360;
+        t0 = (angle1 - (ra == 0 ? 90 : 0)) * M_PI / 180;
+        t1 = (angle2 - (ra == 0 ? 90 : 0)) * M_PI / 180;
+        hi = MAX(cos(t0), cos(t1));
+        lo = MIN(cos(t0), cos(t1));
+        cap0 = cap1 = full ? LINE_CAP_ROUND : cap;
+        if (!full && ra + rb > 0 && __cos_peak(t0, t1))
+        {
+            hi = 1;
+            cap1 = LINE_CAP_ROUND;
+        }
+        if (!full && ra + rb > 0 && __cos_peak(t0 - M_PI, t1 - M_PI))
+        {
+            lo = -1;
+            cap0 = LINE_CAP_ROUND;
+        }
+        if (full)
+        {
+            lo = -1;
+            hi = 1;
+        }
+        __stroke_line(&path, xc + ra * lo, yc + rb * lo,
+                      xc + ra * hi, yc + rb * hi, h, cap0, cap1);
+        __path_fill(&path, color, im, clx, cly, clw, clh, op, blend,
+                    anti_alias);
+        return;
+    }
+
+    /* Step so both the curve and the normal offset by h stay within the
+     * tolerance, the normal turns fastest at the ends of the major axis */
+    rmax = MAX(ra, rb);
+    rmin = MIN(ra, rb);
+    dt = sqrt(8 * STROKE_TOLERANCE / (rmax + h * rmax * rmax / (rmin * rmin)));
+
+    if (angle2 - angle1 >= 360)
+    {
+        n = MIN(ceil(2 * M_PI / dt), STROKE_SEGS_MAX);
+        __path_ellipse(&path, xc, yc, ra, rb, h, 0, 2 * M_PI, n);
+        path.num--;             /* Drop the duplicate end point */
+        path.npoints[0]--;
+        /* No hole when the stroke covers the middle */
+        if (h < rmin)
+        {
+            __path_close(&path);
+            __path_ellipse(&path, xc, yc, ra, rb, -h, 2 * M_PI, -2 * M_PI,
+                           n);
+            path.num--;
+            path.npoints[1]--;
+        }
+        __path_fill(&path, color, im, clx, cly, clw, clh, op, blend,
+                    anti_alias);
+        return;
+    }
+
+    /* The parameter moves the same way as the angle, and by less than a
+     * half turn exactly when the angle does */
+    t0 = __ellipse_param(ra, rb, angle1 * M_PI / 180);
+    t1 = __ellipse_param(ra, rb, angle2 * M_PI / 180) - t0;
+    t1 -= floor(t1 / (2 * M_PI)) * 2 * M_PI;
+    if (angle2 - angle1 < 180 && t1 > M_PI)
+        t1 = 0;
+    else if (angle2 - angle1 > 180 && t1 < M_PI)
+        t1 = 2 * M_PI;
+    t1 += t0;
+    n = MAX(1, MIN(ceil((t1 - t0) / dt), STROKE_SEGS_MAX));
+
+    /* Outside to the end, inside back to the start */
+    __path_ellipse(&path, xc, yc, ra, rb, h, t0, t1 - t0, n);
+    __ellipse_point(ra, rb, cos(t1), sin(t1), &px, &py, &nx, &ny);
+    __path_cap(&path, xc + px, yc + py, -ny, nx, h, cap);
+    __path_ellipse(&path, xc, yc, ra, rb, -h, t1, t0 - t1, n);
+    __ellipse_point(ra, rb, cos(t0), sin(t0), &px, &py, &nx, &ny);
+    __path_cap(&path, xc + px, yc + py, ny, -nx, h, cap);
+
+    __path_fill(&path, color, im, clx, cly, clw, clh, op, blend, anti_alias);
+}
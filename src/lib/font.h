@@ -4,21 +4,63 @@
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #include FT_GLYPH_H
+#include FT_SIZES_H
 
 #include "object.h"
 #include "types.h"
 
+typedef struct _Imlib_Font_Page Imlib_Font_Page;
+
+/*
+ * A rendered glyph.
+ * The coverage (8 bit, width x rows, NULL when empty) is packed into the
+ * atlas pages of the font.
+ * Glyph pointers stay valid until the next glyph is added to the cache.
+ */
+typedef struct {
+    FT_UInt         key;        /* Glyph index + 1, 0: free table slot */
+    int             left, top;  /* Coverage offset from the pen position */
+    int             width, rows;
+    int             advance;    /* 16.16 */
+    uint8_t        *coverage;
+    Imlib_Font_Page *page;
+} Imlib_Font_Glyph;
+
+/* A face of a font file, mapped into memory and shared by all sizes */
+typedef struct _ImlibFontFace {
+    struct _ImlibFontFace *next;
+    char           *file;
+    int             faceidx;
+    int             references;
+    FT_Face         face;
+    void           *map;
+    size_t          map_size;
+} ImlibFontFace;
+
 typedef struct _Imlib_Font {
     Imlib_Object_List _list_data;
     char           *name;
     char           *file;
+    int             faceidx;
     int             size;
 
     struct {
-        FT_Face         face;
+        FT_Face         face;   /* Shared, activate size before use */
+        FT_Size         size;
+        ImlibFontFace  *shared;
     } ft;
 
-    Imlib_Hash     *glyphs;
+    /* Loaded fonts index, on (file, faceidx, size) */
+    struct _Imlib_Font *index_next;
+    unsigned int    hash;
+
+    /* Glyph table, open addressing on the glyph index */
+    struct {
+        Imlib_Font_Glyph *slots;
+        int             mask;   /* Table size - 1 */
+        int             num;
+    } glyphs;
+    Imlib_Font_Page *page;      /* Atlas page being filled */
 
     int             usage;
 
@@ -29,13 +71,56 @@ typedef struct _Imlib_Font {
     struct _Imlib_Font *fallback_next;
 } ImlibFont;
 
-typedef struct {
-    FT_Glyph        glyph;
-    FT_BitmapGlyph  glyph_out;
-} Imlib_Font_Glyph;
+/* Make the font's size the active one of its shared face */
+static inline void
+__imlib_font_activate(ImlibFont *fn)
+{
+    if (fn->ft.face->size != fn->ft.size)
+        FT_Activate_Size(fn->ft.size);
+}
 
 #define IMLIB_GLYPH_NONE ((Imlib_Font_Glyph*) 1)        /* Glyph not found */
 
+/* A glyph positioned in a text run */
+typedef struct {
+    ImlibFont      *fn;         /* Font of the fallback chain having it */
+    FT_UInt         index;
+    int             chr, chr_end;       /* Byte offsets of the character */
+    int             x;          /* Pen position, 24.8 */
+    int             kern;       /* Kerning applied before it, 24.8 */
+    int             left, width;
+    int             advance;    /* 16.16 */
+} ImlibTextGlyph;
+
+/*
+ * A laid out string, the glyphs of the text with the font and its
+ * fallback chain, done once and shared by measuring and drawing.
+ * Runs made with an older layout serial (the fallback chain changed or
+ * fonts were freed since) are laid out again when used.
+ */
+typedef struct {
+    ImlibFont      *fn;
+    char           *text;
+    int             len;
+    unsigned int    hash;
+    unsigned int    serial;
+    unsigned int    stamp;      /* Time of last use, for the cache */
+    ImlibTextGlyph *glyphs;
+    int             num;
+    int             advance;    /* Horizontal advance */
+    int             width;      /* Width from the first glyph's left edge */
+    int             inset;      /* Inset of the first character */
+} ImlibTextRun;
+
+/* A string to draw in a batch */
+typedef struct {
+    ImlibFont      *fn;
+    uint32_t        color;
+    int             x, y;       /* Top left corner */
+    const char     *text;
+    int             dir;
+} ImlibTextItem;
+
 /* functions */
 
 void            __imlib_font_init(void);
@@ -60,39 +145,49 @@ int             __imlib_font_cache_get(void);
 void            __imlib_font_cache_set(int size);
 void            __imlib_font_flush(void);
 void            __imlib_font_modify_cache_by(ImlibFont * fn, int dir);
-void            __imlib_font_modify_cache_by(ImlibFont * fn, int dir);
 void            __imlib_font_flush_last(void);
-ImlibFont      *__imlib_font_find(const char *name, int size);
+ImlibFont      *__imlib_font_find(const char *name, int faceidx, int size);
 
-void            __imlib_font_query_size(ImlibFont * fn, const char *text,
-                                        int *w, int *h);
-int             __imlib_font_query_inset(ImlibFont * fn, const char *text);
-void            __imlib_font_query_advance(ImlibFont * fn, const char *text,
+void            __imlib_font_query_size(ImlibTextRun * run, int *w, int *h);
+int             __imlib_font_query_inset(ImlibTextRun * run);
+void            __imlib_font_query_advance(ImlibTextRun * run,
                                            int *h_adv, int *v_adv);
-int             __imlib_font_query_char_coords(ImlibFont * fn,
-                                               const char *text, int pos,
+int             __imlib_font_query_char_coords(ImlibTextRun * run, int pos,
                                                int *cx, int *cy,
                                                int *cw, int *ch);
-int             __imlib_font_query_text_at_pos(ImlibFont * fn,
-                                               const char *text,
+int             __imlib_font_query_text_at_pos(ImlibTextRun * run,
                                                int x, int y,
                                                int *cx, int *cy,
                                                int *cw, int *ch);
 
+ImlibTextRun   *__imlib_font_run_get(ImlibFont * fn, const char *text);
+ImlibTextRun   *__imlib_font_run_new(ImlibFont * fn, const char *text);
+void            __imlib_font_run_free(ImlibTextRun * run);
+int             __imlib_font_run_check(ImlibTextRun * run);
+void            __imlib_font_run_invalidate(void);
+
 Imlib_Font_Glyph *__imlib_font_get_next_glyph(ImlibFont * fn,
                                               const char *utf8,
                                               int *cindx,
-                                              FT_UInt * pindex, int *pkern);
+                                              FT_UInt * pindex, int *pkern,
+                                              ImlibFont ** pfn);
 Imlib_Font_Glyph *__imlib_font_cache_glyph_get(ImlibFont * fn, FT_UInt index);
-void            __imlib_render_str(ImlibImage * im, ImlibFont * f,
-                                   int drx, int dry, const char *text,
+void            __imlib_font_glyphs_free(ImlibFont * fn);
+void            __imlib_font_glyphs_trim(void);
+unsigned int    __imlib_font_glyphs_evictions(void);
+void            __imlib_render_str(ImlibImage * im, ImlibTextRun * run,
+                                   int drx, int dry,
                                    uint32_t pixel, int dir, double angle,
                                    int *retw, int *reth, int blur,
                                    int *nextx, int *nexty, ImlibOp op,
                                    int clx, int cly, int clw, int clh);
+void            __imlib_render_str_items(ImlibImage * im,
+                                         const ImlibTextItem * items, int n,
+                                         double angle, ImlibOp op,
+                                         int clx, int cly, int clw, int clh);
 void            __imlib_font_draw(ImlibImage * dst, uint32_t col,
-                                  ImlibFont * fn, int x, int y,
-                                  const char *text, int *nextx, int *nexty,
+                                  ImlibTextRun * run, int x, int y,
+                                  int *nextx, int *nexty,
                                   int clx, int cly, int clw, int clh);
 
 #endif                          /* FONT_H */
@@ -4,78 +4,129 @@
 #include FT_FREETYPE_H
 #include FT_GLYPH_H
 #include <math.h>
+#include <stdlib.h>
 
 #include "blend.h"
 #include "font.h"
 #include "image.h"
 #include "rgbadraw.h"
 #include "rotate.h"
+#include "span.h"
+#include "threads.h"
+
+/* Destination rows per band of batched text */
+#define TEXT_BAND_ROWS      32
+#define TEXT_BANDS_MIN      4
 
 extern FT_Library ft_lib;
 
-Imlib_Font_Glyph *
-__imlib_font_cache_glyph_get(ImlibFont *fn, FT_UInt index)
+/* Clip text drawn left to right with its baseline at y to the image and
+ * the cliprect. It is also kept within its text box, as drawing through an
+ * intermediate image did.
+ * Returns 0 when nothing is left. */
+static int
+__text_clip(ImlibImage *im, ImlibTextRun *run, int x, int y,
+            int *pclx, int *pcly, int *pclw, int *pclh)
 {
-    Imlib_Font_Glyph *fg;
-    char            key[6];
-    FT_Error        error;
-
-    key[0] = ((index) & 0x7f) + 1;
-    key[1] = ((index >> 7) & 0x7f) + 1;
-    key[2] = ((index >> 14) & 0x7f) + 1;
-    key[3] = ((index >> 21) & 0x7f) + 1;
-    key[4] = ((index >> 28) & 0x0f) + 1;
-    key[5] = 0;
-
-    fg = __imlib_hash_find(fn->glyphs, key);
-    if (fg)
-        return fg;
-
-    error = FT_Load_Glyph(fn->ft.face, index, FT_LOAD_NO_BITMAP);
-    if (error)
-        return NULL;
-
-    fg = malloc(sizeof(Imlib_Font_Glyph));
-    if (!fg)
-        return NULL;
-    memset(fg, 0, sizeof(Imlib_Font_Glyph));
-
-    error = FT_Get_Glyph(fn->ft.face->glyph, &(fg->glyph));
-    if (error)
+    int             clx, cly, clw, clh, top, bot;
+
+    clx = *pclx;
+    cly = *pcly;
+    clw = *pclw;
+    clh = *pclh;
+    if (clw == 0)
     {
-        free(fg);
-        return NULL;
+        clx = cly = 0;
+        clw = im->w;
+        clh = im->h;
     }
-    if (fg->glyph->format != ft_glyph_format_bitmap)
+    else
     {
-        error = FT_Glyph_To_Bitmap(&(fg->glyph), ft_render_mode_normal, 0, 1);
-        if (error)
-        {
-            FT_Done_Glyph(fg->glyph);
-            free(fg);
-            return NULL;
-        }
+        CLIP(clx, cly, clw, clh, 0, 0, im->w, im->h);
+    }
+    top = y - __imlib_font_max_ascent_get(run->fn);
+    bot = y - __imlib_font_max_descent_get(run->fn);
+    CLIP(clx, cly, clw, clh, x, top, run->advance, bot - top);
+    *pclx = clx;
+    *pcly = cly;
+    *pclw = clw;
+    *pclh = clh;
+
+    return clw > 0 && clh > 0;
+}
+
+/* Draw the run left to right with its baseline at y onto the image without
+ * an intermediate image of the whole text box. Bands of the clipped box are
+ * drawn as __imlib_font_draw() draws into the intermediate image, and
+ * blended as __imlib_BlendImageToImage() blends it, so the pixels come out
+ * the same. */
+static void
+__imlib_font_draw_direct(ImlibImage *im, uint32_t col, ImlibTextRun *run,
+                         int x, int y, ImlibOp op,
+                         int clx, int cly, int clw, int clh)
+{
+    ImlibImage      band;
+    int             by, bh;
+
+    if (!__text_clip(im, run, x, y, &clx, &cly, &clw, &clh))
+        return;
+
+    /* The bands reach to the right end of the box, glyphs drawn there can
+     * reach back into the clipped part */
+    memset(&band, 0, sizeof(band));
+    band.w = x + run->advance - clx;
+    band.h = MIN(clh, TEXT_BAND_ROWS);
+    band.data = malloc(band.w * band.h * sizeof(uint32_t));
+    if (!band.data)
+        return;
+
+    for (by = cly; by < cly + clh; by += bh)
+    {
+        bh = MIN(band.h, cly + clh - by);
+        memset(band.data, 0, band.w * band.h * sizeof(uint32_t));
+        __imlib_font_draw(&band, col, run, x - clx, y - by, NULL, NULL,
+                          0, 0, 0, 0);
+        __imlib_BlendRGBAToData(band.data, band.w, band.h,
+                                im->data, im->w, im->h, 0, 0, clx, by,
+                                clw, bh, 1, im->has_alpha, NULL, op, 0);
     }
-    fg->glyph_out = (FT_BitmapGlyph) fg->glyph;
 
-    fn->glyphs = __imlib_hash_add(fn->glyphs, key, fg);
-    return fg;
+    free(band.data);
 }
 
 void
-__imlib_render_str(ImlibImage *im, ImlibFont *fn, int drx, int dry,
-                   const char *text, uint32_t pixel, int dir, double angle,
+__imlib_render_str(ImlibImage *im, ImlibTextRun *run, int drx, int dry,
+                   uint32_t pixel, int dir, double angle,
                    int *retw, int *reth, int blur,
                    int *nextx, int *nexty, ImlibOp op, int clx, int cly,
                    int clw, int clh)
 {
+    ImlibFont      *fn;
     int             w, h, ascent;
     ImlibImage     *im2;
     int             nx, ny;
 
-    __imlib_font_query_advance(fn, text, &w, NULL);
+    fn = run->fn;
+    w = run->advance;
     h = __imlib_font_max_ascent_get(fn) - __imlib_font_max_descent_get(fn);
 
+    if (dir == 0 && blur <= 0)
+    {
+        /* Plain left to right text, no need for an intermediate image */
+        __imlib_font_draw_direct(im, pixel, run, drx,
+                                 dry + __imlib_font_max_ascent_get(fn),
+                                 op, clx, cly, clw, clh);
+        if (retw)
+            *retw = w;
+        if (reth)
+            *reth = h;
+        if (nextx)
+            *nextx = w;
+        if (nexty)
+            *nexty = __imlib_font_get_line_advance(fn);
+        return;
+    }
+
     /* TODO check if this is the right way of rendering. Esp for huge sizes */
     im2 = __imlib_CreateImage(w, h, NULL, 1);
     if (!im2)
@@ -86,7 +137,7 @@ __imlib_render_str(ImlibImage *im, ImlibFont *fn, int drx, int dry,
     ascent = __imlib_font_max_ascent_get(fn);
 
     nx = ny = 0;
-    __imlib_font_draw(im2, pixel, fn, 0, ascent, text, &nx, &ny, 0, 0, w, h);
+    __imlib_font_draw(im2, pixel, run, 0, ascent, &nx, &ny, 0, 0, w, h);
 
     /* OK, now we have small ImlibImage with text rendered, 
      * have to blend it on im */
@@ -234,20 +285,378 @@ __imlib_render_str(ImlibImage *im, ImlibFont *fn, int drx, int dry,
     /* TODO this function is purely my art -- check once more */
 }
 
+/* Coverage to color table, as __imlib_font_draw() uses */
+static void
+__text_lut(int *lut, uint32_t col)
+{
+    int             ii;
+
+    for (ii = 0; ii < 256; ii++)
+    {
+        lut[ii] = (col & 0x00ffffff);   /* TODO check endianess */
+        lut[ii] |= ((((ii + 1) * (col >> 24)) >> 8) << 24);
+    }
+}
+
+/* Draw the coverage of a glyph with its top left at chr_x, chr_y into the
+ * extents of dst */
+static void
+__text_glyph(ImlibImage *dst, const int *lut, const Imlib_Font_Glyph *fg,
+             int chr_x, int chr_y, int ext_x, int ext_y, int ext_w, int ext_h)
+{
+    uint8_t        *data;
+    uint32_t       *im;
+    int             im_w;
+    int             i, j, w, h;
+
+    im = dst->data;
+    im_w = dst->w;
+    data = fg->coverage;
+    j = fg->width;
+    w = fg->width;
+    h = fg->rows;
+    if (!data || j <= 0 || chr_x + w <= ext_x)
+        return;
+
+    for (i = 0; i < h; i++)
+    {
+        int             dx, dy;
+        int             in_x, in_w;
+
+        in_x = 0;
+        in_w = 0;
+        dx = chr_x;
+        dy = chr_y + i;
+        if ((dx < (ext_x + ext_w)) && (dy >= (ext_y)) &&
+            (dy < (ext_y + ext_h)))
+        {
+            if (dx + w > (ext_x + ext_w))
+                in_w += (dx + w) - (ext_x + ext_w);
+            if (dx < ext_x)
+            {
+                in_w += ext_x - dx;
+                in_x = ext_x - dx;
+                dx = ext_x;
+            }
+            if (in_w < w)
+            {
+                uint8_t        *src_ptr;
+                uint32_t       *dst_ptr;
+                uint32_t       *dst_end_ptr;
+
+                src_ptr = data + (i * j) + in_x;
+                dst_ptr = im + (dy * im_w) + dx;
+                dst_end_ptr = dst_ptr + w - in_w;
+
+                while (dst_ptr < dst_end_ptr)
+                {
+                    /* FIXME Oops! change this op */
+                    if (!*dst_ptr)
+                        *dst_ptr = lut[(unsigned char)*src_ptr];
+                    else if (*src_ptr)
+                    {
+                        /* very rare case - I've never seen symbols 
+                         * overlapped by kerning */
+                        int             tmp;
+
+                        tmp =
+                            (*dst_ptr >> 24) +
+                            (lut[(unsigned char)*src_ptr] >> 24);
+                        tmp = (tmp > 256) ? 256 : tmp;
+                        *dst_ptr &= 0x00ffffff;
+                        *dst_ptr |= (tmp << 24);
+                    }
+
+                    dst_ptr++;
+                    src_ptr++;
+                }
+            }
+        }
+    }
+}
+
+/* A glyph of a batch item, top left in the destination */
+typedef struct {
+    const Imlib_Font_Glyph *fg;
+    int             x, y;
+} ImlibTextBatchGlyph;
+
+/* An item of a batch, clipped as __imlib_font_draw_direct() clips it */
+typedef struct {
+    uint32_t        color;
+    int             clx, cly, clw, clh;
+    int             glyph0, nglyphs;
+} ImlibTextBatchItem;
+
+typedef struct {
+    ImlibImage     *im;
+    ImlibOp         op;
+    const ImlibTextBatchItem *items;
+    const ImlibTextBatchGlyph *glyphs;
+    const int      *band_start;
+    const int      *band_items;
+    int             band_w;     /* Widest clipped item */
+    char           *band_done;
+} ImlibTextBatchJob;
+
+/* Draw rows [y0 .. y1) of an item into the band buffer and blend them, as
+ * __imlib_font_draw_direct() does */
+static void
+__text_batch_item(const ImlibTextBatchJob *tj, ImlibImage *band,
+                  const ImlibTextBatchItem *it, int y0, int y1)
+{
+    const ImlibTextBatchGlyph *gl;
+    ImlibImage     *im = tj->im;
+    int             lut[256];
+    int             k;
+
+    band->w = it->clw;
+    band->h = y1 - y0;
+    memset(band->data, 0, band->w * band->h * sizeof(uint32_t));
+
+    __text_lut(lut, it->color);
+    for (k = 0; k < it->nglyphs; k++)
+    {
+        gl = &tj->glyphs[it->glyph0 + k];
+        __text_glyph(band, lut, gl->fg, gl->x - it->clx, gl->y - y0,
+                     0, 0, band->w, band->h);
+    }
+
+    __imlib_BlendRGBAToData(band->data, band->w, band->h,
+                            im->data, im->w, im->h, 0, 0, it->clx, y0,
+                            band->w, band->h, 1, im->has_alpha, NULL,
+                            tj->op, 0);
+}
+
+/* Draw the items of bands [b0 .. b1), in drawing order */
+static void
+__text_batch_bands(void *data, int b0, int b1)
+{
+    const ImlibTextBatchJob *tj = data;
+    const ImlibTextBatchItem *it;
+    ImlibImage      band;
+    int             b, k;
+
+    memset(&band, 0, sizeof(band));
+    band.data = malloc(tj->band_w * TEXT_BAND_ROWS * sizeof(uint32_t));
+    if (!band.data)
+        return;                 /* Left to the caller */
+
+    for (b = b0; b < b1; b++)
+    {
+        for (k = tj->band_start[b]; k < tj->band_start[b + 1]; k++)
+        {
+            it = &tj->items[tj->band_items[k]];
+            __text_batch_item(tj, &band, it,
+                              MAX(it->cly, b * TEXT_BAND_ROWS),
+                              MIN(it->cly + it->clh,
+                                  (b + 1) * TEXT_BAND_ROWS));
+        }
+        tj->band_done[b] = 1;
+    }
+
+    free(band.data);
+}
+
+/* Left to right items are clipped and sorted into bands of destination
+ * rows, and the bands drawn in parallel. The glyphs are looked up first,
+ * the glyph cache is not for threads. */
+static void
+__text_draw_batch(ImlibImage *im, const ImlibTextItem *items, int n,
+                  ImlibOp op, int clx, int cly, int clw, int clh)
+{
+    ImlibTextBatchJob tj;
+    ImlibTextBatchItem *bitems, *it;
+    ImlibTextBatchGlyph *glyphs, *gl;
+    ImlibTextRun   *run;
+    const ImlibTextGlyph *g;
+    Imlib_Font_Glyph *fg;
+    int            *band_start, *band_items, *band_next;
+    char           *band_done;
+    unsigned int    evictions;
+    int             nitems, nglyphs, nalloc, nbands, band_w;
+    int             i, j, b, x, y, gx;
+
+    if (__imlib_ThreadCount() == 1)
+        goto one_by_one;        /* No point in sorting into bands */
+
+    bitems = malloc(n * sizeof(ImlibTextBatchItem));
+    if (!bitems)
+        goto one_by_one;
+
+    /* Runs are only valid until the next one is got, keep the glyphs that
+     * reach into the clipped boxes. The coverage stays put unless glyph
+     * pages are evicted to make room. */
+    glyphs = NULL;
+    nitems = nglyphs = nalloc = 0;
+    band_w = 0;
+    evictions = __imlib_font_glyphs_evictions();
+    for (i = 0; i < n; i++)
+    {
+        run = __imlib_font_run_get(items[i].fn, items[i].text);
+        if (!run)
+            continue;
+        x = items[i].x;
+        y = items[i].y + __imlib_font_max_ascent_get(run->fn);
+        it = &bitems[nitems];
+        it->color = items[i].color;
+        it->clx = clx;
+        it->cly = cly;
+        it->clw = clw;
+        it->clh = clh;
+        if (!__text_clip(im, run, x, y, &it->clx, &it->cly,
+                         &it->clw, &it->clh))
+            continue;
+        it->glyph0 = nglyphs;
+
+        for (j = 0; j < run->num; j++)
+        {
+            g = &run->glyphs[j];
+            gx = x + (g->x >> 8) + g->left;
+            if (gx >= x + run->advance)
+                break;          /* As __imlib_font_draw() stops */
+            if (gx >= it->clx + it->clw || gx + g->width <= it->clx)
+                continue;
+
+            fg = __imlib_font_cache_glyph_get(g->fn, g->index);
+            if (!fg || !fg->coverage)
+                continue;
+            if (y - fg->top >= it->cly + it->clh ||
+                y - fg->top + fg->rows <= it->cly)
+                continue;
+
+            if (nglyphs >= nalloc)
+            {
+                nalloc = nalloc ? 2 * nalloc : 256;
+                gl = realloc(glyphs, nalloc * sizeof(ImlibTextBatchGlyph));
+                if (!gl)
+                    goto bail;
+                glyphs = gl;
+            }
+            glyphs[nglyphs++] = (ImlibTextBatchGlyph) {
+            fg, gx, y - fg->top};
+        }
+        it->nglyphs = nglyphs - it->glyph0;
+        if (it->clw > band_w)
+            band_w = it->clw;
+        nitems++;
+    }
+    if (__imlib_font_glyphs_evictions() != evictions)
+        goto bail;              /* Too many glyphs for the cache */
+
+    /* Index the items by the bands they touch, keeping their order */
+    nbands = (im->h + TEXT_BAND_ROWS - 1) / TEXT_BAND_ROWS;
+    band_start = calloc(2 * (nbands + 1), sizeof(int));
+    if (!band_start)
+        goto bail;
+    band_next = band_start + nbands + 1;
+    for (i = 0; i < nitems; i++)
+    {
+        for (b = bitems[i].cly / TEXT_BAND_ROWS;
+             b <= (bitems[i].cly + bitems[i].clh - 1) / TEXT_BAND_ROWS; b++)
+            band_start[b + 1]++;
+    }
+    for (b = 0; b < nbands; b++)
+    {
+        band_start[b + 1] += band_start[b];
+        band_next[b] = band_start[b];
+    }
+    band_items = malloc(MAX(band_start[nbands], 1) * sizeof(int));
+    band_done = calloc(MAX(nbands, 1), 1);
+    if (!band_items || !band_done)
+    {
+        free(band_done);
+        free(band_items);
+        free(band_start);
+        goto bail;
+    }
+    for (i = 0; i < nitems; i++)
+    {
+        for (b = bitems[i].cly / TEXT_BAND_ROWS;
+             b <= (bitems[i].cly + bitems[i].clh - 1) / TEXT_BAND_ROWS; b++)
+            band_items[band_next[b]++] = i;
+    }
+
+    tj = (ImlibTextBatchJob) {
+    im, op, bitems, glyphs, band_start, band_items, band_w, band_done};
+    __imlib_ParallelFor(nbands, TEXT_BANDS_MIN, __text_batch_bands, &tj);
+
+    /* Bands a worker had no buffer for */
+    for (b = 0; b < nbands; b++)
+    {
+        if (!band_done[b])
+            __text_batch_bands(&tj, b, b + 1);
+    }
+
+    free(band_done);
+    free(band_items);
+    free(band_start);
+    free(glyphs);
+    free(bitems);
+    return;
+
+  bail:
+    free(glyphs);
+    free(bitems);
+  one_by_one:
+    /* Draw the items one by one */
+    for (i = 0; i < n; i++)
+    {
+        run = __imlib_font_run_get(items[i].fn, items[i].text);
+        if (run)
+            __imlib_font_draw_direct(im, items[i].color, run, items[i].x,
+                                     items[i].y +
+                                     __imlib_font_max_ascent_get(run->fn),
+                                     op, clx, cly, clw, clh);
+    }
+}
+
+void
+__imlib_render_str_items(ImlibImage *im, const ImlibTextItem *items, int n,
+                         double angle, ImlibOp op,
+                         int clx, int cly, int clw, int clh)
+{
+    ImlibTextRun   *run;
+    int             i0, i1, dir;
+
+    for (i0 = 0; i0 < n; i0 = i1)
+    {
+        /* Batch consecutive left to right items */
+        for (i1 = i0; i1 < n; i1++)
+        {
+            dir = items[i1].dir;
+            if (dir != 0 && !(dir == 4 && angle == 0.0))
+                break;
+        }
+        if (i1 > i0)
+        {
+            __text_draw_batch(im, items + i0, i1 - i0, op,
+                              clx, cly, clw, clh);
+            continue;
+        }
+
+        /* Others go through the intermediate image, in order */
+        run = __imlib_font_run_get(items[i0].fn, items[i0].text);
+        if (run)
+            __imlib_render_str(im, run, items[i0].x, items[i0].y,
+                               items[i0].color, items[i0].dir, angle,
+                               NULL, NULL, 0, NULL, NULL, op,
+                               clx, cly, clw, clh);
+        i1 = i0 + 1;
+    }
+}
+
 void
-__imlib_font_draw(ImlibImage *dst, uint32_t col, ImlibFont *fn, int x, int y,
-                  const char *text, int *nextx, int *nexty, int clx, int cly,
+__imlib_font_draw(ImlibImage *dst, uint32_t col, ImlibTextRun *run,
+                  int x, int y, int *nextx, int *nexty, int clx, int cly,
                   int clw, int clh)
 {
-    int             pen_x, pen_y;
-    int             chr;
+    int             pen_x;
+    int             gi;
     int             ext_x, ext_y, ext_w, ext_h;
-    uint32_t       *im;
     int             im_w, im_h;
     int             lut[256];
-    int             ii;
 
-    im = dst->data;
     im_w = dst->w;
     im_h = dst->h;
 
@@ -283,112 +692,29 @@ __imlib_font_draw(ImlibImage *dst, uint32_t col, ImlibFont *fn, int x, int y,
     if (ext_h <= 0)
         return;
 
-    for (ii = 0; ii < 256; ii++)
-    {
-        lut[ii] = (col & 0x00ffffff);   /* TODO check endianess */
-        lut[ii] |= ((((ii + 1) * (col >> 24)) >> 8) << 24);
-    }
+    __text_lut(lut, col);
 
-    pen_x = x << 8;
-    pen_y = y << 8;
-    for (chr = 0; text[chr];)
+    for (gi = 0; gi < run->num; gi++)
     {
-        FT_UInt         index;
         Imlib_Font_Glyph *fg;
-        int             chr_x, chr_y, kern;
+        int             chr_x;
 
-        fg = __imlib_font_get_next_glyph(fn, text, &chr, &index, &kern);
+        pen_x = (x << 8) + run->glyphs[gi].x;
+        fg = __imlib_font_cache_glyph_get(run->glyphs[gi].fn,
+                                          run->glyphs[gi].index);
         if (!fg)
-            break;
-        pen_x += kern;
-        if (fg == IMLIB_GLYPH_NONE)
             continue;
 
-        chr_x = (pen_x + (fg->glyph_out->left << 8)) >> 8;
-        chr_y = (pen_y + (fg->glyph_out->top << 8)) >> 8;
-
-        if (chr_x < (ext_x + ext_w))
-        {
-            uint8_t        *data;
-            int             i, j, w, h;
-
-            data = fg->glyph_out->bitmap.buffer;
-            j = fg->glyph_out->bitmap.pitch;
-            w = fg->glyph_out->bitmap.width;
-            if (j < w)
-                j = w;
-            h = fg->glyph_out->bitmap.rows;
-            if ((fg->glyph_out->bitmap.pixel_mode == ft_pixel_mode_grays) &&
-                (fg->glyph_out->bitmap.num_grays == 256))
-            {
-                if ((j > 0) && (chr_x + w > ext_x))
-                {
-                    for (i = 0; i < h; i++)
-                    {
-                        int             dx, dy;
-                        int             in_x, in_w;
-
-                        in_x = 0;
-                        in_w = 0;
-                        dx = chr_x;
-                        dy = y - (chr_y - i - y);
-                        if ((dx < (ext_x + ext_w)) && (dy >= (ext_y)) &&
-                            (dy < (ext_y + ext_h)))
-                        {
-                            if (dx + w > (ext_x + ext_w))
-                                in_w += (dx + w) - (ext_x + ext_w);
-                            if (dx < ext_x)
-                            {
-                                in_w += ext_x - dx;
-                                in_x = ext_x - dx;
-                                dx = ext_x;
-                            }
-                            if (in_w < w)
-                            {
-                                uint8_t        *src_ptr;
-                                uint32_t       *dst_ptr;
-                                uint32_t       *dst_end_ptr;
-
-                                src_ptr = data + (i * j) + in_x;
-                                dst_ptr = im + (dy * im_w) + dx;
-                                dst_end_ptr = dst_ptr + w - in_w;
-
-                                while (dst_ptr < dst_end_ptr)
-                                {
-                                    /* FIXME Oops! change this op */
-                                    if (!*dst_ptr)
-                                        *dst_ptr = lut[(unsigned char)*src_ptr];
-                                    else if (*src_ptr)
-                                    {
-                                        /* very rare case - I've never seen symbols 
-                                         * overlapped by kerning */
-                                        int             tmp;
-
-                                        tmp =
-                                            (*dst_ptr >> 24) +
-                                            (lut
-                                             [(unsigned char)*src_ptr] >> 24);
-                                        tmp = (tmp > 256) ? 256 : tmp;
-                                        *dst_ptr &= 0x00ffffff;
-                                        *dst_ptr |= (tmp << 24);
-                                    }
-
-                                    dst_ptr++;
-                                    src_ptr++;
-                                }
-                            }
-                        }
-                    }
-                }
-            }
-        }
-        else
+        chr_x = (pen_x + (fg->left << 8)) >> 8;
+        if (chr_x >= (ext_x + ext_w))
             break;
-        pen_x += fg->glyph->advance.x >> 8;
+
+        __text_glyph(dst, lut, fg, chr_x, y - fg->top,
+                     ext_x, ext_y, ext_w, ext_h);
     }
 
     if (nextx)
-        *nextx = (pen_x >> 8) - x;
+        *nextx = run->advance;
     if (nexty)
-        *nexty = __imlib_font_get_line_advance(fn);
+        *nexty = __imlib_font_get_line_advance(run->fn);
 }
@@ -0,0 +1,331 @@
+#include "common.h"
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include <stdlib.h>
+#include <string.h>
+
+#include "font.h"
+
+/*
+ * Glyph cache
+ *
+ * Each font has an open addressing (linear probing) table of its rendered
+ * glyphs, keyed on the glyph index.
+ * The coverage bitmaps are packed into atlas pages owned by the font.
+ * The pages of all fonts share one byte budget, the font cache size (but at
+ * least FONT_GLYPH_CACHE_MIN). When it is exceeded the least recently used
+ * pages are evicted together with their glyphs.
+ */
+
+#define FONT_PAGE_SIZE_MIN      4096
+#define FONT_PAGE_SIZE_MAX      65536
+#define FONT_GLYPH_CACHE_MIN    (4 * 1024 * 1024)
+#define FONT_TABLE_SIZE_MIN     64
+
+struct _Imlib_Font_Page {
+    Imlib_Font_Page *next;
+    ImlibFont      *fn;
+    unsigned int    stamp;      /* Time of last use */
+    int             size, used;
+    uint8_t         data[];
+};
+
+static Imlib_Font_Page *pages = NULL;   /* The atlas pages of all fonts */
+static size_t   pages_size = 0;
+static unsigned int glyph_clock = 0;
+static unsigned int glyph_evictions = 0;
+
+static inline int
+__glyph_hash(FT_UInt key, int mask)
+{
+    unsigned int    h;
+
+    h = key * 0x9e3779b1U;
+    return (h ^ (h >> 16)) & mask;
+}
+
+/* Remove slot i, moving the following glyphs of the cluster up as needed */
+static void
+__glyph_table_del(ImlibFont *fn, int i)
+{
+    Imlib_Font_Glyph *slots = fn->glyphs.slots;
+    int             mask = fn->glyphs.mask;
+    int             j, k;
+
+    for (j = i;;)
+    {
+        j = (j + 1) & mask;
+        if (!slots[j].key)
+            break;
+        /* Glyph j can fill the hole if its home slot k is not in (i, j] */
+        k = __glyph_hash(slots[j].key, mask);
+        if (i <= j ? (k <= i || k > j) : (k <= i && k > j))
+        {
+            slots[i] = slots[j];
+            i = j;
+        }
+    }
+    slots[i].key = 0;
+    fn->glyphs.num--;
+}
+
+static int
+__glyph_table_grow(ImlibFont *fn)
+{
+    Imlib_Font_Glyph *slots, *fg, *end;
+    int             size, mask, i;
+
+    size = fn->glyphs.slots ? 2 * (fn->glyphs.mask + 1) : FONT_TABLE_SIZE_MIN;
+    slots = calloc(size, sizeof(Imlib_Font_Glyph));
+    if (!slots)
+        return -1;
+    mask = size - 1;
+
+    if (fn->glyphs.slots)
+    {
+        end = fn->glyphs.slots + fn->glyphs.mask + 1;
+        for (fg = fn->glyphs.slots; fg < end; fg++)
+        {
+            if (!fg->key)
+                continue;
+            for (i = __glyph_hash(fg->key, mask); slots[i].key;
+                 i = (i + 1) & mask)
+                ;
+            slots[i] = *fg;
+        }
+        free(fn->glyphs.slots);
+    }
+    fn->glyphs.slots = slots;
+    fn->glyphs.mask = mask;
+
+    return 0;
+}
+
+static void
+__glyph_page_unlink(Imlib_Font_Page *pg)
+{
+    Imlib_Font_Page **pp;
+
+    for (pp = &pages; *pp != pg; pp = &(*pp)->next)
+        ;
+    *pp = pg->next;
+    pages_size -= sizeof(Imlib_Font_Page) + pg->size;
+    if (pg->fn->page == pg)
+        pg->fn->page = NULL;
+}
+
+/* Evict the least recently used page and its glyphs */
+static void
+__glyph_page_evict(void)
+{
+    Imlib_Font_Page *pg, *lru;
+    ImlibFont      *fn;
+    int             i;
+
+    lru = pages;
+    for (pg = pages; pg; pg = pg->next)
+    {
+        if (glyph_clock - pg->stamp > glyph_clock - lru->stamp)
+            lru = pg;
+    }
+
+    fn = lru->fn;
+    for (i = 0; i <= fn->glyphs.mask && fn->glyphs.num > 0;)
+    {
+        if (fn->glyphs.slots[i].key && fn->glyphs.slots[i].page == lru)
+            __glyph_table_del(fn, i);   /* Slot i may be refilled */
+        else
+            i++;
+    }
+
+    __glyph_page_unlink(lru);
+    free(lru);
+    glyph_evictions++;
+}
+
+static void
+__glyph_cache_fit(size_t size)
+{
+    size_t          max;
+
+    max = MAX(__imlib_font_cache_get(), FONT_GLYPH_CACHE_MIN);
+    while (pages && pages_size + size > max)
+        __glyph_page_evict();
+}
+
+/* Space for n coverage bytes in the font's atlas */
+static uint8_t *
+__glyph_page_alloc(ImlibFont *fn, int n, Imlib_Font_Page **ppg)
+{
+    Imlib_Font_Page *pg;
+    uint8_t        *p;
+    int             size;
+
+    pg = fn->page;
+    if (!pg || pg->size - pg->used < n)
+    {
+        /* Small fonts get small pages */
+        size = pg ? MIN(2 * pg->size, FONT_PAGE_SIZE_MAX) : FONT_PAGE_SIZE_MIN;
+        size = MAX(size, n);
+        __glyph_cache_fit(sizeof(Imlib_Font_Page) + size);
+
+        pg = malloc(sizeof(Imlib_Font_Page) + size);
+        if (!pg)
+            return NULL;
+        pg->fn = fn;
+        pg->size = size;
+        pg->used = 0;
+        pg->next = pages;
+        pages = pg;
+        pages_size += sizeof(Imlib_Font_Page) + size;
+        fn->page = pg;
+    }
+
+    p = pg->data + pg->used;
+    pg->used += n;
+    pg->stamp = glyph_clock;
+    *ppg = pg;
+
+    return p;
+}
+
+/* Copy the coverage, 256 level grays or mono */
+static void
+__glyph_coverage_copy(uint8_t *dst, const FT_Bitmap *bm)
+{
+    const uint8_t  *src;
+    int             x, y;
+
+    src = bm->buffer;
+    if (bm->pitch < 0)
+        src -= (bm->rows - 1) * bm->pitch;
+    for (y = 0; y < (int)bm->rows; y++, src += bm->pitch, dst += bm->width)
+    {
+        if (bm->pixel_mode == FT_PIXEL_MODE_GRAY)
+            memcpy(dst, src, bm->width);
+        else
+            for (x = 0; x < (int)bm->width; x++)
+                dst[x] = (src[x >> 3] & (0x80 >> (x & 7))) ? 0xff : 0;
+    }
+}
+
+static Imlib_Font_Glyph *
+__glyph_add(ImlibFont *fn, FT_UInt index)
+{
+    FT_GlyphSlot    slot;
+    const FT_Bitmap *bm;
+    Imlib_Font_Glyph gl, *fg;
+    int             i;
+
+    __imlib_font_activate(fn);
+    if (FT_Load_Glyph(fn->ft.face, index, FT_LOAD_NO_BITMAP))
+        return NULL;
+    slot = fn->ft.face->glyph;
+    if (slot->format != FT_GLYPH_FORMAT_BITMAP &&
+        FT_Render_Glyph(slot, FT_RENDER_MODE_NORMAL))
+        return NULL;
+    /* The advance must fit 16.16 */
+    if (slot->advance.x >= 0x8000L * 64 || slot->advance.x <= -0x8000L * 64)
+        return NULL;
+
+    bm = &slot->bitmap;
+    gl = (Imlib_Font_Glyph) {
+        index + 1, slot->bitmap_left, slot->bitmap_top, bm->width, bm->rows,
+        slot->advance.x * 1024, NULL, NULL
+    };
+
+    /* Keep the load below 3/4. Grown before the coverage is put in the
+     * atlas, which can't be given back on failure. */
+    if (4 * (fn->glyphs.num + 1) > 3 * (fn->glyphs.mask + 1) &&
+        __glyph_table_grow(fn))
+        return NULL;
+
+    /* Other pixel modes are kept, but not drawn */
+    if (gl.width > 0 && gl.rows > 0 &&
+        ((bm->pixel_mode == FT_PIXEL_MODE_GRAY && bm->num_grays == 256) ||
+         bm->pixel_mode == FT_PIXEL_MODE_MONO))
+    {
+        gl.coverage = __glyph_page_alloc(fn, gl.width * gl.rows, &gl.page);
+        if (!gl.coverage)
+            return NULL;
+        __glyph_coverage_copy(gl.coverage, bm);
+    }
+
+    for (i = __glyph_hash(gl.key, fn->glyphs.mask); fn->glyphs.slots[i].key;
+         i = (i + 1) & fn->glyphs.mask)
+        ;
+    fg = &fn->glyphs.slots[i];
+    *fg = gl;
+    fn->glyphs.num++;
+
+    return fg;
+}
+
+Imlib_Font_Glyph *
+__imlib_font_cache_glyph_get(ImlibFont *fn, FT_UInt index)
+{
+    Imlib_Font_Glyph *fg;
+    FT_UInt         key;
+    int             i;
+
+    glyph_clock++;
+    key = index + 1;
+    if (fn->glyphs.slots)
+    {
+        for (i = __glyph_hash(key, fn->glyphs.mask);;
+             i = (i + 1) & fn->glyphs.mask)
+        {
+            fg = &fn->glyphs.slots[i];
+            if (fg->key == key)
+            {
+                if (fg->page)
+                    fg->page->stamp = glyph_clock;
+                return fg;
+            }
+            if (!fg->key)
+                break;
+        }
+    }
+
+    return __glyph_add(fn, index);
+}
+
+void
+__imlib_font_glyphs_free(ImlibFont *fn)
+{
+    Imlib_Font_Page **pp, *pg;
+
+    for (pp = &pages; (pg = *pp);)
+    {
+        if (pg->fn == fn)
+        {
+            *pp = pg->next;
+            pages_size -= sizeof(Imlib_Font_Page) + pg->size;
+            free(pg);
+        }
+        else
+        {
+            pp = &pg->next;
+        }
+    }
+    fn->page = NULL;
+
+    free(fn->glyphs.slots);
+    fn->glyphs.slots = NULL;
+    fn->glyphs.mask = fn->glyphs.num = 0;
+}
+
+void
+__imlib_font_glyphs_trim(void)
+{
+    __glyph_cache_fit(0);
+}
+
+/* Number of page evictions so far, coverage pointers obtained before the
+ * count changes may be stale */
+unsigned int
+__imlib_font_glyphs_evictions(void)
+{
+    return glyph_evictions;
+}
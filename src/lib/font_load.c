@@ -3,10 +3,21 @@
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #include FT_GLYPH_H
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "file.h"
 #include "font.h"
 
+/* Buckets of the loaded fonts index */
+#define FONT_INDEX_SIZE     256
+/* Font files per directory read ahead when added to the font path */
+#define FONT_PREWARM_MAX    64
+
 extern FT_Library ft_lib;
 
 static int      font_cache_usage = 0;
@@ -14,12 +25,10 @@ static int      font_cache = 0;
 static char   **fpath = NULL;
 static int      fpath_num = 0;
 static Imlib_Object_List *fonts = NULL;
+static ImlibFont *font_index[FONT_INDEX_SIZE];
+static ImlibFontFace *faces = NULL;
 
 static ImlibFont *__imlib_font_load(const char *name, int faceidx, int size);
-static int      font_modify_cache_cb(Imlib_Hash * hash, const char *key,
-                                     void *data, void *fdata);
-static int      font_flush_free_glyph_cb(Imlib_Hash * hash, const char *key,
-                                         void *data, void *fdata);
 
 /* FIXME now! listdir() from evas_object_text.c */
 
@@ -124,28 +133,129 @@ __imlib_font_load_joined(const char *fontname)
     return fn;
 }
 
+static unsigned int
+__font_hash(const char *file, int faceidx, int size)
+{
+    unsigned int    h;
+
+    /* FNV-1a */
+    for (h = 2166136261U; *file; file++)
+        h = (h ^ (uint8_t) * file) * 16777619U;
+    h = (h ^ faceidx) * 16777619U;
+    h = (h ^ size) * 16777619U;
+
+    return h;
+}
+
+/* Get the shared face of the file, mapping it in if needed */
+static ImlibFontFace *
+__font_face_get(const char *file, int faceidx)
+{
+    ImlibFontFace  *ff;
+    FILE           *fp;
+    struct stat     st;
+
+    for (ff = faces; ff; ff = ff->next)
+    {
+        if (ff->faceidx == faceidx && !strcmp(ff->file, file))
+        {
+            ff->references++;
+            return ff;
+        }
+    }
+
+    ff = calloc(1, sizeof(ImlibFontFace));
+    if (!ff)
+        return NULL;
+
+    fp = __imlib_FileOpen(file, "rb", &st);
+    if (!fp)
+        goto bail;
+    ff->map_size = st.st_size;
+    ff->map = mmap(NULL, ff->map_size, PROT_READ, MAP_SHARED, fileno(fp), 0);
+    fclose(fp);
+    if (ff->map == MAP_FAILED)
+    {
+        ff->map = NULL;
+        goto bail;
+    }
+
+    if (FT_New_Memory_Face(ft_lib, ff->map, ff->map_size, faceidx, &ff->face))
+        goto bail;
+    ff->file = strdup(file);
+    if (!ff->file)
+        goto bail;
+    ff->faceidx = faceidx;
+    ff->references = 1;
+    ff->next = faces;
+    faces = ff;
+
+    return ff;
+
+  bail:
+    if (ff->face)
+        FT_Done_Face(ff->face);
+    if (ff->map)
+        munmap(ff->map, ff->map_size);
+    free(ff);
+    return NULL;
+}
+
+static void
+__font_face_put(ImlibFontFace *ff)
+{
+    ImlibFontFace **pff;
+
+    if (--ff->references > 0)
+        return;
+
+    for (pff = &faces; *pff != ff; pff = &(*pff)->next)
+        ;
+    *pff = ff->next;
+
+    FT_Done_Face(ff->face);
+    munmap(ff->map, ff->map_size);
+    free(ff->file);
+    free(ff);
+}
+
 static ImlibFont *
 __imlib_font_load(const char *name, int faceidx, int size)
 {
     int             error;
     ImlibFont      *fn;
+    ImlibFontFace  *ff;
     char           *file;
 
-    fn = __imlib_font_find(name, size);
+    fn = __imlib_font_find(name, faceidx, size);
     if (fn)
         return fn;
 
     __imlib_font_init();
 
     fn = malloc(sizeof(ImlibFont));
+    if (!fn)
+        return NULL;
     file = (char *)name;
 
-    error = FT_New_Face(ft_lib, file, faceidx, &(fn->ft.face));
+    /* One face per file and index, each font has its own size of it */
+    ff = __font_face_get(file, faceidx);
+    if (!ff)
+    {
+        free(fn);
+        return NULL;
+    }
+    fn->ft.shared = ff;
+    fn->ft.face = ff->face;
+    error = FT_New_Size(fn->ft.face, &fn->ft.size);
     if (error)
     {
+        __font_face_put(ff);
         free(fn);
         return NULL;
     }
+    FT_Activate_Size(fn->ft.size);
+
     error = FT_Set_Char_Size(fn->ft.face, 0, (size * 64), 96, 96);
     if (error)
         error = FT_Set_Pixel_Sizes(fn->ft.face, 0, size);
@@ -189,9 +299,12 @@ __imlib_font_load(const char *name, int faceidx, int size)
 
     fn->file = strdup(file);
     fn->name = strdup(file);
+    fn->faceidx = faceidx;
     fn->size = size;
 
-    fn->glyphs = NULL;
+    fn->glyphs.slots = NULL;
+    fn->glyphs.mask = fn->glyphs.num = 0;
+    fn->page = NULL;
 
     fn->usage = 0;
 
@@ -201,6 +314,11 @@ __imlib_font_load(const char *name, int faceidx, int size)
     fn->fallback_next = NULL;
 
     fonts = __imlib_object_list_prepend(fonts, fn);
+
+    fn->hash = __font_hash(fn->name, faceidx, size);
+    fn->index_next = font_index[fn->hash % FONT_INDEX_SIZE];
+    font_index[fn->hash % FONT_INDEX_SIZE] = fn;
+
     return fn;
 }
 
@@ -235,12 +353,17 @@ __imlib_font_insert_into_fallback_chain_imp(ImlibFont *fn, ImlibFont *fallback)
     fallback->fallback_next = tmp;
     if (tmp)
         tmp->fallback_prev = fallback;
+    __imlib_font_run_invalidate();
     return 0;
 }
 
 void
 __imlib_font_remove_from_fallback_chain_imp(ImlibFont *fn)
 {
+    /* Runs laid out with the chain are stale */
+    if (fn->fallback_prev || fn->fallback_next)
+        __imlib_font_run_invalidate();
+
     /* if fn has a previous font in its font chain, then make its fallback_next fn's fallback_next since fn is going away */
     if (fn->fallback_prev)
         fn->fallback_prev->fallback_next = fn->fallback_next;
@@ -248,31 +371,17 @@ __imlib_font_remove_from_fallback_chain_imp(ImlibFont *fn)
     fn->fallback_next = NULL;
 }
 
-static int
-font_modify_cache_cb(Imlib_Hash *hash, const char *key, void *data, void *fdata)
-{
-    int            *dir;
-    Imlib_Font_Glyph *fg;
-
-    fg = data;
-    dir = fdata;
-    font_cache_usage += (*dir) * ((fg->glyph_out->bitmap.width * fg->glyph_out->bitmap.rows) + sizeof(Imlib_Font_Glyph) + sizeof(Imlib_Object_List) + 400);     /* fudge values */
-    return 1;
-}
-
 void
 __imlib_font_modify_cache_by(ImlibFont *fn, int dir)
 {
-    int             sz_name = 0, sz_file = 0, sz_hash = 0;
+    int             sz_name = 0, sz_file = 0;
 
     if (fn->name)
         sz_name = strlen(fn->name);
     if (fn->file)
         sz_file = strlen(fn->file);
-    if (fn->glyphs)
-        sz_hash = sizeof(Imlib_Hash);
-    __imlib_hash_foreach(fn->glyphs, font_modify_cache_cb, &dir);
-    font_cache_usage += dir * (sizeof(ImlibFont) + sz_name + sz_file + sz_hash + sizeof(FT_FaceRec) + 16384);   /* fudge values */
+    /* The glyphs are accounted for by the glyph cache */
+    font_cache_usage += dir * (sizeof(ImlibFont) + sz_name + sz_file + sizeof(FT_FaceRec) + 16384);     /* fudge values */
 }
 
 int
@@ -286,6 +395,7 @@ __imlib_font_cache_set(int size)
 {
     font_cache = size;
     __imlib_font_flush();
+    __imlib_font_glyphs_trim();
 }
 
 void
@@ -297,23 +407,11 @@ __imlib_font_flush(void)
         __imlib_font_flush_last();
 }
 
-static int
-font_flush_free_glyph_cb(Imlib_Hash *hash, const char *key, void *data,
-                         void *fdata)
-{
-    Imlib_Font_Glyph *fg;
-
-    fg = data;
-    FT_Done_Glyph(fg->glyph);
-    free(fg);
-    return 1;
-}
-
 void
 __imlib_font_flush_last(void)
 {
     Imlib_Object_List *l;
-    ImlibFont      *fn = NULL;
+    ImlibFont      *fn = NULL, **pfn;
 
     for (l = fonts; l; l = l->next)
     {
@@ -327,28 +425,33 @@ __imlib_font_flush_last(void)
         return;
 
     fonts = __imlib_object_list_remove(fonts, fn);
+    for (pfn = &font_index[fn->hash % FONT_INDEX_SIZE]; *pfn != fn;
+         pfn = &(*pfn)->index_next)
+        ;
+    *pfn = fn->index_next;
     __imlib_font_modify_cache_by(fn, -1);
+    __imlib_font_run_invalidate();
 
-    __imlib_hash_foreach(fn->glyphs, font_flush_free_glyph_cb, NULL);
-    __imlib_hash_free(fn->glyphs);
+    __imlib_font_glyphs_free(fn);
 
     free(fn->file);
     free(fn->name);
-    FT_Done_Face(fn->ft.face);
+    FT_Done_Size(fn->ft.size);
+    __font_face_put(fn->ft.shared);
     free(fn);
 }
 
 ImlibFont      *
-__imlib_font_find(const char *name, int size)
+__imlib_font_find(const char *name, int faceidx, int size)
 {
-    Imlib_Object_List *l;
+    ImlibFont      *fn;
+    unsigned int    hash;
 
-    for (l = fonts; l; l = l->next)
+    hash = __font_hash(name, faceidx, size);
+    for (fn = font_index[hash % FONT_INDEX_SIZE]; fn; fn = fn->index_next)
     {
-        ImlibFont      *fn;
-
-        fn = (ImlibFont *) l;
-        if ((fn->size == size) && (!strcmp(name, fn->name)))
+        if (fn->hash == hash && fn->size == size && fn->faceidx == faceidx &&
+            !strcmp(name, fn->name))
         {
             if (fn->references == 0)
                 __imlib_font_modify_cache_by(fn, -1);
@@ -361,6 +464,60 @@ __imlib_font_find(const char *name, int size)
     return NULL;
 }
 
+/* Whether file is named like a font FreeType reads */
+static int
+__font_file_ext(const char *file)
+{
+    static const char *const exts[] = {
+        "ttf", "otf", "ttc", "otc", "pfa", "pfb", "pcf", "bdf", "pfr",
+    };
+    const char     *p;
+    unsigned int    i;
+
+    p = strrchr(file, '.');
+    if (!p)
+        return 0;
+    for (i = 0; i < sizeof(exts) / sizeof(exts[0]); i++)
+    {
+        if (strcasecmp(p + 1, exts[i]) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+/* Have the kernel read the font files of a new path ahead, so the fonts
+ * load from the page cache later.
+ * The font listing opens each file with FreeType to tell fonts from other
+ * files, too costly here, so files are picked by their extension. */
+static void
+__font_path_prewarm(const char *path)
+{
+    char          **dir, *file;
+    int             i, j, n, fd;
+
+    dir = __imlib_FileDir(path, &n);
+    if (!dir)
+        return;
+    for (i = j = 0; i < n && j < FONT_PREWARM_MAX; i++)
+    {
+        if (!__font_file_ext(dir[i]))
+            continue;
+        j++;
+        file = malloc(strlen(path) + strlen(dir[i]) + 2);
+        if (!file)
+            break;
+        sprintf(file, "%s/%s", path, dir[i]);
+        fd = open(file, O_RDONLY);
+        if (fd >= 0)
+        {
+            posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+            close(fd);
+        }
+        free(file);
+    }
+    __imlib_FileFreeDirList(dir, n);
+}
+
 /* font pathes */
 void
 __imlib_font_add_font_path(const char *path)
@@ -371,6 +528,8 @@ __imlib_font_add_font_path(const char *path)
     else
         fpath = realloc(fpath, (fpath_num * sizeof(char *)));
     fpath[fpath_num - 1] = strdup(path);
+
+    __font_path_prewarm(path);
 }
 
 void
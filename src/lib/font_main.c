@@ -8,6 +8,11 @@
 
 FT_Library      ft_lib;
 
+/* The metrics are scaled as if units_per_EM were 2048 (an old hack, which
+ * used to write that into the face, and so changed the glyphs loaded
+ * after it) */
+#define FONT_EM_SQUARED (2048 * 2048)
+
 void
 __imlib_font_init(void)
 {
@@ -29,11 +34,7 @@ __imlib_font_ascent_get(ImlibFont *fn)
     int             ret;
 
     val = (int)fn->ft.face->ascender;
-    fn->ft.face->units_per_EM = 2048;   /* nasy hack - need to have correct 
-                                         * val */
-    ret =
-        (val * fn->ft.face->size->metrics.y_scale) /
-        (fn->ft.face->units_per_EM * fn->ft.face->units_per_EM);
+    ret = (val * fn->ft.size->metrics.y_scale) / FONT_EM_SQUARED;
     return ret;
 }
 
@@ -44,11 +45,7 @@ __imlib_font_descent_get(ImlibFont *fn)
     int             ret;
 
     val = -(int)fn->ft.face->descender;
-    fn->ft.face->units_per_EM = 2048;   /* nasy hack - need to have correct 
-                                         * val */
-    ret =
-        (val * fn->ft.face->size->metrics.y_scale) /
-        (fn->ft.face->units_per_EM * fn->ft.face->units_per_EM);
+    ret = (val * fn->ft.size->metrics.y_scale) / FONT_EM_SQUARED;
     return ret;
 }
 
@@ -59,11 +56,7 @@ __imlib_font_max_ascent_get(ImlibFont *fn)
     int             ret;
 
     val = (int)fn->ft.face->bbox.yMax;
-    fn->ft.face->units_per_EM = 2048;   /* nasy hack - need to have correct 
-                                         * val */
-    ret =
-        (val * fn->ft.face->size->metrics.y_scale) /
-        (fn->ft.face->units_per_EM * fn->ft.face->units_per_EM);
+    ret = (val * fn->ft.size->metrics.y_scale) / FONT_EM_SQUARED;
     return ret;
 }
 
@@ -74,11 +67,7 @@ __imlib_font_max_descent_get(ImlibFont *fn)
     int             ret;
 
     val = (int)fn->ft.face->bbox.yMin;
-    fn->ft.face->units_per_EM = 2048;   /* nasy hack - need to have correct 
-                                         * val */
-    ret =
-        (val * fn->ft.face->size->metrics.y_scale) /
-        (fn->ft.face->units_per_EM * fn->ft.face->units_per_EM);
+    ret = (val * fn->ft.size->metrics.y_scale) / FONT_EM_SQUARED;
     return ret;
 }
 
@@ -89,11 +78,7 @@ __imlib_font_get_line_advance(ImlibFont *fn)
     int             ret;
 
     val = (int)fn->ft.face->height;
-    fn->ft.face->units_per_EM = 2048;   /* nasy hack - need to have correct 
-                                         * val */
-    ret =
-        (val * fn->ft.face->size->metrics.y_scale) /
-        (fn->ft.face->units_per_EM * fn->ft.face->units_per_EM);
+    ret = (val * fn->ft.size->metrics.y_scale) / FONT_EM_SQUARED;
     return ret;
 }
 
@@ -190,7 +175,7 @@ __imlib_font_find_glyph(ImlibFont *first_fn, int gl, unsigned int *ret_index)
 
 Imlib_Font_Glyph *
 __imlib_font_get_next_glyph(ImlibFont *fn, const char *utf8, int *cindx,
-                            FT_UInt *pindex, int *pkern)
+                            FT_UInt *pindex, int *pkern, ImlibFont **pfn)
 {
     FT_UInt         index;
     Imlib_Font_Glyph *fg;
@@ -208,6 +193,7 @@ __imlib_font_get_next_glyph(ImlibFont *fn, const char *utf8, int *cindx,
     {
         FT_Vector       delta;
 
+        __imlib_font_activate(fn_in_chain);
         FT_Get_Kerning(fn_in_chain->ft.face, *pindex, index,
                        ft_kerning_default, &delta);
         kern = delta.x << 2;
@@ -220,6 +206,8 @@ __imlib_font_get_next_glyph(ImlibFont *fn, const char *utf8, int *cindx,
         return IMLIB_GLYPH_NONE;
 
     *pindex = index;
+    if (pfn)
+        *pfn = fn_in_chain;
 
     return fg;
 }
@@ -10,144 +10,80 @@ extern FT_Library ft_lib;
 
 /* string extents */
 void
-__imlib_font_query_size(ImlibFont *fn, const char *text, int *w, int *h)
+__imlib_font_query_size(ImlibTextRun *run, int *w, int *h)
 {
-    int             pen_x /*, pen_y */ ;
-    int             start_x, end_x;
-    int             chr;
-
-    start_x = 0;
-    end_x = 0;
-    pen_x = 0;
-/* pen_y = 0; */
-    for (chr = 0; text[chr];)
-    {
-        FT_UInt         index;
-        Imlib_Font_Glyph *fg;
-        int             chr_x, /*chr_y, */ chr_w, kern;
-
-        fg = __imlib_font_get_next_glyph(fn, text, &chr, &index, &kern);
-        if (!fg)
-            break;
-        pen_x += kern;
-        if (fg == IMLIB_GLYPH_NONE)
-            continue;
-
-        chr_x = (pen_x >> 8) + fg->glyph_out->left;
-/*      chr_y = (pen_y >> 8) + fg->glyph_out->top; */
-        chr_w = fg->glyph_out->bitmap.width;
-
-        if (pen_x == 0)
-            start_x = chr_x;
-        if ((chr_x + chr_w) > end_x)
-            end_x = chr_x + chr_w;
-
-        pen_x += fg->glyph->advance.x >> 8;
-    }
     if (w)
-        *w = (pen_x >> 8) - start_x;
+        *w = run->width;
     if (h)
-        *h = __imlib_font_max_ascent_get(fn) - __imlib_font_max_descent_get(fn);        /* TODO: compute this inside the loop since we now may be dealing with multiple fonts */
+        *h = __imlib_font_max_ascent_get(run->fn) - __imlib_font_max_descent_get(run->fn);        /* TODO: compute this inside the loop since we now may be dealing with multiple fonts */
 }
 
 /* text x inset */
 int
-__imlib_font_query_inset(ImlibFont *fn, const char *text)
+__imlib_font_query_inset(ImlibTextRun *run)
 {
-    FT_UInt         index;
-    Imlib_Font_Glyph *fg;
-    int             chr;
-
-    chr = 0;
-    if (!text[0])
-        return 0;
-
-    fg = __imlib_font_get_next_glyph(fn, text, &chr, &index, NULL);
-    if (!fg || fg == IMLIB_GLYPH_NONE)
-        return 0;
-
-    return -fg->glyph_out->left;
+    return run->inset;
 }
 
 /* h & v advance */
 void
-__imlib_font_query_advance(ImlibFont *fn, const char *text, int *h_adv,
-                           int *v_adv)
+__imlib_font_query_advance(ImlibTextRun *run, int *h_adv, int *v_adv)
 {
-    int             pen_x;
-    int             start_x;
-    int             chr;
+    if (v_adv)
+        *v_adv = __imlib_font_get_line_advance(run->fn);        /* TODO: compute this in the loop since we may be dealing with multiple fonts */
+    if (h_adv)
+        *h_adv = run->advance;
+}
 
-    start_x = 0;
-    pen_x = 0;
-    for (chr = 0; text[chr];)
+/* x and w of the character of glyph g, extended left to the end of the
+ * previous one */
+static void
+__query_char_box(ImlibTextRun *run, const ImlibTextGlyph *g,
+                 int *prev_chr_end, int *pchr_x, int *pchr_w)
+{
+    int             chr_x, chr_w, kern;
+
+    kern = g->kern;
+    if (kern < 0)
+        kern = 0;
+    chr_x = ((g->x - kern) >> 8) + g->left;
+    chr_w = g->width + (kern >> 8);
+    if (g->chr_end < run->len)
     {
-        FT_UInt         index;
-        Imlib_Font_Glyph *fg;
-        int             kern;
+        int             advw;
 
-        fg = __imlib_font_get_next_glyph(fn, text, &chr, &index, &kern);
-        if (!fg)
-            break;
-        pen_x += kern;
-        if (fg == IMLIB_GLYPH_NONE)
-            continue;
-
-        pen_x += fg->glyph->advance.x >> 8;
+        advw = ((g->advance + (kern << 8)) >> 16);
+        if (chr_w < advw)
+            chr_w = advw;
     }
-    if (v_adv)
-        *v_adv = __imlib_font_get_line_advance(fn);     /* TODO: compute this in the loop since we may be dealing with multiple fonts */
-    if (h_adv)
-        *h_adv = (pen_x >> 8) - start_x;
+    if (chr_x > *prev_chr_end)
+    {
+        chr_w += (chr_x - *prev_chr_end);
+        chr_x = *prev_chr_end;
+    }
+    *prev_chr_end = chr_x + chr_w;
+    *pchr_x = chr_x;
+    *pchr_w = chr_w;
 }
 
 /* x y w h for char at char pos */
 int
-__imlib_font_query_char_coords(ImlibFont *fn, const char *text, int pos,
+__imlib_font_query_char_coords(ImlibTextRun *run, int pos,
                                int *cx, int *cy, int *cw, int *ch)
 {
-    int             pen_x;
     int             prev_chr_end;
-    int             chr;
     int             asc, desc;
+    int             i;
 
-    pen_x = 0;
     prev_chr_end = 0;
-    asc = __imlib_font_max_ascent_get(fn);
-    desc = __imlib_font_max_descent_get(fn);
-    for (chr = 0; text[chr];)
+    asc = __imlib_font_max_ascent_get(run->fn);
+    desc = __imlib_font_max_descent_get(run->fn);
+    for (i = 0; i < run->num; i++)
     {
-        int             pchr;
-        FT_UInt         index;
-        Imlib_Font_Glyph *fg;
-        int             chr_x, chr_w, kern;
-
-        pchr = chr;
-        fg = __imlib_font_get_next_glyph(fn, text, &chr, &index, &kern);
-        if (!fg)
-            break;
-        pen_x += kern;
-        if (fg == IMLIB_GLYPH_NONE)
-            continue;
+        int             chr_x, chr_w;
 
-        if (kern < 0)
-            kern = 0;
-        chr_x = ((pen_x - kern) >> 8) + fg->glyph_out->left;
-        chr_w = fg->glyph_out->bitmap.width + (kern >> 8);
-        if (text[chr])
-        {
-            int             advw;
-
-            advw = ((fg->glyph->advance.x + (kern << 8)) >> 16);
-            if (chr_w < advw)
-                chr_w = advw;
-        }
-        if (chr_x > prev_chr_end)
-        {
-            chr_w += (chr_x - prev_chr_end);
-            chr_x = prev_chr_end;
-        }
-        if (pchr == pos)
+        __query_char_box(run, &run->glyphs[i], &prev_chr_end, &chr_x, &chr_w);
+        if (run->glyphs[i].chr == pos)
         {
             if (cx)
                 *cx = chr_x;
@@ -159,58 +95,27 @@ __imlib_font_query_char_coords(ImlibFont *fn, const char *text, int pos,
                 *ch = asc + desc;
             return 1;
         }
-        prev_chr_end = chr_x + chr_w;
-        pen_x += fg->glyph->advance.x >> 8;
     }
     return 0;
 }
 
 /* char pos of text at xy pos */
 int
-__imlib_font_query_text_at_pos(ImlibFont *fn, const char *text, int x, int y,
+__imlib_font_query_text_at_pos(ImlibTextRun *run, int x, int y,
                                int *cx, int *cy, int *cw, int *ch)
 {
-    int             pen_x;
     int             prev_chr_end;
-    int             chr;
     int             asc, desc;
+    int             i;
 
-    pen_x = 0;
     prev_chr_end = 0;
-    asc = __imlib_font_max_ascent_get(fn);
-    desc = __imlib_font_max_descent_get(fn);
-    for (chr = 0; text[chr];)
+    asc = __imlib_font_max_ascent_get(run->fn);
+    desc = __imlib_font_max_descent_get(run->fn);
+    for (i = 0; i < run->num; i++)
     {
-        int             pchr;
-        FT_UInt         index;
-        Imlib_Font_Glyph *fg;
-        int             chr_x, chr_w, kern;
-
-        pchr = chr;
-        fg = __imlib_font_get_next_glyph(fn, text, &chr, &index, &kern);
-        if (!fg)
-            break;
-        pen_x += kern;
-        if (fg == IMLIB_GLYPH_NONE)
-            continue;
-
-        if (kern < 0)
-            kern = 0;
-        chr_x = ((pen_x - kern) >> 8) + fg->glyph_out->left;
-        chr_w = fg->glyph_out->bitmap.width + (kern >> 8);
-        if (text[chr])
-        {
-            int             advw;
+        int             chr_x, chr_w;
 
-            advw = ((fg->glyph->advance.x + (kern << 8)) >> 16);
-            if (chr_w < advw)
-                chr_w = advw;
-        }
-        if (chr_x > prev_chr_end)
-        {
-            chr_w += (chr_x - prev_chr_end);
-            chr_x = prev_chr_end;
-        }
+        __query_char_box(run, &run->glyphs[i], &prev_chr_end, &chr_x, &chr_w);
         if ((x >= chr_x) && (x <= (chr_x + chr_w)) && (y > -asc) && (y < desc))
         {
             if (cx)
@@ -221,10 +126,8 @@ __imlib_font_query_text_at_pos(ImlibFont *fn, const char *text, int x, int y,
                 *cw = chr_w;
             if (ch)
                 *ch = asc + desc;
-            return pchr;
+            return run->glyphs[i].chr;
         }
-        prev_chr_end = chr_x + chr_w;
-        pen_x += fg->glyph->advance.x >> 8;
     }
     return -1;
 }
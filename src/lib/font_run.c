@@ -0,0 +1,201 @@
+#include "common.h"
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include <stdlib.h>
+#include <string.h>
+
+#include "font.h"
+
+/*
+ * Text runs
+ *
+ * Laying out a string walks the UTF-8, finds each character in the
+ * fallback chain, applies kerning and gets the glyph metrics. The result
+ * is kept in a run of positioned glyph indices so measuring and drawing
+ * the same string again only has to look the glyphs up.
+ *
+ * Recently used runs are cached in a small set associative table keyed on
+ * (font, text). Runs of long strings are not cached, the last one is kept
+ * until the next lookup.
+ */
+
+#define FONT_RUN_SETS       64
+#define FONT_RUN_WAYS       4
+#define FONT_RUN_TEXT_MAX   1024
+
+static ImlibTextRun *run_cache[FONT_RUN_SETS][FONT_RUN_WAYS];
+static ImlibTextRun *run_uncached = NULL;
+static unsigned int run_serial = 1;
+static unsigned int run_clock = 0;
+
+static unsigned int
+__run_hash(ImlibFont *fn, const char *text, int len)
+{
+    unsigned int    h;
+    int             i;
+
+    /* FNV-1a */
+    h = 2166136261U ^ (unsigned int)((uintptr_t) fn >> 4);
+    for (i = 0; i < len; i++)
+        h = (h ^ (uint8_t) text[i]) * 16777619U;
+
+    return h;
+}
+
+static int
+__run_layout(ImlibTextRun *run)
+{
+    ImlibTextGlyph *g;
+    Imlib_Font_Glyph *fg;
+    ImlibFont      *fn_in_chain;
+    FT_UInt         index;
+    int             chr, pchr, kern, pen_x, chr_x, start_x;
+
+    /* No more glyphs than bytes */
+    if (!run->glyphs && run->len > 0)
+    {
+        run->glyphs = malloc(run->len * sizeof(ImlibTextGlyph));
+        if (!run->glyphs)
+            return -1;
+    }
+
+    run->num = 0;
+    start_x = 0;
+    pen_x = 0;
+    index = 0;
+    for (chr = 0; run->text[chr];)
+    {
+        pchr = chr;
+        fg = __imlib_font_get_next_glyph(run->fn, run->text, &chr, &index,
+                                         &kern, &fn_in_chain);
+        if (!fg)
+            break;
+        pen_x += kern;
+        if (fg == IMLIB_GLYPH_NONE)
+            continue;
+
+        chr_x = (pen_x >> 8) + fg->left;
+        if (pen_x == 0)
+            start_x = chr_x;
+
+        g = &run->glyphs[run->num++];
+        *g = (ImlibTextGlyph) {
+            fn_in_chain, index, pchr, chr, pen_x, kern,
+            fg->left, fg->width, fg->advance
+        };
+
+        pen_x += fg->advance >> 8;
+    }
+
+    run->advance = pen_x >> 8;
+    run->width = run->advance - start_x;
+    run->inset = (run->num > 0 && run->glyphs[0].chr == 0) ?
+        -run->glyphs[0].left : 0;
+    run->serial = run_serial;
+
+    return 0;
+}
+
+ImlibTextRun   *
+__imlib_font_run_new(ImlibFont *fn, const char *text)
+{
+    ImlibTextRun   *run;
+
+    run = calloc(1, sizeof(ImlibTextRun));
+    if (!run)
+        return NULL;
+
+    run->fn = fn;
+    run->len = strlen(text);
+    run->hash = __run_hash(fn, text, run->len);
+    run->text = malloc(run->len + 1);
+    if (!run->text)
+        goto bail;
+    memcpy(run->text, text, run->len + 1);
+    if (__run_layout(run))
+        goto bail;
+
+    return run;
+
+  bail:
+    __imlib_font_run_free(run);
+    return NULL;
+}
+
+void
+__imlib_font_run_free(ImlibTextRun *run)
+{
+    if (!run)
+        return;
+    free(run->glyphs);
+    free(run->text);
+    free(run);
+}
+
+/* Lay the run out again if the fonts changed since */
+int
+__imlib_font_run_check(ImlibTextRun *run)
+{
+    if (run->serial == run_serial)
+        return 0;
+    return __run_layout(run);
+}
+
+/* The cached run of text with font fn, valid until the next call */
+ImlibTextRun   *
+__imlib_font_run_get(ImlibFont *fn, const char *text)
+{
+    ImlibTextRun  **set, *run;
+    unsigned int    hash;
+    int             len, i, lru;
+
+    run_clock++;
+    len = strlen(text);
+
+    if (len > FONT_RUN_TEXT_MAX)
+    {
+        __imlib_font_run_free(run_uncached);
+        run_uncached = __imlib_font_run_new(fn, text);
+        return run_uncached;
+    }
+
+    hash = __run_hash(fn, text, len);
+    set = run_cache[hash % FONT_RUN_SETS];
+    lru = 0;
+    for (i = 0; i < FONT_RUN_WAYS; i++)
+    {
+        run = set[i];
+        if (!run)
+        {
+            lru = i;
+            break;
+        }
+        if (run->hash == hash && run->fn == fn && run->len == len &&
+            !memcmp(run->text, text, len))
+        {
+            if (__imlib_font_run_check(run))
+                return NULL;
+            run->stamp = run_clock;
+            return run;
+        }
+        if (run_clock - run->stamp > run_clock - set[lru]->stamp)
+            lru = i;
+    }
+
+    run = __imlib_font_run_new(fn, text);
+    if (!run)
+        return NULL;
+    run->stamp = run_clock;
+    __imlib_font_run_free(set[lru]);
+    set[lru] = run;
+
+    return run;
+}
+
+/* Called when fonts or fallback chains change, stales all runs */
+void
+__imlib_font_run_invalidate(void)
+{
+    run_serial++;
+}
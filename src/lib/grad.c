@@ -3,10 +3,15 @@
 #include <math.h>
 #include <stdlib.h>
 
+#include "asm_c.h"
 #include "blend.h"
 #include "color_helpers.h"
 #include "grad.h"
 #include "image.h"
+#include "threads.h"
+
+/* Rows per thread chunk, ~64k pixels */
+#define GRAD_ROWS_MIN(w) (1 + 65536 / (w))
 
 #define ARGB_TO_R_G_B_A(argb, r, g, b, a) \
     do { \
@@ -125,7 +130,7 @@ __imlib_MapRange(ImlibRange *rg, int len)
     for (i = 0; i < len; i++)
     {
         v = pmap[l >> 16];
-        if ((l >> 16) < ll)
+        if ((l >> 16) < ll - 1)
             vv = pmap[(l >> 16) + 1];
         else
             vv = pmap[(l >> 16)];
@@ -150,13 +155,53 @@ __imlib_MapRange(ImlibRange *rg, int len)
     return map;
 }
 
+typedef struct {
+    uint32_t       *map;
+    const uint32_t *pmap;       /* Range colors */
+    const float    *hsv;        /* Range colors, HSV */
+    int             ll;         /* Number of range colors */
+    int             inc;        /* Range color index increment (16.16) */
+} ImlibHsvaMapJob;
+
+static void
+_hsva_map_fill(void *data, int i0, int i1)
+{
+    const ImlibHsvaMapJob *mj = data;
+    const float    *hsv1, *hsv2;
+    uint32_t        k, kk;
+    int             r, g, b, a, aa, i, l, j, jj;
+    float           h, s, v, k1, k2;
+
+    for (i = i0; i < i1; i++)
+    {
+        l = i * mj->inc;
+        j = l >> 16;
+        jj = (j < mj->ll - 1) ? j + 1 : j;
+        k = mj->pmap[j];
+        kk = mj->pmap[jj];
+        hsv1 = mj->hsv + 3 * j;
+        hsv2 = mj->hsv + 3 * jj;
+        k1 = l - (float)(j << 16);
+        k2 = 65536 - k1;
+        a = PIXEL_A(k);
+        aa = PIXEL_A(kk);
+        h = ((hsv1[0] * k2) + (hsv2[0] * k1)) / 65536.0;
+        s = ((hsv1[1] * k2) + (hsv2[1] * k1)) / 65536.0;
+        v = ((hsv1[2] * k2) + (hsv2[2] * k1)) / 65536.0;
+        __imlib_hsv_to_rgb(h, s, v, &r, &g, &b);
+        a = (unsigned long int)((a * k2) + (aa * k1)) >> 16;
+        mj->map[i] = PIXEL_ARGB(a, r, g, b);
+    }
+}
+
 static uint32_t *
 __imlib_MapHsvaRange(ImlibRange *rg, int len)
 {
+    ImlibHsvaMapJob mj;
     ImlibRangeColor *p;
-    uint32_t       *map, *pmap, k, kk;
-    int             r, g, b, a, rr, gg, bb, aa, i, l, ll, inc, j;
-    float           h1, s1, v1, h2, s2, v2, h, s, v, k1, k2;
+    uint32_t       *map, *pmap, k;
+    int             r, g, b, a, rr, gg, bb, i, ll, j;
+    float           h1, s1, v1, h2, s2, v2, h, s, v, k1, k2, *hsv;
 
     if (!rg->color)
         return NULL;
@@ -202,51 +247,124 @@ __imlib_MapHsvaRange(ImlibRange *rg, int len)
             pmap[i++] = PIXEL_ARGB(a, r, g, b);
         }
     }
-    inc = ((ll - 1) << 16) / (len - 1);
-    l = 0;
-    for (i = 0; i < len; i++)
+    hsv = malloc(3 * ll * sizeof(float));
+    if (!hsv)
     {
-        k = pmap[l >> 16];
-        if ((l >> 16) < ll)
-            kk = pmap[(l >> 16) + 1];
-        else
-            kk = pmap[(l >> 16)];
-        k1 = l - (float)((l >> 16) << 16);
-        k2 = 65536 - k1;
-        b = ((k)) & 0xff;
-        g = ((k) >> 8) & 0xff;
-        r = ((k) >> 16) & 0xff;
-        a = ((k) >> 24) & 0xff;
-        bb = ((kk)) & 0xff;
-        gg = ((kk) >> 8) & 0xff;
-        rr = ((kk) >> 16) & 0xff;
-        aa = ((kk) >> 24) & 0xff;
-        __imlib_rgb_to_hsv(r, g, b, &h1, &s1, &v1);
-        __imlib_rgb_to_hsv(rr, gg, bb, &h2, &s2, &v2);
-        h = ((h1 * k2) + (h2 * k1)) / 65536.0;
-        s = ((s1 * k2) + (s2 * k1)) / 65536.0;
-        v = ((v1 * k2) + (v2 * k1)) / 65536.0;
-        __imlib_hsv_to_rgb(h, s, v, &r, &g, &b);
-        a = (unsigned long int)((a * k2) + (aa * k1)) >> 16;
-        map[i] = PIXEL_ARGB(a, r, g, b);
-        l += inc;
+        free(map);
+        map = NULL;
+        goto quit;
+    }
+    for (i = 0; i < ll; i++)
+    {
+        k = pmap[i];
+        __imlib_rgb_to_hsv(PIXEL_R(k), PIXEL_G(k), PIXEL_B(k),
+                           &hsv[3 * i], &hsv[3 * i + 1], &hsv[3 * i + 2]);
     }
+
+    mj.map = map;
+    mj.pmap = pmap;
+    mj.hsv = hsv;
+    mj.ll = ll;
+    mj.inc = ((ll - 1) << 16) / (len - 1);
+    __imlib_ParallelFor(len, 4096, _hsva_map_fill, &mj);
+
+    free(hsv);
+  quit:
     free(pmap);
     return map;
 }
 
 typedef uint32_t *(ImlibRangeMapFunc) (ImlibRange * rg, int len);
 
+static void
+_grad_span(uint32_t *p, const int *pos, int pos_add, const uint32_t *map,
+           int len, int w, int op)
+{
+    uint32_t        tmp;
+    int             x, i;
+    uint8_t         r, g, b, a;
+
+#define GRAD_SPAN_LOOP(BLEND_OP) \
+    for (x = 0; x < w; x++, p++) \
+    { \
+        i = pos[x] + pos_add; \
+        if (i < 0) \
+            i = 0; \
+        else if (i >= len) \
+            i = len - 1; \
+        ARGB_TO_R_G_B_A(map[i], r, g, b, a); \
+        BLEND_OP(r, g, b, a, p); \
+    }
+
+    switch (op)
+    {
+    default:
+    case GRAD_OP_BLEND:
+        GRAD_SPAN_LOOP(BLEND);
+        break;
+    case GRAD_OP_BLEND_DST_ALPHA:
+        GRAD_SPAN_LOOP(BLEND_DST_ALPHA);
+        break;
+    case GRAD_OP_SUBTRACT:
+        GRAD_SPAN_LOOP(BLEND_SUB);
+        break;
+    case GRAD_OP_RESHADE:
+        GRAD_SPAN_LOOP(BLEND_RE);
+        break;
+    }
+#undef GRAD_SPAN_LOOP
+}
+
+static ImlibGradSpanFunction
+_grad_span_function(void)
+{
+#ifdef DO_AMD64_ASM
+    switch (__imlib_cpu_isa())
+    {
+    case ISA_AVX512:
+        return __imlib_grad_span_avx512;
+    case ISA_AVX2:
+        return __imlib_grad_span_avx2;
+    default:
+        break;
+    }
+#endif
+    return _grad_span;
+}
+
+typedef struct {
+    uint32_t       *data;       /* First destination pixel */
+    int             stride;
+    int             w;
+    const int      *hlut;       /* Per column map positions */
+    const int      *vlut;       /* Per row map position offsets */
+    const uint32_t *map;
+    int             len;
+    int             op;
+    ImlibGradSpanFunction span;
+} ImlibGradJob;
+
+static void
+_grad_rows(void *data, int y0, int y1)
+{
+    const ImlibGradJob *gj = data;
+    int             y;
+
+    for (y = y0; y < y1; y++)
+        gj->span(gj->data + y * gj->stride, gj->hlut, gj->vlut[y],
+                 gj->map, gj->len, gj->w, gj->op);
+}
+
 static void
 _DrawGradient(ImlibImage *im, int x, int y, int w, int h,
               ImlibRange *rg, double angle, ImlibOp op,
               int clx, int cly, int clw, int clh, ImlibRangeMapFunc *rmf)
 {
-    uint32_t       *map, *p;
+    ImlibGradJob    gj;
+    uint32_t       *map;
     int            *hlut, *vlut, len;
-    int             xx, yy, xoff, yoff, ww, hh, jump;
-    int             tmp, i, divw, divh;
-    uint8_t         r, g, b, a;
+    int             xx, yy, xoff, yoff, ww, hh;
+    int             i, divw, divh;
 
     xoff = yoff = 0;
     ww = w;
@@ -290,6 +408,30 @@ _DrawGradient(ImlibImage *im, int x, int y, int w, int h,
         yoff += (y - py);
     }
 
+    switch (op)
+    {
+    case OP_COPY:
+        if (im->has_alpha)
+        {
+            __imlib_build_pow_lut();
+            gj.op = GRAD_OP_BLEND_DST_ALPHA;
+        }
+        else
+        {
+            gj.op = GRAD_OP_BLEND;
+        }
+        break;
+    case OP_ADD:               /* Historically drawn as subtract */
+    case OP_SUBTRACT:
+        gj.op = GRAD_OP_SUBTRACT;
+        break;
+    case OP_RESHADE:
+        gj.op = GRAD_OP_RESHADE;
+        break;
+    default:
+        return;
+    }
+
     vlut = NULL;
     map = NULL;
 
@@ -308,6 +450,7 @@ _DrawGradient(ImlibImage *im, int x, int y, int w, int h,
     if (!map)
         goto quit;
 
+    /* The map position of pixel (x, y) is hlut[x] + vlut[y] */
     xx = (int)(32 * sin(((angle + 180) * 2 * 3.141592654) / 360));
     yy = -(int)(32 * cos(((angle + 180) * 2 * 3.141592654) / 360));
     divw = ((ww - 1) << 5);
@@ -336,104 +479,17 @@ _DrawGradient(ImlibImage *im, int x, int y, int w, int h,
         for (i = 0; i < hh; i++)
             vlut[i] = (yy * i * len) / divh;
     }
-    jump = im->w - w;
 
-    p = im->data + (y * im->w) + x;
-    switch (op)
-    {
-    case OP_COPY:
-        if (im->has_alpha)
-        {
-            __imlib_build_pow_lut();
-            for (yy = 0; yy < h; yy++)
-            {
-                for (xx = 0; xx < w; xx++)
-                {
-                    i = vlut[yoff + yy] + hlut[xoff + xx];
-                    if (i < 0)
-                        i = 0;
-                    else if (i >= len)
-                        i = len - 1;
-                    ARGB_TO_R_G_B_A(map[i], r, g, b, a);
-                    BLEND_DST_ALPHA(r, g, b, a, p);
-                    p++;
-                }
-                p += jump;
-            }
-        }
-        else
-        {
-            for (yy = 0; yy < h; yy++)
-            {
-                for (xx = 0; xx < w; xx++)
-                {
-                    i = vlut[yoff + yy] + hlut[xoff + xx];
-                    if (i < 0)
-                        i = 0;
-                    else if (i >= len)
-                        i = len - 1;
-                    ARGB_TO_R_G_B_A(map[i], r, g, b, a);
-                    BLEND(r, g, b, a, p);
-                    p++;
-                }
-                p += jump;
-            }
-        }
-        break;
-    case OP_ADD:
-        for (yy = 0; yy < h; yy++)
-        {
-            for (xx = 0; xx < w; xx++)
-            {
-                i = vlut[yoff + yy] + hlut[xoff + xx];
-                if (i < 0)
-                    i = 0;
-                else if (i >= len)
-                    i = len - 1;
-                ARGB_TO_R_G_B_A(map[i], r, g, b, a);
-                BLEND_SUB(r, g, b, a, p);
-                p++;
-            }
-            p += jump;
-        }
-        break;
-    case OP_SUBTRACT:
-        for (yy = 0; yy < h; yy++)
-        {
-            for (xx = 0; xx < w; xx++)
-            {
-                i = vlut[yoff + yy] + hlut[xoff + xx];
-                if (i < 0)
-                    i = 0;
-                else if (i >= len)
-                    i = len - 1;
-                ARGB_TO_R_G_B_A(map[i], r, g, b, a);
-                BLEND_SUB(r, g, b, a, p);
-                p++;
-            }
-            p += jump;
-        }
-        break;
-    case OP_RESHADE:
-        for (yy = 0; yy < h; yy++)
-        {
-            for (xx = 0; xx < w; xx++)
-            {
-                i = vlut[yoff + yy] + hlut[xoff + xx];
-                if (i < 0)
-                    i = 0;
-                else if (i >= len)
-                    i = len - 1;
-                ARGB_TO_R_G_B_A(map[i], r, g, b, a);
-                BLEND_RE(r, g, b, a, p);
-                p++;
-            }
-            p += jump;
-        }
-        break;
-    default:
-        break;
-    }
+    gj.data = im->data + (y * im->w) + x;
+    gj.stride = im->w;
+    gj.w = w;
+    gj.hlut = hlut + xoff;
+    gj.vlut = vlut + yoff;
+    gj.map = map;
+    gj.len = len;
+    gj.span = _grad_span_function();
+
+    __imlib_ParallelFor(h, GRAD_ROWS_MIN(w), _grad_rows, &gj);
 
   quit:
     free(vlut);
@@ -28,4 +28,26 @@ void            __imlib_DrawHsvaGradient(ImlibImage * im,
                                          ImlibOp op,
                                          int clx, int cly, int clw, int clh);
 
+/* Gradient span operations */
+enum {
+    GRAD_OP_BLEND,
+    GRAD_OP_BLEND_DST_ALPHA,
+    GRAD_OP_SUBTRACT,
+    GRAD_OP_RESHADE,
+};
+
+/* Blend map[clamp(pos[x] + pos_add, 0, len - 1)] onto dst[x], x < w */
+typedef void    (*ImlibGradSpanFunction)(uint32_t * dst, const int *pos,
+                                         int pos_add, const uint32_t * map,
+                                         int len, int w, int op);
+
+#if DO_AMD64_ASM
+void            __imlib_grad_span_avx2(uint32_t * dst, const int *pos,
+                                       int pos_add, const uint32_t * map,
+                                       int len, int w, int op);
+void            __imlib_grad_span_avx512(uint32_t * dst, const int *pos,
+                                         int pos_add, const uint32_t * map,
+                                         int len, int w, int op);
+#endif
+
 #endif
@@ -17,6 +17,7 @@
 #include "file.h"
 #include "image.h"
 #include "loaders.h"
+#include "stats.h"
 #ifdef BUILD_X11
 #include "x11_pixmap.h"
 #endif
@@ -330,6 +331,7 @@ __imlib_CleanupImageCache(void)
                 continue;
 
             IM_FLAG_SET(im, F_INVALID); /* Will be pruned shortly */
+            STATS_CACHE_INC(STATS_CACHE_IMAGE, evict);
             current_cache = __imlib_CurrentCacheSize();
             break;
         }
@@ -366,7 +368,7 @@ __imlib_DecacheFile(const char *file)
     {
         if (!strcmp(file, im->file))
         {
-            IM_FLAG_SET(im, F_INVALID);
+            __imlib_DirtyImage(im);
             ++n;
         }
     }
@@ -438,24 +440,29 @@ static int
 __imlib_LoadImageWrapper(const ImlibLoader *l, ImlibImage *im, int load_data)
 {
     int             rc;
+    unsigned int    t0, dt;
 
     DP("%s: fmt='%s' file='%s'(%s) frame=%d, imm=%d\n", __func__,
        l->name, im->file, im->fi->name, im->frame, load_data);
 
-#if IMLIB2_DEBUG
-    unsigned int    t0 = __imlib_time_us();
-#endif
-
     if (!l->module->load)
         return LOAD_FAIL;
 
     if (!im->format)
         im->format = strdup(l->name);
 
+    t0 = __imlib_time_us();
+
     rc = l->module->load(im, load_data);
 
+    dt = __imlib_time_us() - t0;
+
     DP("%s: %-4s: %s: Elapsed time: %.3f ms\n", __func__,
-       l->name, im->fi->name, 1e-3 * (__imlib_time_us() - t0));
+       l->name, im->fi->name, 1e-3 * dt);
+
+    if (rc != LOAD_FAIL)
+        __imlib_StatsLoad(l->name, load_data, rc, im->fi->fsize,
+                          im->data ? im->w * im->h * sizeof(uint32_t) : 0, dt);
 
     if (rc <= LOAD_FAIL)
     {
@@ -519,6 +526,7 @@ __imlib_LoadImage(const char *file, ImlibLoadArgs *ila)
     ImlibLoader   **loaders, *best_loader, *l, *previous_l;
     int             err, loader_ret;
     ImlibLoaderCtx  ilc;
+    ImlibSpan       span;
     struct stat     st;
     FILE           *fp;
     char           *im_file, *im_key;
@@ -546,23 +554,26 @@ __imlib_LoadImage(const char *file, ImlibLoadArgs *ila)
                 /* if the file on disk is newer than the cached one */
                 if (current_modified_time != im->moddate)
                 {
-                    /* invalidate image */
-                    IM_FLAG_SET(im, F_INVALID);
+                    /* invalidate image, and the pixmaps rendered from it */
+                    __imlib_DirtyImage(im);
                 }
                 else
                 {
                     /* image is ok to re-use - program is just being stupid loading */
                     /* the same data twice */
+                    STATS_CACHE_INC(STATS_CACHE_IMAGE, hit);
                     im->references++;
                     return im;
                 }
             }
             else
             {
+                STATS_CACHE_INC(STATS_CACHE_IMAGE, hit);
                 im->references++;
                 return im;
             }
         }
+        STATS_CACHE_INC(STATS_CACHE_IMAGE, miss);
     }
 
     fp = ila->fp;
@@ -636,6 +647,8 @@ __imlib_LoadImage(const char *file, ImlibLoadArgs *ila)
         ila->immed = 1;
     }
 
+    __imlib_SpanBegin(&span, SPAN_LOAD, NULL, file, 0, 0);
+
     /* take a guess by extension on the best loader to use */
     best_loader = __imlib_FindBestLoader(im->fi->name, NULL, 0);
 
@@ -711,6 +724,12 @@ __imlib_LoadImage(const char *file, ImlibLoadArgs *ila)
 
     __imlib_FileContextClose(im->fi);
 
+    span.name = im->loader ? im->loader->name : NULL;
+    span.w = im->w;
+    span.h = im->h;
+    __imlib_SpanEnd(&span, loader_ret <= LOAD_FAIL ?
+                    __imlib_LoadErrorToErrno(loader_ret, 0) : 0);
+
     if (loader_ret <= LOAD_FAIL)
     {
         /* Image loading failed.
@@ -737,6 +756,7 @@ int
 __imlib_LoadImageData(ImlibImage *im)
 {
     int             err;
+    ImlibSpan       span;
 
     if (im->data)
         return 0;               /* Ok */
@@ -748,11 +768,18 @@ __imlib_LoadImageData(ImlibImage *im)
     err = __imlib_FileContextOpen(im->fi, NULL, NULL, 0);
     if (err)
         return err;
+
+    __imlib_SpanBegin(&span, SPAN_LOAD, im->loader->name, im->file,
+                      im->w, im->h);
+
     err = __imlib_LoadImageWrapper(im->loader, im, 1);
+    err = __imlib_LoadErrorToErrno(err, 0);
+
+    __imlib_SpanEnd(&span, err);
 
     __imlib_FileContextClose(im->fi);
 
-    return __imlib_LoadErrorToErrno(err, 0);
+    return err;
 }
 
 __EXPORT__ int
@@ -901,8 +928,10 @@ __imlib_SaveImage(ImlibImage *im, const char *file, ImlibLoadArgs *ila)
 {
     ImlibLoader    *l;
     ImlibLoaderCtx  ilc;
+    ImlibSpan       span;
     FILE           *fp = ila->fp;
     int             loader_ret;
+    long            fsize;
 
     if (!file && !fp)
     {
@@ -935,9 +964,13 @@ __imlib_SaveImage(ImlibImage *im, const char *file, ImlibLoadArgs *ila)
     __imlib_ImageFileContextPush(im, file ? strdup(file) : NULL);
     im->fi->fp = fp;
 
+    __imlib_SpanBegin(&span, SPAN_SAVE, l->name, file, im->w, im->h);
+
     /* call the saver */
     loader_ret = l->module->save(im);
 
+    fsize = ftell(im->fi->fp);
+
     if (!ila->fp)
     {
         if (fflush(im->fi->fp) != 0)
@@ -950,4 +983,7 @@ __imlib_SaveImage(ImlibImage *im, const char *file, ImlibLoadArgs *ila)
     im->lc = NULL;
 
     ila->err = __imlib_LoadErrorToErrno(loader_ret, 1);
+
+    __imlib_StatsSave(l->name, loader_ret, im->w * im->h * sizeof(uint32_t),
+                      fsize > 0 ? fsize : 0, __imlib_SpanEnd(&span, ila->err));
 }
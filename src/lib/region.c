@@ -0,0 +1,407 @@
+#include "common.h"
+
+#include <limits.h>
+#include <stdlib.h>
+
+#include "region.h"
+
+/*
+ * Region operations, after the X11 (and pixman) region code.
+ *
+ * The bands of both operands are walked top to bottom. Parts of bands
+ * covered by one region only are copied (or not, depending on the
+ * operation), parts covered by both are handed to the operation's overlap
+ * function, which merges the two rows of boxes left to right.
+ */
+
+typedef void    (RegionOverlapFunction)(ImlibRegion * dst,
+                                        const ImlibBox * a,
+                                        const ImlibBox * ae,
+                                        const ImlibBox * b,
+                                        const ImlibBox * be, int y1, int y2);
+
+void
+__imlib_RegionInit(ImlibRegion *rg)
+{
+    rg->boxes = NULL;
+    rg->num = rg->alloc = 0;
+}
+
+void
+__imlib_RegionFini(ImlibRegion *rg)
+{
+    free(rg->boxes);
+    __imlib_RegionInit(rg);
+}
+
+/* Make room for n more boxes */
+static int
+__rg_reserve(ImlibRegion *rg, int n)
+{
+    ImlibBox       *boxes;
+    int             alloc;
+
+    if (rg->num + n <= rg->alloc)
+        return 0;
+    alloc = MAX(2 * rg->alloc, rg->num + n);
+    alloc = MAX(alloc, 16);
+    boxes = realloc(rg->boxes, alloc * sizeof(ImlibBox));
+    if (!boxes)
+        return -1;
+    rg->boxes = boxes;
+    rg->alloc = alloc;
+    return 0;
+}
+
+static void
+__rg_append(ImlibRegion *rg, int x1, int y1, int x2, int y2)
+{
+    ImlibBox       *bx;
+
+    bx = &rg->boxes[rg->num++];
+    bx->x1 = x1;
+    bx->y1 = y1;
+    bx->x2 = x2;
+    bx->y2 = y2;
+}
+
+/* End of the band starting at b */
+static const ImlibBox *
+__rg_band_end(const ImlibBox *b, const ImlibBox *end)
+{
+    const ImlibBox *be;
+
+    for (be = b + 1; be < end && be->y1 == b->y1; be++)
+        ;
+    return be;
+}
+
+/* Merge the band starting at cur into the one starting at prev if they
+ * touch and have the same boxes. Returns the start of the last band. */
+static int
+__rg_coalesce(ImlibRegion *rg, int prev, int cur)
+{
+    ImlibBox       *pb, *cb;
+    int             i, n;
+
+    n = rg->num - cur;
+    if (prev < 0 || cur - prev != n)
+        return cur;
+    pb = rg->boxes + prev;
+    cb = rg->boxes + cur;
+    if (pb->y2 != cb->y1)
+        return cur;
+    for (i = 0; i < n; i++)
+    {
+        if (pb[i].x1 != cb[i].x1 || pb[i].x2 != cb[i].x2)
+            return cur;
+    }
+    for (i = 0; i < n; i++)
+        pb[i].y2 = cb[i].y2;
+    rg->num = cur;
+
+    return prev;
+}
+
+/* Append a band, the boxes from b to be limited to y1, y2 */
+static int
+__rg_band_copy(ImlibRegion *dst, const ImlibBox *b, const ImlibBox *be,
+               int y1, int y2, int prev)
+{
+    int             cur;
+
+    cur = dst->num;
+    for (; b < be; b++)
+        __rg_append(dst, b->x1, y1, b->x2, y2);
+
+    return __rg_coalesce(dst, prev, cur);
+}
+
+static void
+__rg_overlap_union(ImlibRegion *dst, const ImlibBox *a, const ImlibBox *ae,
+                   const ImlibBox *b, const ImlibBox *be, int y1, int y2)
+{
+    const ImlibBox *p;
+    int             x1, x2;
+
+    x1 = x2 = INT_MIN;
+    while (a < ae || b < be)
+    {
+        if (b == be || (a < ae && a->x1 < b->x1))
+            p = a++;
+        else
+            p = b++;
+        if (p->x1 <= x2)
+        {
+            x2 = MAX(x2, p->x2);
+            continue;
+        }
+        if (x1 < x2)
+            __rg_append(dst, x1, y1, x2, y2);
+        x1 = p->x1;
+        x2 = p->x2;
+    }
+    if (x1 < x2)
+        __rg_append(dst, x1, y1, x2, y2);
+}
+
+static void
+__rg_overlap_intersect(ImlibRegion *dst, const ImlibBox *a,
+                       const ImlibBox *ae, const ImlibBox *b,
+                       const ImlibBox *be, int y1, int y2)
+{
+    int             x1, x2;
+
+    while (a < ae && b < be)
+    {
+        x1 = MAX(a->x1, b->x1);
+        x2 = MIN(a->x2, b->x2);
+        if (x1 < x2)
+            __rg_append(dst, x1, y1, x2, y2);
+        if (a->x2 < b->x2)
+            a++;
+        else if (b->x2 < a->x2)
+            b++;
+        else
+        {
+            a++;
+            b++;
+        }
+    }
+}
+
+static void
+__rg_overlap_subtract(ImlibRegion *dst, const ImlibBox *a,
+                      const ImlibBox *ae, const ImlibBox *b,
+                      const ImlibBox *be, int y1, int y2)
+{
+    int             x1;
+
+    x1 = a->x1;
+    while (a < ae)
+    {
+        if (b == be || b->x1 >= a->x2)
+        {
+            /* Nothing more to subtract from this box */
+            if (x1 < a->x2)
+                __rg_append(dst, x1, y1, a->x2, y2);
+            if (++a < ae)
+                x1 = a->x1;
+        }
+        else if (b->x2 <= x1)
+        {
+            b++;
+        }
+        else
+        {
+            if (b->x1 > x1)
+                __rg_append(dst, x1, y1, b->x1, y2);
+            if (b->x2 >= a->x2)
+            {
+                /* b may reach into the next box too */
+                if (++a < ae)
+                    x1 = a->x1;
+            }
+            else
+            {
+                x1 = b->x2;
+                b++;
+            }
+        }
+    }
+}
+
+static int
+__rg_op(ImlibRegion *dst, const ImlibRegion *ra, const ImlibRegion *rb,
+        RegionOverlapFunction *overlap, bool keep_a, bool keep_b)
+{
+    const ImlibBox *a, *ae, *abe, *b, *be, *bbe;
+    int             ytop, ybot, top, bot, prev, cur;
+
+    a = ra->boxes;
+    ae = a + ra->num;
+    b = rb->boxes;
+    be = b + rb->num;
+    dst->num = 0;
+    prev = -1;
+
+    /* ybot is the bottom of what has been done so far */
+    ybot = INT_MIN;
+    while (a < ae && b < be)
+    {
+        abe = __rg_band_end(a, ae);
+        bbe = __rg_band_end(b, be);
+        /* At most one band copy and na + nb boxes from the overlap */
+        if (__rg_reserve(dst, 2 * ((abe - a) + (bbe - b))))
+            return -1;
+
+        /* The part above the other band */
+        if (a->y1 < b->y1)
+        {
+            top = MAX(a->y1, ybot);
+            bot = MIN(a->y2, b->y1);
+            if (keep_a && top < bot)
+                prev = __rg_band_copy(dst, a, abe, top, bot, prev);
+            ytop = b->y1;
+        }
+        else if (b->y1 < a->y1)
+        {
+            top = MAX(b->y1, ybot);
+            bot = MIN(b->y2, a->y1);
+            if (keep_b && top < bot)
+                prev = __rg_band_copy(dst, b, bbe, top, bot, prev);
+            ytop = a->y1;
+        }
+        else
+        {
+            ytop = a->y1;
+        }
+
+        /* The overlapping part */
+        ybot = MIN(a->y2, b->y2);
+        if (ybot > ytop)
+        {
+            cur = dst->num;
+            overlap(dst, a, abe, b, bbe, ytop, ybot);
+            if (dst->num > cur)
+                prev = __rg_coalesce(dst, prev, cur);
+        }
+
+        if (a->y2 == ybot)
+            a = abe;
+        if (b->y2 == ybot)
+            b = bbe;
+    }
+
+    /* The rest of one of them */
+    if (keep_a)
+    {
+        for (; a < ae; a = abe)
+        {
+            abe = __rg_band_end(a, ae);
+            if (__rg_reserve(dst, abe - a))
+                return -1;
+            prev = __rg_band_copy(dst, a, abe, MAX(a->y1, ybot), a->y2, prev);
+        }
+    }
+    if (keep_b)
+    {
+        for (; b < be; b = bbe)
+        {
+            bbe = __rg_band_end(b, be);
+            if (__rg_reserve(dst, bbe - b))
+                return -1;
+            prev = __rg_band_copy(dst, b, bbe, MAX(b->y1, ybot), b->y2, prev);
+        }
+    }
+
+    return 0;
+}
+
+int
+__imlib_RegionUnion(ImlibRegion *dst, const ImlibRegion *a,
+                    const ImlibRegion *b)
+{
+    return __rg_op(dst, a, b, __rg_overlap_union, true, true);
+}
+
+int
+__imlib_RegionIntersect(ImlibRegion *dst, const ImlibRegion *a,
+                        const ImlibRegion *b)
+{
+    return __rg_op(dst, a, b, __rg_overlap_intersect, false, false);
+}
+
+int
+__imlib_RegionSubtract(ImlibRegion *dst, const ImlibRegion *a,
+                       const ImlibRegion *b)
+{
+    return __rg_op(dst, a, b, __rg_overlap_subtract, true, false);
+}
+
+static int
+__rg_box_cmp(const void *p1, const void *p2)
+{
+    const ImlibBox *b1 = p1, *b2 = p2;
+
+    if (b1->y1 != b2->y1)
+        return b1->y1 < b2->y1 ? -1 : 1;
+    if (b1->x1 != b2->x1)
+        return b1->x1 < b2->x1 ? -1 : 1;
+    return 0;
+}
+
+/* Union of n > 0 boxes sorted by y, as a tree of pairwise unions */
+static int
+__rg_from_sorted(ImlibRegion *rg, const ImlibBox *boxes, int n)
+{
+    ImlibRegion     r1, r2;
+    int             err;
+
+    if (n == 1)
+    {
+        if (__rg_reserve(rg, 1))
+            return -1;
+        rg->num = 0;
+        __rg_append(rg, boxes->x1, boxes->y1, boxes->x2, boxes->y2);
+        return 0;
+    }
+
+    __imlib_RegionInit(&r1);
+    __imlib_RegionInit(&r2);
+    err = __rg_from_sorted(&r1, boxes, n / 2);
+    if (!err)
+        err = __rg_from_sorted(&r2, boxes + n / 2, n - n / 2);
+    if (!err)
+        err = __imlib_RegionUnion(rg, &r1, &r2);
+    __imlib_RegionFini(&r1);
+    __imlib_RegionFini(&r2);
+
+    return err;
+}
+
+int
+__imlib_RegionFromBoxes(ImlibRegion *rg, const ImlibBox *boxes, int n)
+{
+    ImlibBox       *sorted;
+    int             i, ns, err;
+
+    rg->num = 0;
+
+    sorted = malloc(MAX(n, 1) * sizeof(ImlibBox));
+    if (!sorted)
+        return -1;
+    for (i = ns = 0; i < n; i++)
+    {
+        if (boxes[i].x1 < boxes[i].x2 && boxes[i].y1 < boxes[i].y2)
+            sorted[ns++] = boxes[i];
+    }
+    qsort(sorted, ns, sizeof(ImlibBox), __rg_box_cmp);
+
+    err = ns > 0 ? __rg_from_sorted(rg, sorted, ns) : 0;
+    free(sorted);
+
+    return err;
+}
+
+void
+__imlib_RegionExtents(const ImlibRegion *rg, ImlibBox *ext)
+{
+    int             i;
+
+    if (rg->num == 0)
+    {
+        ext->x1 = ext->y1 = ext->x2 = ext->y2 = 0;
+        return;
+    }
+
+    ext->x1 = rg->boxes[0].x1;
+    ext->x2 = rg->boxes[0].x2;
+    ext->y1 = rg->boxes[0].y1;
+    ext->y2 = rg->boxes[rg->num - 1].y2;
+    for (i = 1; i < rg->num; i++)
+    {
+        ext->x1 = MIN(ext->x1, rg->boxes[i].x1);
+        ext->x2 = MAX(ext->x2, rg->boxes[i].x2);
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef __REGION
+#define __REGION 1
+
+#include "types.h"
+
+/*
+ * Regions as y-x banded rectangles (as in X11/pixman regions)
+ *
+ * The boxes are sorted into bands of equal y1, y2, with the bands in
+ * increasing y and the boxes of a band in increasing x.
+ * Boxes don't overlap or touch within a band, and vertically adjacent
+ * bands with the same boxes are coalesced.
+ */
+typedef struct {
+    int             x1, y1, x2, y2;     /* x2, y2 exclusive */
+} ImlibBox;
+
+typedef struct {
+    ImlibBox       *boxes;
+    int             num, alloc;
+} ImlibRegion;
+
+void            __imlib_RegionInit(ImlibRegion * rg);
+void            __imlib_RegionFini(ImlibRegion * rg);
+
+/* Set rg to the union of the n boxes (in any order), O(n log n) */
+int             __imlib_RegionFromBoxes(ImlibRegion * rg,
+                                        const ImlibBox * boxes, int n);
+
+/* dst = a op b, dst must not be a or b. Return 0 on success. */
+int             __imlib_RegionUnion(ImlibRegion * dst, const ImlibRegion * a,
+                                    const ImlibRegion * b);
+int             __imlib_RegionIntersect(ImlibRegion * dst,
+                                        const ImlibRegion * a,
+                                        const ImlibRegion * b);
+int             __imlib_RegionSubtract(ImlibRegion * dst,
+                                       const ImlibRegion * a,
+                                       const ImlibRegion * b);
+
+/* Bounding box, all zero when empty */
+void            __imlib_RegionExtents(const ImlibRegion * rg, ImlibBox * ext);
+
+#endif
@@ -2,29 +2,171 @@
 
 #include <stdlib.h>
 #include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "image.h"
 #include "rgbadraw.h"
 
+#ifdef __SSE2__
+/* Reverse 4 pixels */
+#define V_REV(v) _mm_shuffle_epi32(v, 0x1b)
+#endif
+
+#define FLIP_TILE 32            /* Transpose tile size (pixels) */
+
+/* Reverse n pixels in place */
+static void
+_flip_pixels(uint32_t *p1, int n)
+{
+    uint32_t       *p2, tmp;
+
+    p2 = p1 + n - 1;
+#ifdef __SSE2__
+    for (; p2 - p1 >= 7; p1 += 4, p2 -= 4)
+    {
+        __m128i         v1, v2;
+
+        v1 = _mm_loadu_si128((__m128i *) p1);
+        v2 = _mm_loadu_si128((__m128i *) (p2 - 3));
+        _mm_storeu_si128((__m128i *) p1, V_REV(v2));
+        _mm_storeu_si128((__m128i *) (p2 - 3), V_REV(v1));
+    }
+#endif
+    for (; p1 < p2; p1++, p2--)
+    {
+        tmp = *p1;
+        *p1 = *p2;
+        *p2 = tmp;
+    }
+}
+
+/* Swap n pixels */
+static void
+_swap_pixels(uint32_t *p1, uint32_t *p2, int n)
+{
+    uint32_t        tmp;
+    int             x;
+
+    x = 0;
+#ifdef __SSE2__
+    for (; x + 4 <= n; x += 4)
+    {
+        __m128i         v1, v2;
+
+        v1 = _mm_loadu_si128((__m128i *) (p1 + x));
+        v2 = _mm_loadu_si128((__m128i *) (p2 + x));
+        _mm_storeu_si128((__m128i *) (p1 + x), v2);
+        _mm_storeu_si128((__m128i *) (p2 + x), v1);
+    }
+#endif
+    for (; x < n; x++)
+    {
+        tmp = p1[x];
+        p1[x] = p2[x];
+        p2[x] = tmp;
+    }
+}
+
+/* Transposing copy of one tile (dxs = +-dst stride, dys = +-1) */
+static void
+_copy_tile_transposed(const uint32_t *src, int sow, int w, int h,
+                      uint32_t *dst, int dxs, int dys)
+{
+    int             x, y, w4, h4;
+
+    w4 = h4 = 0;
+#ifdef __SSE2__
+    w4 = w & ~3;
+    h4 = h & ~3;
+    for (y = 0; y < h4; y += 4)
+    {
+        for (x = 0; x < w4; x += 4)
+        {
+            const uint32_t *s = src + y * sow + x;
+            uint32_t       *d = dst + x * dxs + y * dys;
+            __m128i         r0, r1, r2, r3, t0, t1, t2, t3;
+
+            r0 = _mm_loadu_si128((const __m128i *)(s + 0 * sow));
+            r1 = _mm_loadu_si128((const __m128i *)(s + 1 * sow));
+            r2 = _mm_loadu_si128((const __m128i *)(s + 2 * sow));
+            r3 = _mm_loadu_si128((const __m128i *)(s + 3 * sow));
+            t0 = _mm_unpacklo_epi32(r0, r1);
+            t1 = _mm_unpacklo_epi32(r2, r3);
+            t2 = _mm_unpackhi_epi32(r0, r1);
+            t3 = _mm_unpackhi_epi32(r2, r3);
+            r0 = _mm_unpacklo_epi64(t0, t1);
+            r1 = _mm_unpackhi_epi64(t0, t1);
+            r2 = _mm_unpacklo_epi64(t2, t3);
+            r3 = _mm_unpackhi_epi64(t2, t3);
+            if (dys < 0)
+            {
+                d -= 3;
+                r0 = V_REV(r0);
+                r1 = V_REV(r1);
+                r2 = V_REV(r2);
+                r3 = V_REV(r3);
+            }
+            _mm_storeu_si128((__m128i *) (d + 0 * dxs), r0);
+            _mm_storeu_si128((__m128i *) (d + 1 * dxs), r1);
+            _mm_storeu_si128((__m128i *) (d + 2 * dxs), r2);
+            _mm_storeu_si128((__m128i *) (d + 3 * dxs), r3);
+        }
+    }
+#endif
+    for (y = 0; y < h; y++)
+    {
+        for (x = y < h4 ? w4 : 0; x < w; x++)
+            dst[x * dxs + y * dys] = src[y * sow + x];
+    }
+}
+
+/*\ Copy w x h pixels from src (row stride sow) to dst, source pixel (x, y)
+|*| going to dst[x * dxs + y * dys], where one of dxs/dys is +-1 and the
+|*| other is +- the destination row stride.
+|*| Transposing copies are done in cache sized tiles.
+\*/
 void
-__imlib_FlipImageHoriz(ImlibImage *im)
+__imlib_CopyDataOrtho(const uint32_t *src, int sow, int w, int h,
+                      uint32_t *dst, int dxs, int dys)
 {
-    uint32_t       *p1, *p2, tmp;
     int             x, y;
 
-    for (y = 0; y < im->h; y++)
+    if (dxs == 1)
     {
-        p1 = im->data + (y * im->w);
-        p2 = im->data + ((y + 1) * im->w) - 1;
-        for (x = 0; x < (im->w >> 1); x++)
+        for (y = 0; y < h; y++)
+            memcpy(dst + y * dys, src + y * sow, w * sizeof(uint32_t));
+    }
+    else if (dxs == -1)
+    {
+        for (y = 0; y < h; y++)
         {
-            tmp = *p1;
-            *p1 = *p2;
-            *p2 = tmp;
-            p1++;
-            p2--;
+            memcpy(dst + y * dys - w + 1, src + y * sow, w * sizeof(uint32_t));
+            _flip_pixels(dst + y * dys - w + 1, w);
         }
     }
+    else
+    {
+        for (y = 0; y < h; y += FLIP_TILE)
+        {
+            for (x = 0; x < w; x += FLIP_TILE)
+                _copy_tile_transposed(src + y * sow + x, sow,
+                                      MIN(FLIP_TILE, w - x),
+                                      MIN(FLIP_TILE, h - y),
+                                      dst + x * dxs + y * dys, dxs, dys);
+        }
+    }
+}
+
+void
+__imlib_FlipImageHoriz(ImlibImage *im)
+{
+    int             x, y;
+
+    for (y = 0; y < im->h; y++)
+        _flip_pixels(im->data + (y * im->w), im->w);
+
     x = im->border.left;
     im->border.left = im->border.right;
     im->border.right = x;
@@ -33,22 +175,12 @@ __imlib_FlipImageHoriz(ImlibImage *im)
 void
 __imlib_FlipImageVert(ImlibImage *im)
 {
-    uint32_t       *p1, *p2, tmp;
     int             x, y;
 
     for (y = 0; y < (im->h >> 1); y++)
-    {
-        p1 = im->data + (y * im->w);
-        p2 = im->data + ((im->h - 1 - y) * im->w);
-        for (x = 0; x < im->w; x++)
-        {
-            tmp = *p1;
-            *p1 = *p2;
-            *p2 = tmp;
-            p1++;
-            p2++;
-        }
-    }
+        _swap_pixels(im->data + (y * im->w),
+                     im->data + ((im->h - 1 - y) * im->w), im->w);
+
     x = im->border.top;
     im->border.top = im->border.bottom;
     im->border.bottom = x;
@@ -57,19 +189,10 @@ __imlib_FlipImageVert(ImlibImage *im)
 void
 __imlib_FlipImageBoth(ImlibImage *im)
 {
-    uint32_t       *p1, *p2, tmp;
     int             x;
 
-    p1 = im->data;
-    p2 = im->data + (im->h * im->w) - 1;
-    for (x = (im->w * im->h) / 2; --x >= 0;)
-    {
-        tmp = *p1;
-        *p1 = *p2;
-        *p2 = tmp;
-        p1++;
-        p2--;
-    }
+    _flip_pixels(im->data, im->w * im->h);
+
     x = im->border.top;
     im->border.top = im->border.bottom;
     im->border.bottom = x;
@@ -87,14 +210,16 @@ __imlib_FlipImageBoth(ImlibImage *im)
 void
 __imlib_FlipImageDiagonal(ImlibImage *im, int direction)
 {
-    uint32_t       *data, *to, *from;
-    int             x, y, w, hw, tmp;
+    uint32_t       *data, *to;
+    int             w, h, dxs, dys, tmp;
 
     data = malloc(im->w * im->h * sizeof(uint32_t));
+    if (!data)
+        return;
+
+    /* New dimensions */
     w = im->h;
-    im->h = im->w;
-    im->w = w;
-    hw = w * im->h;
+    h = im->w;
     switch (direction)
     {
     default:
@@ -106,7 +231,8 @@ __imlib_FlipImageDiagonal(ImlibImage *im, int direction)
         im->border.bottom = im->border.right;
         im->border.right = tmp;
         to = data;
-        hw = -hw + 1;
+        dxs = w;
+        dys = 1;
         break;
     case 1:                    /*\ DOWN_LEFT \ */
         tmp = im->border.top;
@@ -115,7 +241,8 @@ __imlib_FlipImageDiagonal(ImlibImage *im, int direction)
         im->border.bottom = im->border.right;
         im->border.right = tmp;
         to = data + w - 1;
-        hw = -hw - 1;
+        dxs = w;
+        dys = -1;
         break;
     case 2:                    /*\ UP_RIGHT \ */
         tmp = im->border.top;
@@ -123,9 +250,9 @@ __imlib_FlipImageDiagonal(ImlibImage *im, int direction)
         im->border.right = im->border.bottom;
         im->border.bottom = im->border.left;
         im->border.left = tmp;
-        to = data + hw - w;
-        w = -w;
-        hw = hw + 1;
+        to = data + (h - 1) * w;
+        dxs = -w;
+        dys = 1;
         break;
     case 3:                    /*\ UP_LEFT \ */
         tmp = im->border.top;
@@ -134,23 +261,16 @@ __imlib_FlipImageDiagonal(ImlibImage *im, int direction)
         tmp = im->border.bottom;
         im->border.bottom = im->border.left;
         im->border.left = tmp;
-        to = data + hw - 1;
-        w = -w;
-        hw = hw - 1;
+        to = data + h * w - 1;
+        dxs = -w;
+        dys = -1;
         break;
     }
 
-    from = im->data;
-    for (x = im->w; --x >= 0;)
-    {
-        for (y = im->h; --y >= 0;)
-        {
-            *to = *from;
-            from++;
-            to += w;
-        }
-        to += hw;
-    }
+    __imlib_CopyDataOrtho(im->data, im->w, im->w, im->h, to, dxs, dys);
+
+    im->w = w;
+    im->h = h;
     __imlib_ReplaceData(im, data);
 }
 
@@ -30,11 +30,29 @@ typedef struct {
     int             x, y, w, h;
 } Imlib_Rectangle;
 
+/* Must match Imlib_Fill_Rule in Imlib2.h.in */
+enum {
+    POLY_FILL_EVEN_ODD,
+    POLY_FILL_NON_ZERO
+};
+
+/* Must match Imlib_Line_Cap in Imlib2.h.in */
+enum {
+    LINE_CAP_BUTT,
+    LINE_CAP_ROUND,
+    LINE_CAP_SQUARE
+};
+
+typedef struct _ImlibPolyIndex ImlibPolyIndex;
+typedef struct _ImlibDrawList ImlibDrawList;
+
 typedef struct {
     ImlibPoint     *points;
     int             pointcount;
     int             lx, rx;
     int             ty, by;
+    char            fill_rule;
+    ImlibPolyIndex *index;      /* Point query index, built on demand */
 } ImlibPoly;
 
 /* image related operations: in rgbadraw.c */
@@ -43,6 +61,9 @@ void            __imlib_FlipImageHoriz(ImlibImage * im);
 void            __imlib_FlipImageVert(ImlibImage * im);
 void            __imlib_FlipImageBoth(ImlibImage * im);
 void            __imlib_FlipImageDiagonal(ImlibImage * im, int direction);
+void            __imlib_CopyDataOrtho(const uint32_t * src, int sow,
+                                      int w, int h, uint32_t * dst,
+                                      int dxs, int dys);
 void            __imlib_BlurImage(ImlibImage * im, int rad);
 void            __imlib_SharpenImage(ImlibImage * im, int rad);
 void            __imlib_TileImageHoriz(ImlibImage * im);
@@ -104,8 +125,12 @@ void            __imlib_Ellipse_FillToImage(int xc, int yc, int a, int b,
 
 ImlibPoly      *__imlib_polygon_new(void);
 void            __imlib_polygon_free(ImlibPoly * poly);
+ImlibPoly      *__imlib_polygon_copy(const ImlibPoly * poly);
 void            __imlib_polygon_add_point(ImlibPoly * poly, int x, int y);
 unsigned char   __imlib_polygon_contains_point(ImlibPoly * poly, int x, int y);
+int             __imlib_polygon_contains_points(ImlibPoly * poly,
+                                                const int *xy, int n,
+                                                unsigned char *inside);
 void            __imlib_polygon_get_bounds(ImlibPoly * poly,
                                            int *px1, int *py1,
                                            int *px2, int *py2);
@@ -124,4 +149,61 @@ void            __imlib_Polygon_FillToImage(ImlibPoly * poly,
                                             int clh, ImlibOp op, char blend,
                                             char anti_alias);
 
+/* Fill contours of npoints[i] float vertices by coverage */
+void            __imlib_Path_FillToImage(const float *xy,
+                                         const int *npoints, int ncontours,
+                                         int fill_rule, uint32_t color,
+                                         ImlibImage * im, int clx, int cly,
+                                         int clw, int clh, ImlibOp op,
+                                         char blend, char anti_alias);
+
+/* wide lines, ellipses and arcs: in draw_stroke.c */
+
+ImlibUpdate    *__imlib_Line_StrokeToImage(int x0, int y0, int x1, int y1,
+                                           double width, int cap,
+                                           uint32_t color, ImlibImage * im,
+                                           int clx, int cly,
+                                           int clw, int clh, ImlibOp op,
+                                           char blend, char anti_alias,
+                                           char make_updates);
+void            __imlib_Arc_StrokeToImage(int xc, int yc, int a, int b,
+                                          double angle1, double angle2,
+                                          double width, int cap,
+                                          uint32_t color, ImlibImage * im,
+                                          int clx, int cly,
+                                          int clw, int clh, ImlibOp op,
+                                          char blend, char anti_alias);
+
+/* display lists: in draw_list.c */
+
+ImlibDrawList  *__imlib_DrawListNew(void);
+void            __imlib_DrawListFree(ImlibDrawList * dl);
+void            __imlib_DrawListClear(ImlibDrawList * dl);
+void            __imlib_DrawListAddPoint(ImlibDrawList * dl, int x, int y,
+                                         uint32_t color, ImlibOp op,
+                                         char blend);
+void            __imlib_DrawListAddLine(ImlibDrawList * dl,
+                                        int x0, int y0, int x1, int y1,
+                                        double width, int cap,
+                                        uint32_t color, ImlibOp op,
+                                        char blend, char anti_alias);
+void            __imlib_DrawListAddRectangle(ImlibDrawList * dl,
+                                             int x, int y, int w, int h,
+                                             char fill, uint32_t color,
+                                             ImlibOp op, char blend);
+void            __imlib_DrawListAddEllipse(ImlibDrawList * dl,
+                                           int xc, int yc, int a, int b,
+                                           char fill, double width,
+                                           uint32_t color, ImlibOp op,
+                                           char blend, char anti_alias);
+void            __imlib_DrawListAddPolygon(ImlibDrawList * dl,
+                                           const ImlibPoly * poly,
+                                           char closed, char fill,
+                                           uint32_t color, ImlibOp op,
+                                           char blend, char anti_alias);
+void            __imlib_DrawList_DrawToImage(const ImlibDrawList * dl,
+                                             ImlibImage * im,
+                                             int clx, int cly,
+                                             int clw, int clh);
+
 #endif
@@ -1,11 +1,14 @@
 #include "common.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "asm_c.h"
 #include "blend.h"
 #include "image.h"
+#include "rgbadraw.h"
 #include "rotate.h"
+#include "threads.h"
 
 /*\ Linear interpolation functions \*/
 /*\ Between two values \*/
@@ -53,70 +56,180 @@
         ((f1) & _ROTATE_PREC_BITS) * ((f2) & _ROTATE_PREC_BITS)) >> (2 * _ROTATE_PREC); \
 } while (0)
 
-/*\ Rotate by pixel sampling only, target inside source \*/
+/*\ Rotate n pixels of one row by pixel sampling only, all inside \*/
 static void
-__imlib_RotateSampleInside(uint32_t *src, uint32_t *dest, int sow, int dow,
-                           int dw, int dh, int x, int y,
-                           int dxh, int dyh, int dxv, int dyv)
+__imlib_RotateSampleSpan(const uint32_t *src, int sow, uint32_t *dest, int n,
+                         int x, int y, int dxh, int dyh)
 {
-    int             i;
+    for (; n > 0; n--)
+    {
+        *dest = src[(x >> _ROTATE_PREC) + ((y >> _ROTATE_PREC) * sow)];
+        /*\ RIGHT; \ */
+        x += dxh;
+        y += dyh;
+        dest++;
+    }
+}
 
-    if ((dw < 1) || (dh < 1))
-        return;
+/*\ Same as last function, but with antialiasing \*/
+static void
+__imlib_RotateAASpan(const uint32_t *src, int sow, uint32_t *dest, int n,
+                     int x, int y, int dxh, int dyh)
+{
+    for (; n > 0; n--)
+    {
+        const uint32_t *src_x_y = (src + (x >> _ROTATE_PREC) +
+                                   ((y >> _ROTATE_PREC) * sow));
+        INTERP_ARGB(dest, src_x_y, sow, x, y);
+        /*\ RIGHT; \ */
+        x += dxh;
+        y += dyh;
+        dest++;
+    }
+}
 
-    while (1)
+static ImlibRotateSpanFunction
+__rotate_span_function(int aa)
+{
+#ifdef DO_AMD64_ASM
+    switch (__imlib_cpu_isa())
     {
-        i = dw - 1;
-        do
-        {
-            *dest = src[(x >> _ROTATE_PREC) + ((y >> _ROTATE_PREC) * sow)];
-            /*\ RIGHT; \ */
-            x += dxh;
-            y += dyh;
-            dest++;
-        }
-        while (--i >= 0);
-        if (--dh <= 0)
-            break;
-        /*\ DOWN/LEFT; \ */
-        x += dxv - dw * dxh;
-        y += dyv - dw * dyh;
-        dest += (dow - dw);
+    case ISA_AVX512:
+        return aa ? __imlib_rotate_aa_span_avx512 :
+            __imlib_rotate_sample_span_avx512;
+    case ISA_AVX2:
+        return aa ? __imlib_rotate_aa_span_avx2 :
+            __imlib_rotate_sample_span_avx2;
+    default:
+        break;
     }
+#endif
+    return aa ? __imlib_RotateAASpan : __imlib_RotateSampleSpan;
 }
 
-/*\ Same as last function, but with antialiasing \*/
+/*\ Floor of a / b, b > 0 \*/
+static int64_t
+__floor_div(int64_t a, int64_t b)
+{
+    return (a >= 0) ? a / b : -((b - 1 - a) / b);
+}
+
+/*\ Range [k0 .. k1) of k in [0 .. n) for which c + k * d is in [0 .. s).
+|*| Done in 64 bits, so inside the range the 32 bit coordinates stepped
+|*| by the row loops are exact.
+\*/
 static void
-__imlib_RotateAAInside(uint32_t *src, uint32_t *dest, int sow, int dow,
-                       int dw, int dh, int x, int y,
-                       int dxh, int dyh, int dxv, int dyv)
+__inside_range(int c, int d, int n, int s, int *k0, int *k1)
 {
-    int             i;
+    int64_t         lo, hi;
 
-    if ((dw < 1) || (dh < 1))
-        return;
+    if (d > 0)
+    {
+        lo = -__floor_div(c, d);
+        hi = __floor_div((int64_t)s - 1 - c, d) + 1;
+    }
+    else if (d < 0)
+    {
+        lo = -__floor_div((int64_t)s - 1 - c, -d);
+        hi = __floor_div(c, -d) + 1;
+    }
+    else
+    {
+        lo = 0;
+        hi = (c >= 0 && c < s) ? n : 0;
+    }
+    *k0 = MAX(*k0, MAX(lo, 0));
+    *k1 = MIN(*k1, MIN(hi, n));
+}
 
-    while (1)
+/*\ Range [k0 .. k1) of k in [0 .. n) for which c0 + k * u is in [0 .. s) \*/
+static void
+__ortho_range(int c0, int u, int n, int s, int *k0, int *k1)
+{
+    if (u > 0)
     {
-        i = dw - 1;
-        do
-        {
-            uint32_t       *src_x_y = (src + (x >> _ROTATE_PREC) +
-                                       ((y >> _ROTATE_PREC) * sow));
-            INTERP_ARGB(dest, src_x_y, sow, x, y);
-            /*\ RIGHT; \ */
-            x += dxh;
-            y += dyh;
-            dest++;
-        }
-        while (--i >= 0);
-        if (--dh <= 0)
-            break;
-        /*\ DOWN/LEFT; \ */
-        x += dxv - dw * dxh;
-        y += dyv - dw * dyh;
-        dest += (dow - dw);
+        *k0 = MAX(0, -c0);
+        *k1 = MIN(n, s - c0);
+    }
+    else
+    {
+        *k0 = MAX(0, c0 - s + 1);
+        *k1 = MIN(n, c0 + 1);
+    }
+}
+
+/*\ Axis aligned steps (exact multiples of 90 degrees): Every step is one
+|*| whole source pixel, so the result is a clipped orthogonal copy of the
+|*| source, same as sampling pixel by pixel.
+|*| Returns 0 if the steps are not axis aligned unit steps.
+\*/
+static int
+__imlib_RotateSampleOrtho(uint32_t *src, uint32_t *dest, int sow, int sw,
+                          int sh, int dow, int dw, int dh, int x, int y,
+                          int dxh, int dyh, int dxv, int dyv)
+{
+    int             ux, uy, vx, vy;
+    int             i0, i1, j0, j1, sx, sy, rw, rh, dxs, dys, j;
+
+    if ((dxh | dyh | dxv | dyv) & _ROTATE_PREC_BITS)
+        return 0;
+    ux = dxh / _ROTATE_PREC_MAX;
+    uy = dyh / _ROTATE_PREC_MAX;
+    vx = dxv / _ROTATE_PREC_MAX;
+    vy = dyv / _ROTATE_PREC_MAX;
+    if (ux * ux + uy * uy != 1 || vx * vx + vy * vy != 1 || ux * vx + uy * vy)
+        return 0;
+
+    x >>= _ROTATE_PREC;
+    y >>= _ROTATE_PREC;
+
+    for (j = 0; j < dh; j++)
+        memset(dest + j * dow, 0, dw * sizeof(uint32_t));
+
+    if (ux)
+    {
+        __ortho_range(x, ux, dw, sw, &i0, &i1);
+        __ortho_range(y, vy, dh, sh, &j0, &j1);
+    }
+    else
+    {
+        __ortho_range(y, uy, dw, sh, &i0, &i1);
+        __ortho_range(x, vx, dh, sw, &j0, &j1);
+    }
+    if (i0 >= i1 || j0 >= j1)
+        return 1;
+
+    /* Source rectangle corner closest to the origin, and where it goes */
+    sx = x + i0 * ux + j0 * vx;
+    sy = y + i0 * uy + j0 * vy;
+    if (ux)
+    {
+        rw = i1 - i0;
+        rh = j1 - j0;
+        if (ux < 0)
+            sx -= rw - 1;
+        if (vy < 0)
+            sy -= rh - 1;
+        dest += (sy - y) * vy * dow + (sx - x) * ux;
+        dxs = ux;
+        dys = vy * dow;
+    }
+    else
+    {
+        rw = j1 - j0;
+        rh = i1 - i0;
+        if (vx < 0)
+            sx -= rw - 1;
+        if (uy < 0)
+            sy -= rh - 1;
+        dest += (sx - x) * vx * dow + (sy - y) * uy;
+        dxs = vx * dow;
+        dys = uy;
     }
+
+    __imlib_CopyDataOrtho(src + sy * sow + sx, sow, rw, rh, dest, dxs, dys);
+
+    return 1;
 }
 
 /*\ NOTE: To check if v is in [b .. t) ((v >= b) && (v < t))
@@ -126,29 +239,207 @@ __imlib_RotateAAInside(uint32_t *src, uint32_t *dest, int sow, int dow,
 |*|  v in [0 .. t) is a special case: ((unsigned)v < t)
 |*|  v in [-t .. 0) is also special, as its the same as ~v in [0 .. t)
 \*/
-static int
-__check_inside_coords(int x, int y, int dxh, int dyh, int dxv, int dyv,
-                      int dw, int dh, int sw, int sh)
+
+/*\ Antialiased pixel near the source edges, see __imlib_RotateAA().
+|*| sw, sh are the (source size - 1) in fixed point.
+\*/
+static uint32_t
+__rotate_aa_edge(const uint32_t *src, int sow, int sw, int sh, int x, int y)
 {
-    sw <<= _ROTATE_PREC;
-    sh <<= _ROTATE_PREC;
+    uint32_t        pix;
+    uint32_t       *dest = &pix;
+    const uint32_t *src_x_y = (src + (x >> _ROTATE_PREC) +
+                               ((y >> _ROTATE_PREC) * sow));
 
-    if (((unsigned)x >= (unsigned)sw) || ((unsigned)y >= (unsigned)sh))
-        return 0;
-    x += dxh * dw;
-    y += dyh * dw;
-    if (((unsigned)x >= (unsigned)sw) || ((unsigned)y >= (unsigned)sh))
-        return 0;
-    x += dxv * dh;
-    y += dyv * dh;
-    if (((unsigned)x >= (unsigned)sw) || ((unsigned)y >= (unsigned)sh))
-        return 0;
-    x -= dxh * dw;
-    y -= dyh * dw;
-    if (((unsigned)x >= (unsigned)sw) || ((unsigned)y >= (unsigned)sh))
-        return 0;
+    if ((unsigned)x < (unsigned)sw)
+    {
+        if ((unsigned)y < (unsigned)sh)
+        {
+            /*\  12
+             * |*|  34
+             * \ */
+            INTERP_ARGB(dest, src_x_y, sow, x, y);
+        }
+        else if ((unsigned)(y - sh) < _ROTATE_PREC_MAX)
+        {
+            /*\  12
+             * |*|  ..
+             * \ */
+            INTERP_RGB_A0(dest, src_x_y, src_x_y + 1, x, ~y);
+        }
+        else if ((unsigned)(~y) < _ROTATE_PREC_MAX)
+        {
+            /*\  ..
+             * |*|  34
+             * \ */
+            INTERP_RGB_A0(dest, src_x_y + sow, src_x_y + sow + 1, x, y);
+        }
+        else
+            *dest = 0;
+    }
+    else if ((unsigned)(x - sw) < (_ROTATE_PREC_MAX))
+    {
+        if ((unsigned)y < (unsigned)sh)
+        {
+            /*\  1.
+             * |*|  3.
+             * \ */
+            INTERP_RGB_A0(dest, src_x_y, src_x_y + sow, y, ~x);
+        }
+        else if ((unsigned)(y - sh) < _ROTATE_PREC_MAX)
+        {
+            /*\  1.
+             * |*|  ..
+             * \ */
+            INTERP_A000(dest, src_x_y, ~x, ~y);
+        }
+        else if ((unsigned)(~y) < _ROTATE_PREC_MAX)
+        {
+            /*\  ..
+             * |*|  3.
+             * \ */
+            INTERP_A000(dest, src_x_y + sow, ~x, y);
+        }
+        else
+            *dest = 0;
+    }
+    else if ((unsigned)(~x) < _ROTATE_PREC_MAX)
+    {
+        if ((unsigned)y < (unsigned)sh)
+        {
+            /*\  .2
+             * |*|  .4
+             * \ */
+            INTERP_RGB_A0(dest, src_x_y + 1, src_x_y + sow + 1, y, x);
+        }
+        else if ((unsigned)(y - sh) < _ROTATE_PREC_MAX)
+        {
+            /*\  .2
+             * |*|  ..
+             * \ */
+            INTERP_A000(dest, src_x_y + 1, x, ~y);
+        }
+        else if ((unsigned)(~y) < _ROTATE_PREC_MAX)
+        {
+            /*\  ..
+             * |*|  .4
+             * \ */
+            INTERP_A000(dest, src_x_y + sow + 1, x, y);
+        }
+        else
+            *dest = 0;
+    }
+    else
+        *dest = 0;
 
-    return 1;
+    return pix;
+}
+
+/*\ Minimum rows per thread \*/
+#define ROTATE_ROWS_MIN(w) (1 + 65536 / (w))
+
+typedef struct {
+    const uint32_t *src;
+    uint32_t       *dest;
+    int             sow, sw, sh, dow, dw;
+    int             x, y, dxh, dyh, dxv, dyv;
+    ImlibRotateSpanFunction span;
+} ImlibRotateJob;
+
+/*\ Border pixels, sampled one by one \*/
+static void
+__rotate_sample_border(const ImlibRotateJob *rj, uint32_t *dest, int n,
+                       int x, int y)
+{
+    int             sw, sh;
+
+    sw = rj->sw << _ROTATE_PREC;
+    sh = rj->sh << _ROTATE_PREC;
+    for (; n > 0; n--)
+    {
+        if (((unsigned)x < (unsigned)sw) && ((unsigned)y < (unsigned)sh))
+            *dest = rj->src[(x >> _ROTATE_PREC) +
+                            ((y >> _ROTATE_PREC) * rj->sow)];
+        else
+            *dest = 0;
+        /*\ RIGHT; \ */
+        x += rj->dxh;
+        y += rj->dyh;
+        dest++;
+    }
+}
+
+static void
+__rotate_aa_border(const ImlibRotateJob *rj, uint32_t *dest, int n,
+                   int x, int y)
+{
+    int             sw, sh;
+
+    sw = (rj->sw - 1) << _ROTATE_PREC;
+    sh = (rj->sh - 1) << _ROTATE_PREC;
+    for (; n > 0; n--)
+    {
+        *dest = __rotate_aa_edge(rj->src, rj->sow, sw, sh, x, y);
+        /*\ RIGHT; \ */
+        x += rj->dxh;
+        y += rj->dyh;
+        dest++;
+    }
+}
+
+/*\ Each row is split in the part where all taps are inside the source,
+|*| done by the span function, and the border parts on either side.
+\*/
+static void
+__rotate_rows(const ImlibRotateJob *rj, int j0, int j1, int aa)
+{
+    uint32_t       *dest;
+    int             j, k0, k1, x, y, sw, sh;
+
+    sw = (rj->sw - aa) << _ROTATE_PREC;
+    sh = (rj->sh - aa) << _ROTATE_PREC;
+
+    for (j = j0; j < j1; j++)
+    {
+        dest = rj->dest + j * rj->dow;
+        x = rj->x + j * rj->dxv;
+        y = rj->y + j * rj->dyv;
+
+        k0 = 0;
+        k1 = rj->dw;
+        __inside_range(x, rj->dxh, rj->dw, sw, &k0, &k1);
+        __inside_range(y, rj->dyh, rj->dw, sh, &k0, &k1);
+        if (k1 <= k0)
+            k0 = k1 = rj->dw;
+
+        if (aa)
+        {
+            __rotate_aa_border(rj, dest, k0, x, y);
+            __rotate_aa_border(rj, dest + k1, rj->dw - k1,
+                               x + k1 * rj->dxh, y + k1 * rj->dyh);
+        }
+        else
+        {
+            __rotate_sample_border(rj, dest, k0, x, y);
+            __rotate_sample_border(rj, dest + k1, rj->dw - k1,
+                                   x + k1 * rj->dxh, y + k1 * rj->dyh);
+        }
+        if (k1 > k0)
+            rj->span(rj->src, rj->sow, dest + k0, k1 - k0,
+                     x + k0 * rj->dxh, y + k0 * rj->dyh, rj->dxh, rj->dyh);
+    }
+}
+
+static void
+__rotate_sample_rows(void *data, int j0, int j1)
+{
+    __rotate_rows(data, j0, j1, 0);
+}
+
+static void
+__rotate_aa_rows(void *data, int j0, int j1)
+{
+    __rotate_rows(data, j0, j1, 1);
 }
 
 /*\ These ones don't need the target to be inside the source \*/
@@ -157,45 +448,20 @@ __imlib_RotateSample(uint32_t *src, uint32_t *dest, int sow, int sw, int sh,
                      int dow, int dw, int dh, int x, int y,
                      int dxh, int dyh, int dxv, int dyv)
 {
-    int             i;
+    ImlibRotateJob  rj;
 
     if ((dw < 1) || (dh < 1))
         return;
 
-    if (__check_inside_coords(x, y, dxh, dyh, dxv, dyv, dw, dh, sw, sh))
-    {
-        __imlib_RotateSampleInside(src, dest, sow, dow, dw, dh, x, y,
-                                   dxh, dyh, dxv, dyv);
+    if (__imlib_RotateSampleOrtho(src, dest, sow, sw, sh, dow, dw, dh, x, y,
+                                  dxh, dyh, dxv, dyv))
         return;
 
-    }
-
-    sw <<= _ROTATE_PREC;
-    sh <<= _ROTATE_PREC;
-    while (1)
-    {
-        i = dw - 1;
-        do
-        {
-            if (((unsigned)x < (unsigned)sw) && ((unsigned)y < (unsigned)sh))
-                *dest = src[(x >> _ROTATE_PREC) + ((y >> _ROTATE_PREC) * sow)];
-            else
-                *dest = 0;
-            /*\ RIGHT; \ */
-            x += dxh;
-            y += dyh;
-            dest++;
-
-        }
-        while (--i >= 0);
-        if (--dh <= 0)
-            break;
-        /*\ DOWN/LEFT; \ */
-        x += dxv - dw * dxh;
-        y += dyv - dw * dyh;
-        dest += (dow - dw);
-
-    }
+    rj = (ImlibRotateJob) {
+        src, dest, sow, sw, sh, dow, dw, x, y, dxh, dyh, dxv, dyv,
+        __rotate_span_function(0)
+    };
+    __imlib_ParallelFor(dh, ROTATE_ROWS_MIN(dw), __rotate_sample_rows, &rj);
 }
 
 /*\ With antialiasing.
@@ -209,7 +475,7 @@ __imlib_RotateAA(uint32_t *src, uint32_t *dest, int sow, int sw, int sh,
                  int dow, int dw, int dh, int x, int y,
                  int dxh, int dyh, int dxv, int dyv)
 {
-    int             i;
+    ImlibRotateJob  rj;
 
     if ((dw < 1) || (dh < 1))
         return;
@@ -223,207 +489,50 @@ __imlib_RotateAA(uint32_t *src, uint32_t *dest, int sow, int sw, int sh,
     }
 #endif
 
-    if (__check_inside_coords(x, y, dxh, dyh, dxv, dyv, dw, dh, sw - 1, sh - 1))
-    {
-        __imlib_RotateAAInside(src, dest, sow, dow, dw, dh, x, y,
-                               dxh, dyh, dxv, dyv);
-        return;
-
-    }
-
-    sw--;
-    sh--;
-    sw <<= _ROTATE_PREC;
-    sh <<= _ROTATE_PREC;
-    while (1)
-    {
-        i = dw - 1;
-        do
-        {
-            uint32_t       *src_x_y = (src + (x >> _ROTATE_PREC) +
-                                       ((y >> _ROTATE_PREC) * sow));
-            if ((unsigned)x < (unsigned)sw)
-            {
-                if ((unsigned)y < (unsigned)sh)
-                {
-                    /*\  12
-                     * |*|  34
-                     * \ */
-                    INTERP_ARGB(dest, src_x_y, sow, x, y);
-                }
-                else if ((unsigned)(y - sh) < _ROTATE_PREC_MAX)
-                {
-                    /*\  12
-                     * |*|  ..
-                     * \ */
-                    INTERP_RGB_A0(dest, src_x_y, src_x_y + 1, x, ~y);
-                }
-                else if ((unsigned)(~y) < _ROTATE_PREC_MAX)
-                {
-                    /*\  ..
-                     * |*|  34
-                     * \ */
-                    INTERP_RGB_A0(dest, src_x_y + sow, src_x_y + sow + 1, x, y);
-                }
-                else
-                    *dest = 0;
-            }
-            else if ((unsigned)(x - sw) < (_ROTATE_PREC_MAX))
-            {
-                if ((unsigned)y < (unsigned)sh)
-                {
-                    /*\  1.
-                     * |*|  3.
-                     * \ */
-                    INTERP_RGB_A0(dest, src_x_y, src_x_y + sow, y, ~x);
-                }
-                else if ((unsigned)(y - sh) < _ROTATE_PREC_MAX)
-                {
-                    /*\  1.
-                     * |*|  ..
-                     * \ */
-                    INTERP_A000(dest, src_x_y, ~x, ~y);
-                }
-                else if ((unsigned)(~y) < _ROTATE_PREC_MAX)
-                {
-                    /*\  ..
-                     * |*|  3.
-                     * \ */
-                    INTERP_A000(dest, src_x_y + sow, ~x, y);
-                }
-                else
-                    *dest = 0;
-            }
-            else if ((unsigned)(~x) < _ROTATE_PREC_MAX)
-            {
-                if ((unsigned)y < (unsigned)sh)
-                {
-                    /*\  .2
-                     * |*|  .4
-                     * \ */
-                    INTERP_RGB_A0(dest, src_x_y + 1, src_x_y + sow + 1, y, x);
-                }
-                else if ((unsigned)(y - sh) < _ROTATE_PREC_MAX)
-                {
-                    /*\  .2
-                     * |*|  ..
-                     * \ */
-                    INTERP_A000(dest, src_x_y + 1, x, ~y);
-                }
-                else if ((unsigned)(~y) < _ROTATE_PREC_MAX)
-                {
-                    /*\  ..
-                     * |*|  .4
-                     * \ */
-                    INTERP_A000(dest, src_x_y + sow + 1, x, y);
-                }
-                else
-                    *dest = 0;
-            }
-            else
-                *dest = 0;
-            /*\ RIGHT; \ */
-            x += dxh;
-            y += dyh;
-            dest++;
-
-        }
-        while (--i >= 0);
-        if (--dh <= 0)
-            break;
-        /*\ DOWN/LEFT; \ */
-        x += dxv - dw * dxh;
-        y += dyv - dw * dyh;
-        dest += (dow - dw);
-
-    }
+    rj = (ImlibRotateJob) {
+        src, dest, sow, sw, sh, dow, dw, x, y, dxh, dyh, dxv, dyv,
+        __rotate_span_function(1)
+    };
+    __imlib_ParallelFor(dh, ROTATE_ROWS_MIN(dw), __rotate_aa_rows, &rj);
 }
 
 /*\ Should this be in blend.c ?? \*/
 #define LINESIZE 16
 
-void
-__imlib_BlendImageToImageSkewed(ImlibImage *im_src, ImlibImage *im_dst,
-                                char aa, char blend, char merge_alpha,
-                                int ssx, int ssy, int ssw, int ssh,
-                                int ddx, int ddy,
-                                int hsx, int hsy, int vsx, int vsy,
-                                ImlibColorModifier *cm, ImlibOp op,
-                                int clx, int cly, int clw, int clh)
-{
-    int             x, y, dxh, dyh, dxv, dyv, i;
-    double          xy2;
-    uint32_t       *data, *src;
-
-    /* Image data should(must) be loaded here but let's just check anyway */
-    if (!im_src->data || !im_dst->data)
-        return;
+/*\ Minimum bands per thread \*/
+#define SKEWED_BANDS_MIN(w) (1 + 65536 / (LINESIZE * (w)))
 
-    if ((ssw < 0) || (ssh < 0))
-        return;
+typedef struct {
+    ImlibImage     *im_dst;
+    uint32_t       *src;
+    int             sow, ssw, ssh;
+    int             x, y, dxh, dyh, dxv, dyv;
+    char            aa, blend, merge_alpha;
+    ImlibColorModifier *cm;
+    ImlibOp         op;
+} ImlibSkewedJob;
 
-    /*\ Complicated gonio.  Works on paper..
-     * |*| Too bad it doesn't all fit into integer math.. 
-     * \ */
-    if (vsx | vsy)
-    {
-        xy2 = (double)(hsx * vsy - vsx * hsy) / _ROTATE_PREC_MAX;
-        if (xy2 == 0.0)
-            return;
-        dxh = (double)(ssw * vsy) / xy2;
-        dxv = (double)-(ssw * vsx) / xy2;
-        dyh = (double)-(ssh * hsy) / xy2;
-        dyv = (double)(ssh * hsx) / xy2;
-    }
-    else
-    {
-        xy2 = (double)(hsx * hsx + hsy * hsy) / _ROTATE_PREC_MAX;
-        if (xy2 == 0.0)
-            return;
-        dxh = (double)(ssw * hsx) / xy2;
-        dyh = (double)-(ssw * hsy) / xy2;
-        dxv = -dyh;
-        dyv = dxh;
-    }
-    x = -(ddx * dxh + ddy * dxv);
-    y = -(ddx * dyh + ddy * dyv);
-
-    if (ssx < 0)
-    {
-        x += ssx * _ROTATE_PREC_MAX;
-        ssw += ssx;
-        ssx = 0;
-
-    }
-    if (ssy < 0)
-    {
-        y += ssy * _ROTATE_PREC_MAX;
-        ssh += ssy;
-        ssy = 0;
-
-    }
-    if ((ssw + ssx) > im_src->w)
-        ssw = im_src->w - ssx;
-    if ((ssh + ssy) > im_src->h)
-        ssh = im_src->h - ssy;
-
-    src = im_src->data + ssx + ssy * im_src->w;
-    data = malloc(im_dst->w * LINESIZE * sizeof(uint32_t));
-    if (!data)
+/*\ Rotate and blend bands [b0 .. b1) of LINESIZE destination rows \*/
+static void
+__skewed_bands(void *data, int b0, int b1)
+{
+    const ImlibSkewedJob *sj = data;
+    int             dxh = sj->dxh, dyh = sj->dyh, dxv = sj->dxv, dyv = sj->dyv;
+    int             ssw = sj->ssw, ssh = sj->ssh;
+    char            aa = sj->aa;
+    uint32_t       *buf;
+    int             b, i, x, y, x2, y2, w, h, l, r;
+
+    buf = malloc(sj->im_dst->w * LINESIZE * sizeof(uint32_t));
+    if (!buf)
         return;
 
-    if (aa)
-    {
-        /*\ Account for virtual transparent border \ */
-        x += _ROTATE_PREC_MAX;
-        y += _ROTATE_PREC_MAX;
-    }
-
-    for (i = 0; i < im_dst->h; i += LINESIZE)
+    for (b = b0; b < b1; b++)
     {
-        int             x2, y2, w, h, l, r;
-
-        h = MIN(LINESIZE, im_dst->h - i);
+        i = b * LINESIZE;
+        x = sj->x + i * dxv;
+        y = sj->y + i * dyv;
+        h = MIN(LINESIZE, sj->im_dst->h - i);
 
         x2 = x + h * dxv;
         y2 = y + h * dyv;
@@ -506,40 +615,117 @@ __imlib_BlendImageToImageSkewed(ImlibImage *im_src, ImlibImage *im_dst,
         r += 2;                 /*\ Be paranoid about roundoff errors \ */
         if (l < 0)
             l = 0;
-        if (r > im_dst->w)
-            r = im_dst->w;
+        if (r > sj->im_dst->w)
+            r = sj->im_dst->w;
         if (r <= l)
-        {
-            x = x2;
-            y = y2;
             continue;
 
-        }
-
         w = r - l;
-        h = MIN(LINESIZE, im_dst->h - i);
+        h = MIN(LINESIZE, sj->im_dst->h - i);
         x += l * dxh;
         y += l * dyh;
         if (aa)
         {
             x -= _ROTATE_PREC_MAX;
             y -= _ROTATE_PREC_MAX;
-            __imlib_RotateAA(src, data, im_src->w, ssw, ssh, w, w, h,
+            __imlib_RotateAA(sj->src, buf, sj->sow, ssw, ssh, w, w, h,
                              x, y, dxh, dyh, dxv, dyv);
 
         }
         else
         {
-            __imlib_RotateSample(src, data, im_src->w, ssw, ssh, w, w, h,
+            __imlib_RotateSample(sj->src, buf, sj->sow, ssw, ssh, w, w, h,
                                  x, y, dxh, dyh, dxv, dyv);
 
         }
-        __imlib_BlendRGBAToData(data, w, h, im_dst->data,
-                                im_dst->w, im_dst->h, 0, 0, l, i, w, h,
-                                blend, merge_alpha, cm, op, 0);
-        x = x2;
-        y = y2;
+        __imlib_BlendRGBAToData(buf, w, h, sj->im_dst->data,
+                                sj->im_dst->w, sj->im_dst->h, 0, 0, l, i, w, h,
+                                sj->blend, sj->merge_alpha, sj->cm, sj->op, 0);
+    }
+    free(buf);
+}
+
+void
+__imlib_BlendImageToImageSkewed(ImlibImage *im_src, ImlibImage *im_dst,
+                                char aa, char blend, char merge_alpha,
+                                int ssx, int ssy, int ssw, int ssh,
+                                int ddx, int ddy,
+                                int hsx, int hsy, int vsx, int vsy,
+                                ImlibColorModifier *cm, ImlibOp op,
+                                int clx, int cly, int clw, int clh)
+{
+    ImlibSkewedJob  sj;
+    int             x, y, dxh, dyh, dxv, dyv;
+    double          xy2;
+
+    /* Image data should(must) be loaded here but let's just check anyway */
+    if (!im_src->data || !im_dst->data)
+        return;
+
+    if ((ssw < 0) || (ssh < 0))
+        return;
 
+    /*\ Complicated gonio.  Works on paper..
+     * |*| Too bad it doesn't all fit into integer math.. 
+     * \ */
+    if (vsx | vsy)
+    {
+        xy2 = (double)(hsx * vsy - vsx * hsy) / _ROTATE_PREC_MAX;
+        if (xy2 == 0.0)
+            return;
+        dxh = (double)(ssw * vsy) / xy2;
+        dxv = (double)-(ssw * vsx) / xy2;
+        dyh = (double)-(ssh * hsy) / xy2;
+        dyv = (double)(ssh * hsx) / xy2;
     }
-    free(data);
+    else
+    {
+        xy2 = (double)(hsx * hsx + hsy * hsy) / _ROTATE_PREC_MAX;
+        if (xy2 == 0.0)
+            return;
+        dxh = (double)(ssw * hsx) / xy2;
+        dyh = (double)-(ssw * hsy) / xy2;
+        dxv = -dyh;
+        dyv = dxh;
+    }
+    x = -(ddx * dxh + ddy * dxv);
+    y = -(ddx * dyh + ddy * dyv);
+
+    if (ssx < 0)
+    {
+        x += ssx * _ROTATE_PREC_MAX;
+        ssw += ssx;
+        ssx = 0;
+
+    }
+    if (ssy < 0)
+    {
+        y += ssy * _ROTATE_PREC_MAX;
+        ssh += ssy;
+        ssy = 0;
+
+    }
+    if ((ssw + ssx) > im_src->w)
+        ssw = im_src->w - ssx;
+    if ((ssh + ssy) > im_src->h)
+        ssh = im_src->h - ssy;
+
+    if (aa)
+    {
+        /*\ Account for virtual transparent border \ */
+        x += _ROTATE_PREC_MAX;
+        y += _ROTATE_PREC_MAX;
+    }
+
+    sj = (ImlibSkewedJob) {
+        im_dst, im_src->data + ssx + ssy * im_src->w, im_src->w, ssw, ssh,
+        x, y, dxh, dyh, dxv, dyv, aa, blend, merge_alpha, cm, op
+    };
+
+    /*\ Bands touch disjoint destination rows, so they can run in parallel
+     * |*| once the lookup tables shared by the blenders are set up.
+     * \ */
+    __imlib_build_pow_lut();
+    __imlib_ParallelFor((im_dst->h + LINESIZE - 1) / LINESIZE,
+                        SKEWED_BANDS_MIN(im_dst->w), __skewed_bands, &sj);
 }
@@ -8,6 +8,11 @@
 #define _ROTATE_PREC_MAX (1 << _ROTATE_PREC)
 #define _ROTATE_PREC_BITS (_ROTATE_PREC_MAX - 1)
 
+/* Rotate n pixels of one row, all taps inside the source */
+typedef void    (*ImlibRotateSpanFunction)(const uint32_t * src, int sow,
+                                           uint32_t * dst, int n,
+                                           int x, int y, int dxh, int dyh);
+
 void            __imlib_RotateSample(uint32_t * src, uint32_t * dest,
                                      int sow, int sw, int sh,
                                      int dow, int dw, int dh,
@@ -32,6 +37,24 @@ void            __imlib_BlendImageToImageSkewed(ImlibImage * im_src,
                                                 int clx, int cly,
                                                 int clw, int clh);
 
+#if DO_AMD64_ASM
+void            __imlib_rotate_sample_span_avx2(const uint32_t * src, int sow,
+                                                uint32_t * dst, int n,
+                                                int x, int y,
+                                                int dxh, int dyh);
+void            __imlib_rotate_sample_span_avx512(const uint32_t * src,
+                                                  int sow, uint32_t * dst,
+                                                  int n, int x, int y,
+                                                  int dxh, int dyh);
+void            __imlib_rotate_aa_span_avx2(const uint32_t * src, int sow,
+                                            uint32_t * dst, int n,
+                                            int x, int y, int dxh, int dyh);
+void            __imlib_rotate_aa_span_avx512(const uint32_t * src, int sow,
+                                              uint32_t * dst, int n,
+                                              int x, int y,
+                                              int dxh, int dyh);
+#endif
+
 #ifdef DO_MMX_ASM
 void            __imlib_mmx_RotateAA(uint32_t * src, uint32_t * dest,
                                      int sow, int sw, int sh, int dow,
@@ -2,6 +2,7 @@
 
 #include <stddef.h>
 
+#include "asm_c.h"
 #include "blend.h"
 #include "span.h"
 
@@ -1232,27 +1233,38 @@ __imlib_GetSpanDrawFunction(ImlibOp op, char dst_alpha, char blend)
     if (opi == -1)
         return NULL;
 
+#ifdef DO_AMD64_ASM
+    switch (__imlib_cpu_isa())
+    {
+    case ISA_AVX512:
+        return __imlib_span_funcs_avx512[opi][!!dst_alpha][!!blend];
+    case ISA_AVX2:
+        return __imlib_span_funcs_avx2[opi][!!dst_alpha][!!blend];
+    default:
+        break;
+    }
+#endif
     return spanfuncs[opi][!!dst_alpha][!!blend];
 }
 
+const ImlibShapedSpanDrawFunction __imlib_shaped_span_funcs_c[4][2][2] =
+    /* OP_COPY */
+{ { { __imlib_CopyShapedSpanToRGB, __imlib_BlendShapedSpanToRGB},
+   { __imlib_CopyShapedSpanToRGBA, __imlib_BlendShapedSpanToRGBA} },
+/* OP_ADD */
+{ { __imlib_AddCopyShapedSpanToRGB, __imlib_AddBlendShapedSpanToRGB},
+ { __imlib_AddCopyShapedSpanToRGBA, __imlib_AddBlendShapedSpanToRGBA} },
+/* OP_SUBTRACT */
+{ { __imlib_SubCopyShapedSpanToRGB, __imlib_SubBlendShapedSpanToRGB},
+ { __imlib_SubCopyShapedSpanToRGBA, __imlib_SubBlendShapedSpanToRGBA} },
+/* OP_RESHADE */
+{ { __imlib_ReCopyShapedSpanToRGB, __imlib_ReBlendShapedSpanToRGB},
+ { __imlib_ReCopyShapedSpanToRGBA, __imlib_ReBlendShapedSpanToRGBA} },
+};
+
 ImlibShapedSpanDrawFunction
 __imlib_GetShapedSpanDrawFunction(ImlibOp op, char dst_alpha, char blend)
 {
-    static ImlibShapedSpanDrawFunction shapedspanfuncs[4][2][2] =
-        /* OP_COPY */
-    { { { __imlib_CopyShapedSpanToRGB, __imlib_BlendShapedSpanToRGB},
-       { __imlib_CopyShapedSpanToRGBA, __imlib_BlendShapedSpanToRGBA} },
-    /* OP_ADD */
-    { { __imlib_AddCopyShapedSpanToRGB, __imlib_AddBlendShapedSpanToRGB},
-     { __imlib_AddCopyShapedSpanToRGBA, __imlib_AddBlendShapedSpanToRGBA} },
-    /* OP_SUBTRACT */
-    { { __imlib_SubCopyShapedSpanToRGB, __imlib_SubBlendShapedSpanToRGB},
-     { __imlib_SubCopyShapedSpanToRGBA, __imlib_SubBlendShapedSpanToRGBA} },
-    /* OP_RESHADE */
-    { { __imlib_ReCopyShapedSpanToRGB, __imlib_ReBlendShapedSpanToRGB},
-     { __imlib_ReCopyShapedSpanToRGBA, __imlib_ReBlendShapedSpanToRGBA} },
-    };
-
     int             opi = (op == OP_COPY) ? 0
         : (op == OP_ADD) ? 1
         : (op == OP_SUBTRACT) ? 2 : (op == OP_RESHADE) ? 3 : -1;
@@ -1260,5 +1272,16 @@ __imlib_GetShapedSpanDrawFunction(ImlibOp op, char dst_alpha, char blend)
     if (opi == -1)
         return NULL;
 
-    return shapedspanfuncs[opi][!!dst_alpha][!!blend];
+#ifdef DO_AMD64_ASM
+    switch (__imlib_cpu_isa())
+    {
+    case ISA_AVX512:
+        return __imlib_shaped_span_funcs_avx512[opi][!!dst_alpha][!!blend];
+    case ISA_AVX2:
+        return __imlib_shaped_span_funcs_avx2[opi][!!dst_alpha][!!blend];
+    default:
+        break;
+    }
+#endif
+    return __imlib_shaped_span_funcs_c[opi][!!dst_alpha][!!blend];
 }
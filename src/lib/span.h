@@ -19,4 +19,16 @@ typedef void    (*ImlibShapedSpanDrawFunction)(uint8_t *, uint32_t,
 ImlibShapedSpanDrawFunction
 __imlib_GetShapedSpanDrawFunction(ImlibOp op, char dst_alpha, char blend);
 
+/* [ operation ][ dst_alpha ][ blend ] */
+extern const ImlibShapedSpanDrawFunction __imlib_shaped_span_funcs_c[4][2][2];
+
+#if DO_AMD64_ASM
+/* [ operation ][ dst_alpha ][ blend ] */
+extern const ImlibSpanDrawFunction __imlib_span_funcs_avx2[4][2][2];
+extern const ImlibSpanDrawFunction __imlib_span_funcs_avx512[4][2][2];
+extern const ImlibShapedSpanDrawFunction __imlib_shaped_span_funcs_avx2[4][2][2];
+extern const ImlibShapedSpanDrawFunction
+    __imlib_shaped_span_funcs_avx512[4][2][2];
+#endif
+
 #endif
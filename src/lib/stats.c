@@ -0,0 +1,232 @@
+#include "common.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "stats.h"
+
+typedef struct _ImlibStatsLoader {
+    struct _ImlibStatsLoader *next;
+    char           *name;
+    uint64_t        headers;    /* Header-only loads */
+    ImlibStatsIO    load;
+    ImlibStatsIO    save;
+} ImlibStatsLoader;
+
+ImlibStats      __imlib_stats;
+
+static ImlibStatsLoader *loader_stats = NULL;
+
+static ImlibTraceFunction trace_func = NULL;
+static void    *trace_data = NULL;
+
+static const char *const cache_names[STATS_CACHE_NUM] = {
+    "image", "pixmap", "ximage",
+};
+
+static const char *const op_names[4] = {
+    "copy", "add", "subtract", "reshade",
+};
+
+static ImlibStatsLoader *
+_stats_loader(const char *name)
+{
+    ImlibStatsLoader *ls;
+
+    for (ls = loader_stats; ls; ls = ls->next)
+    {
+        if (strcmp(ls->name, name) == 0)
+            return ls;
+    }
+
+    /* Entries are kept when loaders are flushed, the counters survive */
+    ls = calloc(1, sizeof(ImlibStatsLoader));
+    if (!ls)
+        return NULL;
+    ls->name = strdup(name);
+    if (!ls->name)
+    {
+        free(ls);
+        return NULL;
+    }
+    ls->next = loader_stats;
+    loader_stats = ls;
+
+    return ls;
+}
+
+static void
+_stats_io_add(ImlibStatsIO *io, int ok, uint64_t bytes_in, uint64_t bytes_out,
+              unsigned int dt)
+{
+    unsigned int    lim;
+    int             i;
+
+    if (!ok)
+    {
+        io->errors++;
+        return;
+    }
+
+    io->count++;
+    io->bytes_in += bytes_in;
+    io->bytes_out += bytes_out;
+    io->time_us += dt;
+
+    /* Bin upper limits are 16us * 4^i, the last one catches the rest */
+    for (i = 0, lim = 16; i < STATS_HIST_BINS - 1; i++, lim <<= 2)
+    {
+        if (dt <= lim)
+            break;
+    }
+    io->hist[i]++;
+}
+
+void
+__imlib_StatsLoad(const char *ldr, int load_data, int rc,
+                  uint64_t bytes_in, uint64_t bytes_out, unsigned int dt)
+{
+    ImlibStatsLoader *ls;
+
+    ls = _stats_loader(ldr);
+    if (!ls)
+        return;
+
+    if (load_data || rc < 0)
+        _stats_io_add(&ls->load, rc > 0, bytes_in, bytes_out, dt);
+    else
+        ls->headers++;
+}
+
+void
+__imlib_StatsSave(const char *ldr, int rc,
+                  uint64_t bytes_in, uint64_t bytes_out, unsigned int dt)
+{
+    ImlibStatsLoader *ls;
+
+    ls = _stats_loader(ldr);
+    if (!ls)
+        return;
+
+    _stats_io_add(&ls->save, rc > 0, bytes_in, bytes_out, dt);
+}
+
+static void
+_stats_emit(ImlibStatsFunction func, void *data, uint64_t value,
+            const char *fmt, ...) __PRINTF_N__(4);
+
+static void
+_stats_emit(ImlibStatsFunction func, void *data, uint64_t value,
+            const char *fmt, ...)
+{
+    char            name[128];
+    va_list         args;
+
+    va_start(args, fmt);
+    vsnprintf(name, sizeof(name), fmt, args);
+    va_end(args);
+
+    func(name, value, data);
+}
+
+static void
+_stats_emit_io(ImlibStatsFunction func, void *data, const char *pfx,
+               const char *ldr, const ImlibStatsIO *io)
+{
+    unsigned int    lim;
+    int             i;
+
+    _stats_emit(func, data, io->count, "%s.%s.count", pfx, ldr);
+    _stats_emit(func, data, io->errors, "%s.%s.errors", pfx, ldr);
+    _stats_emit(func, data, io->bytes_in, "%s.%s.bytes_in", pfx, ldr);
+    _stats_emit(func, data, io->bytes_out, "%s.%s.bytes_out", pfx, ldr);
+    _stats_emit(func, data, io->time_us, "%s.%s.time_us", pfx, ldr);
+    for (i = 0, lim = 16; i < STATS_HIST_BINS - 1; i++, lim <<= 2)
+        _stats_emit(func, data, io->hist[i], "%s.%s.latency_us.%u",
+                    pfx, ldr, lim);
+    _stats_emit(func, data, io->hist[i], "%s.%s.latency_us.inf", pfx, ldr);
+}
+
+void
+__imlib_StatsForeach(ImlibStatsFunction func, void *data)
+{
+    const ImlibStatsLoader *ls;
+    int             i;
+
+    for (ls = loader_stats; ls; ls = ls->next)
+    {
+        _stats_emit(func, data, ls->headers, "load.%s.headers", ls->name);
+        _stats_emit_io(func, data, "load", ls->name, &ls->load);
+        _stats_emit_io(func, data, "save", ls->name, &ls->save);
+    }
+
+    for (i = 0; i < STATS_CACHE_NUM; i++)
+    {
+        _stats_emit(func, data, __imlib_stats.cache[i].hit,
+                    "cache.%s.hit", cache_names[i]);
+        _stats_emit(func, data, __imlib_stats.cache[i].miss,
+                    "cache.%s.miss", cache_names[i]);
+        _stats_emit(func, data, __imlib_stats.cache[i].evict,
+                    "cache.%s.evict", cache_names[i]);
+    }
+
+    _stats_emit(func, data, __imlib_stats.scale_bytes[0], "scale.sample.bytes");
+    _stats_emit(func, data, __imlib_stats.scale_bytes[1], "scale.aa.bytes");
+    for (i = 0; i < 4; i++)
+        _stats_emit(func, data, __imlib_stats.blend_bytes[i],
+                    "blend.%s.bytes", op_names[i]);
+    _stats_emit(func, data, __imlib_stats.render_count, "render.count");
+    _stats_emit(func, data, __imlib_stats.render_bytes, "render.bytes");
+}
+
+void
+__imlib_StatsReset(void)
+{
+    ImlibStatsLoader *ls;
+
+    for (ls = loader_stats; ls; ls = ls->next)
+    {
+        ls->headers = 0;
+        memset(&ls->load, 0, sizeof(ls->load));
+        memset(&ls->save, 0, sizeof(ls->save));
+    }
+    memset(&__imlib_stats, 0, sizeof(__imlib_stats));
+}
+
+void
+__imlib_SetTraceFunction(ImlibTraceFunction func, void *data)
+{
+    trace_func = func;
+    trace_data = data;
+}
+
+void
+__imlib_SpanBegin(ImlibSpan *sp, int type, const char *name,
+                  const char *file, int w, int h)
+{
+    sp->type = type;
+    sp->name = name;
+    sp->file = file;
+    sp->w = w;
+    sp->h = h;
+    sp->t0 = __imlib_time_us();
+
+    if (trace_func)
+        trace_func(sp, 0, 0, 0, trace_data);
+}
+
+unsigned int
+__imlib_SpanEnd(ImlibSpan *sp, int err)
+{
+    unsigned int    dt;
+
+    dt = __imlib_time_us() - sp->t0;
+
+    if (trace_func)
+        trace_func(sp, 1, err, dt, trace_data);
+
+    return dt;
+}
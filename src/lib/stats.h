@@ -0,0 +1,82 @@
+#ifndef __STATS
+#define __STATS 1
+
+#include "types.h"
+
+#define STATS_HIST_BINS 11      /* Latency bins: <=16us, <=64us, ..., inf */
+
+typedef struct {
+    uint64_t        count;      /* Completed operations */
+    uint64_t        errors;     /* Failed operations */
+    uint64_t        bytes_in;
+    uint64_t        bytes_out;
+    uint64_t        time_us;    /* Accumulated time */
+    uint64_t        hist[STATS_HIST_BINS];      /* Latency histogram */
+} ImlibStatsIO;
+
+typedef struct {
+    uint64_t        hit;
+    uint64_t        miss;
+    uint64_t        evict;
+} ImlibStatsCache;
+
+enum {
+    STATS_CACHE_IMAGE,
+    STATS_CACHE_PIXMAP,
+    STATS_CACHE_XIMAGE,
+    STATS_CACHE_NUM
+};
+
+typedef struct {
+    ImlibStatsCache cache[STATS_CACHE_NUM];
+    uint64_t        scale_bytes[2];     /* [ anti-alias ] */
+    uint64_t        blend_bytes[4];     /* [ operation ] */
+    uint64_t        render_count;
+    uint64_t        render_bytes;
+} ImlibStats;
+
+extern ImlibStats __imlib_stats;
+
+/* Counters may be bumped from the worker threads (threads.c) */
+#define STATS_ADD(field, n) \
+    __atomic_fetch_add(&__imlib_stats.field, (n), __ATOMIC_RELAXED)
+#define STATS_INC(field)        STATS_ADD(field, 1)
+#define STATS_CACHE_INC(c, f)   STATS_ADD(cache[c].f, 1)
+
+/* Must match Imlib_Trace_Type in Imlib2.h.in */
+enum {
+    SPAN_LOAD,
+    SPAN_SAVE,
+    SPAN_SCALE,
+    SPAN_RENDER
+};
+
+typedef struct {
+    int             type;
+    const char     *name;
+    const char     *file;
+    int             w, h;
+    unsigned int    t0;
+} ImlibSpan;
+
+void            __imlib_SpanBegin(ImlibSpan * sp, int type, const char *name,
+                                  const char *file, int w, int h);
+unsigned int    __imlib_SpanEnd(ImlibSpan * sp, int err);
+
+void            __imlib_StatsLoad(const char *ldr, int load_data, int rc,
+                                  uint64_t bytes_in, uint64_t bytes_out,
+                                  unsigned int dt);
+void            __imlib_StatsSave(const char *ldr, int rc,
+                                  uint64_t bytes_in, uint64_t bytes_out,
+                                  unsigned int dt);
+
+typedef void    (*ImlibStatsFunction)(const char *name, uint64_t value,
+                                      void *data);
+typedef void    (*ImlibTraceFunction)(const ImlibSpan * sp, int end,
+                                      int err, unsigned int dt, void *data);
+
+void            __imlib_StatsForeach(ImlibStatsFunction func, void *data);
+void            __imlib_StatsReset(void);
+void            __imlib_SetTraceFunction(ImlibTraceFunction func, void *data);
+
+#endif
@@ -0,0 +1,222 @@
+#include "common.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "threads.h"
+
+#define DBG_PFX "THR"
+
+#define THREADS_MAX     64
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t  cond_work;  /* New job posted */
+    pthread_cond_t  cond_done;  /* Job chunk finished */
+    int             nthreads;   /* Total, including caller, 0: not set up */
+    int             nworkers;   /* Started workers, in threads */
+    pthread_t       threads[THREADS_MAX];
+    unsigned int    job_id;
+    ImlibParallelFunction *func;
+    void           *data;
+    int             n, chunk;
+    int             next;       /* Next item to hand out */
+    int             busy;       /* Chunks being processed */
+    char            active;     /* A job is running */
+    char            quit;       /* Workers are to exit */
+} ImlibThreadPool;
+
+static ImlibThreadPool pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond_work = PTHREAD_COND_INITIALIZER,
+    .cond_done = PTHREAD_COND_INITIALIZER,
+};
+
+static pthread_once_t pool_atfork_once = PTHREAD_ONCE_INIT;
+
+/* Grab and run chunks of the current job. Called with lock held. */
+static void
+_pool_run_chunks(void)
+{
+    ImlibParallelFunction *func;
+    void           *data;
+    int             i0, i1;
+
+    while (pool.next < pool.n)
+    {
+        i0 = pool.next;
+        i1 = i0 + pool.chunk;
+        if (i1 > pool.n)
+            i1 = pool.n;
+        pool.next = i1;
+        pool.busy++;
+        func = pool.func;
+        data = pool.data;
+
+        pthread_mutex_unlock(&pool.lock);
+        func(data, i0, i1);
+        pthread_mutex_lock(&pool.lock);
+
+        if (--pool.busy == 0 && pool.next >= pool.n)
+            pthread_cond_broadcast(&pool.cond_done);
+    }
+}
+
+static void    *
+_pool_worker(void *arg)
+{
+    unsigned int    job_id = 0;
+
+    pthread_mutex_lock(&pool.lock);
+    for (;;)
+    {
+        while (pool.job_id == job_id && !pool.quit)
+            pthread_cond_wait(&pool.cond_work, &pool.lock);
+        if (pool.quit)
+            break;
+        job_id = pool.job_id;
+        _pool_run_chunks();
+    }
+    pthread_mutex_unlock(&pool.lock);
+
+    return NULL;
+}
+
+static void
+_pool_atfork_child(void)
+{
+    /* Only the forking thread exists in the child */
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.cond_work, NULL);
+    pthread_cond_init(&pool.cond_done, NULL);
+    pool.nthreads = 0;
+    pool.nworkers = 0;
+    pool.active = 0;
+}
+
+static void
+_pool_atfork_register(void)
+{
+    pthread_atfork(NULL, NULL, _pool_atfork_child);
+}
+
+/* Set up the pool. Called with lock held. */
+static void
+_pool_init(void)
+{
+    const char     *s;
+    long            n;
+    int             i;
+
+    n = sysconf(_SC_NPROCESSORS_ONLN);
+    s = getenv("IMLIB2_THREADS");
+    if (s)
+        n = strtol(s, NULL, 0);
+    if (n < 1)
+        n = 1;
+    if (n > THREADS_MAX)
+        n = THREADS_MAX;
+
+    pool.nthreads = 1;
+    if (n <= 1 || pool.quit)
+        return;
+
+    for (i = 1; i < n; i++)
+    {
+        if (pthread_create(&pool.threads[pool.nworkers], NULL,
+                           _pool_worker, NULL))
+            break;
+        pool.nworkers++;
+        pool.nthreads++;
+    }
+
+    pthread_once(&pool_atfork_once, _pool_atfork_register);
+
+    D("%s: threads=%d\n", __func__, pool.nthreads);
+}
+
+/* Stop and join the workers when the library is unloaded.
+ * Anything parallel after this runs in the caller. */
+__attribute__((destructor))
+static void
+_pool_fini(void)
+{
+    int             i, n;
+
+    pthread_mutex_lock(&pool.lock);
+    pool.quit = 1;
+    pthread_cond_broadcast(&pool.cond_work);
+    n = pool.nworkers;
+    pool.nworkers = 0;
+    if (pool.nthreads > 1)
+        pool.nthreads = 1;
+    pthread_mutex_unlock(&pool.lock);
+
+    for (i = 0; i < n; i++)
+        pthread_join(pool.threads[i], NULL);
+
+    D("%s: joined %d\n", __func__, n);
+}
+
+int
+__imlib_ThreadCount(void)
+{
+    int             n;
+
+    pthread_mutex_lock(&pool.lock);
+    if (pool.nthreads == 0)
+        _pool_init();
+    n = pool.nthreads;
+    pthread_mutex_unlock(&pool.lock);
+
+    return n;
+}
+
+void
+__imlib_ParallelFor(int n, int min_chunk, ImlibParallelFunction *func,
+                    void *data)
+{
+    int             chunk;
+
+    if (n <= 0)
+        return;
+    if (min_chunk < 1)
+        min_chunk = 1;
+
+    pthread_mutex_lock(&pool.lock);
+
+    if (pool.nthreads == 0)
+        _pool_init();
+
+    if (pool.active || pool.nthreads <= 1 || n < 2 * min_chunk)
+    {
+        /* Nested, single threaded, or too little work */
+        pthread_mutex_unlock(&pool.lock);
+        func(data, 0, n);
+        return;
+    }
+
+    /* A few chunks per thread for load balancing */
+    chunk = (n + 4 * pool.nthreads - 1) / (4 * pool.nthreads);
+    if (chunk < min_chunk)
+        chunk = min_chunk;
+
+    pool.active = 1;
+    pool.func = func;
+    pool.data = data;
+    pool.n = n;
+    pool.chunk = chunk;
+    pool.next = 0;
+    pool.busy = 0;
+    pool.job_id++;
+    pthread_cond_broadcast(&pool.cond_work);
+
+    _pool_run_chunks();
+    while (pool.busy > 0)
+        pthread_cond_wait(&pool.cond_done, &pool.lock);
+
+    pool.active = 0;
+    pthread_mutex_unlock(&pool.lock);
+}
@@ -0,0 +1,20 @@
+#ifndef __THREADS
+#define __THREADS 1
+
+/* Process items [i0 .. i1) */
+typedef void    (ImlibParallelFunction)(void *data, int i0, int i1);
+
+/*
+ * Call func on disjoint ranges covering [0 .. n), in parallel on the
+ * worker threads and the calling thread. Returns when all are done.
+ * Ranges are at least min_chunk items (except the last).
+ * Runs func(data, 0, n) directly when threading does not pay off, and when
+ * called from within a parallel section.
+ */
+void            __imlib_ParallelFor(int n, int min_chunk,
+                                    ImlibParallelFunction * func, void *data);
+
+/* Number of threads (including the caller) used by __imlib_ParallelFor() */
+int             __imlib_ThreadCount(void);
+
+#endif
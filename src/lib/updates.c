@@ -3,145 +3,187 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "region.h"
 #include "updates.h"
 
-enum _t_used {
-    T_UNUSED = 0,
-    T_USED = 1
-};
+/*
+ * Update merging
+ *
+ * The updates are turned into a region, which removes all overlap.
+ * Then bands of the region are merged top to bottom, and gaps within bands
+ * filled, as long as the pixels drawn in excess cost less than the
+ * rectangles saved (cost pixels each).
+ */
+
+/* Append the union of the boxes a and b (each sorted by x), from y1 to y2,
+ * filling gaps when the pixels cost less than a rectangle */
+static int
+__upd_band(ImlibRegion *out, const ImlibBox *a, int na,
+           const ImlibBox *b, int nb, int y1, int y2, int cost)
+{
+    const ImlibBox *p, *ae, *be;
+    int             x1, x2, gapmax;
+    ImlibBox       *bx;
+
+    if (out->num + na + nb > out->alloc)
+    {
+        bx = realloc(out->boxes, (out->num + na + nb) * 2 * sizeof(ImlibBox));
+        if (!bx)
+            return -1;
+        out->boxes = bx;
+        out->alloc = (out->num + na + nb) * 2;
+    }
+
+    gapmax = cost > 0 ? (cost - 1) / (y2 - y1) : 0;
+    ae = a + na;
+    be = b + nb;
+    x1 = x2 = 0;
+    for (;;)
+    {
+        if (a < ae && (b == be || a->x1 < b->x1))
+            p = a++;
+        else if (b < be)
+            p = b++;
+        else
+            p = NULL;
+        if (p && x1 < x2 && p->x1 - x2 <= gapmax)
+        {
+            x2 = MAX(x2, p->x2);
+            continue;
+        }
+        if (x1 < x2)
+        {
+            bx = &out->boxes[out->num++];
+            bx->x1 = x1;
+            bx->y1 = y1;
+            bx->x2 = x2;
+            bx->y2 = y2;
+        }
+        if (!p)
+            break;
+        x1 = p->x1;
+        x2 = p->x2;
+    }
+
+    return 0;
+}
 
-struct _tile {
-    char            used;
-};
+static int64_t
+__upd_cost(const ImlibRegion *band, int cost)
+{
+    int64_t         c;
+    int             i;
+
+    c = (int64_t)band->num * cost;
+    for (i = 0; i < band->num; i++)
+        c += (int64_t)(band->boxes[i].x2 - band->boxes[i].x1) *
+            (band->boxes[i].y2 - band->boxes[i].y1);
+
+    return c;
+}
+
+static int
+__upd_merge(ImlibRegion *out, const ImlibRegion *rg, int cost)
+{
+    ImlibRegion     cur, next, tmp, t;
+    const ImlibBox *b, *be, *end;
+    int             err;
+
+    __imlib_RegionInit(&cur);
+    __imlib_RegionInit(&next);
+    __imlib_RegionInit(&tmp);
+    err = 0;
+
+    end = rg->boxes + rg->num;
+    for (b = rg->boxes; b < end && !err; b = be)
+    {
+        for (be = b + 1; be < end && be->y1 == b->y1; be++)
+            ;
+        next.num = 0;
+        err = __upd_band(&next, b, be - b, NULL, 0, b->y1, b->y2, cost);
+        if (err)
+            break;
+        if (cur.num == 0)
+        {
+            t = cur, cur = next, next = t;
+            continue;
+        }
+
+        /* Merge with the band(s) above if cheaper */
+        tmp.num = 0;
+        err = __upd_band(&tmp, cur.boxes, cur.num, next.boxes, next.num,
+                         cur.boxes[0].y1, next.boxes[0].y2, cost);
+        if (err)
+            break;
+        if (__upd_cost(&tmp, cost) <=
+            __upd_cost(&cur, cost) + __upd_cost(&next, cost))
+        {
+            t = cur, cur = tmp, tmp = t;
+            continue;
+        }
+        err = __upd_band(out, cur.boxes, cur.num, NULL, 0,
+                         cur.boxes[0].y1, cur.boxes[0].y2, 0);
+        t = cur, cur = next, next = t;
+    }
+    if (!err && cur.num > 0)
+        err = __upd_band(out, cur.boxes, cur.num, NULL, 0,
+                         cur.boxes[0].y1, cur.boxes[0].y2, 0);
 
-#define TBITS 5
-#define TB TBITS
-#define TM ((1 << TBITS) - 1)
-#define TS (1 << TBITS)
+    __imlib_RegionFini(&cur);
+    __imlib_RegionFini(&next);
+    __imlib_RegionFini(&tmp);
 
-#define T(x, y) t[((y) * tw) + (x)]
+    return err;
+}
 
 ImlibUpdate    *
-__imlib_MergeUpdate(ImlibUpdate *u, int w, int h, int hgapmax)
+__imlib_MergeUpdate(ImlibUpdate *u, int w, int h, int cost)
 {
-    ImlibUpdate    *nu = NULL, *uu;
-    struct _tile   *t;
-    int             tw, th, x, y;
-    int            *gaps = NULL;
+    ImlibUpdate    *nu, *uu;
+    ImlibBox       *boxes;
+    ImlibRegion     rg, out;
+    int             i, n, err;
 
     /* if theres no rects to process.. return NULL */
     if (!u)
         return NULL;
-    tw = w >> TB;
-    if (w & TM)
-        tw++;
-    th = h >> TB;
-    if (h & TM)
-        th++;
-    t = calloc(tw * th, sizeof(struct _tile));
-    if (!t)
-        return NULL;
-    /* fill in all tiles */
-    for (uu = u; uu; uu = uu->next)
+
+    for (n = 0, uu = u; uu; uu = uu->next)
+        n++;
+    boxes = malloc(n * sizeof(ImlibBox));
+    if (!boxes)
+        return u;
+    for (i = 0, uu = u; uu; uu = uu->next, i++)
     {
         CLIP(uu->x, uu->y, uu->w, uu->h, 0, 0, w, h);
-        for (y = uu->y >> TB; y <= ((uu->y + uu->h - 1) >> TB); y++)
-        {
-            for (x = uu->x >> TB; x <= ((uu->x + uu->w - 1) >> TB); x++)
-                T(x, y).used = T_USED;
-        }
-    }
-    /* scan each line - if > hgapmax gaps between tiles, then fill smallest */
-    gaps = malloc(tw * sizeof(int));
-    if (!gaps)
-    {
-        free(t);
-        return NULL;
+        boxes[i].x1 = uu->x;
+        boxes[i].y1 = uu->y;
+        boxes[i].x2 = uu->x + uu->w;
+        boxes[i].y2 = uu->y + uu->h;
     }
-    for (y = 0; y < th; y++)
-    {
-        int             hgaps = 0, start = -1, min;
-        char            have = 1, gap = 0;
 
-        for (x = 0; x < tw; x++)
-            gaps[x] = 0;
-        for (x = 0; x < tw; x++)
-        {
-            if (have && !T(x, y).used)
-            {
-                start = x;
-                gap = 1;
-                have = 0;
-            }
-            else if (!have && gap && T(x, y).used)
-            {
-                gap = 0;
-                hgaps++;
-                have = 1;
-                gaps[start] = x - start;
-            }
-            else if (T(x, y).used)
-                have = 1;
-        }
-        while (hgaps > hgapmax)
-        {
-            start = -1;
-            min = tw;
-
-            for (x = 0; x < tw; x++)
-            {
-                if ((gaps[x] > 0) && (gaps[x] < min))
-                {
-                    start = x;
-                    min = gaps[x];
-                }
-            }
-            if (start >= 0)
-            {
-                gaps[start] = 0;
-                for (x = start; !T(x, y).used; T(x++, y).used = T_USED)
-                    ;
-                hgaps--;
-            }
-        }
-    }
-    free(gaps);
-    /* coalesce tiles into larger blocks and make new rect list */
-    for (y = 0; y < th; y++)
+    __imlib_RegionInit(&rg);
+    __imlib_RegionInit(&out);
+    err = __imlib_RegionFromBoxes(&rg, boxes, n);
+    free(boxes);
+    if (!err)
+        err = __upd_merge(&out, &rg, cost);
+    __imlib_RegionFini(&rg);
+    if (err)
     {
-        for (x = 0; x < tw; x++)
-        {
-            if (T(x, y).used)
-            {
-                int             xx, yy, ww, hh, ok, xww;
-
-                for (xx = x + 1, ww = 1; xx < tw && T(xx, y).used; xx++, ww++)
-                    ;
-                xww = x + ww;
-                for (yy = y + 1, hh = 1, ok = 1; yy < th && ok; yy++, hh++)
-                {
-                    for (xx = x; xx < xww; xx++)
-                    {
-                        if (!T(xx, yy).used)
-                        {
-                            ok = 0;
-                            hh--;
-                            break;
-                        }
-                    }
-                }
-                for (yy = y; yy < (y + hh); yy++)
-                {
-                    for (xx = x; xx < xww; xx++)
-                        T(xx, yy).used = T_UNUSED;
-                }
-                nu = __imlib_AddUpdate(nu, (x << TB), (y << TB),
-                                       (ww << TB), (hh << TB));
-            }
-        }
+        __imlib_RegionFini(&out);
+        return u;
     }
-    free(t);
+
+    /* Prepending, so go backwards to get them top to bottom */
+    nu = NULL;
+    for (i = out.num - 1; i >= 0; i--)
+        nu = __imlib_AddUpdate(nu, out.boxes[i].x1, out.boxes[i].y1,
+                               out.boxes[i].x2 - out.boxes[i].x1,
+                               out.boxes[i].y2 - out.boxes[i].y1);
+    __imlib_RegionFini(&out);
     __imlib_FreeUpdates(u);
+
     return nu;
 }
 
@@ -178,23 +220,18 @@ __imlib_FreeUpdates(ImlibUpdate *u)
 ImlibUpdate    *
 __imlib_DupUpdates(ImlibUpdate *u)
 {
-    ImlibUpdate    *uu, *cu, *pu, *ru;
-
-    if (!u)
-        return NULL;
+    ImlibUpdate    *ru, **pu;
 
-    uu = malloc(sizeof(ImlibUpdate));
-    memcpy(uu, u, sizeof(ImlibUpdate));
-    cu = u->next;
-    pu = u;
-    ru = uu;
-    while (cu)
+    ru = NULL;
+    for (pu = &ru; u; u = u->next)
     {
-        uu = malloc(sizeof(ImlibUpdate));
-        memcpy(uu, u, sizeof(ImlibUpdate));
-        pu->next = uu;
-        pu = cu;
-        cu = cu->next;
+        *pu = malloc(sizeof(ImlibUpdate));
+        if (!*pu)
+            break;
+        memcpy(*pu, u, sizeof(ImlibUpdate));
+        pu = &(*pu)->next;
     }
+    *pu = NULL;
+
     return ru;
 }
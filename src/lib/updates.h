@@ -7,7 +7,13 @@ struct _ImlibUpdate {
 };
 
 ImlibUpdate    *__imlib_AddUpdate(ImlibUpdate * u, int x, int y, int w, int h);
-ImlibUpdate    *__imlib_MergeUpdate(ImlibUpdate * u, int w, int h, int hgapmax);
+/* Pixel cost of a rectangle when merging, for imlib_updates_merge() and
+ * imlib_updates_merge_for_rendering() (a rough match for the overhead of
+ * putting an image) */
+#define UPDATE_COST_MERGE   1024
+#define UPDATE_COST_RENDER  4096
+
+ImlibUpdate    *__imlib_MergeUpdate(ImlibUpdate * u, int w, int h, int cost);
 void            __imlib_FreeUpdates(ImlibUpdate * u);
 ImlibUpdate    *__imlib_DupUpdates(ImlibUpdate * u);
 
@@ -6,7 +6,9 @@
 #include <X11/extensions/XShm.h>
 #include <sys/ipc.h>
 #include <sys/shm.h>
+#include <string.h>
 
+#include "asm_c.h"
 #include "x11_grab.h"
 #include "x11_ximage.h"
 
@@ -23,6 +25,141 @@ Tmp_HandleXError(Display *d, XErrorEvent *ev)
 /* xim->data is properly aligned (malloc'ed), assuming bytes_per_line behaves */
 #define PTR(T, im_, y_) (T*)(void*)(im_->data + (im_->bytes_per_line * y_))
 
+/*
+ * Row converters for the common ZPixmap layouts, the XImage data being in
+ * client byte order. Pixels come out opaque, except for depth 32 which
+ * keeps its alpha. Other layouts are converted pixel by pixel.
+ */
+static int
+__grab_row_format(int depth, int bpp, int bgr)
+{
+    switch (depth)
+    {
+    case 15:
+        return bpp == 16 ? GRAB_ROW_RGB555 : -1;
+    case 16:
+        return bpp == 16 ? GRAB_ROW_RGB565 : -1;
+    case 25:                   /* 24 bit in 32 bpp */
+        return bgr ? GRAB_ROW_XBGR32 : GRAB_ROW_XRGB32;
+    case 32:
+        if (bpp != 32)
+            return -1;
+        return bgr ? GRAB_ROW_BSWAP32 : GRAB_ROW_ARGB32;
+    default:
+        return -1;
+    }
+}
+
+#define RGB5(v) ((255 * ((v) & 0x1f)) / 0x1f)
+#define RGB6(v) ((255 * ((v) & 0x3f)) / 0x3f)
+
+static void
+__grab_row(uint32_t *dst, const uint8_t *src, int w, int fmt)
+{
+    const uint32_t *s32 = (const uint32_t *)(const void *)src;
+    const uint16_t *s16 = (const uint16_t *)(const void *)src;
+    uint32_t        p;
+    int             x;
+
+    switch (fmt)
+    {
+    case GRAB_ROW_RGB555:
+        for (x = 0; x < w; x++)
+        {
+            p = s16[x];
+            dst[x] = PIXEL_ARGB(0xff, RGB5(p >> 10), RGB5(p >> 5), RGB5(p));
+        }
+        break;
+    case GRAB_ROW_RGB565:
+        for (x = 0; x < w; x++)
+        {
+            p = s16[x];
+            dst[x] = PIXEL_ARGB(0xff, RGB5(p >> 11), RGB6(p >> 5), RGB5(p));
+        }
+        break;
+    case GRAB_ROW_XRGB32:
+        for (x = 0; x < w; x++)
+            dst[x] = 0xff000000 | s32[x];
+        break;
+    case GRAB_ROW_XBGR32:
+        for (x = 0; x < w; x++)
+        {
+            p = s32[x];
+            dst[x] = 0xff000000 | ((p << 16) & 0xff0000) |
+                (p & 0x00ff00) | ((p >> 16) & 0x0000ff);
+        }
+        break;
+    case GRAB_ROW_ARGB32:
+        memcpy(dst, s32, w * sizeof(uint32_t));
+        break;
+    case GRAB_ROW_BSWAP32:
+        for (x = 0; x < w; x++)
+            dst[x] = SWAP32(s32[x]);
+        break;
+    }
+}
+
+/* Clear the alpha of pixels whose bit is 0, LSB first */
+static void
+__grab_mask_row(uint32_t *dst, const uint8_t *bits, int w)
+{
+    uint32_t        m;
+    int             x;
+
+    for (x = 0; x < w; x++)
+    {
+        m = (bits[x >> 3] >> (x & 7)) & 1;
+        dst[x] &= 0x00ffffff | ((0 - m) << 24);
+    }
+}
+
+static void
+__grab_mask_row_msb(uint32_t *dst, const uint8_t *bits, int w)
+{
+    uint32_t        m;
+    int             x;
+
+    for (x = 0; x < w; x++)
+    {
+        m = (bits[x >> 3] >> (7 - (x & 7))) & 1;
+        dst[x] &= 0x00ffffff | ((0 - m) << 24);
+    }
+}
+
+static          ImlibGrabRowFunction
+__grab_row_function(void)
+{
+#ifdef DO_AMD64_ASM
+    switch (__imlib_cpu_isa())
+    {
+    case ISA_AVX512:
+        return __imlib_grab_row_avx512;
+    case ISA_AVX2:
+        return __imlib_grab_row_avx2;
+    default:
+        break;
+    }
+#endif
+    return __grab_row;
+}
+
+static          ImlibGrabMaskRowFunction
+__grab_mask_row_function(void)
+{
+#ifdef DO_AMD64_ASM
+    switch (__imlib_cpu_isa())
+    {
+    case ISA_AVX512:
+        return __imlib_grab_mask_row_avx512;
+    case ISA_AVX2:
+        return __imlib_grab_mask_row_avx2;
+    default:
+        break;
+    }
+#endif
+    return __grab_mask_row;
+}
+
 void
 __imlib_GrabXImageToRGBA(const ImlibContextX11 *x11, int depth,
                          uint32_t *data,
@@ -32,11 +169,10 @@ __imlib_GrabXImageToRGBA(const ImlibContextX11 *x11, int depth,
 {
     int             x, y, inx, iny;
     const uint32_t *src;
-    const uint16_t *s16;
     uint32_t       *ptr;
-    int             pixel;
-    uint16_t        p16;
+    uint32_t        pixel;
     int             bgr = 0;
+    int             fmt;
 
     if (!data)
         return;
@@ -115,415 +251,128 @@ __imlib_GrabXImageToRGBA(const ImlibContextX11 *x11, int depth,
         }
     }
 
-    switch (depth)
+    fmt = __grab_row_format(depth, xim->bits_per_pixel, bgr);
+    if (fmt >= 0)
     {
-    case 0:
-    case 1:
-    case 2:
-    case 3:
-    case 4:
-    case 5:
-    case 6:
-    case 7:
-    case 8:
-        if (mxim)
-        {
-            for (y = 0; y < h_src; y++)
-            {
-                ptr = data + ((y + iny) * w_dst) + inx;
-                for (x = 0; x < w_src; x++)
-                {
-                    pixel = XGetPixel(xim, x, y);
-                    pixel = (btab[pixel & 0xff]) |
-                        (gtab[pixel & 0xff] << 8) | (rtab[pixel & 0xff] << 16);
-                    if (XGetPixel(mxim, x, y))
-                        pixel |= 0xff000000;
-                    *ptr++ = pixel;
-                }
-            }
-        }
-        else
-        {
-            for (y = 0; y < h_src; y++)
-            {
-                ptr = data + ((y + iny) * w_dst) + inx;
-                for (x = 0; x < w_src; x++)
-                {
-                    pixel = XGetPixel(xim, x, y);
-                    *ptr++ = 0xff000000 |
-                        (btab[pixel & 0xff]) |
-                        (gtab[pixel & 0xff] << 8) | (rtab[pixel & 0xff] << 16);
-                }
-            }
-        }
-        break;
-    case 16:
-#undef MP
-#undef RMSK
-#undef GMSK
-#undef BMSK
-#undef RSH
-#undef GSH
-#undef BSH
-#define MP(x, y) ((XGetPixel(mxim, (x), (y))) ? 0xff: 0)
-#define RMSK  0x1f
-#define GMSK  0x3f
-#define BMSK  0x1f
-#define RSH(p)  ((p) >> 11)
-#define GSH(p)  ((p) >>  5)
-#define BSH(p)  ((p) >>  0)
-#define RVAL(p) (255 * (RSH(p) & RMSK)) / RMSK
-#define GVAL(p) (255 * (GSH(p) & GMSK)) / GMSK
-#define BVAL(p) (255 * (BSH(p) & BMSK)) / BMSK
-        if (mxim)
+        ImlibGrabRowFunction row_func = __grab_row_function();
+
+        for (y = 0; y < h_src; y++)
         {
-            for (y = 0; y < h_src; y++)
-            {
-                s16 = PTR(uint16_t, xim, y);
-                ptr = data + ((y + iny) * w_dst) + inx;
-                for (x = 0; x < w_src; x++)
-                {
-                    p16 = *s16++;
-                    *ptr++ =
-                        PIXEL_ARGB(MP(x, y), RVAL(p16), GVAL(p16), BVAL(p16));
-                }
-            }
+            ptr = data + ((y + iny) * w_dst) + inx;
+            row_func(ptr, PTR(uint8_t, xim, y), w_src, fmt);
         }
-        else
+    }
+    else
+    {
+        switch (depth)
         {
+        case 0:
+        case 1:
+        case 2:
+        case 3:
+        case 4:
+        case 5:
+        case 6:
+        case 7:
+        case 8:
             for (y = 0; y < h_src; y++)
             {
-                s16 = PTR(uint16_t, xim, y);
                 ptr = data + ((y + iny) * w_dst) + inx;
-                for (x = 0; x < w_src; x++)
+                if (xim->bits_per_pixel == 8)
                 {
-                    p16 = *s16++;
-                    *ptr++ = PIXEL_ARGB(0xff, RVAL(p16), GVAL(p16), BVAL(p16));
+                    const uint8_t  *s8 = PTR(uint8_t, xim, y);
+
+                    for (x = 0; x < w_src; x++)
+                    {
+                        pixel = *s8++;
+                        *ptr++ = PIXEL_ARGB(0xff, rtab[pixel], gtab[pixel],
+                                            btab[pixel]);
+                    }
+                    continue;
                 }
-            }
-        }
-        break;
-    case 15:
-#undef MP
-#undef RMSK
-#undef GMSK
-#undef BMSK
-#undef RSH
-#undef GSH
-#undef BSH
-#define MP(x, y) ((XGetPixel(mxim, (x), (y))) ? 0xff: 0)
-#define RMSK  0x1f
-#define GMSK  0x1f
-#define BMSK  0x1f
-#define RSH(p)  ((p) >> 10)
-#define GSH(p)  ((p) >>  5)
-#define BSH(p)  ((p) >>  0)
-#define RVAL(p) (255 * (RSH(p) & RMSK)) / RMSK
-#define GVAL(p) (255 * (GSH(p) & GMSK)) / GMSK
-#define BVAL(p) (255 * (BSH(p) & BMSK)) / BMSK
-        if (mxim)
-        {
-            for (y = 0; y < h_src; y++)
-            {
-                s16 = PTR(uint16_t, xim, y);
-                ptr = data + ((y + iny) * w_dst) + inx;
                 for (x = 0; x < w_src; x++)
                 {
-                    p16 = *s16++;
-                    *ptr++ =
-                        PIXEL_ARGB(MP(x, y), RVAL(p16), GVAL(p16), BVAL(p16));
+                    pixel = XGetPixel(xim, x, y) & 0xff;
+                    *ptr++ = PIXEL_ARGB(0xff, rtab[pixel], gtab[pixel],
+                                        btab[pixel]);
                 }
             }
-        }
-        else
-        {
+            break;
+        case 24:
             for (y = 0; y < h_src; y++)
             {
-                s16 = PTR(uint16_t, xim, y);
                 ptr = data + ((y + iny) * w_dst) + inx;
                 for (x = 0; x < w_src; x++)
                 {
-                    p16 = *s16++;
-                    *ptr++ = PIXEL_ARGB(0xff, RVAL(p16), GVAL(p16), BVAL(p16));
-                }
-            }
-        }
-        break;
-    case 24:
-        if (bgr)
-        {
-            if (mxim)
-            {
-                for (y = 0; y < h_src; y++)
-                {
-                    ptr = data + ((y + iny) * w_dst) + inx;
-                    for (x = 0; x < w_src; x++)
+                    if (xim->bits_per_pixel == 24)
                     {
-                        pixel = XGetPixel(xim, x, y);
-                        pixel = ((pixel << 16) & 0xff0000) |
-                            ((pixel) & 0x00ff00) | ((pixel >> 16) & 0x0000ff);
-                        if (XGetPixel(mxim, x, y))
-                            pixel |= 0xff000000;
-                        *ptr++ = pixel;
+                        const uint8_t  *s8 = PTR(uint8_t, xim, y) + 3 * x;
+
+                        if (xim->byte_order == LSBFirst)
+                            pixel = s8[0] | (s8[1] << 8) | (s8[2] << 16);
+                        else
+                            pixel = (s8[0] << 16) | (s8[1] << 8) | s8[2];
                     }
-                }
-            }
-            else
-            {
-                for (y = 0; y < h_src; y++)
-                {
-                    ptr = data + ((y + iny) * w_dst) + inx;
-                    for (x = 0; x < w_src; x++)
-                    {
+                    else
                         pixel = XGetPixel(xim, x, y);
-                        *ptr++ = 0xff000000 |
-                            ((pixel << 16) & 0xff0000) |
+                    if (bgr)
+                        pixel = ((pixel << 16) & 0xff0000) |
                             ((pixel) & 0x00ff00) | ((pixel >> 16) & 0x0000ff);
-                    }
-                }
-            }
-        }
-        else
-        {
-            if (mxim)
-            {
-                for (y = 0; y < h_src; y++)
-                {
-                    ptr = data + ((y + iny) * w_dst) + inx;
-                    for (x = 0; x < w_src; x++)
-                    {
-                        pixel = XGetPixel(xim, x, y) & 0x00ffffff;
-                        if (XGetPixel(mxim, x, y))
-                            pixel |= 0xff000000;
-                        *ptr++ = pixel;
-                    }
-                }
-            }
-            else
-            {
-                for (y = 0; y < h_src; y++)
-                {
-                    ptr = data + ((y + iny) * w_dst) + inx;
-                    for (x = 0; x < w_src; x++)
-                    {
-                        pixel = XGetPixel(xim, x, y);
-                        *ptr++ = 0xff000000 | (pixel & 0x00ffffff);
-                    }
-                }
-            }
-        }
-        break;
-    case 25:
-        if (bgr)
-        {
-            if (mxim)
-            {
-                for (y = 0; y < h_src; y++)
-                {
-                    src = PTR(uint32_t, xim, y);
-                    ptr = data + ((y + iny) * w_dst) + inx;
-                    for (x = 0; x < w_src; x++)
-                    {
-                        pixel = ((*src << 16) & 0xff0000) |
-                            ((*src) & 0x00ff00) | ((*src >> 16) & 0x0000ff);
-                        if (XGetPixel(mxim, x, y))
-                            pixel |= 0xff000000;
-                        *ptr++ = pixel;
-                        src++;
-                    }
-                }
-            }
-            else
-            {
-                for (y = 0; y < h_src; y++)
-                {
-                    src = PTR(uint32_t, xim, y);
-                    ptr = data + ((y + iny) * w_dst) + inx;
-                    for (x = 0; x < w_src; x++)
-                    {
-                        *ptr++ = 0xff000000 |
-                            ((*src << 16) & 0xff0000) |
-                            ((*src) & 0x00ff00) | ((*src >> 16) & 0x0000ff);
-                        src++;
-                    }
-                }
-            }
-        }
-        else
-        {
-            if (mxim)
-            {
-                for (y = 0; y < h_src; y++)
-                {
-                    src = PTR(uint32_t, xim, y);
-                    ptr = data + ((y + iny) * w_dst) + inx;
-                    for (x = 0; x < w_src; x++)
-                    {
-                        pixel = (*src) & 0x00ffffff;
-                        if (XGetPixel(mxim, x, y))
-                            pixel |= 0xff000000;
-                        *ptr++ = pixel;
-                        src++;
-                    }
-                }
-            }
-            else
-            {
-                for (y = 0; y < h_src; y++)
-                {
-                    src = PTR(uint32_t, xim, y);
-                    ptr = data + ((y + iny) * w_dst) + inx;
-                    for (x = 0; x < w_src; x++)
-                    {
-                        *ptr++ = 0xff000000 | ((*src) & 0x00ffffff);
-                        src++;
-                    }
-                }
-            }
-        }
-        break;
-    case 30:
-        if (bgr)
-        {
-            if (mxim)
-            {
-                for (y = 0; y < h_src; y++)
-                {
-                    src = PTR(uint32_t, xim, y);
-                    ptr = data + ((y + iny) * w_dst) + inx;
-                    for (x = 0; x < w_src; x++)
-                    {
-                        pixel = (((*src) & 0x000003ff) << 14 & 0x00ff0000) |
-                            (((*src) & 0x000ffc00) >> 4 & 0x0000ff00) |
-                            (((*src) & 0x3ff00000) >> 22 & 0x000000ff);
-                        if (XGetPixel(mxim, x, y))
-                            pixel |= 0xff000000;
-                        *ptr++ = pixel;
-                        src++;
-                    }
+                    *ptr++ = 0xff000000 | (pixel & 0x00ffffff);
                 }
             }
-            else
+            break;
+        case 30:
+            for (y = 0; y < h_src; y++)
             {
-                for (y = 0; y < h_src; y++)
+                src = PTR(uint32_t, xim, y);
+                ptr = data + ((y + iny) * w_dst) + inx;
+                for (x = 0; x < w_src; x++)
                 {
-                    src = PTR(uint32_t, xim, y);
-                    ptr = data + ((y + iny) * w_dst) + inx;
-                    for (x = 0; x < w_src; x++)
-                    {
+                    if (bgr)
                         *ptr++ = 0xff000000 |
                             (((*src) & 0x000003ff) << 14 & 0x00ff0000) |
                             (((*src) & 0x000ffc00) >> 4 & 0x0000ff00) |
                             (((*src) & 0x3ff00000) >> 22 & 0x000000ff);
-                        src++;
-                    }
-                }
-            }
-        }
-        else
-        {
-            if (mxim)
-            {
-                for (y = 0; y < h_src; y++)
-                {
-                    src = PTR(uint32_t, xim, y);
-                    ptr = data + ((y + iny) * w_dst) + inx;
-                    for (x = 0; x < w_src; x++)
-                    {
-                        pixel = (((*src) & 0x3ff00000) >> 6 & 0x00ff0000) |
-                            (((*src) & 0x000ffc00) >> 4 & 0x0000ff00) |
-                            (((*src) & 0x000003ff) >> 2 & 0x000000ff);
-                        if (XGetPixel(mxim, x, y))
-                            pixel |= 0xff000000;
-                        *ptr++ = pixel;
-                        src++;
-                    }
-                }
-            }
-            else
-            {
-                for (y = 0; y < h_src; y++)
-                {
-                    src = PTR(uint32_t, xim, y);
-                    ptr = data + ((y + iny) * w_dst) + inx;
-                    for (x = 0; x < w_src; x++)
-                    {
+                    else
                         *ptr++ = 0xff000000 |
                             (((*src) & 0x3ff00000) >> 6 & 0x00ff0000) |
                             (((*src) & 0x000ffc00) >> 4 & 0x0000ff00) |
                             (((*src) & 0x000003ff) >> 2 & 0x000000ff);
-                        src++;
-                    }
+                    src++;
                 }
             }
+            break;
+        default:
+            break;
         }
-        break;
-    case 32:
-        if (bgr)
+    }
+
+    /* Clear the alpha of the pixels outside the shape */
+    if (mxim)
+    {
+        ImlibGrabMaskRowFunction mask_func = __grab_mask_row_function();
+
+        for (y = 0; y < h_src; y++)
         {
-            if (mxim)
+            ptr = data + ((y + iny) * w_dst) + inx;
+            if (mxim->bits_per_pixel != 1 ||
+                (mxim->bitmap_unit != 8 &&
+                 mxim->byte_order != mxim->bitmap_bit_order))
             {
-                for (y = 0; y < h_src; y++)
-                {
-                    src = PTR(uint32_t, xim, y);
-                    ptr = data + ((y + iny) * w_dst) + inx;
-                    for (x = 0; x < w_src; x++)
-                    {
-                        pixel = SWAP32(*src);
-                        if (!XGetPixel(mxim, x, y))
-                            pixel &= 0x00ffffff;
-                        *ptr++ = pixel;
-                        src++;
-                    }
-                }
-            }
-            else
-            {
-                for (y = 0; y < h_src; y++)
-                {
-                    src = PTR(uint32_t, xim, y);
-                    ptr = data + ((y + iny) * w_dst) + inx;
-                    for (x = 0; x < w_src; x++)
-                    {
-                        *ptr++ = SWAP32(*src);
-                        src++;
-                    }
-                }
+                for (x = 0; x < w_src; x++)
+                    if (!XGetPixel(mxim, x, y))
+                        ptr[x] &= 0x00ffffff;
             }
-        }
-        else
-        {
-            if (mxim)
+            else if (mxim->bitmap_bit_order == MSBFirst)
             {
-                for (y = 0; y < h_src; y++)
-                {
-                    src = PTR(uint32_t, xim, y);
-                    ptr = data + ((y + iny) * w_dst) + inx;
-                    for (x = 0; x < w_src; x++)
-                    {
-                        pixel = *src++;
-                        if (!XGetPixel(mxim, x, y))
-                            pixel &= 0x00ffffff;
-                        *ptr++ = pixel;
-                    }
-                }
+                __grab_mask_row_msb(ptr, PTR(uint8_t, mxim, y), w_src);
             }
             else
             {
-                for (y = 0; y < h_src; y++)
-                {
-                    src = PTR(uint32_t, xim, y);
-                    ptr = data + ((y + iny) * w_dst) + inx;
-                    for (x = 0; x < w_src; x++)
-                    {
-                        *ptr++ = *src++;
-                    }
-                }
+                mask_func(ptr, PTR(uint8_t, mxim, y), w_src);
             }
         }
-        break;
-    default:
-        break;
     }
 
     if (grab)
@@ -606,7 +455,6 @@ __imlib_GrabDrawableToRGBA(const ImlibContextX11 *x11, uint32_t *data,
     int             i, j;
     int             width, height;
     Pixmap          mask = mask_;
-    XShmSegmentInfo shminfo, mshminfo;
     XImage         *xim, *mxim;
     XColor          cols[256];
 
@@ -724,8 +572,8 @@ __imlib_GrabDrawableToRGBA(const ImlibContextX11 *x11, uint32_t *data,
                                    xatt.width, xatt.height);
 
     /* Create an Ximage (shared or not) */
-    xim = __imlib_ShmGetXImage(x11, draw, xatt.depth,
-                               x_src, y_src, w_src, h_src, &shminfo);
+    xim = __imlib_ShmGrabXImage(x11, 0, draw, xatt.depth,
+                                x_src, y_src, w_src, h_src);
     is_shm = !!xim;
 
     if (!xim)
@@ -738,8 +586,7 @@ __imlib_GrabDrawableToRGBA(const ImlibContextX11 *x11, uint32_t *data,
     mxim = NULL;
     if ((mask) && (domask))
     {
-        mxim = __imlib_ShmGetXImage(x11, mask, 1, 0, 0, w_src, h_src,
-                                    &mshminfo);
+        mxim = __imlib_ShmGrabXImage(x11, 1, mask, 1, 0, 0, w_src, h_src);
         is_mshm = !!mxim;
         if (!mxim)
             mxim = XGetImage(x11->dpy, mask, 0, 0, w_src, h_src,
@@ -811,14 +658,14 @@ __imlib_GrabDrawableToRGBA(const ImlibContextX11 *x11, uint32_t *data,
 
     /* destroy the Ximage */
     if (is_shm)
-        __imlib_ShmDestroyXImage(x11, xim, &shminfo);
+        __imlib_ShmGrabDone(x11, 0, xim);
     else
         XDestroyImage(xim);
 
     if (mxim)
     {
         if (is_mshm)
-            __imlib_ShmDestroyXImage(x11, mxim, &mshminfo);
+            __imlib_ShmGrabDone(x11, 1, mxim);
         else
             XDestroyImage(mxim);
     }
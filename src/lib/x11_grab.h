@@ -4,6 +4,32 @@
 #include "types.h"
 #include "x11_types.h"
 
+/* Grabbed row layouts (see __imlib_GrabXImageToRGBA) */
+enum {
+    GRAB_ROW_RGB555,
+    GRAB_ROW_RGB565,
+    GRAB_ROW_XRGB32,
+    GRAB_ROW_XBGR32,
+    GRAB_ROW_ARGB32,
+    GRAB_ROW_BSWAP32,
+};
+
+typedef void    (*ImlibGrabRowFunction)(uint32_t * dst, const uint8_t * src,
+                                        int w, int fmt);
+typedef void    (*ImlibGrabMaskRowFunction)(uint32_t * dst,
+                                            const uint8_t * bits, int w);
+
+#if DO_AMD64_ASM
+void            __imlib_grab_row_avx2(uint32_t * dst, const uint8_t * src,
+                                      int w, int fmt);
+void            __imlib_grab_row_avx512(uint32_t * dst, const uint8_t * src,
+                                        int w, int fmt);
+void            __imlib_grab_mask_row_avx2(uint32_t * dst,
+                                           const uint8_t * bits, int w);
+void            __imlib_grab_mask_row_avx512(uint32_t * dst,
+                                             const uint8_t * bits, int w);
+#endif
+
 int             __imlib_GrabDrawableToRGBA(const ImlibContextX11 * x11,
                                            uint32_t * data,
                                            int x_dst, int y_dst,
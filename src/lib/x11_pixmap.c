@@ -3,42 +3,267 @@
 #include <stdlib.h>
 #include <string.h>
 #include <X11/Xlib.h>
+#ifdef HAVE_X11_XRENDER
+#include <X11/extensions/Xrender.h>
+#endif
 
 #include "blend.h"
 #include "colormod.h"
 #include "image.h"
+#include "stats.h"
 #include "x11_pixmap.h"
 #include "x11_rend.h"
-
+#include "x11_ximage.h"
+#include "x11_xrender.h"
+
+/*
+ * Rendered pixmaps are indexed by their render parameters (key), by source
+ * image and by pixmap id, so lookups, frees and dirtying don't walk all of
+ * them. Unreferenced pixmaps are kept on their own LRU list, with their size
+ * counted as they come and go, and evicted from its tail. Invalidating an
+ * image drops its unreferenced pixmaps right away, so they don't hold on
+ * to cache space nothing can hit.
+ *
+ * The ARGB32 pictures images are uploaded to for RENDER are cached here too,
+ * keyed with no visual and depth 32.
+ */
 typedef struct _ImlibImagePixmap {
     int             w, h;
     Pixmap          pixmap, mask;
+#ifdef HAVE_X11_XRENDER
+    Picture         picture;
+#endif
     Display        *display;
     Visual         *visual;
     int             depth;
     int             source_x, source_y, source_w, source_h;
     Colormap        colormap;
-    char            antialias, hi_quality, dither_mask;
+    char            antialias, hi_quality, dither_mask, xrender;
     ImlibBorder     border;
     ImlibImage     *image;
     char           *file;
     char            dirty;
     int             references;
     uint64_t        modification_count;
-    struct _ImlibImagePixmap *next;
+    unsigned int    hash;       /* Of the key */
+    int             size;       /* Cache size, bytes */
+    struct _ImlibImagePixmap *key_next, *image_next, *id_next;
+    struct _ImlibImagePixmap *lru_prev, *lru_next;
 } ImlibImagePixmap;
 
-static ImlibImagePixmap *pixmaps = NULL;
+#define PIXMAP_INDEX_MIN    64
 
-/* create a pixmap cache data struct */
-static ImlibImagePixmap *
-__imlib_ProduceImagePixmap(void)
+static ImlibImagePixmap **key_index = NULL;
+static ImlibImagePixmap **image_index = NULL;
+static ImlibImagePixmap **id_index = NULL;
+static unsigned int index_size = 0;     /* Power of 2 */
+static unsigned int pixmap_count = 0;
+
+/* Unreferenced pixmaps, most recently used first */
+static ImlibImagePixmap *lru_head = NULL, *lru_tail = NULL;
+static int      lru_bytes = 0;
+
+static unsigned int
+__hash_add(unsigned int h, const void *p, int len)
 {
-    ImlibImagePixmap *ip;
+    const uint8_t  *b = p;
+    int             i;
 
-    ip = calloc(1, sizeof(ImlibImagePixmap));
+    /* FNV-1a */
+    for (i = 0; i < len; i++)
+        h = (h ^ b[i]) * 16777619U;
 
-    return ip;
+    return h;
+}
+
+static unsigned int
+__hash_ptr(const void *p)
+{
+    uintptr_t       v = (uintptr_t) p;
+
+    v ^= v >> 17;
+    v *= 0x9e3779b1U;
+    return (unsigned int)(v ^ (v >> 15));
+}
+
+#define ID_HASH(d, p)   (__hash_ptr(d) ^ __hash_ptr((void *)(uintptr_t)(p)))
+
+/* Hash of everything a cached pixmap must match */
+static unsigned int
+__pixmap_key_hash(const ImlibContextX11 *x11, const ImlibImage *im,
+                  int w, int h, int sx, int sy, int sw, int sh,
+                  char aa, char dmask, uint64_t modification_count)
+{
+    int             v[12];
+    unsigned int    hash;
+
+    hash = 2166136261U;
+    if (im->file)
+        hash = __hash_add(hash, im->file, strlen(im->file));
+    else
+        hash ^= __hash_ptr(im);
+    hash ^= __hash_ptr(x11->dpy) ^ __hash_ptr(x11->vis);
+
+    v[0] = w;
+    v[1] = h;
+    v[2] = sx;
+    v[3] = sy;
+    v[4] = sw;
+    v[5] = sh;
+    v[6] = x11->depth;
+    v[7] = (int)x11->cmap;
+    v[8] = aa | (dmask << 8) | (x11->xrender << 16);
+    v[9] = (int)modification_count;
+    v[10] = im->border.left | (im->border.right << 16);
+    v[11] = im->border.top | (im->border.bottom << 16);
+    hash = __hash_add(hash, v, sizeof(v));
+
+    return hash;
+}
+
+/* Server memory taken by the pixmaps of ip */
+static int
+__pixmap_size(const ImlibImagePixmap *ip)
+{
+    int             size = 0;
+
+    if (ip->pixmap)
+    {
+        if (ip->depth < 8)
+            size += ip->w * ip->h * (ip->depth / 8);
+        else if (ip->depth == 8)
+            size += ip->w * ip->h;
+        else if (ip->depth <= 16)
+            size += ip->w * ip->h * 2;
+        else if (ip->depth <= 32)
+            size += ip->w * ip->h * 4;
+    }
+    /* if theres a mask add it too */
+    if (ip->mask)
+        size += ip->w * ip->h / 8;
+
+    return size;
+}
+
+static void
+__lru_add(ImlibImagePixmap *ip)
+{
+    ip->lru_prev = NULL;
+    ip->lru_next = lru_head;
+    if (lru_head)
+        lru_head->lru_prev = ip;
+    else
+        lru_tail = ip;
+    lru_head = ip;
+    lru_bytes += ip->size;
+}
+
+static void
+__lru_del(ImlibImagePixmap *ip)
+{
+    if (ip->lru_prev)
+        ip->lru_prev->lru_next = ip->lru_next;
+    else
+        lru_head = ip->lru_next;
+    if (ip->lru_next)
+        ip->lru_next->lru_prev = ip->lru_prev;
+    else
+        lru_tail = ip->lru_prev;
+    ip->lru_prev = ip->lru_next = NULL;
+    lru_bytes -= ip->size;
+}
+
+static void
+__index_add(ImlibImagePixmap *ip)
+{
+    unsigned int    mask = index_size - 1;
+    ImlibImagePixmap **pp;
+
+    pp = &key_index[ip->hash & mask];
+    ip->key_next = *pp;
+    *pp = ip;
+
+    if (ip->image)
+    {
+        pp = &image_index[__hash_ptr(ip->image) & mask];
+        ip->image_next = *pp;
+        *pp = ip;
+    }
+
+    pp = &id_index[ID_HASH(ip->display, ip->pixmap) & mask];
+    ip->id_next = *pp;
+    *pp = ip;
+}
+
+#define UNLINK(head, ip, link) \
+    do { \
+        ImlibImagePixmap **_pp; \
+        for (_pp = head; *_pp; _pp = &(*_pp)->link) \
+            if (*_pp == ip) { *_pp = ip->link; break; } \
+    } while (0)
+
+static void
+__index_del_image(ImlibImagePixmap *ip)
+{
+    if (!ip->image)
+        return;
+    UNLINK(&image_index[__hash_ptr(ip->image) & (index_size - 1)], ip,
+           image_next);
+    ip->image = NULL;
+}
+
+static void
+__index_del(ImlibImagePixmap *ip)
+{
+    unsigned int    mask = index_size - 1;
+
+    UNLINK(&key_index[ip->hash & mask], ip, key_next);
+    __index_del_image(ip);
+    UNLINK(&id_index[ID_HASH(ip->display, ip->pixmap) & mask], ip, id_next);
+}
+
+/* Make room for one more pixmap, the key index holding them all */
+static int
+__index_grow(void)
+{
+    ImlibImagePixmap **old_index, **ki, **ii, **di, *ip, *ip_next;
+    unsigned int    old_size, size, i;
+
+    if (pixmap_count < index_size)
+        return 0;
+
+    size = index_size ? 2 * index_size : PIXMAP_INDEX_MIN;
+    ki = calloc(size, sizeof(ImlibImagePixmap *));
+    ii = calloc(size, sizeof(ImlibImagePixmap *));
+    di = calloc(size, sizeof(ImlibImagePixmap *));
+    if (!ki || !ii || !di)
+    {
+        free(ki);
+        free(ii);
+        free(di);
+        return -1;
+    }
+
+    old_index = key_index;
+    old_size = index_size;
+    free(image_index);
+    free(id_index);
+    key_index = ki;
+    image_index = ii;
+    id_index = di;
+    index_size = size;
+
+    for (i = 0; i < old_size; i++)
+    {
+        for (ip = old_index[i]; ip; ip = ip_next)
+        {
+            ip_next = ip->key_next;
+            __index_add(ip);
+        }
+    }
+    free(old_index);
+
+    return 0;
 }
 
 /* free a pixmap cache data struct and the pixmaps in it */
@@ -50,7 +275,11 @@ __imlib_ConsumeImagePixmap(ImlibImagePixmap *ip)
             "[Imlib2]  Deleting pixmap.  Reference count is %d, pixmap 0x%08lx, mask 0x%08lx\n",
             ip->references, ip->pixmap, ip->mask);
 #endif
-    if (ip->pixmap)
+#ifdef HAVE_X11_XRENDER
+    if (ip->picture)
+        XRenderFreePicture(ip->display, ip->picture);
+#endif
+    if (ip->pixmap && !__imlib_ShmFreePixmap(ip->display, ip->pixmap))
         XFreePixmap(ip->display, ip->pixmap);
     if (ip->mask)
         XFreePixmap(ip->display, ip->mask);
@@ -58,25 +287,44 @@ __imlib_ConsumeImagePixmap(ImlibImagePixmap *ip)
     free(ip);
 }
 
+/* remove a pixmap cache struct from the pixmap cache and free it */
+static void
+__imlib_RemoveImagePixmapFromCache(ImlibImagePixmap *ip)
+{
+    if (ip == lru_head || ip->lru_prev)
+        __lru_del(ip);
+    __index_del(ip);
+    pixmap_count--;
+    __imlib_ConsumeImagePixmap(ip);
+}
+
 static ImlibImagePixmap *
 __imlib_FindCachedImagePixmap(const ImlibContextX11 *x11, ImlibImage *im,
                               int w, int h, int sx, int sy, int sw, int sh,
                               char aa, char hiq,
                               char dmask, uint64_t modification_count)
 {
-    ImlibImagePixmap *ip, *ip_prev;
+    ImlibImagePixmap *ip;
+    unsigned int    hash;
+
+    if (!key_index)
+        return NULL;
 
-    for (ip = pixmaps, ip_prev = NULL; ip; ip_prev = ip, ip = ip->next)
+    hash = __pixmap_key_hash(x11, im, w, h, sx, sy, sw, sh, aa, dmask,
+                             modification_count);
+
+    for (ip = key_index[hash & (index_size - 1)]; ip; ip = ip->key_next)
     {
         /* if all the pixmap attributes match */
-        if ((ip->w == w) && (ip->h == h) && (ip->depth == x11->depth) &&
+        if ((ip->hash == hash) &&
+            (ip->w == w) && (ip->h == h) && (ip->depth == x11->depth) &&
             (!ip->dirty) && (ip->visual == x11->vis) &&
             (ip->display == x11->dpy) && (ip->source_x == sx) &&
-            (ip->source_x == sy) && (ip->source_w == sw) &&
+            (ip->source_y == sy) && (ip->source_w == sw) &&
             (ip->source_h == sh) && (ip->colormap == x11->cmap) &&
             (ip->antialias == aa) &&
             (ip->modification_count == modification_count) &&
-            (ip->dither_mask == dmask) &&
+            (ip->dither_mask == dmask) && (ip->xrender == x11->xrender) &&
             (ip->border.left == im->border.left) &&
             (ip->border.right == im->border.right) &&
             (ip->border.top == im->border.top) &&
@@ -84,20 +332,16 @@ __imlib_FindCachedImagePixmap(const ImlibContextX11 *x11, ImlibImage *im,
             (((im->file) && (ip->file) && !strcmp(im->file, ip->file)) ||
              ((!im->file) && (!ip->file) && (im == ip->image))))
         {
-            /* move the pixmap to the head of the pixmap list */
-            if (ip_prev)
-            {
-                ip_prev->next = ip->next;
-                ip->next = pixmaps;
-                pixmaps = ip;
-            }
+            /* rendered from an image since reloaded */
+            if (ip->image && IM_FLAG_ISSET(ip->image, F_INVALID))
+                continue;
             return ip;
         }
     }
     return NULL;
 }
 
-/* add a pixmap cahce struct to the pixmap cache (at the start of course */
+/* add a pixmap cache struct to the pixmap cache */
 static ImlibImagePixmap *
 __imlib_AddImagePixmapToCache(const ImlibContextX11 *x11, ImlibImage *im,
                               Pixmap pmap, Pixmap mask, int w, int h,
@@ -107,12 +351,24 @@ __imlib_AddImagePixmapToCache(const ImlibContextX11 *x11, ImlibImage *im,
 {
     ImlibImagePixmap *ip;
 
-    ip = __imlib_ProduceImagePixmap();
+    if (__index_grow())
+        return NULL;
+
+    ip = calloc(1, sizeof(ImlibImagePixmap));
+    if (!ip)
+        return NULL;
     ip->visual = x11->vis;
     ip->depth = x11->depth;
     ip->image = im;
     if (im->file)
+    {
         ip->file = strdup(im->file);
+        if (!ip->file)
+        {
+            free(ip);
+            return NULL;
+        }
+    }
     ip->border.left = im->border.left;
     ip->border.right = im->border.right;
     ip->border.top = im->border.top;
@@ -129,83 +385,71 @@ __imlib_AddImagePixmapToCache(const ImlibContextX11 *x11, ImlibImage *im,
     ip->modification_count = modification_count;
     ip->dither_mask = dmask;
     ip->hi_quality = hiq;
+    ip->xrender = x11->xrender;
     ip->references = 1;
     ip->pixmap = pmap;
     ip->mask = mask;
+    ip->hash = __pixmap_key_hash(x11, im, w, h, sx, sy, sw, sh, aa, dmask,
+                                 modification_count);
+    ip->size = __pixmap_size(ip);
 
-    ip->next = pixmaps;
-    pixmaps = ip;
+    __index_add(ip);
+    pixmap_count++;
 
     return ip;
 }
 
-void
-__imlib_PixmapUnrefImage(const ImlibImage *im)
+/* Mark the pixmaps of im dirty, dropping the unreferenced ones */
+static void
+__imlib_DirtyImagePixmaps(const ImlibImage *im, int unref)
 {
-    ImlibImagePixmap *ip;
+    ImlibImagePixmap *ip, *ip_next;
+
+    if (!image_index)
+        return;
 
-    for (ip = pixmaps; ip; ip = ip->next)
+    ip = image_index[__hash_ptr(im) & (index_size - 1)];
+    for (; ip; ip = ip_next)
     {
-        if (ip->image == im)
+        ip_next = ip->image_next;
+        if (ip->image != im)
+            continue;
+
+        ip->dirty = 1;
+        if (ip->references <= 0)
         {
-            ip->image = NULL;
-            ip->dirty = 1;
+            STATS_CACHE_INC(STATS_CACHE_PIXMAP, evict);
+            __imlib_RemoveImagePixmapFromCache(ip);
+        }
+        else if (unref)
+        {
+            __index_del_image(ip);
         }
     }
 }
 
-/* remove a pixmap cache struct from the pixmap cache */
-static void
-__imlib_RemoveImagePixmapFromCache(ImlibImagePixmap *ip_del)
+void
+__imlib_PixmapUnrefImage(const ImlibImage *im)
 {
-    ImlibImagePixmap *ip, *ip_prev;
-
-    for (ip = pixmaps, ip_prev = NULL; ip; ip_prev = ip, ip = ip->next)
-    {
-        if (ip == ip_del)
-        {
-            if (ip_prev)
-                ip_prev->next = ip->next;
-            else
-                pixmaps = ip->next;
-            return;
-        }
-    }
+    __imlib_DirtyImagePixmaps(im, 1);
 }
 
-/* clean out 0 reference count & dirty pixmaps from the cache */
+/* evict least recently used unreferenced pixmaps while the cache is over */
 void
 __imlib_CleanupImagePixmapCache(void)
 {
-    ImlibImagePixmap *ip, *ip_next, *ip_del;
-    int             current_cache;
+    int             excess;
 
-    current_cache = __imlib_CurrentCacheSize();
+    if (!lru_tail)
+        return;
 
-    for (ip = pixmaps; ip; ip = ip_next)
-    {
-        ip_next = ip->next;
-        if ((ip->references <= 0) && (ip->dirty))
-        {
-            __imlib_RemoveImagePixmapFromCache(ip);
-            __imlib_ConsumeImagePixmap(ip);
-        }
-    }
+    excess = __imlib_CurrentCacheSize() - __imlib_GetCacheSize();
 
-    while (current_cache > __imlib_GetCacheSize())
+    while (excess > 0 && lru_tail)
     {
-        for (ip = pixmaps, ip_del = NULL; ip; ip = ip->next)
-        {
-            if (ip->references <= 0)
-                ip_del = ip;
-        }
-        if (!ip_del)
-            break;
-
-        __imlib_RemoveImagePixmapFromCache(ip_del);
-        __imlib_ConsumeImagePixmap(ip_del);
-
-        current_cache = __imlib_CurrentCacheSize();
+        excess -= lru_tail->size;
+        STATS_CACHE_INC(STATS_CACHE_PIXMAP, evict);
+        __imlib_RemoveImagePixmapFromCache(lru_tail);
     }
 }
 
@@ -215,7 +459,11 @@ __imlib_FindImlibImagePixmapByID(Display *d, Pixmap p)
 {
     ImlibImagePixmap *ip;
 
-    for (ip = pixmaps; ip; ip = ip->next)
+    if (!id_index)
+        return NULL;
+
+    for (ip = id_index[ID_HASH(d, p) & (index_size - 1)]; ip;
+         ip = ip->id_next)
     {
         /* if all the pixmap ID & Display match */
         if ((ip->pixmap == p) && (ip->display == d))
@@ -253,7 +501,18 @@ __imlib_FreePixmap(Display *d, Pixmap p)
 #endif
             /* if it becaume 0 reference count - clean the cache up */
             if (ip->references == 0)
+            {
+                if (ip->dirty)
+                {
+                    STATS_CACHE_INC(STATS_CACHE_PIXMAP, evict);
+                    __imlib_RemoveImagePixmapFromCache(ip);
+                }
+                else
+                {
+                    __lru_add(ip);
+                }
                 __imlib_CleanupImagePixmapCache();
+            }
         }
     }
     else
@@ -261,7 +520,8 @@ __imlib_FreePixmap(Display *d, Pixmap p)
 #ifdef DEBUG_CACHE
         fprintf(stderr, "[Imlib2]  Pixmap 0x%08lx not found.  Freeing.\n", p);
 #endif
-        XFreePixmap(d, p);
+        if (!__imlib_ShmFreePixmap(d, p))
+            XFreePixmap(d, p);
     }
 }
 
@@ -271,58 +531,14 @@ __imlib_FreePixmap(Display *d, Pixmap p)
 void
 __imlib_DirtyPixmapsForImage(const ImlibImage *im)
 {
-    ImlibImagePixmap *ip;
-
-    for (ip = pixmaps; ip; ip = ip->next)
-    {
-        /* if image matches */
-        if (ip->image == im)
-            ip->dirty = 1;
-    }
+    __imlib_DirtyImagePixmaps(im, 0);
     __imlib_CleanupImagePixmapCache();
 }
 
 int
 __imlib_PixmapCacheSize(void)
 {
-    int             current_cache = 0;
-    ImlibImagePixmap *ip, *ip_next;
-
-    for (ip = pixmaps; ip; ip = ip_next)
-    {
-        ip_next = ip->next;
-
-        /* if the pixmap has 0 references */
-        if (ip->references == 0)
-        {
-            /* if the image is invalid */
-            if (ip->dirty || (ip->image && IM_FLAG_ISSET(ip->image, F_INVALID)))
-            {
-                __imlib_RemoveImagePixmapFromCache(ip);
-                __imlib_ConsumeImagePixmap(ip);
-            }
-            else
-            {
-                /* add the pixmap data size to the cache size */
-                if (ip->pixmap)
-                {
-                    if (ip->depth < 8)
-                        current_cache += ip->w * ip->h * (ip->depth / 8);
-                    else if (ip->depth == 8)
-                        current_cache += ip->w * ip->h;
-                    else if (ip->depth <= 16)
-                        current_cache += ip->w * ip->h * 2;
-                    else if (ip->depth <= 32)
-                        current_cache += ip->w * ip->h * 4;
-                }
-                /* if theres a mask add it too */
-                if (ip->mask)
-                    current_cache += ip->w * ip->h / 8;
-            }
-        }
-    }
-
-    return current_cache;
+    return lru_bytes;
 }
 
 int
@@ -337,16 +553,21 @@ __imlib_CreatePixmapsForImage(const ImlibContextX11 *x11, Drawable w,
     Pixmap          mask = 0;
     long long       mod_count = 0;
 
+    /* Identity modifiers render the same as none, share the pixmaps */
+    cmod = CMOD_ACTIVE(cmod);
     if (cmod)
         mod_count = cmod->modification_count;
     ip = __imlib_FindCachedImagePixmap(x11, im, dw, dh, sx, sy, sw, sh,
                                        antialias, hiq, dither_mask, mod_count);
     if (ip)
     {
+        STATS_CACHE_INC(STATS_CACHE_PIXMAP, hit);
         if (p)
             *p = ip->pixmap;
         if (m)
             *m = ip->mask;
+        if (ip->references <= 0)
+            __lru_del(ip);
         ip->references++;
 #ifdef DEBUG_CACHE
         fprintf(stderr,
@@ -355,9 +576,14 @@ __imlib_CreatePixmapsForImage(const ImlibContextX11 *x11, Drawable w,
 #endif
         return 2;
     }
+    STATS_CACHE_INC(STATS_CACHE_PIXMAP, miss);
     if (p)
     {
-        pmap = XCreatePixmap(x11->dpy, w, dw, dh, x11->depth);
+        /* SHM pixmaps are rendered to in place, without a put, unless the
+         * server renders */
+        pmap = x11->xrender ? None : __imlib_ShmCreatePixmap(x11, w, dw, dh);
+        if (!pmap)
+            pmap = XCreatePixmap(x11->dpy, w, dw, dh, x11->depth);
         *p = pmap;
     }
     if (m)
@@ -373,9 +599,58 @@ __imlib_CreatePixmapsForImage(const ImlibContextX11 *x11, Drawable w,
                                        dw, dh, sx, sy, sw, sh,
                                        antialias, hiq, dither_mask, mod_count);
 #ifdef DEBUG_CACHE
-    fprintf(stderr,
-            "[Imlib2]  Created pixmap.  Reference count is %d, pixmap 0x%08lx, mask 0x%08lx\n",
-            ip->references, ip->pixmap, ip->mask);
+    if (ip)
+        fprintf(stderr,
+                "[Imlib2]  Created pixmap.  Reference count is %d, pixmap 0x%08lx, mask 0x%08lx\n",
+                ip->references, ip->pixmap, ip->mask);
 #endif
     return 1;
 }
+
+#ifdef HAVE_X11_XRENDER
+/* Get the ARGB32 picture of im (and its pixmap, to be released with
+ * __imlib_FreePixmap()), uploading it if not cached. Returns 0 on failure,
+ * 1 if uploaded, 2 if cached. */
+int
+__imlib_CreatePictureForImage(const ImlibContextX11 *x11, Drawable w,
+                              ImlibImage *im, Pixmap *p, Picture *pict)
+{
+    ImlibContextX11 px11;
+    ImlibImagePixmap *ip;
+    Pixmap          pmap;
+    Picture         picture;
+
+    /* Pictures don't depend on visual or colormap, only on the alpha */
+    px11 = (ImlibContextX11) { x11->dpy, NULL, 0, 32, 0 };
+    ip = __imlib_FindCachedImagePixmap(&px11, im, im->w, im->h,
+                                       0, 0, im->w, im->h,
+                                       im->has_alpha, 0, 0, 0);
+    if (ip)
+    {
+        STATS_CACHE_INC(STATS_CACHE_PIXMAP, hit);
+        *p = ip->pixmap;
+        *pict = ip->picture;
+        if (ip->references <= 0)
+            __lru_del(ip);
+        ip->references++;
+        return 2;
+    }
+    STATS_CACHE_INC(STATS_CACHE_PIXMAP, miss);
+
+    if (__imlib_XRenderUploadImage(x11, w, im, &pmap, &picture))
+        return 0;
+    ip = __imlib_AddImagePixmapToCache(&px11, im, pmap, 0, im->w, im->h,
+                                       0, 0, im->w, im->h,
+                                       im->has_alpha, 0, 0, 0);
+    if (!ip)
+    {
+        XRenderFreePicture(x11->dpy, picture);
+        XFreePixmap(x11->dpy, pmap);
+        return 0;
+    }
+    ip->picture = picture;
+    *p = pmap;
+    *pict = picture;
+    return 1;
+}
+#endif
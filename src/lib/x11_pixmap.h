@@ -3,6 +3,9 @@
 
 #include "types.h"
 #include "x11_types.h"
+#ifdef HAVE_X11_XRENDER
+#include <X11/extensions/Xrender.h>
+#endif
 
 void            __imlib_CleanupImagePixmapCache(void);
 int             __imlib_PixmapCacheSize(void);
@@ -21,4 +24,10 @@ int             __imlib_CreatePixmapsForImage(const ImlibContextX11 * x11,
                                               char dither_mask, int mat,
                                               ImlibColorModifier * cmod);
 
+#ifdef HAVE_X11_XRENDER
+int             __imlib_CreatePictureForImage(const ImlibContextX11 * x11,
+                                              Drawable w, ImlibImage * im,
+                                              Pixmap * p, Picture * pict);
+#endif
+
 #endif                          /* X11_PIXMAP_H */
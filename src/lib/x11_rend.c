@@ -1,5 +1,6 @@
 #include "common.h"
 
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
 #include <X11/Xlib.h>
@@ -11,16 +12,27 @@
 #include "image.h"
 #include "rotate.h"
 #include "scale.h"
+#include "stats.h"
+#include "threads.h"
 #include "x11_color.h"
 #include "x11_context.h"
 #include "x11_grab.h"
 #include "x11_rend.h"
 #include "x11_rgba.h"
 #include "x11_ximage.h"
+#include "x11_xrender.h"
 
 /* size of the lines per segment we scale / render at a time */
 #define LINESIZE 16
 
+/* Minimum bands per thread */
+#define RENDER_BANDS_MIN(w) (1 + 65536 / (LINESIZE * (w)))
+
+/* Number of strips sent to the server one by one, and their minimum size
+ * in bands */
+#define RENDER_STRIPS           4
+#define RENDER_STRIP_BANDS_MIN  8
+
 uint32_t
 __imlib_RenderGetPixel(const ImlibContextX11 *x11, Drawable w,
                        uint8_t r, uint8_t g, uint8_t b)
@@ -239,6 +251,10 @@ static int      last_depth = 0;
 void
 __imlib_RenderDisconnect(Display *d)
 {
+#ifdef HAVE_X11_XRENDER
+    __imlib_XRenderDisconnect(d);
+#endif
+    __imlib_ShmDisconnect(d);
     if (d != disp)
         return;
     disp = NULL;
@@ -246,6 +262,103 @@ __imlib_RenderDisconnect(Display *d)
     last_depth = 0;
 }
 
+typedef struct {
+    const ImlibContextX11 *x11;
+    ImlibImage     *im;
+    Context        *ct;
+    XImage         *xim, *mxim;
+    ImlibScaleInfo *scaleinfo;
+    ImlibColorModifier *cmod;
+    ImlibRGBAFunction rgbaer;
+    ImlibMaskFunction masker;
+    ImlibBlendFunction blender, cmoder;
+    uint32_t       *back;
+    int             sx, sy, sw, sh, dx, dy, dw, dh, mat;
+    int             band0;      /* First band of the current strip */
+    int             err;        /* Set by bands that could not be rendered */
+    char            antialias;
+} ImlibRenderJob;
+
+/* Scale, blend and convert bands [b0 .. b1) of LINESIZE rows of the
+ * current strip into the XImages. Bands write disjoint rows. */
+static void
+__render_bands(void *data, int b0, int b1)
+{
+    ImlibRenderJob *rj = data;
+    const ImlibImage *im = rj->im;
+    XImage         *xim = rj->xim, *mxim = rj->mxim;
+    uint32_t       *buf = NULL, *pointer;
+    int             b, y, hh, jump, dw = rj->dw;
+
+    /* if we are scaling or modifying the image make a row buffer */
+    if (rj->scaleinfo || rj->cmoder)
+    {
+        buf = malloc(dw * LINESIZE * sizeof(uint32_t));
+        if (!buf)
+        {
+            __atomic_store_n(&rj->err, ENOMEM, __ATOMIC_RELAXED);
+            return;
+        }
+    }
+
+    for (b = rj->band0 + b0; b < rj->band0 + b1; b++)
+    {
+        y = b * LINESIZE;
+        hh = MIN(LINESIZE, rj->dh - y);
+
+        /* if we're scaling it */
+        if (rj->scaleinfo)
+        {
+            /* scale the imagedata for this LINESIZE lines chunk of image data */
+            __imlib_Scale(rj->scaleinfo, rj->antialias, im->has_alpha,
+                          im->data, buf, (rj->sx * dw) / rj->sw,
+                          ((rj->sy * rj->dh) / rj->sh) + y, 0, 0, dw, hh, dw,
+                          im->w);
+            jump = 0;
+            pointer = buf;
+            if (rj->cmod && !rj->back)
+                __imlib_DataCmodApply(buf, dw, hh, 0, true, rj->cmod);
+        }
+        else if (rj->cmoder)
+        {
+            rj->cmoder(im->data + ((y + rj->sy) * im->w) + rj->sx, im->w,
+                       buf, dw, dw, hh, rj->cmod);
+            jump = 0;
+            pointer = buf;
+        }
+        else
+        {
+            jump = im->w - rj->sw;
+            pointer = im->data + ((y + rj->sy) * im->w) + rj->sx;
+        }
+
+        /* if we have a back buffer - we're blending to the bg */
+        if (rj->back)
+        {
+            rj->blender(pointer, jump + dw, rj->back + (y * dw), dw, dw, hh,
+                        rj->cmod);
+            pointer = rj->back + (y * dw);
+            jump = 0;
+        }
+
+        /* once scaled... convert chunk to bit depth into XImage bufer */
+        if (rj->rgbaer)
+            rj->rgbaer(pointer, jump,
+                       ((uint8_t *) xim->data) + (y * (xim->bytes_per_line)),
+                       xim->bytes_per_line, dw, hh, rj->dx, rj->dy + y);
+        else
+            __imlib_generic_render(pointer, jump, dw, hh, 0, y, xim,
+                                   rj->x11->vis, rj->ct);
+        if (mxim)
+            rj->masker(pointer, jump,
+                       ((uint8_t *) mxim->data) + (y * (mxim->bytes_per_line)),
+                       mxim->bytes_per_line, dw, hh, rj->dx, rj->dy + y,
+                       rj->mat);
+    }
+
+    free(buf);
+}
+
 void
 __imlib_RenderImage(const ImlibContextX11 *x11, ImlibImage *im,
                     Drawable w, Drawable m,
@@ -255,19 +368,20 @@ __imlib_RenderImage(const ImlibContextX11 *x11, ImlibImage *im,
                     char dither_mask, int mat,
                     ImlibColorModifier *cmod, ImlibOp op)
 {
+    ImlibRenderJob  rj;
     XImage         *xim = NULL, *mxim = NULL;
     Context        *ct;
-    uint32_t       *buf = NULL, *pointer = NULL, *back = NULL;
-    int             y, h, hh, jump;
+    uint32_t       *back = NULL;
+    int             i, y, hh, nbands, nstrips, b0, b1;
     XGCValues       gcv;
     ImlibScaleInfo *scaleinfo = NULL;
+    ImlibSpan       span;
     int             psx, psy, psw, psh;
-    char            shm = 0;
+    char            shm = 0, inplace;
     ImlibRGBAFunction rgbaer;
     ImlibMaskFunction masker = NULL;
     ImlibBlendFunction blender = NULL;
-
-    blender = __imlib_GetBlendFunction(op, 1, 0, !im->has_alpha, NULL);
+    ImlibBlendFunction cmoder = NULL;
 
     /* dont do anything if we have a 0 widht or height image to render */
     if ((dw == 0) || (dh == 0))
@@ -303,6 +417,13 @@ __imlib_RenderImage(const ImlibContextX11 *x11, ImlibImage *im,
     /* if the output is too big (8k arbitrary limit here) dont bother */
     if ((abs(dw) > X_MAX_DIM) || (abs(dh) > X_MAX_DIM))
         return;
+#ifdef HAVE_X11_XRENDER
+    /* let the server scale and blend if asked to and it can */
+    if (x11->xrender && !m && !CMOD_ACTIVE(cmod) && op == OP_COPY &&
+        !__imlib_XRenderImage(x11, im, w, sx, sy, sw, sh, dx, dy, dw, dh,
+                              antialias, blend))
+        return;
+#endif
     /* if we are scaling the image at all make a scaling buffer */
     if (!((sw == dw) && (sh == dh)))
     {
@@ -313,11 +434,18 @@ __imlib_RenderImage(const ImlibContextX11 *x11, ImlibImage *im,
     /* Sign not needed anymore */
     dw = abs(dw);
     dh = abs(dh);
+    __imlib_SpanBegin(&span, SPAN_RENDER, NULL, im->file, dw, dh);
     ct = __imlib_GetContext(x11);
     __imlib_RGBASetupContext(ct);
     if (blend && im->has_alpha)
     {
         back = malloc(dw * dh * sizeof(uint32_t));
+        if (!back)
+        {
+            __imlib_FreeScaleInfo(scaleinfo);
+            __imlib_SpanEnd(&span, ENOMEM);
+            return;
+        }
         if (__imlib_GrabDrawableToRGBA(x11, back, 0, 0, dw, dh,
                                        w, 0, dx, dy, dw, dh, 0, 1, false, NULL))
         {
@@ -325,12 +453,25 @@ __imlib_RenderImage(const ImlibContextX11 *x11, ImlibImage *im,
             back = NULL;
         }
     }
-    /* get a new XImage - or get one from the cached list */
-    xim = __imlib_ProduceXImage(x11, x11->depth, dw, dh, &shm);
+    /* The colour modifier is applied while blending onto the background,
+     * else while copying unscaled rows, else in place on the scaled rows */
+    cmod = CMOD_ACTIVE(cmod);
+    if (back)
+        blender = __imlib_GetBlendFunction(op, 1, 0, !im->has_alpha, cmod);
+    else if (cmod && !scaleinfo)
+        cmoder = __imlib_GetBlendFunction(OP_COPY, 0, 1, 0, cmod);
+    /* render straight into new SHM pixmaps, else get a new XImage - or get
+     * one from the cached list */
+    xim = (dx == 0 && dy == 0) ? __imlib_ShmPixmapXImage(x11->dpy, w) : NULL;
+    inplace = xim && xim->depth == x11->depth &&
+        xim->width >= dw && xim->height >= dh;
+    if (!inplace)
+        xim = __imlib_ProduceXImage(x11, x11->depth, dw, dh, &shm);
     if (!xim)
     {
         __imlib_FreeScaleInfo(scaleinfo);
         free(back);
+        __imlib_SpanEnd(&span, ENOMEM);
         return;
     }
     if (m)
@@ -338,111 +479,15 @@ __imlib_RenderImage(const ImlibContextX11 *x11, ImlibImage *im,
         mxim = __imlib_ProduceXImage(x11, 1, dw, dh, &shm);
         if (!mxim)
         {
-            __imlib_ConsumeXImage(x11, xim);
+            if (!inplace)
+                __imlib_ConsumeXImage(x11, xim);
             __imlib_FreeScaleInfo(scaleinfo);
             free(back);
+            __imlib_SpanEnd(&span, ENOMEM);
             return;
         }
         memset(mxim->data, 0, mxim->bytes_per_line * mxim->height);
     }
-    /* if we are scaling the image at all make a scaling buffer */
-    if (scaleinfo)
-    {
-        /* allocate a buffer to render scaled RGBA data into */
-        buf = malloc(dw * LINESIZE * sizeof(uint32_t));
-        if (!buf)
-        {
-            __imlib_ConsumeXImage(x11, xim);
-            if (m)
-                __imlib_ConsumeXImage(x11, mxim);
-            __imlib_FreeScaleInfo(scaleinfo);
-            free(back);
-            return;
-        }
-    }
-    /* setup h */
-    h = dh;
-    /* scale in LINESIZE Y chunks and convert to depth */
-    /* Get rgba and mask functions for XImage rendering */
-    rgbaer = __imlib_GetRGBAFunction(xim->bits_per_pixel,
-                                     x11->vis->red_mask, x11->vis->green_mask,
-                                     x11->vis->blue_mask, hiq,
-                                     ct->palette_type);
-    if (m)
-        masker = __imlib_GetMaskFunction(dither_mask);
-    for (y = 0; y < dh; y += LINESIZE, h -= LINESIZE)
-    {
-        hh = LINESIZE;
-        if (h < LINESIZE)
-            hh = h;
-
-        /* if we're scaling it */
-        if (scaleinfo)
-        {
-            /* scale the imagedata for this LINESIZE lines chunk of image data */
-            __imlib_Scale(scaleinfo, antialias, im->has_alpha,
-                          im->data, buf, (sx * dw) / sw,
-                          ((sy * dh) / sh) + y, 0, 0, dw, hh, dw, im->w);
-            jump = 0;
-            pointer = buf;
-            if (cmod)
-                __imlib_DataCmodApply(buf, dw, hh, 0, true, cmod);
-        }
-        else
-        {
-            if (cmod)
-            {
-                if (!buf)
-                    buf = malloc(im->w * LINESIZE * sizeof(uint32_t));
-                if (!buf)
-                {
-                    __imlib_ConsumeXImage(x11, xim);
-                    if (m)
-                        __imlib_ConsumeXImage(x11, mxim);
-                    __imlib_FreeScaleInfo(scaleinfo);
-                    free(back);
-                    return;
-                }
-                memcpy(buf, im->data + ((y + sy) * im->w),
-                       im->w * hh * sizeof(uint32_t));
-                __imlib_DataCmodApply(buf, im->w, hh, 0, true, cmod);
-                pointer = buf + sx;
-                jump = im->w - sw;
-            }
-            else
-            {
-                jump = im->w - sw;
-                pointer = im->data + ((y + sy) * im->w) + sx;
-            }
-        }
-
-        /* if we have a back buffer - we're blending to the bg */
-        if (back)
-        {
-            blender(pointer, jump + dw, back + (y * dw), dw, dw, hh, NULL);
-            pointer = back + (y * dw);
-            jump = 0;
-        }
-
-        /* once scaled... convert chunk to bit depth into XImage bufer */
-        if (rgbaer)
-            rgbaer(pointer, jump,
-                   ((uint8_t *) xim->data) + (y * (xim->bytes_per_line)),
-                   xim->bytes_per_line, dw, hh, dx, dy + y);
-        else
-            __imlib_generic_render(pointer, jump, dw, hh, 0, y, xim, x11->vis,
-                                   ct);
-        if (m)
-            masker(pointer, jump,
-                   ((uint8_t *) mxim->data) + (y * (mxim->bytes_per_line)),
-                   mxim->bytes_per_line, dw, hh, dx, dy + y, mat);
-    }
-
-    /* free up our buffers and poit tables */
-    free(buf);
-    if (scaleinfo)
-        __imlib_FreeScaleInfo(scaleinfo);
-    free(back);
 
     /* if we changed diplays or depth since last time... free old gc */
     if ((gc) && ((last_depth != x11->depth) || (disp != x11->dpy)))
@@ -473,30 +518,71 @@ __imlib_RenderImage(const ImlibContextX11 *x11, ImlibImage *im,
             gcv.graphics_exposures = False;
             gcm = XCreateGC(x11->dpy, m, GCGraphicsExposures, &gcv);
         }
+    }
+
+    /* Get rgba and mask functions for XImage rendering */
+    rgbaer = __imlib_GetRGBAFunction(xim->bits_per_pixel,
+                                     x11->vis->red_mask, x11->vis->green_mask,
+                                     x11->vis->blue_mask, hiq,
+                                     ct->palette_type);
+    if (m)
+        masker = __imlib_GetMaskFunction(dither_mask);
+
+    rj = (ImlibRenderJob) {
+        x11, im, ct, xim, mxim, scaleinfo, cmod, rgbaer, masker, blender,
+        cmoder, back, sx, sy, sw, sh, dx, dy, dw, dh, mat, 0, 0, antialias
+    };
+
+    /* Render in a few strips of bands, the bands of a strip in parallel.
+     * Each strip is sent off as soon as it is done, so the server copies it
+     * while the next one is being prepared. */
+    nbands = (dh + LINESIZE - 1) / LINESIZE;
+    nstrips = MAX(1, MIN(RENDER_STRIPS, nbands / RENDER_STRIP_BANDS_MIN));
+    for (i = 0, b0 = 0; i < nstrips; i++, b0 = b1)
+    {
+        b1 = nbands * (i + 1) / nstrips;
+        rj.band0 = b0;
+        __imlib_ParallelFor(b1 - b0, RENDER_BANDS_MIN(dw), __render_bands,
+                            &rj);
+        /* don't put out bands that weren't rendered */
+        if (rj.err)
+            break;
+
+        y = b0 * LINESIZE;
+        hh = MIN(b1 * LINESIZE, dh) - y;
         /* write the mask */
-        if (shm)
-            /* write shm XImage */
-            XShmPutImage(x11->dpy, m, gcm, mxim, 0, 0, dx, dy, dw, dh, False);
-        /* write regular XImage */
-        else
-            XPutImage(x11->dpy, m, gcm, mxim, 0, 0, dx, dy, dw, dh);
+        if (m)
+            __imlib_PutXImage(x11, m, gcm, mxim, 0, y, dx, dy + y, dw, hh);
+
+        /* write the image */
+        if (!inplace)
+            __imlib_PutXImage(x11, w, gc, xim, 0, y, dx, dy + y, dw, hh);
+        XFlush(x11->dpy);
     }
 
-    /* write the image */
-    if (shm)
-        /* write shm XImage */
-        XShmPutImage(x11->dpy, w, gc, xim, 0, 0, dx, dy, dw, dh, False);
-    /* write regular XImage */
-    else
-        XPutImage(x11->dpy, w, gc, xim, 0, 0, dx, dy, dw, dh);
+    /* free up our buffers and poit tables */
+    if (scaleinfo)
+    {
+        __imlib_FreeScaleInfo(scaleinfo);
+        if (!rj.err)
+            STATS_ADD(scale_bytes[!!antialias],
+                      (uint64_t) dw * dh * sizeof(uint32_t));
+    }
+    free(back);
 
-    /* free the XImage and put onto our free list */
-    /* wait for the write to be done */
-    if (shm)
-        XSync(x11->dpy, False);
-    __imlib_ConsumeXImage(x11, xim);
+    /* free the XImage and put onto our free list, shared ones are waited
+     * for when next written */
+    if (!rj.err)
+    {
+        STATS_INC(render_count);
+        STATS_ADD(render_bytes, (uint64_t) xim->bytes_per_line * dh);
+    }
+    if (!inplace)
+        __imlib_ConsumeXImage(x11, xim);
     if (m)
         __imlib_ConsumeXImage(x11, mxim);
+
+    __imlib_SpanEnd(&span, rj.err);
 }
 
 void
@@ -512,6 +598,13 @@ __imlib_RenderImageSkewed(const ImlibContextX11 *x11, ImlibImage *im,
     int             dx1, dy1, dx2, dy2, dw, dh, tsx, tsy;
     ImlibImage     *back;
 
+#ifdef HAVE_X11_XRENDER
+    if (x11->xrender && !m && !CMOD_ACTIVE(cmod) && op == OP_COPY &&
+        !__imlib_XRenderImageSkewed(x11, im, w, sx, sy, sw, sh, dx, dy,
+                                    hsx, hsy, vsx, vsy, antialias))
+        return;
+#endif
+
     dx1 = dx2 = dx;
     dy1 = dy2 = dy;
 
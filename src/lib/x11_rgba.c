@@ -44,7 +44,7 @@ static int      dither_a_init = 0;
 static uint8_t  _dither_a1[8 * 8 * 256];
 
 /* the famous dither matrix */
-static const uint8_t _dither_44[4][4] = {
+const uint8_t   __imlib_dither_44[4][4] = {
     { 0, 4, 1, 5 },
     { 6, 2, 7, 3 },
     { 1, 5, 0, 4 },
@@ -2491,19 +2491,21 @@ __imlib_RGBA_init(void *rd, void *gd, void *bd, int depth, int palette_type)
             {
                 for (i = 0; i < 256; i++)
                 {
-                    if ((_dither_44[x][y] < (i & 0x7)) && (i < (256 - 8)))
+                    if ((__imlib_dither_44[x][y] < (i & 0x7)) &&
+                        (i < (256 - 8)))
                         rd16[(x << 10) | (y << 8) | i] = ((i + 8) & 0xf8) << 8;
                     else
                         rd16[(x << 10) | (y << 8) | i] = (i & 0xf8) << 8;
 
-                    if ((_dither_44[x][y] < ((i & 0x3) << 1)) &&
+                    if ((__imlib_dither_44[x][y] < ((i & 0x3) << 1)) &&
                         (i < (256 - 4)))
                         gd16[(x << 10) | (y << 8) | i] =
                             (((i + 4) & 0xfc) << 8) >> 5;
                     else
                         gd16[(x << 10) | (y << 8) | i] = ((i & 0xfc) << 8) >> 5;
 
-                    if ((_dither_44[x][y] < (i & 0x7)) && (i < (256 - 8)))
+                    if ((__imlib_dither_44[x][y] < (i & 0x7)) &&
+                        (i < (256 - 8)))
                         bd16[(x << 10) | (y << 8) | i] =
                             (((i + 8) & 0xf8) << 16) >> 19;
                     else
@@ -2523,19 +2525,22 @@ __imlib_RGBA_init(void *rd, void *gd, void *bd, int depth, int palette_type)
             {
                 for (i = 0; i < 256; i++)
                 {
-                    if ((_dither_44[x][y] < (i & 0x7)) && (i < (256 - 8)))
+                    if ((__imlib_dither_44[x][y] < (i & 0x7)) &&
+                        (i < (256 - 8)))
                         rd16[(x << 10) | (y << 8) | i] =
                             (((i + 8) & 0xf8) << 8) >> 1;
                     else
                         rd16[(x << 10) | (y << 8) | i] = ((i & 0xf8) << 8) >> 1;
 
-                    if ((_dither_44[x][y] < (i & 0x7)) && (i < (256 - 8)))
+                    if ((__imlib_dither_44[x][y] < (i & 0x7)) &&
+                        (i < (256 - 8)))
                         gd16[(x << 10) | (y << 8) | i] =
                             (((i + 8) & 0xf8) << 8) >> 6;
                     else
                         gd16[(x << 10) | (y << 8) | i] = ((i & 0xf8) << 8) >> 6;
 
-                    if ((_dither_44[x][y] < (i & 0x7)) && (i < (256 - 8)))
+                    if ((__imlib_dither_44[x][y] < (i & 0x7)) &&
+                        (i < (256 - 8)))
                         bd16[(x << 10) | (y << 8) | i] =
                             (((i + 8) & 0xf8) << 16) >> 19;
                     else
@@ -4722,14 +4727,13 @@ __imlib_RGBA_to_RGB8888_fast(const uint32_t *src, int src_jump,
         memcpy(dest, src, h * w * sizeof(uint32_t));
 }
 
-#if 0                           /* Unused */
 static void
 __imlib_RGBA_to_BGR8888_fast(const uint32_t *src, int src_jump,
                              uint8_t *dst, int dow,
                              int width, int height, int dx, int dy)
 {
     int             x, y, w, h;
-    uint32_t       *dest = (uint32_t *) dst;
+    uint32_t       *dest = (uint32_t *) (void *)dst;
     int             dest_jump = (dow / sizeof(uint32_t)) - width;
 
     w = width;
@@ -4745,7 +4749,6 @@ __imlib_RGBA_to_BGR8888_fast(const uint32_t *src, int src_jump,
         dest += dest_jump;
     }
 }
-#endif
 
 static void
 __imlib_RGBA_to_RGB888_fast(const uint32_t *src, int src_jump,
@@ -4769,7 +4772,6 @@ __imlib_RGBA_to_RGB888_fast(const uint32_t *src, int src_jump,
     }
 }
 
-#if 0                           /* Unused */
 static void
 __imlib_RGBA_to_BGR888_fast(const uint32_t *src, int src_jump,
                             uint8_t *dest, int dow,
@@ -4791,7 +4793,6 @@ __imlib_RGBA_to_BGR888_fast(const uint32_t *src, int src_jump,
         dest += dest_jump;
     }
 }
-#endif
 
 #if 0                           /* Unused */
 static void
@@ -4803,11 +4804,62 @@ __imlib_RGBA_to_Nothing(const uint32_t *src, int src_jump,
 }
 #endif
 
+#ifdef DO_AMD64_ASM
+/* The vectorized row layout for bits per pixel depth and masks, or -1 */
+static int
+__rgba_row_format(int depth,
+                  unsigned long rm, unsigned long gm, unsigned long bm)
+{
+    switch (depth)
+    {
+    case 16:
+        if ((rm == 0xf800) && (gm == 0x7e0) && (bm == 0x1f))
+            return RGBA_ROW_RGB565;
+        if ((rm == 0x7c00) && (gm == 0x3e0) && (bm == 0x1f))
+            return RGBA_ROW_RGB555;
+        if ((bm == 0xf800) && (gm == 0x7e0) && (rm == 0x1f))
+            return RGBA_ROW_BGR565;
+        if ((bm == 0x7c00) && (gm == 0x3e0) && (rm == 0x1f))
+            return RGBA_ROW_BGR555;
+        break;
+    case 32:
+        if ((bm == 0xff0000) && (gm == 0xff00) && (rm == 0xff))
+            return RGBA_ROW_BGR8888;
+        break;
+    case 24:
+        if ((rm == 0xff0000) && (gm == 0xff00) && (bm == 0xff))
+            return RGBA_ROW_RGB888;
+        if ((bm == 0xff0000) && (gm == 0xff00) && (rm == 0xff))
+            return RGBA_ROW_BGR888;
+        break;
+    }
+    return -1;
+}
+#endif
+
 ImlibRGBAFunction
 __imlib_GetRGBAFunction(int depth,
                         unsigned long rm, unsigned long gm, unsigned long bm,
                         char hiq, int palette_type)
 {
+#ifdef DO_AMD64_ASM
+    int             fmt;
+
+    fmt = __rgba_row_format(depth, rm, gm, bm);
+    if (fmt >= 0)
+    {
+        switch (__imlib_cpu_isa())
+        {
+        case ISA_AVX512:
+            return __imlib_rgba_funcs_avx512[fmt][!!hiq];
+        case ISA_AVX2:
+            return __imlib_rgba_funcs_avx2[fmt][!!hiq];
+        default:               /* No SSE2 rows, the C ones below */
+            break;
+        }
+    }
+#endif
+
     if (depth == 16)
     {
         if (hiq)
@@ -4854,12 +4906,16 @@ __imlib_GetRGBAFunction(int depth,
     {
         if ((rm == 0xff0000) && (gm == 0xff00) && (bm == 0xff))
             return __imlib_RGBA_to_RGB8888_fast;
+        if ((bm == 0xff0000) && (gm == 0xff00) && (rm == 0xff))
+            return __imlib_RGBA_to_BGR8888_fast;
         return NULL;
     }
     else if (depth == 24)
     {
         if ((rm == 0xff0000) && (gm == 0xff00) && (bm == 0xff))
             return __imlib_RGBA_to_RGB888_fast;
+        if ((bm == 0xff0000) && (gm == 0xff00) && (rm == 0xff))
+            return __imlib_RGBA_to_BGR888_fast;
         return NULL;
     }
     else if (depth == 8)
@@ -22,6 +22,27 @@ ImlibRGBAFunction __imlib_GetRGBAFunction(int depth, unsigned long rm,
                                           char hiq, int palette_type);
 ImlibMaskFunction __imlib_GetMaskFunction(char hiq);
 
+/* the 4x4 ordered dither matrix of the 15/16 bpp converters */
+extern const uint8_t __imlib_dither_44[4][4];
+
+#if DO_AMD64_ASM
+/* Vectorized row layouts (see __imlib_GetRGBAFunction) */
+enum {
+    RGBA_ROW_RGB565,
+    RGBA_ROW_BGR565,
+    RGBA_ROW_RGB555,
+    RGBA_ROW_BGR555,
+    RGBA_ROW_BGR8888,
+    RGBA_ROW_RGB888,
+    RGBA_ROW_BGR888,
+    RGBA_ROW_NUM
+};
+
+/* [ layout ][ dither ] */
+extern const ImlibRGBAFunction __imlib_rgba_funcs_avx2[RGBA_ROW_NUM][2];
+extern const ImlibRGBAFunction __imlib_rgba_funcs_avx512[RGBA_ROW_NUM][2];
+#endif
+
 #ifdef DO_MMX_ASM
 void            __imlib_mmx_rgb555_fast(const uint32_t *, int, uint8_t *,
                                         int, int, int, int, int);
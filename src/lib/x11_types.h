@@ -8,6 +8,7 @@ typedef struct {
     Visual         *vis;
     Colormap        cmap;
     int             depth;
+    char            xrender;    /* Composite with RENDER if possible */
 } ImlibContextX11;
 
 #endif                          /* X11_TYPES_H */
@@ -14,19 +14,59 @@
 #include <sys/ipc.h>
 #include <sys/shm.h>
 
+#include "stats.h"
 #include "x11_ximage.h"
 
 static void     __imlib_FlushXImage(const ImlibContextX11 * x11);
 
 static signed char x_does_shm = -1;
+static signed char x_does_shm_pixmaps = 0;
 
 #ifdef HAVE_X11_SHM_FD
 static signed char x_does_shm_fd = 0;
 #endif
 
+/*
+ * The shared segments of XImages are pooled, in power of 2 sizes, and handed
+ * to new XImages without creating and attaching new ones. The serial of the
+ * last put from a segment is kept as the fence: it may be written again
+ * once the server has got that far, which any reply or event it has sent
+ * since tells without a round trip. No completion events are asked for,
+ * they would end up in the application's event queue.
+ * Pooled segments are removed once attached (see __shm_seg_new()), so
+ * they don't outlive the process.
+ */
+typedef struct _shm_seg {
+    struct _shm_seg *next;
+    Display        *dpy;
+    XShmSegmentInfo si;
+    size_t          size;
+    unsigned long   fence;      /* Serial of the last put from it, 0 if none */
+    char            used;
+} shm_seg_t;
+
+#define SHM_SEG_SIZE_MIN    (64 * 1024)
+#define SHM_POOL_IDLE_MAX   4
+
+/* Most recently released first */
+static shm_seg_t *shm_segs = NULL;
+
+/* Pixmaps on segments of their own, see __imlib_ShmCreatePixmap() */
+typedef struct _shm_pixmap {
+    struct _shm_pixmap *next;
+    Display        *dpy;
+    Pixmap          pixmap;
+    XImage         *xim;
+    XShmSegmentInfo si;
+    size_t          size;
+    char            fresh;      /* Not drawn to yet */
+} shm_pixmap_t;
+
+static shm_pixmap_t *shm_pixmaps = NULL;
+
 typedef struct {
     XImage         *xim;
-    XShmSegmentInfo *si;
+    shm_seg_t      *seg;
     Display        *dpy;
     char            used;
 } xim_cache_rec_t;
@@ -58,17 +98,17 @@ ShmCheck(Display *d)
     /* if its there set x_does_shm flag */
     if (XShmQueryExtension(d))
     {
-#ifdef HAVE_X11_SHM_FD
         int             major, minor;
         Bool            pixmaps;
-#endif
-        x_does_shm = 2;         /* 2: __imlib_ShmGetXImage tests first XShmAttach */
-#ifdef HAVE_X11_SHM_FD
+
+        x_does_shm = 2;         /* 2: __shm_seg_new tests first XShmAttach */
         if (XShmQueryVersion(d, &major, &minor, &pixmaps))
         {
+#ifdef HAVE_X11_SHM_FD
             x_does_shm_fd = (major == 1 && minor >= 2) || major > 1;
-        }
 #endif
+            x_does_shm_pixmaps = pixmaps && XShmPixmapFormat(d) == ZPixmap;
+        }
     }
     /* clear the flag - no shm at all */
     else
@@ -96,6 +136,15 @@ ShmCheck(Display *d)
 #endif
     }
 
+    /* SHM pixmaps only if asked for, servers can't accelerate drawing from
+     * them */
+    s = getenv("IMLIB2_SHM_PIXMAPS");
+    val = s ? atoi(s) : 0;
+    if (val <= 0)
+        x_does_shm_pixmaps = 0;
+    if (s)
+        printf("%s: x_does_shm_pixmaps=%d\n", __func__, x_does_shm_pixmaps);
+
     /* Set ximage cache list_max_count */
     s = getenv("IMLIB2_XIMAGE_CACHE_COUNT");
     if (s)
@@ -108,23 +157,10 @@ ShmCheck(Display *d)
     }
 }
 
-XImage         *
-__imlib_ShmGetXImage(const ImlibContextX11 *x11, Drawable draw, int depth,
-                     int x, int y, int w, int h, XShmSegmentInfo *si)
+/* Create a shared memory segment of size bytes and attach it to the server */
+static int
+__shm_seg_new(const ImlibContextX11 *x11, XShmSegmentInfo *si, size_t size)
 {
-    XImage         *xim;
-
-    if (x_does_shm < 0)
-        ShmCheck(x11->dpy);
-
-    if (!x_does_shm)
-        return NULL;
-
-    /* try create an shm image */
-    xim = XShmCreateImage(x11->dpy, x11->vis, depth, ZPixmap, NULL, si, w, h);
-    if (!xim)
-        return NULL;
-
 #ifdef HAVE_X11_SHM_FD
     if (x_does_shm_fd)
     {
@@ -132,14 +168,12 @@ __imlib_ShmGetXImage(const ImlibContextX11 *x11, Drawable draw, int depth,
         xcb_shm_create_segment_cookie_t cookie;
         xcb_shm_create_segment_reply_t *reply;
         xcb_connection_t *c = XGetXCBConnection(x11->dpy);
-        size_t          segment_size = xim->bytes_per_line * xim->height;
 
         si->shmaddr = NULL;
         si->shmseg = xcb_generate_id(c);
         si->readOnly = False;
 
-        cookie =
-            xcb_shm_create_segment(c, si->shmseg, segment_size, si->readOnly);
+        cookie = xcb_shm_create_segment(c, si->shmseg, size, si->readOnly);
         reply = xcb_shm_create_segment_reply(c, cookie, &error);
         if (reply)
         {
@@ -149,7 +183,7 @@ __imlib_ShmGetXImage(const ImlibContextX11 *x11, Drawable draw, int depth,
                 xcb_shm_create_segment_reply_fds(c, reply) : NULL;
             if (fds)
             {
-                si->shmaddr = mmap(0, segment_size, PROT_READ | PROT_WRITE,
+                si->shmaddr = mmap(0, size, PROT_READ | PROT_WRITE,
                                    MAP_SHARED, fds[0], 0);
                 close(fds[0]);
                 if (si->shmaddr == MAP_FAILED)
@@ -164,32 +198,23 @@ __imlib_ShmGetXImage(const ImlibContextX11 *x11, Drawable draw, int depth,
         free(error);
 
         if (si->shmaddr)
-        {
-            xim->data = si->shmaddr;
-            if (draw != None)
-                XShmGetImage(x11->dpy, draw, xim, x, y, 0xffffffff);
+            return 1;
 
-            return xim;
-        }
-        else
-        {
-            x_does_shm = 0;
-        }
+        x_does_shm = 0;
     }
     else
 #endif
     {
         /* get an shm id of this image */
-        si->shmid = shmget(IPC_PRIVATE, xim->bytes_per_line * xim->height,
-                           IPC_CREAT | 0666);
+        si->shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0666);
         /* if the get succeeds */
         if (si->shmid != -1)
         {
             /* set the params for the shm segment */
             si->readOnly = False;
-            si->shmaddr = xim->data = shmat(si->shmid, 0, 0);
+            si->shmaddr = shmat(si->shmid, 0, 0);
             /* get the shm addr for this data chunk */
-            if (xim->data != (char *)-1)
+            if (si->shmaddr != (char *)-1)
             {
                 XErrorHandler   ph = NULL;
 
@@ -202,20 +227,23 @@ __imlib_ShmGetXImage(const ImlibContextX11 *x11, Drawable draw, int depth,
                 }
                 /* ask X to attach to the shared mem segment */
                 XShmAttach(x11->dpy, si);
-                if (draw != None)
-                    XShmGetImage(x11->dpy, draw, xim, x, y, 0xffffffff);
+                /* wait for X to reply and do this */
+                XSync(x11->dpy, False);
                 if (x_does_shm == 2)
                 {
-                    /* wait for X to reply and do this */
-                    XSync(x11->dpy, False);
                     /* reset the error handler */
                     XSetErrorHandler(ph);
                     x_does_shm = 1;
                 }
 
-                /* if we attached without an error we're set */
+                /* if we attached without an error we're set, the id can
+                 * go now, the segment goes when the last one detaches
+                 * (also if we exit without doing it) */
                 if (_x_err == 0)
-                    return xim;
+                {
+                    shmctl(si->shmid, IPC_RMID, 0);
+                    return 1;
+                }
 
                 /* attach by X failed... must be remote client */
                 /* flag shm forever to not work - remote */
@@ -231,31 +259,292 @@ __imlib_ShmGetXImage(const ImlibContextX11 *x11, Drawable draw, int depth,
         }
     }
 
-    /* couldnt create SHM image ? */
-    /* destroy previous image */
-    XDestroyImage(xim);
-
-    return NULL;
+    return 0;
 }
 
-void
-__imlib_ShmDestroyXImage(const ImlibContextX11 *x11, XImage *xim,
-                         XShmSegmentInfo *si)
+/* Detach a segment. It is already removed, and goes when the server has
+ * detached it too, which it does after the pending requests and pixmaps
+ * using it. */
+static void
+__shm_seg_free(Display *d, XShmSegmentInfo *si, size_t size)
 {
-    XSync(x11->dpy, False);
-    XShmDetach(x11->dpy, si);
+    XShmDetach(d, si);
 #ifdef HAVE_X11_SHM_FD
     if (x_does_shm_fd)
     {
-        munmap(si->shmaddr, xim->bytes_per_line * xim->height);
+        munmap(si->shmaddr, size);
     }
     else
 #endif
     {
         shmdt(si->shmaddr);
-        shmctl(si->shmid, IPC_RMID, 0);
     }
+}
+
+/* Read what the server has sent so far, which moves the last processed
+ * request. Events are left queued for the application. */
+static void
+__shm_read(Display *d)
+{
+    XEventsQueued(d, QueuedAfterReading);
+}
+
+/* Whether the server is done with the puts from seg, reading what it has
+ * sent first if fresh is set */
+static int
+__shm_seg_idle(shm_seg_t *seg, int fresh)
+{
+    if (!seg->fence)
+        return 1;
+
+    if (fresh)
+        __shm_read(seg->dpy);
+    if ((long)(LastKnownRequestProcessed(seg->dpy) - seg->fence) < 0)
+        return 0;
+
+    seg->fence = 0;
+    return 1;
+}
+
+/* Wait for the server to be done with the puts from seg */
+static void
+__shm_seg_wait(shm_seg_t *seg)
+{
+    if (__shm_seg_idle(seg, 1))
+        return;
+
+    XSync(seg->dpy, False);
+    seg->fence = 0;
+}
+
+/* Free the idle segments of d beyond the keep most recently released ones
+ * within the XImage cache memory limit */
+static void
+__shm_pool_trim(Display *d, int keep)
+{
+    shm_seg_t      *seg, **pseg;
+    size_t          mem;
+    int             num;
+
+    num = 0;
+    mem = 0;
+    for (pseg = &shm_segs; (seg = *pseg);)
+    {
+        if (!seg->used && seg->dpy == d)
+        {
+            num++;
+            mem += seg->size;
+            if (num > keep || mem > (size_t)list_max_mem)
+            {
+                __shm_seg_wait(seg);
+                *pseg = seg->next;
+                __shm_seg_free(seg->dpy, &seg->si, seg->size);
+                free(seg);
+                continue;
+            }
+        }
+        pseg = &seg->next;
+    }
+}
+
+/* Get an idle pooled segment of at least size bytes or a new one, waiting
+ * for a busy one if there are enough */
+static shm_seg_t *
+__shm_seg_get(const ImlibContextX11 *x11, size_t size)
+{
+    shm_seg_t      *seg, *fit, *busy;
+    int             num, fresh;
+
+    fit = busy = NULL;
+    num = 0;
+    fresh = 1;
+    for (seg = shm_segs; seg; seg = seg->next)
+    {
+        if (seg->used || seg->dpy != x11->dpy)
+            continue;
+        num++;
+        if (seg->size < size)
+            continue;
+        if (seg->fence && fresh)
+        {
+            __shm_read(x11->dpy);
+            fresh = 0;
+        }
+        if (!__shm_seg_idle(seg, 0))
+        {
+            if (!busy || seg->size < busy->size)
+                busy = seg;
+            continue;
+        }
+        if (!fit || seg->size < fit->size)
+            fit = seg;
+    }
+
+    if (!fit && busy && num >= SHM_POOL_IDLE_MAX)
+    {
+        __shm_seg_wait(busy);
+        fit = busy;
+    }
+
+    if (!fit)
+    {
+        fit = calloc(1, sizeof(shm_seg_t));
+        if (!fit)
+            return NULL;
+        for (fit->size = SHM_SEG_SIZE_MIN; fit->size < size;)
+            fit->size *= 2;
+        if (!__shm_seg_new(x11, &fit->si, fit->size))
+        {
+            free(fit);
+            return NULL;
+        }
+        fit->dpy = x11->dpy;
+        fit->next = shm_segs;
+        shm_segs = fit;
+    }
+
+    fit->used = 1;
+    return fit;
+}
+
+/* Return seg to the pool */
+static void
+__shm_seg_release(shm_seg_t *seg)
+{
+    shm_seg_t     **pseg;
+
+    seg->used = 0;
+    for (pseg = &shm_segs; *pseg != seg; pseg = &(*pseg)->next)
+        ;
+    *pseg = seg->next;
+    seg->next = shm_segs;
+    shm_segs = seg;
+}
+
+/* Create a shared XImage on a pooled segment */
+static XImage  *
+__shm_ximage_new(const ImlibContextX11 *x11, int depth, int w, int h,
+                 shm_seg_t **pseg)
+{
+    XImage         *xim;
+    shm_seg_t      *seg;
+
+    if (x_does_shm < 0)
+        ShmCheck(x11->dpy);
+
+    if (!x_does_shm)
+        return NULL;
+
+    xim = XShmCreateImage(x11->dpy, x11->vis, depth, ZPixmap, NULL, NULL,
+                          w, h);
+    if (!xim)
+        return NULL;
+
+    seg = __shm_seg_get(x11, xim->bytes_per_line * xim->height);
+    if (!seg)
+    {
+        XDestroyImage(xim);
+        return NULL;
+    }
+
+    xim->data = seg->si.shmaddr;
+    xim->obdata = (char *)&seg->si;
+    *pseg = seg;
+
+    return xim;
+}
+
+/*
+ * Grabs fetch through one shared segment per slot (drawable and mask), kept
+ * between grabs and grown as needed, so repeated grabs don't create, attach
+ * and remove a segment each time. Segments larger than the XImage cache
+ * memory limit are dropped after use.
+ */
+typedef struct {
+    Display        *dpy;
+    XShmSegmentInfo si;
+    size_t          size;
+} shm_grab_seg_t;
+
+static shm_grab_seg_t grab_segs[2];
+
+static void
+__shm_grab_seg_free(Display *d, shm_grab_seg_t *gs)
+{
+    if (gs->size == 0)
+        return;
+    if (gs->dpy == d)
+        __shm_seg_free(d, &gs->si, gs->size);
+    else
+    {
+        /* The display the segment was attached on may be gone, just let
+         * go of our end */
+#ifdef HAVE_X11_SHM_FD
+        if (x_does_shm_fd)
+            munmap(gs->si.shmaddr, gs->size);
+        else
+#endif
+        {
+            shmdt(gs->si.shmaddr);
+        }
+    }
+    gs->size = 0;
+    gs->dpy = NULL;
+}
+
+XImage         *
+__imlib_ShmGrabXImage(const ImlibContextX11 *x11, int slot, Drawable draw,
+                      int depth, int x, int y, int w, int h)
+{
+    shm_grab_seg_t *gs = &grab_segs[slot];
+    XImage         *xim;
+    size_t          size;
+
+    if (x_does_shm < 0)
+        ShmCheck(x11->dpy);
+
+    if (!x_does_shm)
+        return NULL;
+
+    xim = XShmCreateImage(x11->dpy, x11->vis, depth, ZPixmap, NULL, &gs->si,
+                          w, h);
+    if (!xim)
+        return NULL;
+
+    size = xim->bytes_per_line * xim->height;
+    if (gs->size < size || gs->dpy != x11->dpy)
+    {
+        __shm_grab_seg_free(x11->dpy, gs);
+        size = (size + 0xffff) & ~(size_t) 0xffff;
+        if (!__shm_seg_new(x11, &gs->si, size))
+        {
+            XDestroyImage(xim);
+            return NULL;
+        }
+        gs->size = size;
+        gs->dpy = x11->dpy;
+    }
+
+    xim->data = gs->si.shmaddr;
+    if (!XShmGetImage(x11->dpy, draw, xim, x, y, 0xffffffff))
+    {
+        __imlib_ShmGrabDone(x11, slot, xim);
+        return NULL;
+    }
+
+    return xim;
+}
+
+void
+__imlib_ShmGrabDone(const ImlibContextX11 *x11, int slot, XImage *xim)
+{
+    shm_grab_seg_t *gs = &grab_segs[slot];
+
+    xim->data = NULL;
     XDestroyImage(xim);
+
+    if (gs->size > (size_t)list_max_mem)
+        __shm_grab_seg_free(x11->dpy, gs);
 }
 
 void
@@ -282,6 +571,11 @@ __imlib_SetXImageCacheSizeMax(const ImlibContextX11 *x11, int num)
 {
     list_max_mem = num;
     __imlib_FlushXImage(x11);
+    if (grab_segs[0].size > (size_t)list_max_mem)
+        __shm_grab_seg_free(x11->dpy, &grab_segs[0]);
+    if (grab_segs[1].size > (size_t)list_max_mem)
+        __shm_grab_seg_free(x11->dpy, &grab_segs[1]);
+    __shm_pool_trim(x11->dpy, SHM_POOL_IDLE_MAX);
 }
 
 int
@@ -296,11 +590,55 @@ __imlib_GetXImageCacheSizeUsed(const ImlibContextX11 *x11)
     return list_mem_use;
 }
 
+/* Remove entry i of the XImage cache, its segment going back to the pool */
+static void
+__xim_cache_del(int i)
+{
+    XImage         *xim;
+    int             j;
+
+    xim = xim_cache[i].xim;
+    list_mem_use -= xim->bytes_per_line * xim->height;
+
+    if (xim_cache[i].seg)
+        __shm_seg_release(xim_cache[i].seg);
+    XDestroyImage(xim);
+
+    list_num--;
+    for (j = i; j < list_num; j++)
+    {
+        xim_cache[j] = xim_cache[j + 1];
+    }
+
+    if (list_num == 0)
+    {
+        free(xim_cache);
+        xim_cache = NULL;
+    }
+    else
+    {
+        xim_cache = realloc(xim_cache, sizeof(xim_cache_rec_t) * list_num);
+    }
+}
+
+static xim_cache_rec_t *
+__xim_cache_find(const XImage *xim)
+{
+    int             i;
+
+    for (i = 0; i < list_num; i++)
+    {
+        if (xim_cache[i].xim == xim)
+            return &xim_cache[i];
+    }
+
+    return NULL;
+}
+
 void
 __imlib_FlushXImage(const ImlibContextX11 *x11)
 {
-    int             i, j;
-    XImage         *xim;
+    int             i;
     char            did_free = 1;
 
     while (((list_mem_use > list_max_mem) || (list_num > list_max_count)) &&
@@ -315,63 +653,65 @@ __imlib_FlushXImage(const ImlibContextX11 *x11)
                 continue;
             }
 
-            xim = xim_cache[i].xim;
-            list_mem_use -= xim->bytes_per_line * xim->height;
-
-            if (xim_cache[i].si)
-            {
-                __imlib_ShmDestroyXImage(x11, xim, xim_cache[i].si);
-                free(xim_cache[i].si);
-            }
-            else
-            {
-                XDestroyImage(xim);
-            }
-
-            list_num--;
-            for (j = i; j < list_num; j++)
-            {
-                xim_cache[j] = xim_cache[j + 1];
-            }
-
-            if (list_num == 0)
-            {
-                free(xim_cache);
-                xim_cache = NULL;
-            }
-            else
-            {
-                xim_cache =
-                    realloc(xim_cache, sizeof(xim_cache_rec_t) * list_num);
-            }
+            STATS_CACHE_INC(STATS_CACHE_XIMAGE, evict);
+            __xim_cache_del(i);
 
             did_free = 1;
         }
     }
+
+    __shm_pool_trim(x11->dpy, SHM_POOL_IDLE_MAX);
 }
 
 /* free (consume == opposite of produce) the XImage (mark as unused) */
 void
 __imlib_ConsumeXImage(const ImlibContextX11 *x11, XImage *xim)
 {
-    int             i;
+    xim_cache_rec_t *xr;
 
-    /* march through the XImage list */
-    for (i = 0; i < list_num; i++)
+    /* find it on the XImage list */
+    xr = __xim_cache_find(xim);
+    if (!xr)
+        return;
+
+    /* we have a match = mark as unused */
+    xr->used = 0;
+    /* flush the XImage list to get rud of stuff we dont want */
+    __imlib_FlushXImage(x11);
+}
+
+/* Put (part of) an XImage from __imlib_ProduceXImage() onto d. Shared ones
+ * are fenced by the serial of the put, instead of having to sync before
+ * they are written again. */
+void
+__imlib_PutXImage(const ImlibContextX11 *x11, Drawable d, GC gc, XImage *xim,
+                  int sx, int sy, int dx, int dy, int w, int h)
+{
+    xim_cache_rec_t *xr;
+
+    xr = __xim_cache_find(xim);
+    if (xr && xr->seg)
     {
-        /* find a match */
-        if (xim_cache[i].xim == xim)
-        {
-            /* we have a match = mark as unused */
-            xim_cache[i].used = 0;
-            /* flush the XImage list to get rud of stuff we dont want */
-            __imlib_FlushXImage(x11);
-            /* return */
-            return;
-        }
+        XShmPutImage(x11->dpy, d, gc, xim, sx, sy, dx, dy, w, h, False);
+        xr->seg->fence = NextRequest(x11->dpy) - 1;
+    }
+    else
+    {
+        XPutImage(x11->dpy, d, gc, xim, sx, sy, dx, dy, w, h);
     }
 }
 
+/* Wait for the puts from xim to be done before writing it again */
+void
+__imlib_SyncXImage(const ImlibContextX11 *x11, XImage *xim)
+{
+    xim_cache_rec_t *xr;
+
+    xr = __xim_cache_find(xim);
+    if (xr && xr->seg)
+        __shm_seg_wait(xr->seg);
+}
+
 /* create a new XImage or find it on our list of currently available ones so */
 /* we dont need to create a new one */
 XImage         *
@@ -380,6 +720,7 @@ __imlib_ProduceXImage(const ImlibContextX11 *x11, int depth, int w, int h,
 {
     XImage         *xim;
     xim_cache_rec_t *xim_cache_tmp;
+    shm_seg_t      *seg;
     int             i;
 
     /* find a cached XImage (to avoid server to & fro) that is big enough */
@@ -398,15 +739,20 @@ __imlib_ProduceXImage(const ImlibContextX11 *x11, int depth, int w, int h,
             /* && (xim_cache[i].dpy == d) */
         {
             xim_cache[i].used = 1;
-            /* if its shared set shared flag */
-            if (xim_cache[i].si)
+            STATS_CACHE_INC(STATS_CACHE_XIMAGE, hit);
+            /* if its shared set shared flag, and let the last put finish */
+            if (xim_cache[i].seg)
+            {
+                __shm_seg_wait(xim_cache[i].seg);
                 *shared = 1;
+            }
             /* return it */
             return xim;
         }
     }
 
     /* can't find a usable XImage on the cache - create one */
+    STATS_CACHE_INC(STATS_CACHE_XIMAGE, miss);
     /* add the new XImage to the XImage cache */
     list_num++;
     xim_cache_tmp = realloc(xim_cache, sizeof(xim_cache_rec_t) * list_num);
@@ -417,17 +763,10 @@ __imlib_ProduceXImage(const ImlibContextX11 *x11, int depth, int w, int h,
         return NULL;
     }
     xim_cache = xim_cache_tmp;
-    xim_cache[list_num - 1].si = malloc(sizeof(XShmSegmentInfo));
-    if (!xim_cache[list_num - 1].si)
-    {
-        /* failed to allocate memory */
-        list_num--;
-        return NULL;
-    }
 
     /* work on making a shared image */
-    xim = __imlib_ShmGetXImage(x11, None, depth, 0, 0, w, h,
-                               xim_cache[list_num - 1].si);
+    seg = NULL;
+    xim = __shm_ximage_new(x11, depth, w, h, &seg);
     /* ok if xim == NULL it all failed - fall back to XImages */
     if (xim)
     {
@@ -435,10 +774,6 @@ __imlib_ProduceXImage(const ImlibContextX11 *x11, int depth, int w, int h,
     }
     else
     {
-        /* get rid of out shm info struct */
-        free(xim_cache[list_num - 1].si);
-        /* flag it as NULL ot indicate a normal XImage */
-        xim_cache[list_num - 1].si = NULL;
         /* create a normal ximage */
         xim =
             XCreateImage(x11->dpy, x11->vis, depth, ZPixmap, 0, NULL, w, h, 32,
@@ -457,6 +792,8 @@ __imlib_ProduceXImage(const ImlibContextX11 *x11, int depth, int w, int h,
     }
     /* add xim to our list */
     xim_cache[list_num - 1].xim = xim;
+    /* flag it as NULL ot indicate a normal XImage */
+    xim_cache[list_num - 1].seg = seg;
     /* incriment our memory count */
     list_mem_use += xim->bytes_per_line * xim->height;
     /* mark image as used */
@@ -480,3 +817,122 @@ __imlib_ProduceXImage(const ImlibContextX11 *x11, int depth, int w, int h,
     /* return out image */
     return xim;
 }
+
+/* Create a pixmap on a shared segment of its own, so it can be rendered to
+ * in place through __imlib_ShmPixmapXImage() instead of by putting images
+ * onto it. Returns None if SHM pixmaps are not available. */
+Pixmap
+__imlib_ShmCreatePixmap(const ImlibContextX11 *x11, Drawable draw, int w,
+                        int h)
+{
+    shm_pixmap_t   *sp;
+
+    if (x_does_shm < 0)
+        ShmCheck(x11->dpy);
+
+    if (!x_does_shm || !x_does_shm_pixmaps)
+        return None;
+
+    sp = calloc(1, sizeof(shm_pixmap_t));
+    if (!sp)
+        return None;
+
+    sp->xim = XShmCreateImage(x11->dpy, x11->vis, x11->depth, ZPixmap, NULL,
+                              &sp->si, w, h);
+    if (!sp->xim)
+        goto bail;
+
+    sp->size = sp->xim->bytes_per_line * sp->xim->height;
+    if (!__shm_seg_new(x11, &sp->si, sp->size))
+    {
+        XDestroyImage(sp->xim);
+        goto bail;
+    }
+    sp->xim->data = sp->si.shmaddr;
+#ifdef WORDS_BIGENDIAN
+    sp->xim->byte_order = MSBFirst;
+    sp->xim->bitmap_bit_order = MSBFirst;
+#else
+    sp->xim->byte_order = LSBFirst;
+    sp->xim->bitmap_bit_order = LSBFirst;
+#endif
+
+    sp->dpy = x11->dpy;
+    sp->fresh = 1;
+    sp->pixmap = XShmCreatePixmap(x11->dpy, draw, sp->si.shmaddr, &sp->si,
+                                  w, h, x11->depth);
+    sp->next = shm_pixmaps;
+    shm_pixmaps = sp;
+
+    return sp->pixmap;
+
+  bail:
+    free(sp);
+    return None;
+}
+
+/* The XImage sharing the memory of p, if it is an SHM pixmap not drawn to
+ * yet. Once drawn to, requests using it may be pending, and it is written
+ * to with puts like any other pixmap. */
+XImage         *
+__imlib_ShmPixmapXImage(Display *d, Pixmap p)
+{
+    shm_pixmap_t   *sp;
+
+    for (sp = shm_pixmaps; sp; sp = sp->next)
+    {
+        if (sp->pixmap == p && sp->dpy == d)
+        {
+            if (!sp->fresh)
+                return NULL;
+            sp->fresh = 0;
+            return sp->xim;
+        }
+    }
+
+    return NULL;
+}
+
+/* Free p and its segment if it is an SHM pixmap, returns 0 if it isn't */
+int
+__imlib_ShmFreePixmap(Display *d, Pixmap p)
+{
+    shm_pixmap_t   *sp, **psp;
+
+    for (psp = &shm_pixmaps; (sp = *psp); psp = &sp->next)
+    {
+        if (sp->pixmap == p && sp->dpy == d)
+            break;
+    }
+    if (!sp)
+        return 0;
+
+    *psp = sp->next;
+    XFreePixmap(d, p);
+    __shm_seg_free(d, &sp->si, sp->size);
+    XDestroyImage(sp->xim);
+    free(sp);
+
+    return 1;
+}
+
+/* Let go of the segments and unused XImages kept for d */
+void
+__imlib_ShmDisconnect(Display *d)
+{
+    int             i;
+
+    for (i = 0; i < list_num;)
+    {
+        if (xim_cache[i].dpy == d && !xim_cache[i].used)
+            __xim_cache_del(i);
+        else
+            i++;
+    }
+
+    __shm_pool_trim(d, 0);
+    if (grab_segs[0].dpy == d)
+        __shm_grab_seg_free(d, &grab_segs[0]);
+    if (grab_segs[1].dpy == d)
+        __shm_grab_seg_free(d, &grab_segs[1]);
+}
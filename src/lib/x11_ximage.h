@@ -18,11 +18,20 @@ void            __imlib_ConsumeXImage(const ImlibContextX11 * x11,
                                       XImage * xim);
 XImage         *__imlib_ProduceXImage(const ImlibContextX11 * x11,
                                       int depth, int w, int h, char *shared);
-XImage         *__imlib_ShmGetXImage(const ImlibContextX11 * x11,
-                                     Drawable draw, int depth,
-                                     int x, int y, int w, int h,
-                                     XShmSegmentInfo * si);
-void            __imlib_ShmDestroyXImage(const ImlibContextX11 * x11,
-                                         XImage * xim, XShmSegmentInfo * si);
+void            __imlib_PutXImage(const ImlibContextX11 * x11, Drawable d,
+                                  GC gc, XImage * xim, int sx, int sy,
+                                  int dx, int dy, int w, int h);
+void            __imlib_SyncXImage(const ImlibContextX11 * x11,
+                                   XImage * xim);
+Pixmap          __imlib_ShmCreatePixmap(const ImlibContextX11 * x11,
+                                        Drawable draw, int w, int h);
+XImage         *__imlib_ShmPixmapXImage(Display * d, Pixmap p);
+int             __imlib_ShmFreePixmap(Display * d, Pixmap p);
+void            __imlib_ShmDisconnect(Display * d);
+XImage         *__imlib_ShmGrabXImage(const ImlibContextX11 * x11, int slot,
+                                      Drawable draw, int depth,
+                                      int x, int y, int w, int h);
+void            __imlib_ShmGrabDone(const ImlibContextX11 * x11, int slot,
+                                    XImage * xim);
 
 #endif                          /* X11_XIMAGE_H */
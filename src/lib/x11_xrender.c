@@ -0,0 +1,312 @@
+#include "common.h"
+
+#ifdef HAVE_X11_XRENDER
+
+#include <math.h>
+#include <stdlib.h>
+#include <X11/Xlib.h>
+#include <X11/extensions/Xrender.h>
+
+#include "image.h"
+#include "stats.h"
+#include "x11_pixmap.h"
+#include "x11_ximage.h"
+#include "x11_xrender.h"
+
+/*
+ * Rendering with the X RENDER extension
+ *
+ * The source image is uploaded once as a premultiplied ARGB32 picture, kept
+ * in the pixmap cache, and composited onto the drawable by the server with
+ * a transform doing the scaling, flipping or skewing. Blending is done by
+ * PictOpOver, so nothing has to be read back from the drawable.
+ */
+
+/* Pixels converted and sent per upload strip */
+#define UPLOAD_STRIP_PIXELS (256 * 1024)
+
+static Display *xr_disp = NULL;
+static char     xr_ok = 0;
+
+/* RENDER >= 0.10 (for RepeatPad) with the standard ARGB32 format */
+static int
+__xrender_check(Display *d)
+{
+    int             event_base, error_base, major, minor;
+
+    if (d == xr_disp)
+        return xr_ok;
+
+    xr_disp = d;
+    xr_ok = XRenderQueryExtension(d, &event_base, &error_base) &&
+        XRenderQueryVersion(d, &major, &minor) &&
+        (major > 0 || minor >= 10) &&
+        XRenderFindStandardFormat(d, PictStandardARGB32);
+
+    return xr_ok;
+}
+
+void
+__imlib_XRenderDisconnect(Display *d)
+{
+    if (d != xr_disp)
+        return;
+    xr_disp = NULL;
+    xr_ok = 0;
+}
+
+/* Premultiply a row of pixels, opaque if the image has no alpha */
+static void
+__upload_row(uint32_t *dst, const uint32_t *src, int w, int has_alpha)
+{
+    uint32_t        p, a, rb, g;
+    int             x;
+
+    if (!has_alpha)
+    {
+        for (x = 0; x < w; x++)
+            dst[x] = src[x] | 0xff000000;
+        return;
+    }
+
+    for (x = 0; x < w; x++)
+    {
+        p = src[x];
+        a = p >> 24;
+        if (a == 0xff)
+        {
+            dst[x] = p;
+            continue;
+        }
+        rb = (p & 0xff00ff) * a + 0x800080;
+        rb = ((rb + ((rb >> 8) & 0xff00ff)) >> 8) & 0xff00ff;
+        g = (p & 0xff00) * a + 0x8000;
+        g = ((g + ((g >> 8) & 0xff00)) >> 8) & 0xff00;
+        dst[x] = (a << 24) | rb | g;
+    }
+}
+
+/* Upload im to a new depth 32 pixmap and its ARGB32 picture */
+int
+__imlib_XRenderUploadImage(const ImlibContextX11 *x11, Drawable w,
+                           ImlibImage *im, Pixmap *p, Picture *pict)
+{
+    XRenderPictFormat *fmt;
+    XImage         *xim;
+    XGCValues       gcv;
+    GC              gc;
+    Pixmap          pmap;
+    int             y, i, hh, strip;
+    char            shm;
+
+    if (!__xrender_check(x11->dpy))
+        return -1;
+    if (im->w > X_MAX_DIM || im->h > X_MAX_DIM)
+        return -1;
+    fmt = XRenderFindStandardFormat(x11->dpy, PictStandardARGB32);
+
+    strip = MAX(1, MIN(im->h, UPLOAD_STRIP_PIXELS / im->w));
+    xim = __imlib_ProduceXImage(x11, 32, im->w, strip, &shm);
+    if (!xim)
+        return -1;
+
+    pmap = XCreatePixmap(x11->dpy, w, im->w, im->h, 32);
+    gcv.graphics_exposures = False;
+    gc = XCreateGC(x11->dpy, pmap, GCGraphicsExposures, &gcv);
+
+    for (y = 0; y < im->h; y += hh)
+    {
+        hh = MIN(strip, im->h - y);
+        /* the previous strip must be sent before it is overwritten */
+        if (y > 0)
+            __imlib_SyncXImage(x11, xim);
+        for (i = 0; i < hh; i++)
+            __upload_row((uint32_t *) (xim->data + i * xim->bytes_per_line),
+                         im->data + (y + i) * im->w, im->w, im->has_alpha);
+        __imlib_PutXImage(x11, pmap, gc, xim, 0, 0, 0, y, im->w, hh);
+    }
+
+    XFreeGC(x11->dpy, gc);
+    STATS_ADD(render_bytes, (uint64_t) im->w * im->h * sizeof(uint32_t));
+    __imlib_ConsumeXImage(x11, xim);
+
+    *p = pmap;
+    *pict = XRenderCreatePicture(x11->dpy, pmap, fmt, 0, NULL);
+
+    return 0;
+}
+
+/* A picture of drawable w, if RENDER can composite onto its visual */
+static Picture
+__xrender_dest(const ImlibContextX11 *x11, Drawable w)
+{
+    XRenderPictFormat *fmt;
+
+    if (!__xrender_check(x11->dpy))
+        return None;
+
+    fmt = XRenderFindVisualFormat(x11->dpy, x11->vis);
+    if (!fmt || fmt->type != PictTypeDirect || fmt->depth != x11->depth)
+        return None;
+
+    return XRenderCreatePicture(x11->dpy, w, fmt, 0, NULL);
+}
+
+static void
+__xrender_composite(Display *d, Picture src, Picture dst,
+                    XTransform *xf, const char *filter, int repeat, int op,
+                    int src_x, int src_y, int dx, int dy, int dw, int dh)
+{
+    XRenderPictureAttributes pa;
+
+    pa.repeat = repeat;
+    XRenderChangePicture(d, src, CPRepeat, &pa);
+    XRenderSetPictureTransform(d, src, xf);
+    XRenderSetPictureFilter(d, src, filter, NULL, 0);
+    XRenderComposite(d, op, src, None, dst, src_x, src_y, 0, 0,
+                     dx, dy, dw, dh);
+}
+
+/* Composite im (sx, sy, sw, sh) scaled to (dx, dy, dw, dh) onto w, flipped
+ * if dw or dh are negative. Returns 0 if done, else the image is to be
+ * rendered client side. */
+int
+__imlib_XRenderImage(const ImlibContextX11 *x11, ImlibImage *im, Drawable w,
+                     int sx, int sy, int sw, int sh,
+                     int dx, int dy, int dw, int dh,
+                     char antialias, char blend)
+{
+    XTransform      xf = { {
+            { XDoubleToFixed(1), 0, 0 },
+            { 0, XDoubleToFixed(1), 0 },
+            { 0, 0, XDoubleToFixed(1) } }
+    };
+    ImlibSpan       span;
+    Picture         src, dst;
+    Pixmap          pmap;
+    const char     *filter;
+    int             src_x, src_y;
+
+    /* Unblended images lose their alpha, premultiplied pictures can't */
+    if (im->has_alpha && !blend)
+        return -1;
+
+    dst = __xrender_dest(x11, w);
+    if (!dst)
+        return -1;
+    __imlib_SpanBegin(&span, SPAN_RENDER, NULL, im->file, abs(dw), abs(dh));
+    if (!__imlib_CreatePictureForImage(x11, w, im, &pmap, &src))
+    {
+        XRenderFreePicture(x11->dpy, dst);
+        __imlib_SpanEnd(&span, -1);
+        return -1;
+    }
+
+    if (sw == dw && sh == dh)
+    {
+        /* Plain copy */
+        filter = FilterNearest;
+        src_x = sx;
+        src_y = sy;
+    }
+    else
+    {
+        /* Sample the centres of the destination pixels */
+        filter = antialias ? FilterBilinear : FilterNearest;
+        src_x = src_y = 0;
+        xf.matrix[0][0] = XDoubleToFixed((double)sw / dw);
+        xf.matrix[0][2] = XDoubleToFixed(dw < 0 ? sx + sw : sx);
+        xf.matrix[1][1] = XDoubleToFixed((double)sh / dh);
+        xf.matrix[1][2] = XDoubleToFixed(dh < 0 ? sy + sh : sy);
+    }
+
+    __xrender_composite(x11->dpy, src, dst, &xf, filter, RepeatPad,
+                        im->has_alpha ? PictOpOver : PictOpSrc,
+                        src_x, src_y, dx, dy, abs(dw), abs(dh));
+
+    XRenderFreePicture(x11->dpy, dst);
+    __imlib_FreePixmap(x11->dpy, pmap);
+    STATS_INC(render_count);
+    __imlib_SpanEnd(&span, 0);
+
+    return 0;
+}
+
+/* Composite im onto w along the vectors (hsx, hsy) and (vsx, vsy) from
+ * (dx, dy), like __imlib_RenderImageSkewed(). Only whole images, the server
+ * would sample their surroundings. */
+int
+__imlib_XRenderImageSkewed(const ImlibContextX11 *x11, ImlibImage *im,
+                           Drawable w, int sx, int sy, int sw, int sh,
+                           int dx, int dy, int hsx, int hsy, int vsx, int vsy,
+                           char antialias)
+{
+    XTransform      xf;
+    ImlibSpan       span;
+    Picture         src, dst;
+    Pixmap          pmap;
+    double          hx, hy, vx, vy, det;
+    int             dx1, dy1, dx2, dy2;
+
+    if (sx != 0 || sy != 0 || sw != im->w || sh != im->h)
+        return -1;
+
+    hx = hsx;
+    hy = hsy;
+    if (vsx || vsy)
+    {
+        vx = vsx;
+        vy = vsy;
+    }
+    else
+    {
+        /* Perpendicular, keeping the aspect ratio */
+        vx = -hy * sh / sw;
+        vy = hx * sh / sw;
+    }
+    det = hx * vy - vx * hy;
+    if (det == 0)
+        return 0;
+
+    dx1 = dx + floor(MIN(hx, 0) + MIN(vx, 0));
+    dy1 = dy + floor(MIN(hy, 0) + MIN(vy, 0));
+    dx2 = dx + ceil(MAX(hx, 0) + MAX(vx, 0));
+    dy2 = dy + ceil(MAX(hy, 0) + MAX(vy, 0));
+    if (dx2 <= 0 || dy2 <= 0 || dx1 >= dx2 || dy1 >= dy2)
+        return 0;
+
+    dst = __xrender_dest(x11, w);
+    if (!dst)
+        return -1;
+    __imlib_SpanBegin(&span, SPAN_RENDER, NULL, im->file,
+                      dx2 - dx1, dy2 - dy1);
+    if (!__imlib_CreatePictureForImage(x11, w, im, &pmap, &src))
+    {
+        XRenderFreePicture(x11->dpy, dst);
+        __imlib_SpanEnd(&span, -1);
+        return -1;
+    }
+
+    /* Inverse of the mapping of the image onto the skew vectors */
+    xf = (XTransform) { {
+            { XDoubleToFixed(sw * vy / det), XDoubleToFixed(-sw * vx / det),
+              XDoubleToFixed(sx) },
+            { XDoubleToFixed(-sh * hy / det), XDoubleToFixed(sh * hx / det),
+              XDoubleToFixed(sy) },
+            { 0, 0, XDoubleToFixed(1) } }
+    };
+
+    __xrender_composite(x11->dpy, src, dst, &xf,
+                        antialias ? FilterBilinear : FilterNearest,
+                        RepeatNone, PictOpOver, dx1 - dx, dy1 - dy,
+                        dx1, dy1, dx2 - dx1, dy2 - dy1);
+
+    XRenderFreePicture(x11->dpy, dst);
+    __imlib_FreePixmap(x11->dpy, pmap);
+    STATS_INC(render_count);
+    __imlib_SpanEnd(&span, 0);
+
+    return 0;
+}
+
+#endif                          /* HAVE_X11_XRENDER */
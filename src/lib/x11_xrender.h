@@ -0,0 +1,33 @@
+#ifndef X11_XRENDER_H
+#define X11_XRENDER_H 1
+
+#ifdef HAVE_X11_XRENDER
+
+#include <X11/Xlib.h>
+#include <X11/extensions/Xrender.h>
+
+#include "types.h"
+#include "x11_types.h"
+
+void            __imlib_XRenderDisconnect(Display * d);
+
+int             __imlib_XRenderUploadImage(const ImlibContextX11 * x11,
+                                           Drawable w, ImlibImage * im,
+                                           Pixmap * p, Picture * pict);
+
+int             __imlib_XRenderImage(const ImlibContextX11 * x11,
+                                     ImlibImage * im, Drawable w,
+                                     int sx, int sy, int sw, int sh,
+                                     int dx, int dy, int dw, int dh,
+                                     char antialias, char blend);
+
+int             __imlib_XRenderImageSkewed(const ImlibContextX11 * x11,
+                                           ImlibImage * im, Drawable w,
+                                           int sx, int sy, int sw, int sh,
+                                           int dx, int dy,
+                                           int hsx, int hsy,
+                                           int vsx, int vsy, char antialias);
+
+#endif                          /* HAVE_X11_XRENDER */
+
+#endif                          /* X11_XRENDER_H */
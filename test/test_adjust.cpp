@@ -0,0 +1,293 @@
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <Imlib2.h>
+
+/*
+ * Whole image HSV/HLS adjustment and grayscale conversion.
+ *
+ * They are done in fixed point, the vector kernels must give the same
+ * pixels as C, and all must be within 2 of converting to HSV or HLS and
+ * back in floating point. Alpha is kept.
+ *
+ * The instruction set tier is picked once per process, so each one is run
+ * in a child. Tiers the CPU lacks are capped to the best one it has.
+ */
+
+static const char *const isas[] = { "c", "avx2", "avx512" };
+
+#define W	67
+#define H	41
+
+static const struct {
+    int             mode;       /* 0: HSV, 1: HLS, 2: gray */
+    float           hue, sat, lum;
+} adjusts[] = {
+    { 0, 0, 1, 1 },
+    { 0, 37, .7, 1.2 },
+    { 0, -200, 2.5, .5 },
+    { 0, 720, 0, 1 },
+    { 1, 0, 1, 1 },
+    { 1, -100, 1.3, 1.1 },
+    { 1, 123.4, .4, .8 },
+    { 1, 60, 3, 2 },
+    { 2, 0, 0, 0 },
+};
+
+#define N_ADJUSTS	((int)(sizeof(adjusts) / sizeof(adjusts[0])))
+#define N_PIXELS	((N_ADJUSTS + 1) * W * H)
+
+static          uint32_t
+_rand(uint32_t *seed)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return *seed >> 16;
+}
+
+/* Random colors, grays and saturated ones every few pixels */
+static void
+_fill(uint32_t *data)
+{
+    uint32_t        seed = 9, px, c;
+    int             i;
+
+    for (i = 0; i < W * H; i++)
+    {
+        px = _rand(&seed) << 16 | _rand(&seed);
+        c = px & 0xff;
+        if (i % 5 == 0)
+            px = (px & 0xff000000) | c << 16 | c << 8 | c;
+        else if (i % 5 == 1)
+            px &= 0xffff00ff;
+        data[i] = px;
+    }
+}
+
+/* Source image, then every adjustment of it */
+static void
+_adjust_all(uint32_t *out)
+{
+    Imlib_Image     im;
+    int             i;
+
+    _fill(out);
+    for (i = 0; i < N_ADJUSTS; i++)
+    {
+        im = imlib_create_image_using_copied_data(W, H, out);
+        imlib_context_set_image(im);
+        imlib_image_set_has_alpha(1);
+        switch (adjusts[i].mode)
+        {
+        case 0:
+            imlib_image_adjust_hsv(adjusts[i].hue, adjusts[i].sat,
+                                   adjusts[i].lum);
+            break;
+        case 1:
+            imlib_image_adjust_hls(adjusts[i].hue, adjusts[i].lum,
+                                   adjusts[i].sat);
+            break;
+        case 2:
+            imlib_image_grayscale();
+            break;
+        }
+        memcpy(out + (i + 1) * W * H, imlib_image_get_data_for_reading_only(),
+               W * H * sizeof(uint32_t));
+        imlib_free_image();
+    }
+}
+
+/* Run all adjustments with the tier capped to isa in a child */
+static bool
+_adjust_isa(const char *isa, uint32_t *out)
+{
+    size_t          len, n;
+    ssize_t         nr;
+    pid_t           pid;
+    int             fd[2], status;
+
+    if (pipe(fd) < 0)
+        return false;
+
+    pid = fork();
+    if (pid < 0)
+        return false;
+
+    if (pid == 0)
+    {
+        close(fd[0]);
+        unsetenv("IMLIB2_ASM_OFF");
+        setenv("IMLIB2_ISA", isa, 1);
+        _adjust_all(out);
+        len = N_PIXELS * sizeof(uint32_t);
+        for (n = 0; n < len; n += nr)
+        {
+            nr = write(fd[1], (char *)out + n, len - n);
+            if (nr <= 0)
+                _exit(1);
+        }
+        _exit(0);
+    }
+
+    close(fd[1]);
+    len = N_PIXELS * sizeof(uint32_t);
+    for (n = 0; n < len; n += nr)
+    {
+        nr = read(fd[0], (char *)out + n, len - n);
+        if (nr <= 0)
+            break;
+    }
+    close(fd[0]);
+
+    if (waitpid(pid, &status, 0) != pid)
+        return false;
+
+    return n == len && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/* Channel of hue h (degrees) for HSV and HLS, as a 0..1 fraction of the
+ * way from the minimum to the maximum */
+static double
+_hue_channel(double h)
+{
+    h = fmod(h, 360);
+    if (h < 0)
+        h += 360;
+    if (h < 60)
+        return h / 60;
+    if (h < 180)
+        return 1;
+    if (h < 240)
+        return (240 - h) / 60;
+    return 0;
+}
+
+/* The adjustment of px in floating point */
+static          uint32_t
+_reference(uint32_t px, int adj)
+{
+    double          r, g, b, mx, mn, d, h, s, v, lo, c[3];
+    int             i;
+
+    r = (px >> 16) & 0xff;
+    g = (px >> 8) & 0xff;
+    b = px & 0xff;
+
+    if (adjusts[adj].mode == 2)
+    {
+        i = lrint(.299 * r + .587 * g + .114 * b);
+        return (px & 0xff000000) | i << 16 | i << 8 | i;
+    }
+
+    mx = std::max(r, std::max(g, b));
+    mn = std::min(r, std::min(g, b));
+    d = mx - mn;
+    h = 0;
+    if (d > 0 && r == mx)
+        h = 60 * (g - b) / d;
+    else if (d > 0 && g == mx)
+        h = 120 + 60 * (b - r) / d;
+    else if (d > 0)
+        h = 240 + 60 * (r - g) / d;
+    h += adjusts[adj].hue;
+
+    if (adjusts[adj].mode == 0)
+    {
+        s = mx > 0 ? d / mx : 0;
+        s = std::min(s * adjusts[adj].sat, 1.);
+        v = std::min(mx * adjusts[adj].lum, 255.);
+        lo = v * (1 - s);
+    }
+    else
+    {
+        v = (mx + mn) / 2;
+        s = (v > 0 && v < 255) ? d / (255 - fabs(2 * v - 255)) : 0;
+        s = std::min(s * adjusts[adj].sat, 1.);
+        v = std::min(v * adjusts[adj].lum, 255.);
+        d = s * (255 - fabs(2 * v - 255));
+        lo = v - d / 2;
+        v = v + d / 2;
+    }
+
+    c[0] = lo + (v - lo) * _hue_channel(h + 120);
+    c[1] = lo + (v - lo) * _hue_channel(h);
+    c[2] = lo + (v - lo) * _hue_channel(h - 120);
+
+    return (px & 0xff000000) | lrint(c[0]) << 16 | lrint(c[1]) << 8 |
+        lrint(c[2]);
+}
+
+static bool
+_near(uint32_t p, uint32_t q, int tolerance)
+{
+    int             i, d;
+
+    if ((p ^ q) >> 24)
+        return false;
+    for (i = 0; i < 24; i += 8)
+    {
+        d = (int)((p >> i) & 0xff) - (int)((q >> i) & 0xff);
+        if (d < -tolerance || d > tolerance)
+            return false;
+    }
+
+    return true;
+}
+
+TEST(ADJUST, isa_tiers_match_c)
+{
+    std::vector<uint32_t> ref(N_PIXELS), out(N_PIXELS);
+    unsigned int    isa;
+    int             i, j;
+
+    ASSERT_TRUE(_adjust_isa(isas[0], ref.data()));
+
+    for (isa = 1; isa < sizeof(isas) / sizeof(isas[0]); isa++)
+    {
+        ASSERT_TRUE(_adjust_isa(isas[isa], out.data())) << "isa=" << isas[isa];
+
+        for (i = 0; i < N_ADJUSTS; i++)
+        {
+            j = memcmp(ref.data() + (i + 1) * W * H,
+                       out.data() + (i + 1) * W * H,
+                       W * H * sizeof(uint32_t));
+            EXPECT_EQ(j, 0) << "isa=" << isas[isa] << " adjust=" << i;
+        }
+    }
+}
+
+TEST(ADJUST, close_to_float)
+{
+    std::vector<uint32_t> out(N_PIXELS);
+    const uint32_t *src, *p;
+    uint32_t        c;
+    int             i, j;
+
+    ASSERT_TRUE(_adjust_isa(isas[0], out.data()));
+
+    src = out.data();
+    for (i = 0; i < N_ADJUSTS; i++)
+    {
+        p = out.data() + (i + 1) * W * H;
+        for (j = 0; j < W * H; j++)
+        {
+            c = _reference(src[j], i);
+            if (_near(p[j], c, 2))
+                continue;
+            ADD_FAILURE() << "adjust=" << i << " x=" << j % W
+                << " y=" << j / W << std::hex << " src=" << src[j]
+                << " c=" << c << " got=" << p[j];
+            break;
+        }
+    }
+
+    /* No change leaves the image as it is */
+    EXPECT_EQ(memcmp(src, out.data() + W * H, W * H * sizeof(uint32_t)), 0);
+    EXPECT_EQ(memcmp(src, out.data() + 5 * W * H, W * H * sizeof(uint32_t)),
+              0);
+}
@@ -0,0 +1,244 @@
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <Imlib2.h>
+
+/*
+ * Every unscaled blend kernel (op x color modifier x blend x merge alpha x
+ * source/destination alpha) is run for each instruction set tier
+ * IMLIB2_ISA can select, and compared with the C tier.
+ *
+ * The AVX2 and AVX-512 kernels must give the same pixels. The SSE2 assembly
+ * (also used by the SSSE3 tier) rounds differently, and its non-blending
+ * color modified ADD/SUBTRACT/RESHADE of RGB sources writes the modified
+ * alpha where C keeps the destination's, so it only has to be within 2 of
+ * C, in the alpha channel only where alpha is merged into an alpha image.
+ *
+ * The tier is picked once per process, so each one is run in a child.
+ * Tiers the CPU lacks are capped to the best one it has.
+ */
+
+static const struct {
+    const char     *name;
+    int             tolerance;  /* Max. channel difference, -1: exact */
+} isas[] = {
+    { "c", -1 },
+    { "sse2", 2 },
+    { "ssse3", 2 },
+    { "avx2", -1 },
+    { "avx512", -1 },
+};
+
+static const char *const op_names[] = {
+    "copy", "add", "subtract", "reshade",
+};
+
+#define W	71
+#define H	5
+
+/* Blended widths, around the 8 and 16 pixel vector steps */
+static const int widths[] = { 1, 3, 7, 8, 9, 15, 16, 17, 31, 33, 64, W };
+
+#define N_WIDTHS	((int)(sizeof(widths) / sizeof(widths[0])))
+#define N_COMBOS	(4 * 2 * 2 * 2 * 2 * 2)
+#define N_PIXELS	(N_COMBOS * N_WIDTHS * W * H)
+
+static          uint32_t
+_rand(uint32_t *seed)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return *seed >> 16;
+}
+
+/* Random colors, with the alpha extremes every few pixels */
+static void
+_fill(Imlib_Image im, uint32_t seed)
+{
+    static const uint32_t alphas[] = { 0x00, 0xff, 0x01, 0xfe, 0x80 };
+    uint32_t       *data;
+    uint32_t        px, a;
+    int             i;
+
+    imlib_context_set_image(im);
+    data = imlib_image_get_data();
+    for (i = 0; i < W * H; i++)
+    {
+        px = _rand(&seed) << 16 | _rand(&seed);
+        a = i % 7 < 5 ? alphas[i % 7] : px >> 24;
+        data[i] = a << 24 | (px & 0xffffff);
+    }
+    imlib_image_put_back_data(data);
+}
+
+static void
+_combo_name(char *buf, size_t len, int combo)
+{
+    snprintf(buf, len,
+             "op=%s cmod=%d blend=%d merge_alpha=%d src_alpha=%d dst_alpha=%d",
+             op_names[combo >> 5], (combo >> 4) & 1, (combo >> 3) & 1,
+             (combo >> 2) & 1, (combo >> 1) & 1, combo & 1);
+}
+
+static void
+_blend_all(uint32_t *out)
+{
+    Imlib_Color_Modifier cm;
+    Imlib_Image     src, dst;
+    uint8_t         r[256], g[256], b[256], a[256];
+    int             combo, i, w;
+
+    /* Non-monotonic tables, so every channel lookup shows */
+    for (i = 0; i < 256; i++)
+    {
+        r[i] = 255 - i;
+        g[i] = (i * 7) & 0xff;
+        b[i] = i ^ 0x5a;
+        a[i] = (i * 3 + 17) & 0xff;
+    }
+    cm = imlib_create_color_modifier();
+    imlib_context_set_color_modifier(cm);
+    imlib_set_color_modifier_tables(r, g, b, a);
+
+    src = imlib_create_image(W, H);
+    dst = imlib_create_image(W, H);
+    _fill(src, 1);
+
+    for (combo = 0; combo < N_COMBOS; combo++)
+    {
+        imlib_context_set_image(src);
+        imlib_image_set_has_alpha((combo >> 1) & 1);
+
+        for (i = 0; i < N_WIDTHS; i++)
+        {
+            w = widths[i];
+            _fill(dst, 2 + i);
+            imlib_context_set_image(dst);
+            imlib_image_set_has_alpha(combo & 1);
+            imlib_context_set_operation((Imlib_Operation) (combo >> 5));
+            imlib_context_set_color_modifier((combo >> 4) & 1 ? cm : NULL);
+            imlib_context_set_blend((combo >> 3) & 1);
+            imlib_blend_image_onto_image(src, (combo >> 2) & 1,
+                                         W - w, 0, w, H,
+                                         (W - w) / 2, 0, w, H);
+            memcpy(out, imlib_image_get_data_for_reading_only(),
+                   W * H * sizeof(uint32_t));
+            out += W * H;
+        }
+    }
+
+    imlib_context_set_image(src);
+    imlib_free_image();
+    imlib_context_set_image(dst);
+    imlib_free_image();
+    imlib_context_set_color_modifier(cm);
+    imlib_free_color_modifier();
+}
+
+static bool
+_pixel_match(uint32_t p, uint32_t q, int tolerance, bool alpha)
+{
+    int             i, d;
+
+    if (tolerance < 0)
+        return p == q;
+
+    for (i = 0; i < (alpha ? 32 : 24); i += 8)
+    {
+        d = (int)((p >> i) & 0xff) - (int)((q >> i) & 0xff);
+        if (d < -tolerance || d > tolerance)
+            return false;
+    }
+
+    return true;
+}
+
+/* Run all blends with the tier capped to isa in a child, collect them */
+static bool
+_blend_isa(const char *isa, uint32_t *out)
+{
+    size_t          len, n;
+    ssize_t         nr;
+    pid_t           pid;
+    int             fd[2], status;
+
+    if (pipe(fd) < 0)
+        return false;
+
+    pid = fork();
+    if (pid < 0)
+        return false;
+
+    if (pid == 0)
+    {
+        close(fd[0]);
+        unsetenv("IMLIB2_ASM_OFF");
+        setenv("IMLIB2_ISA", isa, 1);
+        _blend_all(out);
+        len = N_PIXELS * sizeof(uint32_t);
+        for (n = 0; n < len; n += nr)
+        {
+            nr = write(fd[1], (char *)out + n, len - n);
+            if (nr <= 0)
+                _exit(1);
+        }
+        _exit(0);
+    }
+
+    close(fd[1]);
+    len = N_PIXELS * sizeof(uint32_t);
+    for (n = 0; n < len; n += nr)
+    {
+        nr = read(fd[0], (char *)out + n, len - n);
+        if (nr <= 0)
+            break;
+    }
+    close(fd[0]);
+
+    if (waitpid(pid, &status, 0) != pid)
+        return false;
+
+    return n == len && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+TEST(BLEND, isa_tiers_match_c)
+{
+    std::vector<uint32_t> ref(N_PIXELS), out(N_PIXELS);
+    const uint32_t *p, *q;
+    char            name[128];
+    unsigned int    isa;
+    int             combo, i, j;
+
+    ASSERT_TRUE(_blend_isa(isas[0].name, ref.data()));
+
+    for (isa = 1; isa < sizeof(isas) / sizeof(isas[0]); isa++)
+    {
+        ASSERT_TRUE(_blend_isa(isas[isa].name, out.data()))
+            << "isa=" << isas[isa].name;
+
+        for (combo = 0; combo < N_COMBOS; combo++)
+        {
+            for (i = 0; i < N_WIDTHS; i++)
+            {
+                p = ref.data() + (combo * N_WIDTHS + i) * W * H;
+                q = out.data() + (combo * N_WIDTHS + i) * W * H;
+                for (j = 0; j < W * H &&
+                     _pixel_match(p[j], q[j], isas[isa].tolerance,
+                                  (combo & 5) == 5); j++)
+                    ;
+                if (j == W * H)
+                    continue;
+
+                _combo_name(name, sizeof(name), combo);
+                ADD_FAILURE() << "isa=" << isas[isa].name << " " << name
+                    << " w=" << widths[i] << " x=" << j % W << " y=" << j / W
+                    << std::hex << " c=" << p[j] << " got=" << q[j];
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,295 @@
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <Imlib2.h>
+
+/*
+ * imlib_image_draw_list() must give the same pixels as drawing the
+ * primitives one by one. Each primitive gets a random color, operation,
+ * blend, anti-alias and line width. They are drawn onto images with and
+ * without alpha, with and without a cliprect.
+ *
+ * The thread count is picked once per process, so it is all done in a
+ * child, single threaded and with threads.
+ */
+
+#define W	211
+#define H	263
+#define N_PRIMS	300
+#define N_COMBOS	4
+#define N_PIXELS	(2 * N_COMBOS * W * H)
+
+enum {
+    PRIM_PIXEL, PRIM_LINE, PRIM_POLYLINE, PRIM_RECT, PRIM_FILL_RECT,
+    PRIM_ELLIPSE, PRIM_FILL_ELLIPSE, PRIM_POLYGON, PRIM_FILL_POLYGON,
+    N_PRIM_KINDS
+};
+
+static          uint32_t
+_rand(uint32_t *seed)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return *seed >> 16;
+}
+
+/* Random colors, with the alpha extremes every few pixels */
+static void
+_fill(Imlib_Image im, uint32_t seed)
+{
+    static const uint32_t alphas[] = { 0x00, 0xff, 0x01, 0xfe, 0x80 };
+    uint32_t       *data;
+    uint32_t        px, a;
+    int             i;
+
+    imlib_context_set_image(im);
+    data = imlib_image_get_data();
+    for (i = 0; i < W * H; i++)
+    {
+        px = _rand(&seed) << 16 | _rand(&seed);
+        a = i % 7 < 5 ? alphas[i % 7] : px >> 24;
+        data[i] = a << 24 | (px & 0xffffff);
+    }
+    imlib_image_put_back_data(data);
+}
+
+/* A coordinate, a little beyond the image at times */
+static int
+_coord(uint32_t *seed, int max)
+{
+    return (int)(_rand(seed) % (max + 40)) - 20;
+}
+
+/* Draw the primitives, or add them to dl if set */
+static void
+_prims(Imlib_Draw_List dl)
+{
+    static const uint32_t alphas[] = { 0xff, 0x80, 0x28 };
+    ImlibPolygon    poly;
+    uint32_t        seed = 5;
+    int             xy[16];
+    int             i, j, n, kind;
+    double          width;
+
+    for (i = 0; i < N_PRIMS; i++)
+    {
+        kind = _rand(&seed) % N_PRIM_KINDS;
+        imlib_context_set_color(_rand(&seed) & 0xff, _rand(&seed) & 0xff,
+                                _rand(&seed) & 0xff,
+                                alphas[_rand(&seed) % 3]);
+        imlib_context_set_operation((Imlib_Operation) (_rand(&seed) % 4));
+        imlib_context_set_blend(_rand(&seed) % 4 != 0);
+        imlib_context_set_anti_alias(_rand(&seed) & 1);
+        width = (_rand(&seed) % 3) * 1.75;
+        imlib_context_set_line_width(width);
+        imlib_context_set_line_cap((Imlib_Line_Cap) (_rand(&seed) % 3));
+
+        n = 2 + _rand(&seed) % 7;
+        for (j = 0; j < 2 * n; j += 2)
+        {
+            xy[j] = _coord(&seed, W);
+            xy[j + 1] = _coord(&seed, H);
+        }
+
+        switch (kind)
+        {
+        case PRIM_PIXEL:
+            if (dl)
+                imlib_draw_list_draw_pixel(dl, xy[0], xy[1]);
+            else
+                imlib_image_draw_pixel(xy[0], xy[1], 0);
+            break;
+        case PRIM_LINE:
+            if (dl)
+                imlib_draw_list_draw_line(dl, xy[0], xy[1], xy[2], xy[3]);
+            else
+                imlib_image_draw_line(xy[0], xy[1], xy[2], xy[3], 0);
+            break;
+        case PRIM_POLYLINE:
+            if (dl)
+            {
+                imlib_draw_list_draw_polyline(dl, xy, n, i & 1);
+                break;
+            }
+            /* Two points are not closed, that would draw the line twice */
+            for (j = 0; j < n - 1 + ((i & 1) && n > 2); j++)
+                imlib_image_draw_line(xy[2 * j], xy[2 * j + 1],
+                                      xy[2 * ((j + 1) % n)],
+                                      xy[2 * ((j + 1) % n) + 1], 0);
+            break;
+        case PRIM_RECT:
+        case PRIM_FILL_RECT:
+            xy[2] = xy[2] % 90;
+            xy[3] = xy[3] % 90;
+            if (dl && kind == PRIM_RECT)
+                imlib_draw_list_draw_rectangle(dl, xy[0], xy[1],
+                                               xy[2], xy[3]);
+            else if (dl)
+                imlib_draw_list_fill_rectangle(dl, xy[0], xy[1],
+                                               xy[2], xy[3]);
+            else if (kind == PRIM_RECT)
+                imlib_image_draw_rectangle(xy[0], xy[1], xy[2], xy[3]);
+            else
+                imlib_image_fill_rectangle(xy[0], xy[1], xy[2], xy[3]);
+            break;
+        case PRIM_ELLIPSE:
+        case PRIM_FILL_ELLIPSE:
+            xy[2] = abs(xy[2]) % 60;
+            xy[3] = abs(xy[3]) % 60;
+            if (dl && kind == PRIM_ELLIPSE)
+                imlib_draw_list_draw_ellipse(dl, xy[0], xy[1], xy[2], xy[3]);
+            else if (dl)
+                imlib_draw_list_fill_ellipse(dl, xy[0], xy[1], xy[2], xy[3]);
+            else if (kind == PRIM_ELLIPSE)
+                imlib_image_draw_ellipse(xy[0], xy[1], xy[2], xy[3]);
+            else
+                imlib_image_fill_ellipse(xy[0], xy[1], xy[2], xy[3]);
+            break;
+        case PRIM_POLYGON:
+        case PRIM_FILL_POLYGON:
+            poly = imlib_polygon_new();
+            for (j = 0; j < 2 * n; j += 2)
+                imlib_polygon_add_point(poly, xy[j], xy[j + 1]);
+            if (dl && kind == PRIM_POLYGON)
+                imlib_draw_list_draw_polygon(dl, poly, i & 1);
+            else if (dl)
+                imlib_draw_list_fill_polygon(dl, poly);
+            else if (kind == PRIM_POLYGON)
+                imlib_image_draw_polygon(poly, i & 1);
+            else
+                imlib_image_fill_polygon(poly);
+            imlib_polygon_free(poly);
+            break;
+        }
+    }
+
+    imlib_context_set_line_width(0);
+    imlib_context_set_operation(IMLIB_OP_COPY);
+    imlib_context_set_blend(1);
+    imlib_context_set_anti_alias(1);
+}
+
+/* Draw the primitives listed and one by one, for all combos */
+static void
+_draw_all(uint32_t *out)
+{
+    Imlib_Draw_List dl;
+    Imlib_Image     im;
+    int             combo, pass;
+
+    im = imlib_create_image(W, H);
+    dl = imlib_draw_list_new();
+
+    for (combo = 0; combo < N_COMBOS; combo++)
+    {
+        for (pass = 0; pass < 2; pass++)
+        {
+            _fill(im, 11 + combo);
+            imlib_context_set_image(im);
+            imlib_image_set_has_alpha(combo >> 1);
+            if (combo & 1)
+                imlib_context_set_cliprect(17, 29, W - 50, H - 70);
+            else
+                imlib_context_set_cliprect(0, 0, 0, 0);
+
+            if (pass == 0)
+            {
+                imlib_draw_list_clear(dl);
+                _prims(dl);
+                imlib_image_draw_list(dl);
+            }
+            else
+            {
+                _prims(NULL);
+            }
+
+            memcpy(out, imlib_image_get_data_for_reading_only(),
+                   W * H * sizeof(uint32_t));
+            out += W * H;
+        }
+    }
+
+    imlib_draw_list_free(dl);
+    imlib_free_image();
+}
+
+/* Draw everything with threads threads in a child, collect it */
+static bool
+_draw_threads(const char *threads, uint32_t *out)
+{
+    size_t          len, n;
+    ssize_t         nr;
+    pid_t           pid;
+    int             fd[2], status;
+
+    if (pipe(fd) < 0)
+        return false;
+
+    pid = fork();
+    if (pid < 0)
+        return false;
+
+    if (pid == 0)
+    {
+        close(fd[0]);
+        setenv("IMLIB2_THREADS", threads, 1);
+        _draw_all(out);
+        len = N_PIXELS * sizeof(uint32_t);
+        for (n = 0; n < len; n += nr)
+        {
+            nr = write(fd[1], (char *)out + n, len - n);
+            if (nr <= 0)
+                _exit(1);
+        }
+        _exit(0);
+    }
+
+    close(fd[1]);
+    len = N_PIXELS * sizeof(uint32_t);
+    for (n = 0; n < len; n += nr)
+    {
+        nr = read(fd[0], (char *)out + n, len - n);
+        if (nr <= 0)
+            break;
+    }
+    close(fd[0]);
+
+    if (waitpid(pid, &status, 0) != pid)
+        return false;
+
+    return n == len && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+TEST(DRAW_LIST, draw_list_matches_one_by_one)
+{
+    static const char *const threads[] = { "1", "4" };
+    std::vector<uint32_t> out(N_PIXELS);
+    const uint32_t *p, *q;
+    unsigned int    t;
+    int             combo, j;
+
+    for (t = 0; t < sizeof(threads) / sizeof(threads[0]); t++)
+    {
+        ASSERT_TRUE(_draw_threads(threads[t], out.data()))
+            << "threads=" << threads[t];
+
+        for (combo = 0; combo < N_COMBOS; combo++)
+        {
+            p = out.data() + (2 * combo + 1) * W * H;
+            q = out.data() + 2 * combo * W * H;
+            for (j = 0; j < W * H && p[j] == q[j]; j++)
+                ;
+            if (j == W * H)
+                continue;
+
+            ADD_FAILURE() << "threads=" << threads[t]
+                << " dst_alpha=" << (combo >> 1) << " clip=" << (combo & 1)
+                << " x=" << j % W << " y=" << j / W
+                << std::hex << " c=" << p[j] << " got=" << q[j];
+        }
+    }
+}
@@ -0,0 +1,174 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+#include <Imlib2.h>
+
+/*
+ * imlib_polygon_contains_points() against a plain test of every edge, for
+ * polygons small enough to be tested edge by edge and large enough to be
+ * indexed, also after points are added to an indexed one.
+ * Points on an edge are inside.
+ */
+
+#define GRID	160
+
+typedef struct {
+    int             x, y;
+} point_t;
+
+/* As the library tests an edge: -1 on it, 1 if a ray towards +x crosses */
+static int
+_edge_test(const point_t *a, const point_t *b, int x, int y)
+{
+    int64_t         d;
+
+    if (x >= std::min(a->x, b->x) && x <= std::max(a->x, b->x) &&
+        y >= std::min(a->y, b->y) && y <= std::max(a->y, b->y) &&
+        (int64_t)(b->x - a->x) * (y - a->y) ==
+        (int64_t)(b->y - a->y) * (x - a->x))
+        return -1;
+
+    if ((a->y > y) == (b->y > y))
+        return 0;
+
+    d = (int64_t)(a->x - x) * (b->y - a->y) +
+        (int64_t)(y - a->y) * (b->x - a->x);
+
+    return (b->y > a->y) ? d > 0 : d < 0;
+}
+
+static bool
+_contains(const std::vector<point_t> &pts, int x, int y)
+{
+    int             i, r, count;
+
+    count = 0;
+    for (i = 0; i < (int)pts.size(); i++)
+    {
+        r = _edge_test(&pts[i], &pts[(i + 1) % pts.size()], x, y);
+        if (r < 0)
+            return true;
+        count ^= r;
+    }
+
+    return count;
+}
+
+/* Test all points of the grid, one by one and batched */
+static void
+_check(ImlibPolygon poly, const std::vector<point_t> &pts, const char *name)
+{
+    std::vector<int> xy(2 * GRID * GRID);
+    std::vector<unsigned char> inside(GRID * GRID);
+    int             i, x, y, n, r, ref;
+
+    for (i = 0; i < GRID * GRID; i++)
+    {
+        xy[2 * i] = i % GRID - 5;
+        xy[2 * i + 1] = i / GRID - 5;
+    }
+
+    n = imlib_polygon_contains_points(poly, xy.data(), GRID * GRID,
+                                      inside.data());
+
+    for (i = ref = 0; i < GRID * GRID; i++)
+    {
+        x = xy[2 * i];
+        y = xy[2 * i + 1];
+        r = _contains(pts, x, y);
+        ref += r;
+        ASSERT_EQ(!!inside[i], r)
+            << name << " x=" << x << " y=" << y;
+        ASSERT_EQ(!!imlib_polygon_contains_point(poly, x, y), !!inside[i])
+            << name << " x=" << x << " y=" << y;
+    }
+    EXPECT_EQ(n, ref) << name;
+}
+
+static          ImlibPolygon
+_polygon(const std::vector<point_t> &pts)
+{
+    ImlibPolygon    poly;
+
+    poly = imlib_polygon_new();
+    for (const point_t &p: pts)
+        imlib_polygon_add_point(poly, p.x, p.y);
+
+    return poly;
+}
+
+/* A self-intersecting star with n spikes */
+static          std::vector<point_t>
+_star(int n)
+{
+    std::vector<point_t> pts;
+    double          a, r;
+    int             i;
+
+    for (i = 0; i < 2 * n; i++)
+    {
+        a = i * M_PI / n;
+        r = (i & 1) ? 20 : 70;
+        pts.push_back({ 75 + (int)lrint(r * cos(a)),
+                        75 + (int)lrint(r * sin(a)) });
+    }
+    for (i = 0; i < 2 * n; i += 7)
+        std::swap(pts[i], pts[(i * 5 + 3) % (2 * n)]);
+
+    return pts;
+}
+
+/* Square teeth, with horizontal and vertical edges */
+static          std::vector<point_t>
+_comb(int n)
+{
+    std::vector<point_t> pts;
+    int             i;
+
+    for (i = 0; i < n; i++)
+    {
+        pts.push_back({ 4 * i, (i & 1) ? 10 : 30 });
+        pts.push_back({ 4 * i + 4, (i & 1) ? 10 : 30 });
+    }
+    pts.push_back({ 4 * n, 140 });
+    pts.push_back({ 0, 140 });
+
+    return pts;
+}
+
+TEST(POLYGON, contains_points)
+{
+    const struct {
+        const char     *name;
+        std::vector<point_t> pts;
+    } polys[] = {
+        { "triangle", { { 3, 2 }, { 130, 60 }, { 40, 148 } } },
+        { "star 5", _star(5) },
+        { "star 90", _star(90) },
+        { "comb 36", _comb(36) },
+    };
+    ImlibPolygon    poly;
+    std::vector<point_t> pts;
+
+    for (const auto &p: polys)
+    {
+        poly = _polygon(p.pts);
+        _check(poly, p.pts, p.name);
+        imlib_polygon_free(poly);
+    }
+
+    /* Adding points to an indexed polygon */
+    pts = _star(40);
+    poly = _polygon(pts);
+    _check(poly, pts, "star 40");
+    for (const point_t &q: _comb(10))
+    {
+        imlib_polygon_add_point(poly, q.x, q.y);
+        pts.push_back(q);
+    }
+    _check(poly, pts, "star 40 + comb 10");
+    imlib_polygon_free(poly);
+}
@@ -0,0 +1,194 @@
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+#include <math.h>
+#include <Imlib2.h>
+
+/*
+ * Wide lines and arcs are filled with area coverage, exact where edges
+ * don't overlap within a pixel, so the summed coverage of a stroke drawn
+ * in opaque white on black is its area, up to the flattening of curves.
+ */
+
+#define W	128
+#define H	128
+
+typedef struct {
+    double          area;
+    int             x0, y0, x1, y1;     /* Bounds of the drawn pixels */
+} coverage_t;
+
+static          Imlib_Image
+_black(void)
+{
+    Imlib_Image     im;
+
+    im = imlib_create_image(W, H);
+    imlib_context_set_image(im);
+    imlib_image_set_has_alpha(0);
+    imlib_context_set_color(0, 0, 0, 255);
+    imlib_context_set_cliprect(0, 0, 0, 0);
+    imlib_context_set_operation(IMLIB_OP_COPY);
+    imlib_context_set_blend(0);
+    imlib_image_fill_rectangle(0, 0, W, H);
+
+    imlib_context_set_color(255, 255, 255, 255);
+    imlib_context_set_blend(1);
+    imlib_context_set_anti_alias(1);
+
+    return im;
+}
+
+static          coverage_t
+_coverage(Imlib_Image im)
+{
+    const uint32_t *data;
+    coverage_t      cov = { 0, W, H, -1, -1 };
+    int             x, y, v;
+
+    imlib_context_set_image(im);
+    data = imlib_image_get_data_for_reading_only();
+    for (y = 0; y < H; y++)
+    {
+        for (x = 0; x < W; x++)
+        {
+            v = (data[y * W + x] >> 16) & 0xff;
+            if (!v)
+                continue;
+            cov.area += v / 255.;
+            cov.x0 = std::min(cov.x0, x);
+            cov.y0 = std::min(cov.y0, y);
+            cov.x1 = std::max(cov.x1, x);
+            cov.y1 = std::max(cov.y1, y);
+        }
+    }
+    imlib_free_image();
+
+    return cov;
+}
+
+/* Rounding of the 8 bit coverage, and the curve flattening */
+#define EXPECT_AREA(cov, expect) \
+    EXPECT_NEAR((cov).area, (expect), 0.5 + 0.005 * (expect))
+
+TEST(STROKE, line_width_and_cap)
+{
+    imlib_context_set_line_width(2.5);
+    EXPECT_EQ(imlib_context_get_line_width(), 2.5);
+    imlib_context_set_line_cap(IMLIB_LINE_CAP_SQUARE);
+    EXPECT_EQ(imlib_context_get_line_cap(), IMLIB_LINE_CAP_SQUARE);
+    imlib_context_set_line_width(0);
+    imlib_context_set_line_cap(IMLIB_LINE_CAP_BUTT);
+}
+
+TEST(STROKE, wide_lines)
+{
+    static const struct {
+        Imlib_Line_Cap  cap;
+        double          area;
+    } caps[] = {
+        { IMLIB_LINE_CAP_BUTT, 50 * 6 },
+        { IMLIB_LINE_CAP_ROUND, 50 * 6 + M_PI * 3 * 3 },
+        { IMLIB_LINE_CAP_SQUARE, 56 * 6 },
+    };
+    coverage_t      cov;
+
+    imlib_context_set_line_width(6);
+    for (const auto &c: caps)
+    {
+        imlib_context_set_line_cap(c.cap);
+
+        _black();
+        imlib_image_draw_line(20, 30, 70, 30, 0);
+        cov = _coverage(imlib_context_get_image());
+        EXPECT_AREA(cov, c.area) << "cap=" << c.cap;
+
+        /* Diagonal, the same area */
+        _black();
+        imlib_image_draw_line(20, 20, 50, 60, 0);
+        cov = _coverage(imlib_context_get_image());
+        EXPECT_AREA(cov, c.area) << "cap=" << c.cap << " diagonal";
+    }
+    imlib_context_set_line_width(0);
+    imlib_context_set_line_cap(IMLIB_LINE_CAP_BUTT);
+}
+
+TEST(STROKE, arcs)
+{
+    coverage_t      cov;
+
+    imlib_context_set_line_width(4);
+    imlib_context_set_line_cap(IMLIB_LINE_CAP_BUTT);
+
+    /* Ring */
+    _black();
+    imlib_image_draw_ellipse(64, 64, 30, 30);
+    cov = _coverage(imlib_context_get_image());
+    EXPECT_AREA(cov, M_PI * (32 * 32 - 28 * 28));
+
+    _black();
+    imlib_image_draw_arc(64, 64, 30, 30, 0, 360);
+    cov = _coverage(imlib_context_get_image());
+    EXPECT_AREA(cov, M_PI * (32 * 32 - 28 * 28));
+
+    /* Lower half, clockwise from the positive x axis */
+    _black();
+    imlib_image_draw_arc(64, 64, 30, 30, 0, 180);
+    cov = _coverage(imlib_context_get_image());
+    EXPECT_AREA(cov, M_PI * (32 * 32 - 28 * 28) / 2);
+    EXPECT_GE(cov.y0, 63);
+
+    /* Angles wrap */
+    _black();
+    imlib_image_draw_arc(64, 64, 30, 30, 270, 0);
+    cov = _coverage(imlib_context_get_image());
+    EXPECT_AREA(cov, M_PI * (32 * 32 - 28 * 28) / 4);
+    EXPECT_GE(cov.x0, 63);
+    EXPECT_LE(cov.y1, 64);
+
+    imlib_context_set_line_width(0);
+}
+
+TEST(STROKE, flat_arcs)
+{
+    coverage_t      cov;
+
+    imlib_context_set_line_width(4);
+    imlib_context_set_line_cap(IMLIB_LINE_CAP_BUTT);
+
+    /* A quarter covers the axis from the center to the end */
+    _black();
+    imlib_image_draw_arc(64, 64, 30, 0, 0, 90);
+    cov = _coverage(imlib_context_get_image());
+    EXPECT_AREA(cov, 30 * 4);
+    EXPECT_GE(cov.x0, 63);
+
+    _black();
+    imlib_image_draw_arc(64, 64, 0, 30, 0, 90);
+    cov = _coverage(imlib_context_get_image());
+    EXPECT_AREA(cov, 30 * 4);
+    EXPECT_GE(cov.y0, 63);
+
+    /* With the cap */
+    imlib_context_set_line_cap(IMLIB_LINE_CAP_SQUARE);
+    _black();
+    imlib_image_draw_arc(64, 64, 30, 0, 0, 90);
+    cov = _coverage(imlib_context_get_image());
+    EXPECT_AREA(cov, 34 * 4);
+
+    /* Turning back at the end of the axis, round there */
+    imlib_context_set_line_cap(IMLIB_LINE_CAP_BUTT);
+    _black();
+    imlib_image_draw_arc(64, 64, 30, 0, -60, 60);
+    cov = _coverage(imlib_context_get_image());
+    EXPECT_AREA(cov, 15 * 4 + M_PI * 2 * 2 / 2);
+    EXPECT_GE(cov.x0, 78);
+
+    /* Whole axis, round */
+    _black();
+    imlib_image_draw_ellipse(64, 64, 30, 0);
+    cov = _coverage(imlib_context_get_image());
+    EXPECT_AREA(cov, 60 * 4 + M_PI * 2 * 2);
+
+    imlib_context_set_line_width(0);
+}
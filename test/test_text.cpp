@@ -0,0 +1,332 @@
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <Imlib2.h>
+
+/*
+ * imlib_text_draw_items() must give the same pixels as drawing the items
+ * one by one with imlib_text_draw(), for every operation, with opaque and
+ * translucent colors, onto images with and without alpha, with and
+ * without a cliprect.
+ *
+ * The thread count is picked once per process, so the batch is drawn in a
+ * child, both single threaded (item by item) and with threads (band by
+ * band). The image is tall enough for the bands to be split up.
+ */
+
+static const char *const op_names[] = {
+    "copy", "add", "subtract", "reshade",
+};
+
+static const uint32_t col_alphas[] = { 0xff, 0x80, 0x28 };
+
+static const char *const fonts[] = {
+    "notepad/11", "grunge/17", "morpheus/23", "cinema/14",
+};
+
+static const char *const texts[] = {
+    "Imlib2", "fjord jiggle", "WAVY", "x", "Hello, world!", "(123) 456",
+    "ffff jjjj ffff", "A.V.A.W.", "kerning", "labels",
+};
+
+#define W	167
+#define H	300
+#define N_ITEMS	64
+
+#define N_COL_ALPHAS	((int)(sizeof(col_alphas) / sizeof(col_alphas[0])))
+#define N_FONTS		((int)(sizeof(fonts) / sizeof(fonts[0])))
+#define N_TEXTS		((int)(sizeof(texts) / sizeof(texts[0])))
+#define N_COMBOS	(4 * N_COL_ALPHAS * 2 * 2)
+#define N_PIXELS	(2 * N_COMBOS * W * H)
+
+static          uint32_t
+_rand(uint32_t *seed)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return *seed >> 16;
+}
+
+/* Random colors, with the alpha extremes every few pixels */
+static void
+_fill(Imlib_Image im, uint32_t seed)
+{
+    static const uint32_t alphas[] = { 0x00, 0xff, 0x01, 0xfe, 0x80 };
+    uint32_t       *data;
+    uint32_t        px, a;
+    int             i;
+
+    imlib_context_set_image(im);
+    data = imlib_image_get_data();
+    for (i = 0; i < W * H; i++)
+    {
+        px = _rand(&seed) << 16 | _rand(&seed);
+        a = i % 7 < 5 ? alphas[i % 7] : px >> 24;
+        data[i] = a << 24 | (px & 0xffffff);
+    }
+    imlib_image_put_back_data(data);
+}
+
+static void
+_combo_name(char *buf, size_t len, int combo)
+{
+    snprintf(buf, len, "op=%s col_alpha=%#x dst_alpha=%d clip=%d",
+             op_names[combo / (N_COL_ALPHAS * 4)],
+             col_alphas[(combo / 4) % N_COL_ALPHAS], (combo >> 1) & 1,
+             combo & 1);
+}
+
+/* Overlapping items, some partly off the image */
+static void
+_items(Imlib_Text_Item *items, Imlib_Font *fn, uint32_t alpha)
+{
+    uint32_t        seed = 3;
+    int             i;
+
+    for (i = 0; i < N_ITEMS; i++)
+    {
+        items[i].font = fn[_rand(&seed) % N_FONTS];
+        items[i].color = alpha << 24 | (_rand(&seed) << 8 ^ _rand(&seed));
+        items[i].x = (int)(_rand(&seed) % (W + 40)) - 30;
+        items[i].y = (int)(_rand(&seed) % (H + 30)) - 20;
+        items[i].text = texts[_rand(&seed) % N_TEXTS];
+        items[i].direction = IMLIB_TEXT_TO_RIGHT;
+    }
+}
+
+/* Draw the items batched and one by one, for all combos */
+static bool
+_draw_all(uint32_t *out)
+{
+    Imlib_Text_Item items[N_ITEMS];
+    Imlib_Font      fn[N_FONTS];
+    Imlib_Image     im;
+    uint32_t        c;
+    int             combo, i, pass;
+
+    imlib_add_path_to_font_path(SRCDIR "/data/fonts");
+    for (i = 0; i < N_FONTS; i++)
+    {
+        fn[i] = imlib_load_font(fonts[i]);
+        if (!fn[i])
+            return false;
+    }
+
+    im = imlib_create_image(W, H);
+    imlib_context_set_image(im);
+    imlib_context_set_direction(IMLIB_TEXT_TO_RIGHT);
+
+    for (combo = 0; combo < N_COMBOS; combo++)
+    {
+        _items(items, fn, col_alphas[(combo / 4) % N_COL_ALPHAS]);
+        imlib_context_set_operation((Imlib_Operation)
+                                    (combo / (N_COL_ALPHAS * 4)));
+
+        for (pass = 0; pass < 2; pass++)
+        {
+            _fill(im, 7 + combo);
+            imlib_context_set_image(im);
+            imlib_image_set_has_alpha((combo >> 1) & 1);
+            if (combo & 1)
+                imlib_context_set_cliprect(13, 37, W - 40, H - 90);
+            else
+                imlib_context_set_cliprect(0, 0, 0, 0);
+
+            if (pass == 0)
+            {
+                imlib_text_draw_items(items, N_ITEMS);
+            }
+            else
+            {
+                for (i = 0; i < N_ITEMS; i++)
+                {
+                    c = items[i].color;
+                    imlib_context_set_font(items[i].font);
+                    imlib_context_set_color((c >> 16) & 0xff,
+                                            (c >> 8) & 0xff, c & 0xff,
+                                            c >> 24);
+                    imlib_text_draw(items[i].x, items[i].y, items[i].text);
+                }
+            }
+
+            memcpy(out, imlib_image_get_data_for_reading_only(),
+                   W * H * sizeof(uint32_t));
+            out += W * H;
+        }
+    }
+
+    imlib_free_image();
+    for (i = 0; i < N_FONTS; i++)
+    {
+        imlib_context_set_font(fn[i]);
+        imlib_free_font();
+    }
+
+    return true;
+}
+
+/* Draw everything with threads threads in a child, collect it */
+static bool
+_draw_threads(const char *threads, uint32_t *out)
+{
+    size_t          len, n;
+    ssize_t         nr;
+    pid_t           pid;
+    int             fd[2], status;
+
+    if (pipe(fd) < 0)
+        return false;
+
+    pid = fork();
+    if (pid < 0)
+        return false;
+
+    if (pid == 0)
+    {
+        close(fd[0]);
+        setenv("IMLIB2_THREADS", threads, 1);
+        if (!_draw_all(out))
+            _exit(1);
+        len = N_PIXELS * sizeof(uint32_t);
+        for (n = 0; n < len; n += nr)
+        {
+            nr = write(fd[1], (char *)out + n, len - n);
+            if (nr <= 0)
+                _exit(1);
+        }
+        _exit(0);
+    }
+
+    close(fd[1]);
+    len = N_PIXELS * sizeof(uint32_t);
+    for (n = 0; n < len; n += nr)
+    {
+        nr = read(fd[0], (char *)out + n, len - n);
+        if (nr <= 0)
+            break;
+    }
+    close(fd[0]);
+
+    if (waitpid(pid, &status, 0) != pid)
+        return false;
+
+    return n == len && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+TEST(TEXT, draw_items_match_text_draw)
+{
+    static const char *const threads[] = { "1", "4" };
+    std::vector<uint32_t> out(N_PIXELS);
+    const uint32_t *p, *q;
+    char            name[128];
+    unsigned int    t;
+    int             combo, j;
+
+    for (t = 0; t < sizeof(threads) / sizeof(threads[0]); t++)
+    {
+        ASSERT_TRUE(_draw_threads(threads[t], out.data()))
+            << "threads=" << threads[t];
+
+        for (combo = 0; combo < N_COMBOS; combo++)
+        {
+            p = out.data() + (2 * combo + 1) * W * H;
+            q = out.data() + 2 * combo * W * H;
+            for (j = 0; j < W * H && p[j] == q[j]; j++)
+                ;
+            if (j == W * H)
+                continue;
+
+            _combo_name(name, sizeof(name), combo);
+            ADD_FAILURE() << "threads=" << threads[t] << " " << name
+                << " x=" << j % W << " y=" << j / W
+                << std::hex << " c=" << p[j] << " got=" << q[j];
+        }
+    }
+}
+
+/* Draw text onto a cleared image, with a run if run is set */
+static void
+_draw_text(Imlib_Image im, Imlib_Text_Run run, const char *text,
+           uint32_t *out)
+{
+    imlib_context_set_image(im);
+    imlib_image_clear();
+    imlib_context_set_color(200, 100, 50, 255);
+    if (run)
+        imlib_text_run_draw(run, 3, 2);
+    else
+        imlib_text_draw(3, 2, text);
+    memcpy(out, imlib_image_get_data_for_reading_only(),
+           W * 40 * sizeof(uint32_t));
+}
+
+/*
+ * Text runs measure and draw as the plain calls do, also after the font
+ * cache is flushed (dropping the glyphs and cached runs), and after the
+ * fallback chain changes.
+ */
+TEST(TEXT, runs_match_text)
+{
+    std::vector<uint32_t> ref(W * 40), out(W * 40);
+    Imlib_Font      fn, fb;
+    Imlib_Text_Run  run;
+    Imlib_Image     im;
+    int             i, pass, m[4], mr[4], m0[4];
+
+    imlib_add_path_to_font_path(SRCDIR "/data/fonts");
+    fn = imlib_load_font("notepad/15");
+    fb = imlib_load_font("grunge/13");
+    ASSERT_TRUE(fn && fb);
+    im = imlib_create_image(W, 40);
+    imlib_context_set_operation(IMLIB_OP_COPY);
+    imlib_context_set_cliprect(0, 0, 0, 0);
+    imlib_context_set_direction(IMLIB_TEXT_TO_RIGHT);
+
+    for (i = 0; i < N_TEXTS; i++)
+    {
+        imlib_context_set_font(fn);
+        run = imlib_text_run_new(texts[i]);
+        ASSERT_TRUE(run != NULL);
+
+        for (pass = 0; pass < 3; pass++)
+        {
+            if (pass == 1)
+                imlib_flush_font_cache();
+            if (pass == 2)
+                imlib_insert_font_into_fallback_chain(fn, fb);
+
+            imlib_context_set_font(fn);
+            imlib_get_text_size(texts[i], &m[0], &m[1]);
+            imlib_get_text_advance(texts[i], &m[2], &m[3]);
+            imlib_text_run_get_size(run, &mr[0], &mr[1]);
+            imlib_text_run_get_advance(run, &mr[2], &mr[3]);
+            EXPECT_EQ(memcmp(m, mr, sizeof(m)), 0)
+                << "text=" << texts[i] << " pass=" << pass;
+            if (pass == 0)
+                memcpy(m0, m, sizeof(m));
+            else
+                EXPECT_EQ(memcmp(m, m0, sizeof(m)), 0)
+                    << "text=" << texts[i] << " pass=" << pass;
+
+            _draw_text(im, NULL, texts[i], ref.data());
+            _draw_text(im, run, texts[i], out.data());
+            EXPECT_EQ(memcmp(ref.data(), out.data(),
+                             W * 40 * sizeof(uint32_t)), 0)
+                << "text=" << texts[i] << " pass=" << pass;
+        }
+
+        imlib_remove_font_from_fallback_chain(fb);
+        imlib_text_run_free(run);
+    }
+
+    imlib_context_set_image(im);
+    imlib_free_image();
+    imlib_context_set_font(fn);
+    imlib_free_font();
+    imlib_context_set_font(fb);
+    imlib_free_font();
+}
@@ -0,0 +1,441 @@
+#include <gtest/gtest.h>
+
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <X11/Xlib.h>
+#include <Imlib2.h>
+
+/*
+ * Rendering to and grabbing from an X server. $DISPLAY is used if set,
+ * otherwise an Xvfb is started if there is one. The tests are skipped when
+ * there is no server.
+ */
+
+#define W	93
+#define H	61
+
+/* Scaled renders, in enough bands for threads */
+#define PW	300
+#define PH	480
+
+static Display *disp;
+static pid_t    xvfb_pid;
+
+static void
+_xvfb_stop(void)
+{
+    if (disp)
+        XCloseDisplay(disp);
+    disp = NULL;
+    if (xvfb_pid > 0)
+    {
+        kill(xvfb_pid, SIGTERM);
+        waitpid(xvfb_pid, NULL, 0);
+    }
+    xvfb_pid = 0;
+}
+
+/* Start an Xvfb, which tells its display number on a pipe */
+static bool
+_xvfb_start(void)
+{
+    char            buf[32], fdarg[16];
+    ssize_t         nr;
+    size_t          n;
+    int             fd[2];
+
+    if (pipe(fd) < 0)
+        return false;
+
+    xvfb_pid = fork();
+    if (xvfb_pid < 0)
+        return false;
+
+    if (xvfb_pid == 0)
+    {
+        close(fd[0]);
+        snprintf(fdarg, sizeof(fdarg), "%d", fd[1]);
+        execlp("Xvfb", "Xvfb", "-displayfd", fdarg, "-screen", "0",
+               "320x240x24", "-nolisten", "tcp", (char *)NULL);
+        _exit(127);
+    }
+
+    close(fd[1]);
+    buf[0] = ':';
+    for (n = 1; n < sizeof(buf) - 1 && !memchr(buf + 1, '\n', n - 1);
+         n += nr)
+    {
+        nr = read(fd[0], buf + n, sizeof(buf) - 1 - n);
+        if (nr <= 0)
+            break;
+    }
+    close(fd[0]);
+    buf[n] = '\0';
+    buf[strcspn(buf, "\n")] = '\0';
+    if (strlen(buf) < 2)
+    {
+        _xvfb_stop();
+        return false;
+    }
+
+    setenv("DISPLAY", buf, 1);
+    return true;
+}
+
+/* The display, or NULL if there is no server */
+static Display *
+_display(void)
+{
+    static bool     tried;
+
+    if (tried)
+        return disp;
+    tried = true;
+
+    if (!getenv("DISPLAY") && !_xvfb_start())
+        return NULL;
+    disp = XOpenDisplay(NULL);
+    if (!disp)
+        return NULL;
+    atexit(_xvfb_stop);
+
+    imlib_context_set_display(disp);
+    imlib_context_set_visual(DefaultVisual(disp, DefaultScreen(disp)));
+    imlib_context_set_colormap(DefaultColormap(disp, DefaultScreen(disp)));
+
+    return disp;
+}
+
+#define NEED_DISPLAY() \
+    if (!_display()) \
+        GTEST_SKIP() << "No X server"
+
+static          uint32_t
+_rand(uint32_t *seed)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return *seed >> 16;
+}
+
+/* An image of random colors, opaque unless alpha is set */
+static          Imlib_Image
+_image(uint32_t seed, bool alpha)
+{
+    Imlib_Image     im;
+    uint32_t       *data;
+    uint32_t        a;
+    int             i;
+
+    im = imlib_create_image(W, H);
+    imlib_context_set_image(im);
+    imlib_image_set_has_alpha(alpha);
+    data = imlib_image_get_data();
+    for (i = 0; i < W * H; i++)
+    {
+        a = alpha ? _rand(&seed) & 0xff : 0xff;
+        data[i] = a << 24 | _rand(&seed) << 8 | (_rand(&seed) & 0xff);
+    }
+    imlib_image_put_back_data(data);
+
+    return im;
+}
+
+static          Pixmap
+_pixmap(Display *d, int w, int h)
+{
+    return XCreatePixmap(d, DefaultRootWindow(d), w, h,
+                         DefaultDepth(d, DefaultScreen(d)));
+}
+
+/* Render an image blended onto another, scaled, and grab the result */
+static bool
+_render_grab(uint32_t *out)
+{
+    Imlib_Image     grab;
+    Display        *d;
+    Pixmap          pmap;
+
+    d = XOpenDisplay(NULL);
+    if (!d)
+        return false;
+    imlib_context_set_display(d);
+    imlib_context_set_visual(DefaultVisual(d, DefaultScreen(d)));
+    imlib_context_set_colormap(DefaultColormap(d, DefaultScreen(d)));
+
+    pmap = _pixmap(d, PW, PH);
+    imlib_context_set_drawable(pmap);
+    imlib_context_set_anti_alias(1);
+
+    _image(2, false);
+    imlib_context_set_blend(0);
+    imlib_render_image_on_drawable_at_size(0, 0, PW, PH);
+    imlib_free_image();
+
+    _image(3, true);
+    imlib_context_set_blend(1);
+    imlib_render_image_on_drawable_at_size(0, 0, PW, PH);
+    imlib_free_image();
+
+    grab = imlib_create_image_from_drawable(0, 0, 0, PW, PH, 0);
+    if (!grab)
+        return false;
+    imlib_context_set_image(grab);
+    memcpy(out, imlib_image_get_data_for_reading_only(),
+           PW * PH * sizeof(uint32_t));
+    imlib_free_image();
+
+    XFreePixmap(d, pmap);
+    XCloseDisplay(d);
+
+    return true;
+}
+
+/* Run func with threads threads in a child with its own connection */
+static bool
+_run_threads(const char *threads, bool (*func)(uint32_t *), uint32_t *out,
+             size_t len)
+{
+    ssize_t         nr;
+    size_t          n;
+    pid_t           pid;
+    int             fd[2], status;
+
+    if (pipe(fd) < 0)
+        return false;
+
+    pid = fork();
+    if (pid < 0)
+        return false;
+
+    if (pid == 0)
+    {
+        close(fd[0]);
+        setenv("IMLIB2_THREADS", threads, 1);
+        if (!func(out))
+            _exit(1);
+        for (n = 0; n < len; n += nr)
+        {
+            nr = write(fd[1], (char *)out + n, len - n);
+            if (nr <= 0)
+                _exit(1);
+        }
+        _exit(0);
+    }
+
+    close(fd[1]);
+    for (n = 0; n < len; n += nr)
+    {
+        nr = read(fd[0], (char *)out + n, len - n);
+        if (nr <= 0)
+            break;
+    }
+    close(fd[0]);
+
+    if (waitpid(pid, &status, 0) != pid)
+        return false;
+
+    return n == len && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/* First differing pixel, -1 if none */
+static int
+_diff(const uint32_t *p, const uint32_t *q, int n)
+{
+    int             i;
+
+    for (i = 0; i < n; i++)
+    {
+        if (p[i] != q[i])
+            return i;
+    }
+
+    return -1;
+}
+
+TEST(X11, render_leaves_no_events)
+{
+    Imlib_Image     im;
+    Pixmap          pmap;
+    int             i;
+
+    NEED_DISPLAY();
+
+    im = _image(1, false);
+    pmap = _pixmap(disp, W, H);
+    imlib_context_set_drawable(pmap);
+    imlib_context_set_image(im);
+    for (i = 0; i < 8; i++)
+        imlib_render_image_on_drawable(0, 0);
+    XSync(disp, False);
+
+    /* No completion events of shared puts for the application */
+    EXPECT_EQ(XPending(disp), 0);
+
+    XFreePixmap(disp, pmap);
+    imlib_free_image();
+}
+
+TEST(X11, threaded_render_matches_single)
+{
+    std::vector<uint32_t> ref(PW * PH), out(PW * PH);
+    int             i;
+
+    NEED_DISPLAY();
+
+    ASSERT_TRUE(_run_threads("1", _render_grab, ref.data(),
+                             PW * PH * sizeof(uint32_t)));
+    ASSERT_TRUE(_run_threads("4", _render_grab, out.data(),
+                             PW * PH * sizeof(uint32_t)));
+
+    i = _diff(ref.data(), out.data(), PW * PH);
+    EXPECT_EQ(i, -1) << "x=" << i % PW << " y=" << i / PW << std::hex
+        << " c=" << ref[i] << " got=" << out[i];
+}
+
+/* Compare the RGB of a grab of x, y, w, h with the image it was put from */
+static void
+_check_grab(Imlib_Image im, Imlib_Image grab, int x, int y, int w, int h)
+{
+    const uint32_t *p, *q;
+    int             i, j;
+
+    imlib_context_set_image(im);
+    p = imlib_image_get_data_for_reading_only();
+    imlib_context_set_image(grab);
+    ASSERT_EQ(imlib_image_get_width(), w);
+    ASSERT_EQ(imlib_image_get_height(), h);
+    q = imlib_image_get_data_for_reading_only();
+
+    for (j = 0; j < h; j++)
+    {
+        for (i = 0; i < w; i++)
+        {
+            if (((p[(y + j) * W + x + i] ^ q[j * w + i]) & 0xffffff) == 0)
+                continue;
+            ADD_FAILURE() << "x=" << x + i << " y=" << y + j << std::hex
+                << " c=" << p[(y + j) * W + x + i] << " got=" << q[j * w + i];
+            return;
+        }
+    }
+}
+
+TEST(X11, put_grab_round_trip)
+{
+    static const int rects[][4] = {
+        { 0, 0, W, H }, { 5, 7, 40, 30 }, { 0, 0, W, H }, { W - 1, 0, 1, H },
+    };
+    Imlib_Image     im, grab;
+    Pixmap          pmap;
+    unsigned int    i;
+
+    NEED_DISPLAY();
+    if (DefaultDepth(disp, DefaultScreen(disp)) != 24)
+        GTEST_SKIP() << "Needs a depth 24 screen";
+
+    pmap = _pixmap(disp, W, H);
+    imlib_context_set_drawable(pmap);
+    imlib_context_set_blend(0);
+
+    /* Grabs reuse the shared segment, so put new content each time */
+    for (i = 0; i < sizeof(rects) / sizeof(rects[0]); i++)
+    {
+        im = _image(10 + i, false);
+        imlib_render_image_on_drawable(0, 0);
+        grab = imlib_create_image_from_drawable(0, rects[i][0], rects[i][1],
+                                                rects[i][2], rects[i][3], 0);
+        ASSERT_TRUE(grab != NULL);
+        _check_grab(im, grab, rects[i][0], rects[i][1], rects[i][2],
+                    rects[i][3]);
+        imlib_context_set_image(grab);
+        imlib_free_image();
+        imlib_context_set_image(im);
+        imlib_free_image();
+    }
+
+    XFreePixmap(disp, pmap);
+}
+
+/* Render an image blended or not onto a background, at scale times its
+ * size, with or without RENDER, and grab the result */
+static          Imlib_Image
+_render_xrender(bool xrender, bool blend, int scale)
+{
+    Imlib_Image     im;
+    Pixmap          pmap;
+
+    pmap = _pixmap(disp, W * scale, H * scale);
+    imlib_context_set_drawable(pmap);
+    imlib_context_set_anti_alias(0);
+
+    _image(20, false);
+    imlib_context_set_xrender(0);
+    imlib_context_set_blend(0);
+    imlib_render_image_on_drawable_at_size(0, 0, W * scale, H * scale);
+    imlib_free_image();
+
+    _image(21, blend);
+    imlib_context_set_xrender(xrender);
+    imlib_context_set_blend(blend);
+    imlib_render_image_on_drawable_at_size(0, 0, W * scale, H * scale);
+    imlib_free_image();
+    imlib_context_set_xrender(0);
+
+    im = imlib_create_image_from_drawable(0, 0, 0, W * scale, H * scale, 0);
+    XFreePixmap(disp, pmap);
+
+    return im;
+}
+
+/*
+ * The RENDER path is close to the client side one. Unscaled and integer
+ * nearest neighbour scaled copies must be the same, blending premultiplied
+ * may round a little differently.
+ * Servers without RENDER fall back to the client side, and pass.
+ */
+TEST(X11, xrender_matches_client_side)
+{
+    Imlib_Image     ref, out;
+    const uint32_t *p, *q;
+    int             blend, scale, i, n, d, tol;
+
+    NEED_DISPLAY();
+    if (DefaultDepth(disp, DefaultScreen(disp)) != 24)
+        GTEST_SKIP() << "Needs a depth 24 screen";
+
+    for (blend = 0; blend < 2; blend++)
+    {
+        for (scale = 1; scale <= 2; scale++)
+        {
+            ref = _render_xrender(false, blend, scale);
+            out = _render_xrender(true, blend, scale);
+            ASSERT_TRUE(ref && out);
+
+            tol = blend ? 2 : 0;
+            n = W * scale * H * scale;
+            imlib_context_set_image(ref);
+            p = imlib_image_get_data_for_reading_only();
+            imlib_context_set_image(out);
+            q = imlib_image_get_data_for_reading_only();
+            for (i = 0; i < n * 3; i++)
+            {
+                d = (int)((p[i / 3] >> (8 * (i % 3))) & 0xff) -
+                    (int)((q[i / 3] >> (8 * (i % 3))) & 0xff);
+                if (d < -tol || d > tol)
+                    break;
+            }
+            EXPECT_EQ(i, n * 3) << "blend=" << blend << " scale=" << scale
+                << " x=" << i / 3 % (W * scale) << " y="
+                << i / 3 / (W * scale) << std::hex << " c=" << p[i / 3]
+                << " got=" << q[i / 3];
+
+            imlib_free_image();
+            imlib_context_set_image(ref);
+            imlib_free_image();
+        }
+    }
+}